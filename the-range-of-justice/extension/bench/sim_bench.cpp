@@ -0,0 +1,1376 @@
+// 模拟核心的基准测试（不依赖 Godot）
+// 用法: sim_bench [场景名|all] [tick 数] [trace 输出目录]
+//       sim_bench --record <回放文件> <场景名> [tick 数]
+//       sim_bench --replay <回放文件> [每 tick 耗时.csv]
+//       sim_bench --snapshot [存档路径]      （512x512 地图、1 万单位的存档 / 读档耗时）
+//       sim_bench --bake [烘焙文件路径]      （烘焙流场的生成 / 映射耗时，以及修改代价后的失效检查）
+//       sim_bench --avoidance [tick 数]      （5000 个单位对穿，比较力模型与 ORCA 的耗时、抖动和重叠）
+//       sim_bench --rate [模拟秒数]          （spawn_block 分别以 60 / 30 / 20 Hz 模拟同样长的游戏时间）
+//       sim_bench --lod [tick 数]            （8000 个单位分 8 队在大地图上行军，镜头只看一角，比较全速更新与 LOD 降频）
+//       sim_bench --influence [tick 数]      （同上的行军，以及 1024x1024 地图上 4 个阵营的密集方阵，比较开启 / 关闭影响力图的耗时、峰值和查询耗时）
+//       sim_bench --teams                    （1 万个单位分两个阵营挤在一起，比较逐个过滤与按阵营分段的敌人查询）
+//       sim_bench --bounded [tick 数]        （1000x1000 地图上 40 次短距离移动，比较完整计算与有界计算的流场耗时和结果）
+//       sim_bench --budget [微秒] [tick 数]  （大 / 小地图上每 tick 只算一个流场与按预算分摊流场计算的 tick 耗时峰值和流场吞吐）
+//       sim_bench --replication [tick 数]    （同 --lod 的行军，向完整 / 差分 / 关注区域三种客户端同步状态，比较每 tick 的字节数并校验解码结果）
+//       sim_bench --steady [tick 数]         （各场景预热后不再下命令，统计之后的堆分配次数，不为 0 时返回 1）
+// 每个场景输出 ms/tick 和 allocs/tick（通过替换全局 operator new 统计）
+// 以 -DSIM_PROFILING=ON 构建时额外输出各阶段耗时，并可把每个场景导出为 <目录>/<场景名>.trace.json
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <new>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <deque>
+
+#include "flow_field.h"
+#include "unit_types.h"
+#include "unit_system.h"
+#include "building_system.h"
+#include "profiler.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "replication.h"
+#include "alloc_counter.h"
+
+// --- 分配计数 ---
+#ifdef SIM_COUNT_ALLOCATIONS
+// 核心库已经替换了 operator new，直接读它的计数
+static uint64_t get_alloc_count() { return sim::get_allocation_count(); }
+static uint64_t get_alloc_bytes() { return sim::get_allocation_bytes(); }
+#else
+static uint64_t g_alloc_count = 0;
+static uint64_t g_alloc_bytes = 0;
+
+static uint64_t get_alloc_count() { return g_alloc_count; }
+static uint64_t get_alloc_bytes() { return g_alloc_bytes; }
+
+void* operator new(std::size_t p_size) {
+    ++g_alloc_count;
+    g_alloc_bytes += p_size;
+    if (void* ptr = std::malloc(p_size ? p_size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t p_size) {
+    return operator new(p_size);
+}
+
+void operator delete(void* p_ptr) noexcept { std::free(p_ptr); }
+void operator delete[](void* p_ptr) noexcept { std::free(p_ptr); }
+void operator delete(void* p_ptr, std::size_t) noexcept { std::free(p_ptr); }
+void operator delete[](void* p_ptr, std::size_t) noexcept { std::free(p_ptr); }
+#endif
+
+using namespace sim;
+
+namespace {
+
+    const double TICK_DELTA = 1.0 / 60.0;
+
+    // 一个完整的模拟世界，与 main.tscn 中的节点一一对应
+    // 外部输入和各个 Manager 一样经过 ReplayRecorder，以便录制基准场景
+    struct World {
+        FlowFieldSystem flow_fields;
+        UnitTypeTable unit_types;
+        UnitSystem units;
+        BuildingSystem buildings;
+        SelectionInput selection;
+
+        void setup(int p_width, int p_height, Vec2i p_cell_size, Vec2i p_origin) {
+            ReplayRecorder::get().record_setup(p_width, p_height, p_cell_size, p_origin);
+            flow_fields.setup_grid(p_width, p_height, p_origin, p_cell_size);
+
+            // 与 UnitManager 的调试默认值一致
+            unit_types.ensure_type(0);
+            unit_types.apply_defaults(200.0f, 28.0f, 32.0f);
+
+            units.set_flow_field_system(&flow_fields);
+            units.set_unit_types(&unit_types);
+            units.setup(p_width, p_height, p_cell_size, p_origin);
+
+            buildings.set_flow_field_system(&flow_fields);
+            buildings.set_unit_system(&units);
+        }
+
+        SimulationRefs get_refs() {
+            SimulationRefs target;
+            target.flow_fields = &flow_fields;
+            target.unit_types = &unit_types;
+            target.units = &units;
+            target.buildings = &buildings;
+            return target;
+        }
+
+        void set_cost(Vec2i p_cell, uint8_t p_cost) {
+            ReplayRecorder::get().record_set_cost(p_cell, p_cost);
+            flow_fields.set_cost(p_cell, p_cost);
+        }
+
+        void set_cost_region(Rect2i p_region, uint8_t p_cost) {
+            ReplayRecorder::get().record_set_cost_region(p_region, p_cost);
+            flow_fields.set_cost_region(p_region, p_cost);
+        }
+
+        int spawn(Vec2 p_world_pos, int p_type, int p_team = 0) {
+            ReplayRecorder::get().record_spawn(units, p_world_pos, p_type, p_team);
+            return units.spawn_unit(p_world_pos, p_type, p_team);
+        }
+
+        void command(const std::vector<int>& p_ids, Vec2 p_target) {
+            ReplayRecorder::get().record_command_move(p_ids.data(), (int)p_ids.size(), p_target);
+            units.command_units_to_move(p_ids.data(), (int)p_ids.size(), p_target);
+        }
+
+        int place_building(Vec2i p_grid_pos, Vec2i p_size, int p_type) {
+            ReplayRecorder::get().record_place_building(p_grid_pos, p_size, p_type);
+            return buildings.place_building(p_grid_pos, p_size, p_type);
+        }
+
+        void remove_building(int p_building_id) {
+            ReplayRecorder::get().record_remove_building(p_building_id);
+            buildings.remove_building(p_building_id);
+        }
+
+        void tick(double p_delta) {
+            ReplayRecorder& recorder = ReplayRecorder::get();
+            recorder.record_tick_begin(p_delta, selection, units);
+            units.tick(p_delta, selection);
+            recorder.record_tick_end(selection, units);
+        }
+
+        Vec2 grid_to_world(Vec2i p_cell) const {
+            Vec2i cell_size = flow_fields.get_cell_size();
+            return Vec2((p_cell.x + 0.5f) * cell_size.x, (p_cell.y + 0.5f) * cell_size.y);
+        }
+
+        void command_all(Vec2 p_target) {
+            std::vector<int> ids;
+            ids.reserve(units.units.size());
+            for (const UnitData& unit : units.units) {
+                ids.push_back(unit.id);
+            }
+            command(ids, p_target);
+        }
+    };
+
+    struct Scenario {
+        const char* name;
+        int default_ticks;
+        std::function<void(World&)> setup;
+        std::function<void(World&, int)> before_tick;   // 每 tick 开始前的外部输入（可为空）
+    };
+
+    // main.gd 中的 40x40 出生方阵：地图为 main.tscn 的 TileMapLayer (200x100，128 像素)
+    void setup_spawn_block(World& p_world) {
+        p_world.setup(200, 100, Vec2i(128, 128), Vec2i(-60, -34));
+        for (int x = 0; x < 40; ++x) {
+            for (int y = 0; y < 40; ++y) {
+                p_world.spawn(Vec2(-16.0f * x, -16.0f * y), 0);
+            }
+        }
+        p_world.command_all(Vec2(4000, 2000));
+    }
+
+    // 1 万个单位穿过一张有多道墙的地图，墙上留有缺口
+    void setup_crossing(World& p_world) {
+        const int width = 256;
+        const int height = 256;
+        p_world.setup(width, height, Vec2i(16, 16), Vec2i(0, 0));
+
+        for (int wall_x = 48; wall_x < width - 32; wall_x += 40) {
+            int gap = 16 + (wall_x * 7) % (height - 48);
+            p_world.set_cost_region(Rect2i(wall_x, 0, 2, gap), 255);
+            p_world.set_cost_region(Rect2i(wall_x, gap + 12, 2, height - gap - 12), 255);
+        }
+
+        for (int i = 0; i < 10000; ++i) {
+            int x = i % 100;
+            int y = i / 100;
+            p_world.spawn(Vec2(8.0f + x * 4.0f, 8.0f + y * 40.0f), 0);
+        }
+        p_world.command_all(p_world.grid_to_world(Vec2i(width - 8, height / 2)));
+    }
+
+    // 单位移动的同时，每 tick 放置一个建筑，并移除 30 tick 前放置的建筑
+    std::mt19937 churn_rng;
+    int churn_next_to_remove = 0;
+
+    void setup_building_churn(World& p_world) {
+        p_world.setup(128, 128, Vec2i(32, 32), Vec2i(0, 0));
+        churn_rng.seed(12345);
+        churn_next_to_remove = 0;
+
+        for (int i = 0; i < 2000; ++i) {
+            p_world.spawn(Vec2(16.0f + (i % 50) * 12.0f, 16.0f + (i / 50) * 12.0f), 0);
+        }
+        p_world.command_all(p_world.grid_to_world(Vec2i(120, 120)));
+    }
+
+    void building_churn_tick(World& p_world, int) {
+        std::uniform_int_distribution<int> pos(20, 110);
+        p_world.place_building(Vec2i(pos(churn_rng), pos(churn_rng)), Vec2i(3, 3), 0);
+        if (p_world.buildings.get_building_count() > 30) {
+            // 建筑 ID 单调递增（放置失败不占 ID），最早放置的先移除
+            p_world.remove_building(churn_next_to_remove++);
+        }
+    }
+
+    // 100 个同时存在的流场，每个流场由一小队单位使用
+    void setup_concurrent_fields(World& p_world) {
+        const int width = 256;
+        const int height = 256;
+        p_world.setup(width, height, Vec2i(16, 16), Vec2i(0, 0));
+
+        std::mt19937 rng(777);
+        std::uniform_int_distribution<int> cell(4, width - 5);
+        for (int group = 0; group < 100; ++group) {
+            std::vector<int> ids;
+            for (int i = 0; i < 20; ++i) {
+                Vec2 pos = p_world.grid_to_world(Vec2i(cell(rng), cell(rng)));
+                ids.push_back(p_world.spawn(pos, 0));
+            }
+            Vec2 target = p_world.grid_to_world(Vec2i(cell(rng), cell(rng)));
+            p_world.command(ids, target);
+        }
+    }
+
+#ifdef SIM_PROFILING
+    // 环形缓冲区中最近若干帧的平均值
+    void print_phase_breakdown() {
+        std::vector<ProfileFrame> frames;
+        int count = Profiler::get().get_frames(Profiler::CAPACITY, frames);
+        if (count == 0) return;
+
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            int64_t total_us = 0;
+            for (const ProfileFrame& frame : frames) total_us += frame.phase_us[phase];
+            if (total_us == 0) continue;
+            std::printf("    %-24s %10.3f ms\n", get_phase_name(phase), total_us / 1000.0 / count);
+        }
+        for (int counter = 0; counter < COUNTER_COUNT; ++counter) {
+            int64_t total = 0;
+            for (const ProfileFrame& frame : frames) total += frame.counters[counter];
+            std::printf("    %-24s %12.1f\n", get_counter_name(counter), (double)total / count);
+        }
+    }
+#endif
+
+    const Scenario SCENARIOS[] = {
+        { "spawn_block", 600, setup_spawn_block, nullptr },
+        { "crossing_10k", 120, setup_crossing, nullptr },
+        { "building_churn", 300, setup_building_churn, building_churn_tick },
+        { "concurrent_fields", 300, setup_concurrent_fields, nullptr },
+    };
+
+    void run_scenario(const Scenario& p_scenario, int p_ticks, const char* p_trace_dir) {
+        Profiler::get().reset();
+
+        World world;
+        p_scenario.setup(world);
+
+        std::vector<double> tick_ms;
+        tick_ms.reserve(p_ticks);
+
+        uint64_t allocs_before = get_alloc_count();
+        uint64_t bytes_before = get_alloc_bytes();
+        double total_ms = 0.0;
+
+        for (int tick = 0; tick < p_ticks; ++tick) {
+            if (p_scenario.before_tick) {
+                p_scenario.before_tick(world, tick);
+            }
+
+            SIM_PROFILE_FRAME_BEGIN();
+            auto start = std::chrono::steady_clock::now();
+            world.tick(TICK_DELTA);
+            auto end = std::chrono::steady_clock::now();
+            SIM_PROFILE_FRAME_END();
+
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            tick_ms.push_back(ms);
+            total_ms += ms;
+        }
+
+        // tick_ms 已经预留空间，不计入统计
+        uint64_t allocs = get_alloc_count() - allocs_before;
+        uint64_t bytes = get_alloc_bytes() - bytes_before;
+
+        std::sort(tick_ms.begin(), tick_ms.end());
+        double p99 = tick_ms[std::min((size_t)(p_ticks * 0.99), tick_ms.size() - 1)];
+
+        std::printf("%-18s %6d %8d %10.3f %10.3f %10.3f %12.1f %12.1f\n",
+            p_scenario.name, world.units.get_unit_count(), p_ticks,
+            total_ms / p_ticks, p99, tick_ms.back(),
+            (double)allocs / p_ticks, (double)bytes / p_ticks / 1024.0);
+
+#ifdef SIM_PROFILING
+        print_phase_breakdown();
+        if (p_trace_dir) {
+            std::string path = std::string(p_trace_dir) + "/" + p_scenario.name + ".trace.json";
+            if (!Profiler::get().write_chrome_trace(path, Profiler::CAPACITY)) {
+                std::fprintf(stderr, "failed to write %s\n", path.c_str());
+            }
+        }
+#else
+        (void)p_trace_dir;
+#endif
+    }
+
+    const Scenario* find_scenario(const char* p_name) {
+        for (const Scenario& scenario : SCENARIOS) {
+            if (std::strcmp(p_name, scenario.name) == 0) return &scenario;
+        }
+        return nullptr;
+    }
+
+    double elapsed_ms(std::chrono::steady_clock::time_point p_start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - p_start).count();
+    }
+
+    // 512x512 地图、1 万个单位、若干个已算好的流场，测量存档和读档的耗时
+    int run_snapshot(const char* p_path) {
+        World world;
+        world.setup(512, 512, Vec2i(16, 16), Vec2i(0, 0));
+
+        std::mt19937 rng(99);
+        std::uniform_int_distribution<int> cell(0, 511);
+        for (int i = 0; i < 20000; ++i) {
+            world.set_cost(Vec2i(cell(rng), cell(rng)), 255);
+        }
+        for (int group = 0; group < 8; ++group) {
+            std::vector<int> ids;
+            for (int i = 0; i < 1250; ++i) {
+                ids.push_back(world.spawn(world.grid_to_world(Vec2i(cell(rng), cell(rng))), 0));
+            }
+            world.command(ids, world.grid_to_world(Vec2i(cell(rng), cell(rng))));
+        }
+        for (int tick = 0; tick < 10; ++tick) {
+            world.tick(TICK_DELTA);
+        }
+
+        uint64_t checksum = world.units.compute_checksum();
+        std::printf("%-28s %10s %12s\n", "snapshot", "ms", "MiB");
+
+        for (int with_fields = 0; with_fields <= 1; ++with_fields) {
+            auto start = std::chrono::steady_clock::now();
+            bool saved = save_snapshot(p_path, world.get_refs(), with_fields != 0);
+            double save_ms = elapsed_ms(start);
+            if (!saved) {
+                std::fprintf(stderr, "failed to write %s\n", p_path);
+                return 1;
+            }
+
+            World loaded;
+            SimulationRefs refs = loaded.get_refs();
+            std::string error;
+            start = std::chrono::steady_clock::now();
+            bool ok = load_snapshot(p_path, refs, error);
+            double load_ms = elapsed_ms(start);
+            if (!ok) {
+                std::fprintf(stderr, "failed to load %s: %s\n", p_path, error.c_str());
+                return 1;
+            }
+
+            FILE* file = std::fopen(p_path, "rb");
+            std::fseek(file, 0, SEEK_END);
+            double mib = std::ftell(file) / (1024.0 * 1024.0);
+            std::fclose(file);
+
+            const char* label = with_fields ? "with flow fields" : "units + map";
+            std::printf("save %-23s %10.3f %12.2f\n", label, save_ms, mib);
+            std::printf("load %-23s %10.3f %12s\n", label, load_ms,
+                loaded.units.compute_checksum() == checksum ? "(match)" : "(MISMATCH)");
+            if (loaded.units.compute_checksum() != checksum) return 2;
+        }
+        return 0;
+    }
+
+    // 在当前地图上单独算一遍流场，和烘焙流场逐格比较，返回不一致的格子数
+    int count_baked_mismatches(const FlowFieldSystem& p_source, const FlowField& p_baked, const std::vector<int>& p_ignored) {
+        FlowFieldSystem reference;
+        reference.setup_grid(p_source.get_width(), p_source.get_height(), p_source.get_grid_origin(), p_source.get_cell_size());
+        reference.restore_cost_layers(p_source.get_terrain_costs().data(), p_source.get_building_occupancy().data(),
+            p_source.get_cost_modifiers().data());
+        reference.create_flow_field(p_baked.target_position);
+        reference.process_one_task();
+        const FlowField& expected = reference.get_flow_fields().at(p_baked.target_position);
+
+        int mismatches = 0;
+        int cells = p_source.get_width() * p_source.get_height();
+        for (int index = 0; index < cells; ++index) {
+            // 被修改的格子本身允许保留旧值
+            if (std::find(p_ignored.begin(), p_ignored.end(), index) != p_ignored.end()) continue;
+            if (std::fabs(p_baked.integration_at(index) - expected.integration_at(index)) > 1e-3f ||
+                !(p_baked.direction_at(index) == expected.direction_at(index))) {
+                ++mismatches;
+            }
+        }
+        return mismatches;
+    }
+
+    // 512x512 地图上烘焙 8 个目标，测量烘焙、映射的耗时，再随机修改代价，检查仍保持烘焙状态的流场是否正确
+    // 两队各 2500 个单位相向而行，在地图中间交汇
+    void setup_head_on(World& p_world) {
+        p_world.setup(512, 256, Vec2i(16, 16), Vec2i(0, 0));
+
+        std::vector<int> left_ids;
+        std::vector<int> right_ids;
+        for (int i = 0; i < 2500; ++i) {
+            float x = 200.0f + (i % 50) * 60.0f;
+            float y = 600.0f + (i / 50) * 60.0f;
+            left_ids.push_back(p_world.spawn(Vec2(x, y), 0));
+            right_ids.push_back(p_world.spawn(Vec2(8192.0f - x, y), 0));
+        }
+        p_world.command(left_ids, p_world.grid_to_world(Vec2i(500, 128)));
+        p_world.command(right_ids, p_world.grid_to_world(Vec2i(12, 128)));
+    }
+
+    // 抖动：速度方向每 tick 的平均转角（度），只统计前后两 tick 都在移动的单位
+    // 重叠：每 10 tick 统计一次互相穿插（距离小于两倍碰撞半径）的单位对数
+    int run_avoidance(int p_ticks) {
+        const char* mode_names[] = { "forces", "orca" };
+
+        std::printf("%-10s %6s %8s %10s %10s %14s %12s %10s\n",
+            "mode", "units", "ticks", "ms/tick", "p99 ms", "jitter deg", "mean speed", "overlaps");
+
+        for (int mode = AVOIDANCE_FORCES; mode <= AVOIDANCE_ORCA; ++mode) {
+            World world;
+            world.units.avoidance_mode = (AvoidanceMode)mode;
+            setup_head_on(world);
+
+            std::vector<double> tick_ms;
+            tick_ms.reserve(p_ticks);
+            std::vector<Vec2> previous_velocities;
+            double total_ms = 0.0;
+            double total_turn = 0.0;
+            double total_speed = 0.0;
+            int64_t turn_samples = 0;
+            int64_t speed_samples = 0;
+            int64_t overlaps = 0;
+            int overlap_samples = 0;
+
+            for (int tick = 0; tick < p_ticks; ++tick) {
+                previous_velocities.clear();
+                for (const UnitData& unit : world.units.units) previous_velocities.push_back(unit.velocity);
+
+                auto start = std::chrono::steady_clock::now();
+                world.tick(TICK_DELTA);
+                double ms = elapsed_ms(start);
+                tick_ms.push_back(ms);
+                total_ms += ms;
+
+                // 没有单位死亡，下标在 tick 前后一一对应
+                for (size_t i = 0; i < world.units.units.size(); ++i) {
+                    Vec2 before = previous_velocities[i];
+                    Vec2 after = world.units.units[i].velocity;
+                    if (world.units.units[i].state != MOVING) continue;
+                    total_speed += after.length();
+                    ++speed_samples;
+                    if (before.length_squared() < 1.0f || after.length_squared() < 1.0f) continue;
+                    total_turn += std::fabs(std::atan2(before.cross(after), before.dot(after)));
+                    ++turn_samples;
+                }
+
+                if (tick % 10 == 0) {
+                    for (size_t i = 0; i < world.units.units.size(); ++i) {
+                        const UnitData& unit = world.units.units[i];
+                        float diameter = world.units.get_type_record(unit).collision_radius * 2.0f;
+                        for (int other : world.units.get_nearby_units(unit.position, diameter)) {
+                            if (other > (int)i) ++overlaps;
+                        }
+                    }
+                    ++overlap_samples;
+                }
+            }
+
+            std::sort(tick_ms.begin(), tick_ms.end());
+            double p99 = tick_ms[std::min((size_t)(p_ticks * 0.99), tick_ms.size() - 1)];
+            std::printf("%-10s %6d %8d %10.3f %10.3f %14.3f %12.1f %10.1f\n",
+                mode_names[mode], world.units.get_unit_count(), p_ticks, total_ms / p_ticks, p99,
+                turn_samples ? total_turn / turn_samples * 180.0 / 3.14159265 : 0.0,
+                speed_samples ? total_speed / speed_samples : 0.0,
+                overlap_samples ? (double)overlaps / overlap_samples : 0.0);
+        }
+        return 0;
+    }
+
+    // 每秒游戏时间的模拟耗时；到达：已经停下的单位；剩余距离：所有单位到目标的平均距离；
+    // 静止抖动：最后一秒里停下的单位的平均速度（摩擦积分不稳定时会明显大于 0）
+    int run_rate(double p_seconds) {
+        const int rates[] = { 60, 30, 20 };
+
+        std::printf("%-6s %6s %8s %12s %10s %14s %12s\n",
+            "hz", "units", "ticks", "ms/sim sec", "arrived", "mean distance", "idle speed");
+
+        for (int rate : rates) {
+            World world;
+            setup_spawn_block(world);
+
+            double step = 1.0 / rate;
+            int ticks = (int)std::lround(p_seconds * rate);
+            double total_ms = 0.0;
+            double idle_speed = 0.0;
+            int64_t idle_samples = 0;
+            for (int tick = 0; tick < ticks; ++tick) {
+                auto start = std::chrono::steady_clock::now();
+                world.tick(step);
+                total_ms += elapsed_ms(start);
+
+                if (tick >= ticks - rate) {
+                    for (const UnitData& unit : world.units.units) {
+                        if (unit.state != IDLE) continue;
+                        idle_speed += unit.velocity.length();
+                        ++idle_samples;
+                    }
+                }
+            }
+
+            int arrived = 0;
+            double distance = 0.0;
+            for (const UnitData& unit : world.units.units) {
+                if (unit.state == IDLE) ++arrived;
+                distance += unit.position.distance_to(unit.target_pos);
+            }
+            int count = world.units.get_unit_count();
+            std::printf("%-6d %6d %8d %12.3f %10d %14.1f %12.2f\n",
+                rate, count, ticks, total_ms / p_seconds, arrived, count ? distance / count : 0.0,
+                idle_samples ? idle_speed / idle_samples : 0.0);
+        }
+        return 0;
+    }
+
+    // 512x512 的空地图，8 个 1000 人的方阵（间距 72 像素）各自走到地图另一侧，左右两列分属两个阵营
+    void setup_lod_march(World& p_world) {
+        p_world.setup(512, 512, Vec2i(16, 16), Vec2i(0, 0));
+        for (int squad = 0; squad < 8; ++squad) {
+            std::vector<int> ids;
+            float origin_x = 200.0f + (squad % 2) * 4300.0f;
+            float origin_y = 200.0f + (squad / 2) * 2000.0f;
+            for (int i = 0; i < 1000; ++i) {
+                ids.push_back(p_world.spawn(Vec2(origin_x + (i % 50) * 72.0f, origin_y + (i / 50) * 72.0f), 0, squad % 2));
+            }
+            Vec2i target((squad % 2) ? 40 : 470, 60 + ((squad / 2) ^ 1) * 120);
+            p_world.command(ids, p_world.grid_to_world(target));
+        }
+    }
+
+    // 跳过：本 tick 没有重新计算受力的单位；到达：已经停下的单位；剩余距离：所有单位到目标的平均距离
+    int run_lod(int p_ticks) {
+        std::printf("%-6s %6s %8s %10s %10s %10s %10s %14s\n",
+            "lod", "units", "ticks", "ms/tick", "p99 ms", "skipped", "arrived", "mean distance");
+
+        for (int is_lod = 0; is_lod <= 1; ++is_lod) {
+            World world;
+            world.units.lod_enabled = is_lod != 0;
+            setup_lod_march(world);
+            world.units.set_lod_view(Rect2(Vec2(0, 0), Vec2(1280, 720)));
+
+            std::vector<double> tick_ms;
+            tick_ms.reserve(p_ticks);
+            double total_ms = 0.0;
+            int64_t skipped = 0;
+            for (int tick = 0; tick < p_ticks; ++tick) {
+                auto start = std::chrono::steady_clock::now();
+                world.tick(TICK_DELTA);
+                double ms = elapsed_ms(start);
+                tick_ms.push_back(ms);
+                total_ms += ms;
+                for (const UnitData& unit : world.units.units) {
+                    if (unit.lod_elapsed > 0) ++skipped;
+                }
+            }
+
+            int arrived = 0;
+            double distance = 0.0;
+            for (const UnitData& unit : world.units.units) {
+                if (unit.state == IDLE) ++arrived;
+                distance += unit.position.distance_to(unit.target_pos);
+            }
+            int count = world.units.get_unit_count();
+            std::sort(tick_ms.begin(), tick_ms.end());
+            double p99 = tick_ms[std::min((size_t)(p_ticks * 0.99), tick_ms.size() - 1)];
+            std::printf("%-6s %6d %8d %10.3f %10.3f %9.1f%% %10d %14.1f\n",
+                is_lod ? "on" : "off", count, p_ticks, total_ms / p_ticks, p99,
+                100.0 * skipped / ((double)count * p_ticks), arrived, count ? distance / count : 0.0);
+        }
+        return 0;
+    }
+
+    // 1024x1024 的空地图，4 个阵营各 2 个 1000 人的密集方阵（间距 24 像素）散在地图各处，原地不动
+    // 扩散的尾巴要走过上千格，衰减到非规格化浮点数的范围
+    void setup_influence_blobs(World& p_world) {
+        p_world.setup(1024, 1024, Vec2i(16, 16), Vec2i(0, 0));
+        for (int blob = 0; blob < 8; ++blob) {
+            float origin_x = 600.0f + (blob % 4) * 4000.0f;
+            float origin_y = 600.0f + (blob / 4) * 12000.0f + (blob % 2) * 2000.0f;
+            for (int i = 0; i < 1000; ++i) {
+                p_world.spawn(Vec2(origin_x + (i % 40) * 24.0f, origin_y + (i / 40) * 24.0f), 0, blob % 4);
+            }
+        }
+        p_world.units.update_spatial_grid();
+    }
+
+    // 影响力图的开销：两个场景（--lod 的行军、大地图上的密集方阵）分别关闭 / 开启时的 ms/tick 和 tick 耗时峰值，
+    // 开启时 influence 阶段每 tick 的耗时（按 cell_budget 分片后的均摊值），以及每个阵营查一次敌方实力最高的 8 个峰值的耗时
+    // 第一个 tick 所有阵营都没有结果，会一次重算完，峰值不计这个 tick
+    int run_influence(int p_ticks) {
+        std::printf("%-8s %-10s %6s %8s %10s %10s %10s %14s %10s\n",
+            "map", "influence", "units", "ticks", "ms/tick", "p99 ms", "max ms", "phase ms/tick", "query ms");
+
+        struct Scenario {
+            const char* name;
+            void (*setup)(World&);
+        };
+        const Scenario scenarios[] = {
+            { "march", setup_lod_march },
+            { "blobs", setup_influence_blobs },
+        };
+
+        for (const Scenario& scenario : scenarios) {
+            for (int is_enabled = 0; is_enabled <= 1; ++is_enabled) {
+                World world;
+                world.units.influence_enabled = is_enabled != 0;
+                scenario.setup(world);
+
+                std::vector<double> tick_ms;
+                tick_ms.reserve(p_ticks);
+                double total_ms = 0.0;
+                for (int tick = 0; tick < p_ticks; ++tick) {
+                    auto start = std::chrono::steady_clock::now();
+                    world.tick(TICK_DELTA);
+                    double ms = elapsed_ms(start);
+                    if (tick > 0) tick_ms.push_back(ms);
+                    total_ms += ms;
+                }
+                if (tick_ms.empty()) tick_ms.push_back(0.0);
+
+                // 单独计时 update，与整个 tick 的计时互不干扰
+                InfluenceMap& influence = world.units.get_influence_map();
+                double phase_ms = 0.0;
+                double query_ms = 0.0;
+                if (is_enabled) {
+                    const int repeats = 100;
+                    auto start = std::chrono::steady_clock::now();
+                    for (int i = 0; i < repeats; ++i) {
+                        influence.update(world.units.units, world.units.unit_health, world.units.unit_shield, world.unit_types);
+                    }
+                    phase_ms = elapsed_ms(start) / repeats;
+
+                    InfluenceWeights weights;
+                    weights.enemy_strength = 1.0f;
+                    std::vector<InfluenceCell> cells;
+                    int team_count = std::max(influence.get_team_count(), 1);
+                    start = std::chrono::steady_clock::now();
+                    for (int i = 0; i < repeats; ++i) {
+                        influence.find_top_cells(i % team_count, weights, 8, true, cells);
+                    }
+                    query_ms = elapsed_ms(start) / repeats;
+                }
+
+                std::sort(tick_ms.begin(), tick_ms.end());
+                double p99 = tick_ms[std::min((size_t)(tick_ms.size() * 0.99), tick_ms.size() - 1)];
+                std::printf("%-8s %-10s %6d %8d %10.3f %10.3f %10.3f %14.3f %10.3f\n",
+                    scenario.name, is_enabled ? "on" : "off", world.units.get_unit_count(), p_ticks, total_ms / p_ticks, p99,
+                    tick_ms.back(), phase_ms, query_ms);
+            }
+        }
+        return 0;
+    }
+
+    // 4 个 2500 人的密集方阵（间距 24 像素），相邻的两两属于不同阵营并且互相挤在一起
+    void setup_team_blobs(World& p_world) {
+        p_world.setup(256, 256, Vec2i(16, 16), Vec2i(0, 0));
+        for (int blob = 0; blob < 4; ++blob) {
+            float origin_x = 400.0f + (blob % 2) * 1150.0f;
+            float origin_y = 400.0f + (blob / 2) * 1150.0f;
+            for (int i = 0; i < 2500; ++i) {
+                p_world.spawn(Vec2(origin_x + (i % 50) * 24.0f, origin_y + (i / 50) * 24.0f), 0, (blob + blob / 2) % 2);
+            }
+        }
+        p_world.units.update_spatial_grid();
+    }
+
+    // 每个单位各查一次攻击距离内的敌人：旧做法是 get_nearby_units 后逐个过滤阵营，
+    // 新做法按格子的阵营掩码和分段跳过本方；两种做法的结果必须一致
+    int run_team_queries() {
+        World world;
+        setup_team_blobs(world);
+        UnitSystem& units = world.units;
+        const float radius = 100.0f;
+        int count = units.get_unit_count();
+
+        std::printf("%-24s %6s %10s %10s\n", "query", "units", "ms total", "found");
+
+        std::vector<int> filtered_nearest(count, -1);
+        auto start = std::chrono::steady_clock::now();
+        int found = 0;
+        for (int i = 0; i < count; ++i) {
+            const UnitData& unit = units.units[i];
+            float best = radius * radius;
+            for (int other : units.get_nearby_units(unit.position, radius)) {
+                if (units.units[other].team == unit.team) continue;
+                float distance_squared = unit.position.distance_squared_to(units.units[other].position);
+                if (distance_squared < best || (distance_squared == best && other < filtered_nearest[i])) {
+                    best = distance_squared;
+                    filtered_nearest[i] = other;
+                }
+            }
+            if (filtered_nearest[i] != -1) ++found;
+        }
+        std::printf("%-24s %6d %10.3f %10d\n", "nearby + filter", count, elapsed_ms(start), found);
+
+        int mismatches = 0;
+        start = std::chrono::steady_clock::now();
+        found = 0;
+        for (int i = 0; i < count; ++i) {
+            const UnitData& unit = units.units[i];
+            int nearest = units.find_nearest_enemy(unit.position, unit.team, radius);
+            if (nearest != -1) ++found;
+            if (nearest != filtered_nearest[i]) ++mismatches;
+        }
+        std::printf("%-24s %6d %10.3f %10d\n", "find_nearest_enemy", count, elapsed_ms(start), found);
+
+        start = std::chrono::steady_clock::now();
+        found = 0;
+        for (const UnitData& unit : units.units) {
+            if (units.has_enemy_in_radius(unit.position, unit.team, radius)) ++found;
+        }
+        std::printf("%-24s %6d %10.3f %10d\n", "has_enemy_in_radius", count, elapsed_ms(start), found);
+
+        start = std::chrono::steady_clock::now();
+        int64_t allies = 0;
+        for (const UnitData& unit : units.units) {
+            allies += units.count_allies_in_radius(unit.position, unit.team, radius);
+        }
+        std::printf("%-24s %6d %10.3f %10lld\n", "count_allies_in_radius", count, elapsed_ms(start), (long long)allies);
+
+        std::printf("mismatches   %d\n", mismatches);
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    Vec2i get_local_move_base(int p_squad) {
+        return Vec2i(60 + (p_squad % 8) * 110, 60 + (p_squad / 8) * 180);
+    }
+
+    // 1000x1000 的大地图上 40 个小队各自做一次 20 格左右的短距离移动，每 3 tick 下一道命令
+    void setup_local_moves(World& p_world) {
+        const int size = 1000;
+        p_world.setup(size, size, Vec2i(16, 16), Vec2i(0, 0));
+
+        // 随机散布的墙，小队的出发区和目标周围留空
+        std::vector<uint8_t> costs((size_t)size * size, 1);
+        std::mt19937 rng(11);
+        std::uniform_int_distribution<int> cell(0, size - 1);
+        for (int i = 0; i < 40000; ++i) {
+            costs[(size_t)cell(rng) * size + cell(rng)] = 255;
+        }
+        for (int squad = 0; squad < 40; ++squad) {
+            Vec2i base = get_local_move_base(squad);
+            for (int y = base.y - 2; y < base.y + 10; ++y) {
+                std::fill(costs.begin() + (size_t)y * size + base.x - 2, costs.begin() + (size_t)y * size + base.x + 24, 1);
+            }
+        }
+        p_world.flow_fields.import_cost_map(costs.data(), (int)costs.size());
+    }
+
+    void local_moves_tick(World& p_world, int p_tick) {
+        const int SQUADS = 40;
+        if (p_tick % 3 != 0 || p_tick / 3 >= SQUADS) return;
+
+        Vec2i base = get_local_move_base(p_tick / 3);
+        std::vector<int> ids;
+        for (int i = 0; i < 25; ++i) {
+            ids.push_back(p_world.spawn(p_world.grid_to_world(base + Vec2i(i % 5, i / 5)), 0));
+        }
+        p_world.command(ids, p_world.grid_to_world(base + Vec2i(20, 6)));
+    }
+
+    // 同样的命令分别用完整计算和有界计算各跑一遍：单位的结果必须一致，
+    // 有界计算已确定的格子上方向必须与完整计算相同
+    int run_bounded(int p_ticks) {
+        std::printf("%-8s %6s %8s %10s %10s %12s %18s\n", "bounded", "units", "ticks", "ms/tick", "max ms", "cells/field", "checksum");
+
+        World worlds[2];
+        uint64_t checksums[2] = {};
+        for (int is_bounded = 0; is_bounded <= 1; ++is_bounded) {
+            World& world = worlds[is_bounded];
+            world.flow_fields.set_bounded_integration(is_bounded != 0);
+            // 两次运行要逐格比较，不能让计时决定每 tick 算到哪里
+            world.flow_fields.set_compute_budget_us(0);
+            setup_local_moves(world);
+            // 第一 tick 合成整张代价图、建墙壁距离场，不计入
+            world.tick(TICK_DELTA);
+
+            double total_ms = 0.0;
+            double max_ms = 0.0;
+            for (int tick = 0; tick < p_ticks; ++tick) {
+                local_moves_tick(world, tick);
+                auto start = std::chrono::steady_clock::now();
+                world.tick(TICK_DELTA);
+                double ms = elapsed_ms(start);
+                total_ms += ms;
+                max_ms = std::max(max_ms, ms);
+            }
+
+            // 每个流场改动过的格子数
+            double touched = 0.0;
+            const auto& fields = world.flow_fields.get_flow_fields();
+            for (const auto& it : fields) {
+                touched += (double)it.second.touched.size.x * it.second.touched.size.y;
+            }
+            checksums[is_bounded] = world.units.compute_checksum();
+            std::printf("%-8s %6d %8d %10.3f %10.3f %12.0f %18llx\n", is_bounded ? "on" : "off",
+                world.units.get_unit_count(), p_ticks, total_ms / p_ticks, max_ms,
+                fields.empty() ? 0.0 : touched / fields.size(), (unsigned long long)checksums[is_bounded]);
+        }
+
+        int mismatches = 0;
+        const auto& full_fields = worlds[0].flow_fields.get_flow_fields();
+        for (const auto& it : worlds[1].flow_fields.get_flow_fields()) {
+            const FlowField& bounded = it.second;
+            auto full = full_fields.find(it.first);
+            if (full == full_fields.end() || bounded.is_computing) continue;
+            for (size_t index = 0; index < bounded.integration_field.size(); ++index) {
+                if (!bounded.is_settled((int)index)) continue;
+                if (bounded.integration_field[index] != full->second.integration_field[index] ||
+                    bounded.flow_directions[index] != full->second.flow_directions[index]) {
+                    ++mismatches;
+                }
+            }
+        }
+        std::printf("mismatched cells  %d\n", mismatches);
+        return (mismatches == 0 && checksums[0] == checksums[1]) ? 0 : 1;
+    }
+
+    // 64x64 的小地图上 100 个小队同时下命令，每个流场都很小
+    void setup_small_orders(World& p_world) {
+        const int size = 64;
+        p_world.setup(size, size, Vec2i(16, 16), Vec2i(0, 0));
+
+        std::mt19937 rng(5);
+        std::uniform_int_distribution<int> cell(2, size - 3);
+        for (int group = 0; group < 100; ++group) {
+            std::vector<int> ids;
+            for (int i = 0; i < 5; ++i) {
+                ids.push_back(p_world.spawn(p_world.grid_to_world(Vec2i(cell(rng), cell(rng))), 0));
+            }
+            p_world.command(ids, p_world.grid_to_world(Vec2i(cell(rng), cell(rng))));
+        }
+    }
+
+    // 计算预算的效果：大地图上关闭有界计算，每个流场都是一次完整的 100 万格计算；
+    // 小地图上 100 个小流场同时排队。分别比较每 tick 只算一个流场（预算为 0）与按预算分摊时
+    // 的平均 / 最大 tick 耗时、算完的流场数，以及队列清空时的 tick
+    int run_budget(int p_ticks, int p_budget_us) {
+        std::printf("%-12s %8s %8s %10s %10s %8s %8s\n", "scenario", "budget", "ticks", "ms/tick", "max ms", "fields", "drained");
+
+        for (int is_large = 1; is_large >= 0; --is_large) {
+            for (int budget = 0; budget <= p_budget_us; budget += p_budget_us) {
+                World world;
+                world.flow_fields.set_compute_budget_us(budget);
+                int commands = 0;
+                if (is_large) {
+                    world.flow_fields.set_bounded_integration(false);
+                    setup_local_moves(world);
+                    // 第一 tick 合成整张代价图、建墙壁距离场，不计入
+                    world.tick(TICK_DELTA);
+                }
+                else {
+                    setup_small_orders(world);
+                    commands = 100;
+                }
+
+                double total_ms = 0.0;
+                double max_ms = 0.0;
+                int drained = -1;
+                for (int tick = 0; tick < p_ticks; ++tick) {
+                    if (is_large) {
+                        local_moves_tick(world, tick);
+                        if (tick % 3 == 0 && tick / 3 < 40) ++commands;
+                    }
+                    auto start = std::chrono::steady_clock::now();
+                    world.tick(TICK_DELTA);
+                    double ms = elapsed_ms(start);
+                    total_ms += ms;
+                    max_ms = std::max(max_ms, ms);
+
+                    bool is_all_commanded = !is_large || tick / 3 >= 40;
+                    if (drained < 0 && is_all_commanded && world.flow_fields.get_queue_length() == 0) {
+                        drained = tick + 1;
+                    }
+                }
+                std::printf("%-12s %8d %8d %10.3f %10.3f %8d %8d\n", is_large ? "large_1000" : "small_64",
+                    budget, p_ticks, total_ms / p_ticks, max_ms, commands - world.flow_fields.get_queue_length(), drained);
+                if (p_budget_us <= 0) break;
+            }
+        }
+        return 0;
+    }
+
+    // --- 状态同步 ---
+
+    // 进程内的回环连接：数据包和确认都延迟 latency tick 到达，数据包按 loss 的概率丢失
+    struct LoopbackLink {
+        struct Packet {
+            int deliver_tick;
+            uint32_t sequence;
+            std::vector<uint8_t> data;
+        };
+        struct Ack {
+            int deliver_tick;
+            uint32_t sequence;
+        };
+
+        int latency = 3;
+        double loss = 0.05;
+        std::deque<Packet> packets;
+        std::deque<Ack> acks;
+    };
+
+    // 一个同步客户端：服务端的编号、本地的模拟世界、回环连接和用来校验的期望快照
+    struct ReplicaSession {
+        const char* name;
+        int server_client = -1;
+        bool is_acknowledging = true;
+        bool has_interest = false;
+        Rect2 interest;
+
+        World world;
+        ReplicationClient client;
+        LoopbackLink link;
+        std::deque<std::pair<uint32_t, std::vector<ReplicatedUnit>>> expected;
+
+        uint64_t bytes = 0;
+        size_t max_bytes = 0;
+        uint64_t units_sent = 0;
+        double encode_ms = 0.0;
+        double decode_ms = 0.0;
+        int decoded = 0;
+        int mismatches = 0;
+        int errors = 0;
+    };
+
+    bool is_same_unit(const ReplicatedUnit& p_a, const ReplicatedUnit& p_b) {
+        return p_a.id == p_b.id && p_a.x == p_b.x && p_a.y == p_b.y && p_a.velocity_x == p_b.velocity_x &&
+            p_a.velocity_y == p_b.velocity_y && p_a.health == p_b.health && p_a.shield == p_b.shield &&
+            p_a.type == p_b.type && p_a.heading == p_b.heading && p_a.state == p_b.state && p_a.team == p_b.team;
+    }
+
+    // 8000 个单位的行军（同 --lod），同时向几个客户端同步：
+    //   full      不回确认，每个包都是完整的量化状态
+    //   delta     3 tick 延迟、5% 丢包，以确认过的快照为基准差分
+    //   interest  同上，只同步 1920x1080 的关注区域
+    // 与直接发送 UnitData 数组（raw）比较每 tick 的字节数；客户端解码出的状态必须与服务端量化后的状态完全一致
+    int run_replication(int p_ticks) {
+        World server_world;
+        setup_lod_march(server_world);
+        ReplicationServer server;
+        Vec2i cell_size = server_world.flow_fields.get_cell_size();
+
+        const int SESSION_COUNT = 3;
+        ReplicaSession sessions[SESSION_COUNT];
+        sessions[0].name = "full";
+        sessions[0].is_acknowledging = false;
+        sessions[1].name = "delta";
+        sessions[2].name = "interest";
+        sessions[2].has_interest = true;
+        sessions[2].interest = Rect2(Vec2(3000, 1500), Vec2(1920, 1080));
+
+        for (ReplicaSession& session : sessions) {
+            session.world.setup(512, 512, cell_size, Vec2i(0, 0));
+            session.server_client = server.add_client();
+            if (session.has_interest) {
+                server.set_client_interest(session.server_client, session.interest);
+            }
+        }
+
+        std::mt19937 rng(99);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        uint64_t raw_bytes = 0;
+        double max_error = 0.0;
+        std::vector<uint8_t> packet;
+        std::vector<int> indices;
+
+        for (int tick = 0; tick < p_ticks; ++tick) {
+            server_world.tick(TICK_DELTA);
+            raw_bytes += server_world.units.units.size() * (sizeof(UnitData) + 2 * sizeof(float));
+
+            for (ReplicaSession& session : sessions) {
+                // 1. 收到已经到达的确认
+                while (!session.link.acks.empty() && session.link.acks.front().deliver_tick <= tick) {
+                    server.acknowledge(session.server_client, session.link.acks.front().sequence);
+                    session.link.acks.pop_front();
+                }
+
+                // 2. 编码并发出
+                auto start = std::chrono::steady_clock::now();
+                uint32_t sequence = server.encode(session.server_client, server_world.units, (uint32_t)tick, packet);
+                session.encode_ms += elapsed_ms(start);
+                session.bytes += packet.size();
+                session.max_bytes = std::max(session.max_bytes, packet.size());
+
+                // 校验用：同样的单位集合直接量化
+                indices.clear();
+                if (session.has_interest) {
+                    server_world.units.collect_units_in_rect(session.interest, indices);
+                }
+                else {
+                    for (int i = 0; i < server_world.units.get_unit_count(); ++i) indices.push_back(i);
+                }
+                std::vector<ReplicatedUnit> expected;
+                for (int index : indices) {
+                    const UnitData& unit = server_world.units.units[index];
+                    expected.push_back(quantize_unit(server.get_quantizer(), cell_size, unit,
+                        server_world.units.unit_health[index], server_world.units.unit_shield[index]));
+
+                    UnitData restored;
+                    float health, shield;
+                    dequantize_unit(server.get_quantizer(), cell_size, expected.back(), restored, health, shield);
+                    max_error = std::max(max_error, (double)restored.position.distance_to(unit.position));
+                }
+                std::sort(expected.begin(), expected.end(),
+                    [](const ReplicatedUnit& p_a, const ReplicatedUnit& p_b) { return p_a.id < p_b.id; });
+                session.units_sent += expected.size();
+
+                if (chance(rng) >= session.link.loss) {
+                    session.link.packets.push_back({ tick + session.link.latency, sequence, packet });
+                    session.expected.push_back({ sequence, std::move(expected) });
+                }
+
+                // 3. 客户端收包、解码、写入本地的 UnitSystem，再回确认
+                while (!session.link.packets.empty() && session.link.packets.front().deliver_tick <= tick) {
+                    LoopbackLink::Packet& arrived = session.link.packets.front();
+                    std::string error;
+                    start = std::chrono::steady_clock::now();
+                    bool ok = session.client.decode(arrived.data.data(), arrived.data.size(), error);
+                    if (ok) {
+                        session.client.apply(session.world.units);
+                    }
+                    session.decode_ms += elapsed_ms(start);
+
+                    if (ok) {
+                        ++session.decoded;
+                        const std::vector<ReplicatedUnit>& decoded = session.client.get_latest_snapshot()->units;
+                        const std::vector<ReplicatedUnit>& reference = session.expected.front().second;
+                        if (decoded.size() != reference.size()) {
+                            ++session.mismatches;
+                        }
+                        else {
+                            for (size_t i = 0; i < decoded.size(); ++i) {
+                                if (!is_same_unit(decoded[i], reference[i])) {
+                                    ++session.mismatches;
+                                    break;
+                                }
+                            }
+                        }
+                        if (session.is_acknowledging) {
+                            session.link.acks.push_back({ tick + session.link.latency, session.client.get_acknowledgement() });
+                        }
+                    }
+                    else {
+                        ++session.errors;
+                        std::fprintf(stderr, "%s: packet %u rejected: %s\n", session.name, arrived.sequence, error.c_str());
+                    }
+                    session.expected.pop_front();
+                    session.link.packets.pop_front();
+                }
+            }
+        }
+
+        std::printf("%-10s %8s %8s %12s %12s %12s %12s %10s\n",
+            "mode", "units", "ticks", "KiB/tick", "max KiB", "encode ms", "decode ms", "mismatch");
+        std::printf("%-10s %8d %8d %12.2f %12s %12s %12s %10s\n", "raw", server_world.units.get_unit_count(), p_ticks,
+            raw_bytes / 1024.0 / p_ticks, "-", "-", "-", "-");
+        int failures = 0;
+        for (ReplicaSession& session : sessions) {
+            std::printf("%-10s %8.0f %8d %12.2f %12.2f %12.3f %12.3f %10d\n", session.name, (double)session.units_sent / p_ticks, p_ticks,
+                session.bytes / 1024.0 / p_ticks, session.max_bytes / 1024.0, session.encode_ms / p_ticks,
+                session.decoded ? session.decode_ms / session.decoded : 0.0, session.mismatches);
+            failures += session.mismatches + session.errors;
+        }
+        std::printf("max quantization error  %.3f px\n", max_error);
+        return failures == 0 ? 0 : 1;
+    }
+
+    // 没有新命令的稳定运行：先把流场算完、让各种缓冲区长到需要的大小，之后的 tick 不应再向堆申请内存
+    // building_churn 每 tick 都在放置建筑，不算稳定运行
+    int run_steady(int p_ticks) {
+        const int WARMUP_TICKS = 120;
+        std::printf("%-18s %6s %8s %10s %12s\n", "scenario", "units", "ticks", "allocs", "arena KiB");
+
+        int failures = 0;
+        for (const Scenario& scenario : SCENARIOS) {
+            if (scenario.before_tick) continue;
+
+            World world;
+            scenario.setup(world);
+            for (int tick = 0; tick < WARMUP_TICKS || world.flow_fields.get_queue_length() > 0; ++tick) {
+                world.tick(TICK_DELTA);
+            }
+
+            uint64_t allocs_before = get_alloc_count();
+            for (int tick = 0; tick < p_ticks; ++tick) {
+                world.tick(TICK_DELTA);
+            }
+            uint64_t allocs = get_alloc_count() - allocs_before;
+            if (allocs > 0) ++failures;
+
+            std::printf("%-18s %6d %8d %10llu %12.1f\n", scenario.name, world.units.get_unit_count(), p_ticks,
+                (unsigned long long)allocs, world.units.get_frame_arena().get_peak() / 1024.0);
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    int run_bake(const char* p_path) {
+        const int size = 512;
+        World world;
+        world.setup(size, size, Vec2i(16, 16), Vec2i(0, 0));
+
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> cell(0, size - 1);
+        for (int i = 0; i < 20000; ++i) {
+            world.set_cost(Vec2i(cell(rng), cell(rng)), 255);
+        }
+
+        std::vector<Vec2i> targets;
+        for (int i = 0; i < 8; ++i) {
+            targets.push_back(Vec2i(cell(rng), cell(rng)));
+        }
+
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        bool baked = world.flow_fields.bake_flow_fields(p_path, targets, error);
+        double bake_ms = elapsed_ms(start);
+        if (!baked) {
+            std::fprintf(stderr, "failed to bake %s: %s\n", p_path, error.c_str());
+            return 1;
+        }
+
+        start = std::chrono::steady_clock::now();
+        bool loaded = world.flow_fields.load_baked_fields(p_path, error);
+        double load_ms = elapsed_ms(start);
+        if (!loaded) {
+            std::fprintf(stderr, "failed to load %s: %s\n", p_path, error.c_str());
+            return 1;
+        }
+
+        std::printf("bake   %d fields       %10.3f ms (%.3f ms/field)\n", (int)targets.size(), bake_ms, bake_ms / targets.size());
+        std::printf("map    %d fields       %10.3f ms\n", world.flow_fields.get_baked_field_count(), load_ms);
+
+        int mismatches = 0;
+        for (const auto& pair : world.flow_fields.get_flow_fields()) {
+            mismatches += count_baked_mismatches(world.flow_fields, pair.second, {});
+        }
+        std::printf("verify after load    %10d mismatched cells\n", mismatches);
+        if (mismatches != 0) return 2;
+
+        // 每次只改一个格子的代价：仍保持烘焙状态的流场必须与重新计算的结果一致，然后改回原值并重新映射
+        const int trials = 40;
+        const uint8_t costs[] = { 255, 10, 1 };
+        int kept = 0;
+        mismatches = 0;
+        for (int trial = 0; trial < trials; ++trial) {
+            Vec2i pos(cell(rng), cell(rng));
+            uint8_t old_cost = (uint8_t)world.flow_fields.get_terrain_cost(pos);
+            world.set_cost(pos, costs[trial % 3]);
+            world.flow_fields.flush_cost_layers();
+
+            for (const auto& pair : world.flow_fields.get_flow_fields()) {
+                if (!pair.second.is_baked()) continue;
+                ++kept;
+                mismatches += count_baked_mismatches(world.flow_fields, pair.second, { pos.y * size + pos.x });
+            }
+
+            world.set_cost(pos, old_cost);
+            if (!world.flow_fields.load_baked_fields(p_path, error)) {
+                std::fprintf(stderr, "failed to reload %s: %s\n", p_path, error.c_str());
+                return 1;
+            }
+        }
+        std::printf("single cost edits    %10d of %d fields kept, %d mismatched cells\n",
+            kept, trials * (int)targets.size(), mismatches);
+
+        return mismatches == 0 ? 0 : 2;
+    }
+
+    // 无界面地以最快速度重新运行一段回放，输出每 tick 耗时和状态校验和
+    int run_replay(const char* p_path, const char* p_csv_path) {
+        ReplayPlayer player;
+        if (!player.load(p_path)) {
+            std::fprintf(stderr, "failed to load %s: %s\n", p_path, player.get_error().c_str());
+            return 1;
+        }
+
+        FILE* csv = nullptr;
+        if (p_csv_path) {
+            csv = std::fopen(p_csv_path, "w");
+            if (!csv) {
+                std::fprintf(stderr, "failed to open %s\n", p_csv_path);
+                return 1;
+            }
+            std::fprintf(csv, "tick,ms,units,checksum\n");
+        }
+
+        World world;
+        SimulationRefs target = world.get_refs();
+
+        std::vector<double> tick_ms;
+        double total_ms = 0.0;
+        double worst_ms = 0.0;
+        uint32_t worst_tick = 0;
+
+        while (true) {
+            auto start = std::chrono::steady_clock::now();
+            bool ticked = player.step(target);
+            auto end = std::chrono::steady_clock::now();
+            if (!ticked) break;
+
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            uint32_t tick = player.get_ticks_played() - 1;
+            tick_ms.push_back(ms);
+            total_ms += ms;
+            if (ms > worst_ms) {
+                worst_ms = ms;
+                worst_tick = tick;
+            }
+
+            if (csv) {
+                std::fprintf(csv, "%u,%.4f,%d,%016llx\n", tick, ms, world.units.get_unit_count(),
+                    (unsigned long long)world.units.compute_checksum());
+            }
+        }
+
+        if (csv) std::fclose(csv);
+
+        if (!player.get_error().empty()) {
+            std::fprintf(stderr, "replay stopped: %s\n", player.get_error().c_str());
+            return 1;
+        }
+        if (tick_ms.empty()) {
+            std::fprintf(stderr, "replay contains no ticks\n");
+            return 1;
+        }
+
+        std::vector<double> sorted = tick_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double p99 = sorted[std::min((size_t)(sorted.size() * 0.99), sorted.size() - 1)];
+
+        std::printf("ticks        %u\n", player.get_ticks_played());
+        std::printf("units        %d\n", world.units.get_unit_count());
+        std::printf("ms/tick      %.3f\n", total_ms / tick_ms.size());
+        std::printf("p99 ms       %.3f\n", p99);
+        std::printf("max ms       %.3f (tick %u)\n", worst_ms, worst_tick);
+        std::printf("checksum     %016llx\n", (unsigned long long)world.units.compute_checksum());
+        std::printf("verified     %d checkpoints, %d mismatches\n",
+            player.get_checksums_verified(), player.get_checksum_mismatches());
+
+        return player.get_checksum_mismatches() == 0 ? 0 : 2;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--replay") == 0) {
+        if (argc < 3) {
+            std::fprintf(stderr, "usage: sim_bench --replay <file> [per_tick.csv]\n");
+            return 1;
+        }
+        return run_replay(argv[2], argc > 3 ? argv[3] : nullptr);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--snapshot") == 0) {
+        return run_snapshot(argc > 2 ? argv[2] : "sim_bench.snapshot");
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bake") == 0) {
+        return run_bake(argc > 2 ? argv[2] : "sim_bench.ffbk");
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--avoidance") == 0) {
+        int ticks = argc > 2 ? std::atoi(argv[2]) : 0;
+        return run_avoidance(ticks > 0 ? ticks : 900);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--rate") == 0) {
+        double seconds = argc > 2 ? std::atof(argv[2]) : 0.0;
+        return run_rate(seconds > 0.0 ? seconds : 20.0);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--lod") == 0) {
+        int ticks = argc > 2 ? std::atoi(argv[2]) : 0;
+        return run_lod(ticks > 0 ? ticks : 600);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--influence") == 0) {
+        int ticks = argc > 2 ? std::atoi(argv[2]) : 0;
+        return run_influence(ticks > 0 ? ticks : 300);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--teams") == 0) {
+        return run_team_queries();
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bounded") == 0) {
+        int ticks = argc > 2 ? std::atoi(argv[2]) : 0;
+        return run_bounded(ticks > 0 ? ticks : 300);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--budget") == 0) {
+        int budget = argc > 2 ? std::atoi(argv[2]) : 0;
+        int ticks = argc > 3 ? std::atoi(argv[3]) : 0;
+        return run_budget(ticks > 0 ? ticks : 300, budget > 0 ? budget : 2000);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--replication") == 0) {
+        int ticks = argc > 2 ? std::atoi(argv[2]) : 0;
+        return run_replication(ticks > 0 ? ticks : 300);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--steady") == 0) {
+        int ticks = argc > 2 ? std::atoi(argv[2]) : 0;
+        return run_steady(ticks > 0 ? ticks : 300);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--record") == 0) {
+        const Scenario* scenario = argc > 3 ? find_scenario(argv[3]) : nullptr;
+        if (!scenario) {
+            std::fprintf(stderr, "usage: sim_bench --record <file> <scenario> [ticks]\n");
+            return 1;
+        }
+        if (!ReplayRecorder::get().start(argv[2])) {
+            std::fprintf(stderr, "failed to open %s\n", argv[2]);
+            return 1;
+        }
+        int ticks = argc > 4 ? std::atoi(argv[4]) : 0;
+        run_scenario(*scenario, ticks > 0 ? ticks : scenario->default_ticks, nullptr);
+        ReplayRecorder::get().stop();
+        return 0;
+    }
+
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    int ticks = argc > 2 ? std::atoi(argv[2]) : 0;
+    const char* trace_dir = argc > 3 ? argv[3] : nullptr;
+
+    std::printf("%-18s %6s %8s %10s %10s %10s %12s %12s\n",
+        "scenario", "units", "ticks", "ms/tick", "p99 ms", "max ms", "allocs/tick", "KiB/tick");
+
+    bool found = false;
+    for (const Scenario& scenario : SCENARIOS) {
+        if (filter && std::strcmp(filter, "all") != 0 && std::strcmp(filter, scenario.name) != 0) continue;
+        found = true;
+        run_scenario(scenario, ticks > 0 ? ticks : scenario.default_ticks, trace_dir);
+    }
+
+    if (!found) {
+        std::fprintf(stderr, "unknown scenario: %s\n", filter);
+        return 1;
+    }
+    return 0;
+}
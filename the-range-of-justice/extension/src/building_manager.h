@@ -3,22 +3,14 @@
 #include <godot_cpp/classes/node2d.hpp>
 #include <godot_cpp/variant/vector2i.hpp>
 #include <godot_cpp/variant/rect2i.hpp>
-#include <unordered_map>
-#include <vector>
 
 #include "unit_manager.h"
 #include "flow_field_manager.h"
+#include "core/building_system.h"
 
 namespace godot {
 
-    struct BuildingData {
-        int id;
-        Vector2i grid_pos;   // 网格左上角坐标
-        Vector2i size;       // 占地格子数 (例如 3x3)
-        int type;
-        // 可以在这里添加生命值、建造进度等
-    };
-
+    // 建筑管理器：对模拟核心 sim::BuildingSystem 的薄封装
     class BuildingManager : public Node2D {
         GDCLASS(BuildingManager, Node2D)
 
@@ -26,8 +18,7 @@ namespace godot {
         FlowFieldManager* flow_field_manager = nullptr;
         UnitManager* unit_manager = nullptr;
 
-        std::unordered_map<int, BuildingData> buildings;
-        int next_building_id = 0;
+        sim::BuildingSystem core;
 
     protected:
         static void _bind_methods();
@@ -40,6 +31,8 @@ namespace godot {
         void set_flow_field_manager(Node* p_node);
         void set_unit_manager(Node* p_node);
 
+        sim::BuildingSystem& get_core() { return core; }
+
         // --- 核心功能 ---
 
         // 检查某个区域是否可以放置建筑
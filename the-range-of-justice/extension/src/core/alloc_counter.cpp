@@ -0,0 +1,38 @@
+#include "alloc_counter.h"
+
+#ifdef SIM_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> g_allocation_count(0);
+static std::atomic<uint64_t> g_allocation_bytes(0);
+
+void* operator new(std::size_t p_size) {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    g_allocation_bytes.fetch_add(p_size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(p_size ? p_size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t p_size) {
+    return operator new(p_size);
+}
+
+void operator delete(void* p_ptr) noexcept { std::free(p_ptr); }
+void operator delete[](void* p_ptr) noexcept { std::free(p_ptr); }
+void operator delete(void* p_ptr, std::size_t) noexcept { std::free(p_ptr); }
+void operator delete[](void* p_ptr, std::size_t) noexcept { std::free(p_ptr); }
+
+bool sim::is_allocation_counting_enabled() { return true; }
+uint64_t sim::get_allocation_count() { return g_allocation_count.load(std::memory_order_relaxed); }
+uint64_t sim::get_allocation_bytes() { return g_allocation_bytes.load(std::memory_order_relaxed); }
+
+#else
+
+bool sim::is_allocation_counting_enabled() { return false; }
+uint64_t sim::get_allocation_count() { return 0; }
+uint64_t sim::get_allocation_bytes() { return 0; }
+
+#endif
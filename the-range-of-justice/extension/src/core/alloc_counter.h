@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// 堆分配计数
+// 定义了 SIM_COUNT_ALLOCATIONS 时替换全局 operator new，统计整个进程的分配次数和字节数，
+// 用来确认没有新命令的 tick 不向堆申请内存（Debug 构建默认开启）
+// 未定义时不替换，计数一直为 0
+
+namespace sim {
+
+    bool is_allocation_counting_enabled();
+
+    uint64_t get_allocation_count();
+
+    uint64_t get_allocation_bytes();
+}
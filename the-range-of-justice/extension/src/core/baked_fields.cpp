@@ -0,0 +1,235 @@
+#include "baked_fields.h"
+#include "flow_field.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+using namespace sim;
+
+static const uint64_t BAKED_ALIGNMENT = 16;
+
+static uint64_t align_up(uint64_t p_value) {
+    return (p_value + BAKED_ALIGNMENT - 1) & ~(BAKED_ALIGNMENT - 1);
+}
+
+uint64_t FlowFieldSystem::compute_cost_map_hash() const {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint8_t cost : global_cost_map) {
+        hash ^= cost;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+int FlowFieldSystem::get_baked_field_count() const {
+    int count = 0;
+    for (const auto& pair : flow_fields) {
+        if (pair.second.is_baked()) ++count;
+    }
+    return count;
+}
+
+bool FlowFieldSystem::bake_flow_fields(const std::string& p_path, const std::vector<Vec2i>& p_targets, std::string& r_error) {
+    if (size <= 0) {
+        r_error = "grid is not set up";
+        return false;
+    }
+    flush_cost_layers();
+
+    // 去重并检查范围
+    std::vector<Vec2i> targets;
+    for (const Vec2i& target : p_targets) {
+        if (!is_in_grid(target)) {
+            r_error = "target (" + std::to_string(target.x) + ", " + std::to_string(target.y) + ") is outside the grid";
+            return false;
+        }
+        if (std::find(targets.begin(), targets.end(), target) == targets.end()) {
+            targets.push_back(target);
+        }
+    }
+
+    // --- 计算布局 ---
+    BakedFieldsHeader header = {};
+    header.magic = BAKED_FIELDS_MAGIC;
+    header.version = BAKED_FIELDS_VERSION;
+    header.width = width;
+    header.height = height;
+    header.origin_x = grid_origin.x;
+    header.origin_y = grid_origin.y;
+    header.field_count = (uint32_t)targets.size();
+    header.cost_map_hash = compute_cost_map_hash();
+
+    std::vector<BakedFieldEntry> entries(targets.size());
+    uint64_t offset = align_up(sizeof(BakedFieldsHeader) + entries.size() * sizeof(BakedFieldEntry));
+    for (size_t i = 0; i < targets.size(); ++i) {
+        entries[i].target_x = targets[i].x;
+        entries[i].target_y = targets[i].y;
+        entries[i].integration_offset = offset;
+        offset = align_up(offset + (uint64_t)size * sizeof(float));
+        entries[i].directions_offset = offset;
+        offset = align_up(offset + (uint64_t)size);
+    }
+    header.file_size = offset;
+
+    FILE* file = std::fopen(p_path.c_str(), "wb");
+    if (!file) {
+        r_error = "cannot open " + p_path + " for writing";
+        return false;
+    }
+
+    static const uint8_t PADDING[BAKED_ALIGNMENT] = {};
+    uint64_t written = 0;
+    bool ok = true;
+    auto write_bytes = [&](const void* p_data, uint64_t p_size) {
+        ok = ok && std::fwrite(p_data, 1, p_size, file) == p_size;
+        written += p_size;
+    };
+    auto pad_to = [&](uint64_t p_offset) {
+        write_bytes(PADDING, p_offset - written);
+    };
+
+    write_bytes(&header, sizeof(header));
+    write_bytes(entries.data(), entries.size() * sizeof(BakedFieldEntry));
+
+    // 每个目标单独算一遍，不影响当前的流场
+    FlowField field;
+    std::vector<uint8_t> codes(size);
+    for (size_t i = 0; ok && i < targets.size(); ++i) {
+        field.target_position = targets[i];
+        field.reserve(size);
+        compute_integration(field);
+        compute_directions(field);
+
+        for (int index = 0; index < size; ++index) {
+            codes[index] = encode_flow_direction(field.flow_directions[index]);
+        }
+
+        pad_to(entries[i].integration_offset);
+        write_bytes(field.integration_field.data(), (uint64_t)size * sizeof(float));
+        pad_to(entries[i].directions_offset);
+        write_bytes(codes.data(), codes.size());
+    }
+    pad_to(header.file_size);
+
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) r_error = "failed to write " + p_path;
+    return ok;
+}
+
+bool FlowFieldSystem::load_baked_fields(const std::string& p_path, std::string& r_error) {
+    // 旧映射上的烘焙流场先全部移除，之后才能关闭映射
+    drop_baked_fields();
+    flush_cost_layers();
+
+    if (!baked_file.open(p_path)) {
+        r_error = "cannot map " + p_path;
+        return false;
+    }
+
+    const uint8_t* data = baked_file.get_data();
+    uint64_t file_size = baked_file.get_size();
+
+    // --- 校验 ---
+    BakedFieldsHeader header;
+    if (file_size < sizeof(header)) {
+        r_error = "file too small";
+    }
+    else {
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != BAKED_FIELDS_MAGIC) {
+            r_error = "not a baked flow field file";
+        }
+        else if (header.version != BAKED_FIELDS_VERSION) {
+            r_error = "unsupported version " + std::to_string(header.version);
+        }
+        else if (header.file_size != file_size) {
+            r_error = "file is truncated";
+        }
+        else if (header.width != width || header.height != height ||
+            header.origin_x != grid_origin.x || header.origin_y != grid_origin.y) {
+            r_error = "grid size or origin does not match the current map";
+        }
+        else if (header.cost_map_hash != compute_cost_map_hash()) {
+            r_error = "cost map has changed since the fields were baked";
+        }
+        else if (sizeof(header) + (uint64_t)header.field_count * sizeof(BakedFieldEntry) > file_size) {
+            r_error = "field table out of range";
+        }
+    }
+
+    std::vector<BakedFieldEntry> entries;
+    if (r_error.empty()) {
+        entries.resize(header.field_count);
+        std::memcpy(entries.data(), data + sizeof(header), entries.size() * sizeof(BakedFieldEntry));
+
+        for (const BakedFieldEntry& entry : entries) {
+            if (!is_in_grid(Vec2i(entry.target_x, entry.target_y)) ||
+                entry.integration_offset % alignof(float) != 0 ||
+                entry.integration_offset > file_size || (uint64_t)size * sizeof(float) > file_size - entry.integration_offset ||
+                entry.directions_offset > file_size || (uint64_t)size > file_size - entry.directions_offset) {
+                r_error = "field data out of range";
+                break;
+            }
+        }
+    }
+
+    if (!r_error.empty()) {
+        baked_file.close();
+        return false;
+    }
+
+    // --- 加入流场表，数据指向映射区 ---
+    // 文件与当前地图一致，同一目标已有的普通流场直接被替换
+    for (const BakedFieldEntry& entry : entries) {
+        Vec2i target(entry.target_x, entry.target_y);
+        FlowField& field = flow_fields[target];
+        field.target_position = target;
+        release_field_buffers(field);
+        field.demand = Rect2i();
+        field.counted_demand = Rect2i();
+        field.pending = 0;
+        field.touched = Rect2i();
+        field.frontier.clear();
+        field.settled_limit = 65535.0f;
+        field.baked_integration = (const float*)(data + entry.integration_offset);
+        field.baked_directions = data + entry.directions_offset;
+        field.is_dirty = false;
+        field.is_computing = false;
+        field.last_used_time = clock;
+    }
+
+    return true;
+}
+
+void FlowFieldSystem::unbake_flow_field(FlowField& r_field) {
+    acquire_field_buffers(r_field);
+    std::copy(r_field.baked_integration, r_field.baked_integration + size, r_field.integration_field.begin());
+    r_field.touched = Rect2i(0, 0, width, height);
+    r_field.frontier.clear();
+    r_field.settled_limit = 65535.0f;
+    for (int index = 0; index < size; ++index) {
+        r_field.flow_directions[index] = decode_flow_direction(r_field.baked_directions[index]);
+    }
+    r_field.baked_integration = nullptr;
+    r_field.baked_directions = nullptr;
+
+    // 在重算完成之前继续使用旧数据，与普通流场变脏后的行为一致
+    r_field.is_dirty = true;
+    r_field.is_computing = false;
+}
+
+void FlowFieldSystem::drop_baked_fields() {
+    auto it = flow_fields.begin();
+    while (it != flow_fields.end()) {
+        if (it->second.is_baked()) {
+            release_field_buffers(it->second);
+            it = flow_fields.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    baked_file.close();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+// 烘焙流场文件：离线为固定目标（基地、隘口、资源点等）预先算好的流场
+//
+// 文件布局（小端，数据块 16 字节对齐）：
+//   BakedFieldsHeader
+//   BakedFieldEntry[field_count]
+//   每个流场：float integration[width * height]，uint8_t directions[width * height]
+//
+// 运行时整个文件只读映射进内存，流场直接指向映射的数据，不做任何拷贝。
+// 方向只存 1 字节的邻居编码（见 decode_flow_direction），每格 5 字节，内存中的普通流场每格 12 字节。
+// 头部记录烘焙时代价地图的哈希，地图改过之后旧文件会被拒绝。
+
+namespace sim {
+
+    const uint32_t BAKED_FIELDS_MAGIC = 0x4B424646; // "FFBK"
+    const uint32_t BAKED_FIELDS_VERSION = 1;
+
+    struct BakedFieldsHeader {
+        uint32_t magic;
+        uint32_t version;
+        int32_t width;
+        int32_t height;
+        int32_t origin_x, origin_y;
+        uint32_t field_count;
+        uint32_t reserved;
+        uint64_t cost_map_hash;
+        uint64_t file_size;
+    };
+
+    struct BakedFieldEntry {
+        int32_t target_x, target_y;
+        uint64_t integration_offset;    // 相对文件开头
+        uint64_t directions_offset;
+    };
+}
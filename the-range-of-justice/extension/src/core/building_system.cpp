@@ -0,0 +1,101 @@
+#include "building_system.h"
+
+using namespace sim;
+
+bool BuildingSystem::is_area_clear(Vec2i p_grid_pos, Vec2i p_size) {
+    if (!flow_field_system) return false;
+
+    // --- 1. 地形与边界检查 ---
+    for (int x = 0; x < p_size.x; ++x) {
+        for (int y = 0; y < p_size.y; ++y) {
+            Vec2i current_cell = p_grid_pos + Vec2i(x, y);
+
+            // 检查边界
+            if (!flow_field_system->is_in_grid(current_cell)) return false;
+
+            // 检查代价 (255 为墙或已有建筑)
+            if (flow_field_system->get_cost(current_cell) == 255) return false;
+        }
+    }
+
+    // --- 2. 单位阻挡检查 ---
+    if (unit_system) {
+        // 获取格子大小（从流场系统获取）
+        Vec2i cell_size = flow_field_system->get_cell_size();
+
+        // 计算建筑在世界空间中的矩形范围 (Rect2)
+        Vec2 world_pos = Vec2(p_grid_pos.x * cell_size.x, p_grid_pos.y * cell_size.y);
+        Vec2 world_size = Vec2(p_size.x * cell_size.x, p_size.y * cell_size.y);
+        Rect2 building_rect(world_pos, world_size);
+
+        // 使用单位系统的空间网格优化查询
+        // 查询半径设定为建筑对角线的一半，确保覆盖整个矩形
+        Vec2 center = world_pos + world_size * 0.5;
+        float query_radius = world_size.length() * 0.5;
+
+        std::vector<int> nearby_units = unit_system->get_nearby_units(center, query_radius);
+
+        for (int unit_idx : nearby_units) {
+            Vec2 u_pos = (unit_system->units)[unit_idx].position;
+
+            // 如果单位位置在建筑矩形内，则判定为阻挡
+            if (building_rect.has_point(u_pos)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int BuildingSystem::place_building(Vec2i p_grid_pos, Vec2i p_size, int p_type) {
+    if (!is_area_clear(p_grid_pos, p_size)) return -1;
+
+    // 1. 创建建筑数据
+    int b_id = next_building_id++;
+    BuildingData b;
+    b.id = b_id;
+    b.grid_pos = p_grid_pos;
+    b.size = p_size;
+    b.type = p_type;
+    buildings[b_id] = b;
+
+    // 2. 写入建筑占用层：占用的格子不可通行，地形代价保持不变
+    flow_field_system->set_building_footprint(Rect2i(p_grid_pos, p_size), true);
+
+    return b_id;
+}
+
+void BuildingSystem::remove_building(int p_building_id) {
+    auto it = buildings.find(p_building_id);
+    if (it == buildings.end()) return;
+
+    BuildingData& b = it->second;
+
+    // 1. 撤销占用，这些格子恢复为原来的地形代价
+    flow_field_system->set_building_footprint(Rect2i(b.grid_pos, b.size), false);
+
+    // 2. 从记录中删除
+    buildings.erase(it);
+}
+
+Vec2i BuildingSystem::get_building_grid_pos(int p_building_id) const {
+    auto it = buildings.find(p_building_id);
+    if (it != buildings.end()) return it->second.grid_pos;
+    return Vec2i(-1, -1);
+}
+
+void BuildingSystem::restore_building(const BuildingData& p_building) {
+    buildings[p_building.id] = p_building;
+    if (p_building.id >= next_building_id) {
+        next_building_id = p_building.id + 1;
+    }
+}
+
+void BuildingSystem::restore_buildings(const BuildingData* p_buildings, int p_count, int p_next_building_id) {
+    buildings.clear();
+    for (int i = 0; i < p_count; ++i) {
+        buildings[p_buildings[i].id] = p_buildings[i];
+    }
+    next_building_id = p_next_building_id;
+}
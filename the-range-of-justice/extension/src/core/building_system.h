@@ -0,0 +1,55 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "sim_math.h"
+#include "flow_field.h"
+#include "unit_system.h"
+
+namespace sim {
+
+    struct BuildingData {
+        int id;
+        Vec2i grid_pos;   // 网格左上角坐标
+        Vec2i size;       // 占地格子数 (例如 3x3)
+        int type;
+        // 可以在这里添加生命值、建造进度等
+    };
+
+    // 建筑系统（与引擎无关），BuildingManager 只是它的外壳
+    class BuildingSystem {
+    private:
+        FlowFieldSystem* flow_field_system = nullptr;
+        UnitSystem* unit_system = nullptr;
+
+        std::unordered_map<int, BuildingData> buildings;
+        int next_building_id = 0;
+
+    public:
+        void set_flow_field_system(FlowFieldSystem* p_system) { flow_field_system = p_system; }
+        void set_unit_system(UnitSystem* p_system) { unit_system = p_system; }
+
+        // 检查某个区域是否可以放置建筑
+        bool is_area_clear(Vec2i p_grid_pos, Vec2i p_size);
+
+        // 放置建筑：返回建筑 ID，失败返回 -1
+        int place_building(Vec2i p_grid_pos, Vec2i p_size, int p_type);
+
+        // 移除建筑
+        void remove_building(int p_building_id);
+
+        // 根据 ID 获取建筑数据
+        Vec2i get_building_grid_pos(int p_building_id) const;
+
+        int get_building_count() const { return (int)buildings.size(); }
+
+        const std::unordered_map<int, BuildingData>& get_buildings() const { return buildings; }
+
+        int get_next_building_id() const { return next_building_id; }
+
+        // 按原样恢复一个建筑（保留 ID，代价地图由调用方负责），用于回放和读档
+        void restore_building(const BuildingData& p_building);
+        // 整体替换所有建筑
+        void restore_buildings(const BuildingData* p_buildings, int p_count, int p_next_building_id);
+    };
+}
@@ -0,0 +1,65 @@
+#include "congestion_field.h"
+#include "flow_field.h"
+
+#include <algorithm>
+
+using namespace sim;
+
+void CongestionField::reset(const FlowFieldSystem& p_flow_field_system) {
+    if (p_flow_field_system.get_width() != width || p_flow_field_system.get_height() != height ||
+        p_flow_field_system.get_grid_origin() != grid_origin || p_flow_field_system.get_cell_size() != cell_size) {
+        width = p_flow_field_system.get_width();
+        height = p_flow_field_system.get_height();
+        grid_origin = p_flow_field_system.get_grid_origin();
+        cell_size = p_flow_field_system.get_cell_size();
+        densities.assign(width * height, 0.0f);
+        velocity_sums.assign(width * height, Vec2(0, 0));
+        touched_cells.clear();
+        return;
+    }
+
+    for (int index : touched_cells) {
+        densities[index] = 0.0f;
+        velocity_sums[index] = Vec2(0, 0);
+    }
+    touched_cells.clear();
+}
+
+void CongestionField::add(int p_x, int p_y, float p_weight, Vec2 p_velocity) {
+    if (p_x < 0 || p_x >= width || p_y < 0 || p_y >= height || p_weight <= 0.0f) return;
+
+    int index = p_y * width + p_x;
+    if (densities[index] == 0.0f) touched_cells.push_back(index);
+    densities[index] += p_weight;
+    velocity_sums[index] += p_velocity * p_weight;
+}
+
+void CongestionField::splat(Vec2 p_world_pos, Vec2 p_velocity) {
+    if (densities.empty()) return;
+
+    float u = p_world_pos.x / (float)cell_size.x - (float)grid_origin.x - 0.5f;
+    float v = p_world_pos.y / (float)cell_size.y - (float)grid_origin.y - 0.5f;
+    int x0 = (int)std::floor(u);
+    int y0 = (int)std::floor(v);
+    float fx = u - (float)x0;
+    float fy = v - (float)y0;
+
+    add(x0, y0, (1.0f - fx) * (1.0f - fy), p_velocity);
+    add(x0 + 1, y0, fx * (1.0f - fy), p_velocity);
+    add(x0, y0 + 1, (1.0f - fx) * fy, p_velocity);
+    add(x0 + 1, y0 + 1, fx * fy, p_velocity);
+}
+
+float CongestionField::get_congestion_cost(int p_index, Vec2 p_direction, float p_max_speed) const {
+    float density = densities[p_index];
+    if (density <= density_min || p_max_speed <= 0.0f) return 0.0f;
+
+    // 人群在这个方向上的平均速度
+    Vec2 average_velocity = velocity_sums[p_index] / density;
+    float flow_speed = std::max(average_velocity.dot(p_direction) / p_max_speed, min_speed_fraction);
+    flow_speed = std::min(flow_speed, 1.0f);
+
+    float t = density_max > density_min ? std::min((density - density_min) / (density_max - density_min), 1.0f) : 1.0f;
+    float speed = 1.0f + t * (flow_speed - 1.0f);
+    return weight * (1.0f / speed - 1.0f);
+}
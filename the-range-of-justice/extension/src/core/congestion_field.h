@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "sim_math.h"
+
+namespace sim {
+
+    class FlowFieldSystem;
+
+    // 拥挤场：每 tick 把单位的位置和速度按双线性权重分摊到流场分辨率的网格上
+    // 得到每格的密度和平均速度（continuum crowds 的密度场 / 平均速度场）
+    //
+    // 密度低于 density_min 的格子按地形速度通行；高于 density_max 时只能随人群的平均速度前进，
+    // 逆着人群走的速度降到 min_speed_fraction。中间线性过渡。
+    // 通过一格的额外时间 (1 / speed - 1) 乘以 weight 就是该格的拥挤代价。
+    //
+    // 每 tick 只清空上一 tick 写过的格子，开销与单位数成正比，与地图大小无关
+    class CongestionField {
+    private:
+        int width = 0;
+        int height = 0;
+        Vec2i grid_origin;
+        Vec2i cell_size;
+
+        std::vector<float> densities;       // 每格的单位数（双线性分摊后）
+        std::vector<Vec2> velocity_sums;    // 每格按同样权重累加的速度
+        std::vector<int> touched_cells;     // 本 tick 写过的格子，下次清空时只清这些
+
+        void add(int p_x, int p_y, float p_weight, Vec2 p_velocity);
+
+    public:
+        float weight = 3.0f;                // 0 表示关闭
+        float density_min = 0.4f;           // 每格单位数
+        float density_max = 1.0f;
+        float min_speed_fraction = 0.1f;
+
+        // 清空上一 tick 的数据，网格尺寸与流场系统不一致时重新分配
+        void reset(const FlowFieldSystem& p_flow_field_system);
+
+        // 按格子中心做双线性分摊，地图外的部分丢弃
+        void splat(Vec2 p_world_pos, Vec2 p_velocity);
+
+        bool is_enabled() const { return weight > 0.0f && !touched_cells.empty(); }
+
+        float get_density(int p_index) const { return densities[p_index]; }
+
+        // 以 p_max_speed 沿 p_direction（单位向量）穿过 p_index 格的额外代价（乘在地形代价上）
+        float get_congestion_cost(int p_index, Vec2 p_direction, float p_max_speed) const;
+    };
+}
@@ -0,0 +1,56 @@
+#include "damage_system.h"
+
+#include <algorithm>
+
+using namespace sim;
+
+//                       轻甲    重甲    建筑    英雄
+const float DamageSystem::DAMAGE_MULTIPLIER[ATTACK_TYPE_COUNT][ARMOR_TYPE_COUNT] = {
+    /* 物理 */          { 1.00f, 0.75f, 0.50f, 0.75f },
+    /* 魔法 */          { 1.25f, 1.50f, 0.50f, 0.75f },
+    /* 攻城 */          { 0.75f, 0.75f, 2.00f, 0.50f },
+};
+
+void DamageSystem::push_hit(int p_target_id, int p_attacker_id, float p_damage, int p_attack_type, int p_armor_type) {
+    if (p_attack_type < 0 || p_attack_type >= ATTACK_TYPE_COUNT) return;
+    if (p_armor_type < 0 || p_armor_type >= ARMOR_TYPE_COUNT) return;
+
+    HitRecord hit;
+    hit.target_id = p_target_id;
+    hit.attacker_id = p_attacker_id;
+    hit.damage = p_damage;
+    hit.attack_type = (uint8_t)p_attack_type;
+    hit.armor_type = (uint8_t)p_armor_type;
+    hits.push_back(hit);
+}
+
+void DamageSystem::resolve(const std::unordered_map<int, size_t>& p_id_to_index, float* p_health, float* p_shield, int p_unit_count) {
+    dead_indices.clear();
+    if (hits.empty()) return;
+
+    // 1. 查倍率表，把所有命中累加到目标单位上
+    //    命中按追加顺序累加，同样的输入总是得到同样的浮点结果
+    pending_damage.assign(p_unit_count, 0.0f);
+    for (const HitRecord& hit : hits) {
+        auto it = p_id_to_index.find(hit.target_id);
+        if (it == p_id_to_index.end()) continue;     // 目标已经不存在
+
+        pending_damage[it->second] += hit.damage * DAMAGE_MULTIPLIER[hit.attack_type][hit.armor_type];
+    }
+    hits.clear();
+
+    // 2. 先扣护盾再扣生命（无分支，编译器可以向量化）
+    float* damage = pending_damage.data();
+    for (int i = 0; i < p_unit_count; ++i) {
+        float absorbed = std::min(p_shield[i], damage[i]);
+        p_shield[i] -= absorbed;
+        p_health[i] -= damage[i] - absorbed;
+    }
+
+    // 3. 收集本 tick 受到伤害且死亡的单位，按下标升序
+    for (int i = 0; i < p_unit_count; ++i) {
+        if (damage[i] > 0.0f && p_health[i] <= 0.0f) {
+            dead_indices.push_back(i);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+namespace sim {
+
+    // 与 game_definitions.h 中 AttackType / ArmorType 的数量一致
+    static const int ATTACK_TYPE_COUNT = 3;
+    static const int ARMOR_TYPE_COUNT = 4;
+
+    // 一次命中的记录，攻击方在本 tick 内只往缓冲区里追加，不直接改血量
+    struct HitRecord {
+        int target_id;
+        int attacker_id;
+        float damage;           // 未乘倍率的原始伤害
+        uint8_t attack_type;
+        uint8_t armor_type;     // 追加时从目标的类型表里取
+    };
+
+    // 批量伤害结算
+    // 每 tick 统一结算一次：倍率 -> 按单位累加 -> 护盾/生命 -> 死亡列表
+    class DamageSystem {
+    private:
+        std::vector<HitRecord> hits;
+        std::vector<float> pending_damage;      // 按单位下标累加的本 tick 伤害
+        std::vector<int> dead_indices;          // 本 tick 死亡单位的下标（升序）
+
+    public:
+        // 伤害倍率表 [攻击类型][护甲类型]
+        static const float DAMAGE_MULTIPLIER[ATTACK_TYPE_COUNT][ARMOR_TYPE_COUNT];
+
+        void push_hit(int p_target_id, int p_attacker_id, float p_damage, int p_attack_type, int p_armor_type);
+
+        bool has_pending_hits() const { return !hits.empty(); }
+
+        // 结算本 tick 所有命中并清空缓冲区
+        // p_health / p_shield 是与 units 数组平行的数组，长度为 p_unit_count
+        void resolve(const std::unordered_map<int, size_t>& p_id_to_index, float* p_health, float* p_shield, int p_unit_count);
+
+        const std::vector<int>& get_dead_indices() const { return dead_indices; }
+    };
+}
@@ -0,0 +1,1231 @@
+#include "flow_field.h"
+#include "congestion_field.h"
+#include "profiler.h"
+
+#include <queue>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <functional>
+
+using namespace sim;
+
+static const float INTEGRATION_EPSILON = 1e-3f;
+
+// 方向编码表，下标为编码值（0 = 没有方向）
+static const Vec2i DIRECTION_OFFSETS[9] = {
+    Vec2i(0, 0),
+    Vec2i(-1, -1), Vec2i(0, -1), Vec2i(1, -1),
+    Vec2i(-1, 0),                Vec2i(1, 0),
+    Vec2i(-1, 1),  Vec2i(0, 1),  Vec2i(1, 1),
+};
+
+uint8_t sim::encode_flow_direction(Vec2 p_direction) {
+    int x = p_direction.x > 0.5f ? 1 : (p_direction.x < -0.5f ? -1 : 0);
+    int y = p_direction.y > 0.5f ? 1 : (p_direction.y < -0.5f ? -1 : 0);
+    for (uint8_t code = 1; code < 9; ++code) {
+        if (DIRECTION_OFFSETS[code].x == x && DIRECTION_OFFSETS[code].y == y) return code;
+    }
+    return 0;
+}
+
+Vec2 sim::decode_flow_direction(uint8_t p_code) {
+    if (p_code == 0 || p_code >= 9) return Vec2(0, 0);
+    Vec2i offset = DIRECTION_OFFSETS[p_code];
+    return Vec2((float)offset.x, (float)offset.y).normalized();
+}
+
+Vec2i sim::get_flow_direction_offset(uint8_t p_code) {
+    if (p_code >= 9) return Vec2i(0, 0);
+    return DIRECTION_OFFSETS[p_code];
+}
+
+float FlowField::integration_at(int p_index) const {
+    return baked_integration ? baked_integration[p_index] : integration_field[p_index];
+}
+
+Vec2 FlowField::direction_at(int p_index) const {
+    return baked_directions ? decode_flow_direction(baked_directions[p_index]) : flow_directions[p_index];
+}
+
+void FlowFieldSystem::update(double p_delta) {
+    clock += p_delta;
+    flush_cost_layers();
+    process_tasks();
+    
+    cleanup_timer += p_delta;
+    if (cleanup_timer >= CLEANUP_INTERVAL) {
+        cleanup_timer = 0.0;
+        cleanup_flow_fields();
+    }
+}
+
+void FlowFieldSystem::process_one_task() {
+    // 1. 如果队列为空，直接返回
+    if (calculation_queue.empty()) {
+        return;
+    }
+    flush_cost_layers();
+
+    // 2. 一次算完队首的流场（已经不在哈希表中的目标直接出队）
+    step_build(nullptr);
+}
+
+void FlowFieldSystem::process_tasks() {
+    bool has_work_limit = has_replay_work;
+    int64_t work_limit = replay_work;
+    has_replay_work = false;
+    last_update_work = -1;
+
+    if (calculation_queue.empty()) {
+        return;
+    }
+    if (has_work_limit ? work_limit < 0 : compute_budget_us <= 0) {
+        process_one_task();
+        return;
+    }
+    flush_cost_layers();
+
+    WorkBudget budget;
+    if (has_work_limit) {
+        budget.work_limit = work_limit;
+    }
+    else {
+        budget.has_deadline = true;
+        budget.deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(compute_budget_us);
+    }
+
+    // 小的流场一次 update 可以算完好几个，大的流场分到多次 update 里
+    bool is_interrupted = false;
+    while (!calculation_queue.empty() && !is_interrupted) {
+        is_interrupted = !step_build(&budget);
+    }
+
+    // 队列算空时最后一个检查点的工作量可能正好等于总量，回放时不能在那里停下
+    last_update_work = is_interrupted ? budget.work : std::numeric_limits<int64_t>::max();
+}
+
+bool FlowFieldSystem::WorkBudget::consume(int64_t p_work) {
+    int64_t previous = work;
+    work += p_work;
+    if (previous / CHECK_INTERVAL == work / CHECK_INTERVAL) return true;
+
+    // 检查点只由工作量决定，录制和回放在同样的位置检查
+    if (work_limit >= 0) return work < work_limit;
+    return !has_deadline || std::chrono::steady_clock::now() < deadline;
+}
+
+bool FlowFieldSystem::step_build(WorkBudget* p_budget) {
+    if (calculation_queue.empty()) {
+        return true;
+    }
+
+    // 取出队首的目标点坐标（算完才出队，存档时仍在队列中）
+    Vec2i target = calculation_queue.front();
+
+    // 检查这个流场是否还存在于哈希表中
+    auto it = flow_fields.find(target);
+    if (it == flow_fields.end() || it->second.is_baked()) {
+        cancel_build();
+        calculation_queue.pop();
+        return true;
+    }
+    FlowField& field = it->second;
+
+    if (build.stage == BUILD_IDLE || build.target != target) {
+        // 缓冲区由 setup_grid 分配；大小不对（没有 setup 过）时内容未知，整张重置
+        if (build.work.integration_field.size() != (size_t)size) {
+            acquire_field_buffers(build.work);
+            build.work.touched = Rect2i(0, 0, width, height);
+        }
+        build.target = target;
+        build.stage = BUILD_RESET;
+        build.row = build.work.touched.intersection(Rect2i(0, 0, width, height)).position.y;
+        build.is_stale = false;
+    }
+
+    if (build.stage == BUILD_RESET) {
+        // 上一次计算改动过的范围逐行重置，和计算一样记入预算；中途停下时 touched 不变，下次接着重置
+        Rect2i touched = build.work.touched.intersection(Rect2i(0, 0, width, height));
+        while (build.row < touched.position.y + touched.size.y) {
+            if (p_budget && !p_budget->consume(touched.size.x)) {
+                return false;
+            }
+            reset_region(build.work, Rect2i(touched.position.x, build.row, touched.size.x, 1));
+            ++build.row;
+        }
+        build.work.touched = Rect2i();
+        build.work.target_position = target;
+        begin_integration(build.work);
+        build.stage = BUILD_INTEGRATION;
+    }
+
+    // --- 执行重型计算逻辑 ---
+
+    if (build.stage == BUILD_INTEGRATION) {
+        // 计算各点到目标的代价值 (Dijkstra)，计算期间 demand 可能变大
+        build.work.demand = field.demand;
+        Rect2i settled;
+        if (!expand_integration(build.work, p_budget, settled)) {
+            return false;
+        }
+        build.stage = BUILD_DIRECTIONS;
+        build.row = build.work.touched.position.y;
+    }
+
+    // 根据代价值生成方向向量，逐行进行
+    Rect2i touched = build.work.touched;
+    while (build.row < touched.position.y + touched.size.y) {
+        if (p_budget && !p_budget->consume(touched.size.x)) {
+            return false;
+        }
+        compute_directions(build.work, Rect2i(touched.position.x, build.row, touched.size.x, 1));
+        ++build.row;
+    }
+
+    // --- 计算完成，和流场交换缓冲区，旧数据留给下一次计算 ---
+    field.integration_field.swap(build.work.integration_field);
+    field.flow_directions.swap(build.work.flow_directions);
+    field.frontier.swap(build.work.frontier);
+    std::swap(field.touched, build.work.touched);
+    std::swap(field.settled_limit, build.work.settled_limit);
+    std::swap(field.counted_demand, build.work.counted_demand);
+    std::swap(field.pending, build.work.pending);
+    field.is_dirty = false;
+    if (build.is_stale) {
+        field.mark_dirty();
+    }
+    field.is_computing = false;
+
+    build.stage = BUILD_IDLE;
+    calculation_queue.pop();
+    SIM_PROFILE_COUNT(COUNTER_FIELDS_COMPUTED, 1);
+    return true;
+}
+
+void FlowFieldSystem::cancel_build() {
+    // 缓冲区的 touched 始终有效，下一次计算照常只重置 touched 之内
+    build.stage = BUILD_IDLE;
+    build.is_stale = false;
+}
+
+void FlowFieldSystem::cleanup_flow_fields() {
+    // 1. 获取当前模拟时间（秒）
+    double current_time = clock;
+
+    // 2. 安全遍历并删除
+    auto it = flow_fields.begin();
+    while (it != flow_fields.end()) {
+        FlowField& field = it->second;
+
+        // 只有同时满足以下条件才删除：
+        // - 没在计算队列中 (is_computing == false)
+        // - 距离上次使用时间超过了阈值
+        // 烘焙流场不占堆内存，一直保留
+        if (!field.is_baked() && !field.is_computing && (current_time - field.last_used_time > UNUSED_THRESHOLD)) {
+            // UtilityFunctions::print("正在清理过期的流场，目标点: ", it->first);
+
+            // erase(it) 会返回下一个有效的迭代器，这是 C++ 中安全删除的标志写法
+            release_field_buffers(field);
+            it = flow_fields.erase(it);
+        }
+        else {
+            // 否则继续指向下一个
+            ++it;
+        }
+    }
+}
+
+void FlowFieldSystem::setup_grid(int p_width, int p_height, Vec2i p_origin, Vec2i p_cell_size) {
+    width = p_width;
+    height = p_height;
+    size = width * height;
+    grid_origin = p_origin;
+    cell_size = p_cell_size;
+
+    // 初始化全局地图
+    terrain_costs.assign(size, 1);
+    building_occupancy.assign(size, 0);
+    cost_modifiers.assign(size, 0);
+    global_cost_map.assign(size, 1);
+    dirty_regions.clear();
+
+    // 池里的数组是按旧地图大小分配的
+    // 计算用的缓冲区在这里按初始值分配好，第一次计算不用在 tick 里申请和整张重置
+    cancel_build();
+    build.work = FlowField();
+    build.work.reserve(size);
+    free_integration_buffers.clear();
+    free_direction_buffers.clear();
+
+    sector_columns = (width + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    sector_rows = (height + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    sector_versions.assign(sector_columns * sector_rows, ++cost_version);
+
+    // 烘焙数据是针对旧地图的
+    drop_baked_fields();
+}
+
+void FlowFieldSystem::create_flow_field(Vec2i p_target_grid_pos, bool p_overwrite) {
+    Vec2i relative_target_grid_pos = p_target_grid_pos - grid_origin;
+    if (relative_target_grid_pos.x < 0 || relative_target_grid_pos.x >= width ||
+        relative_target_grid_pos.y < 0 || relative_target_grid_pos.y >= height) {
+        return;
+    }
+    
+    // 1. 检查该目标点的流场是否已经存在
+    auto it = flow_fields.find(p_target_grid_pos);
+    bool exists = (it != flow_fields.end());
+
+    // 2. 如果已存在且不要求覆盖，则直接返回
+    if (exists && !p_overwrite) {
+        // UtilityFunctions::print("Flow field for ", p_target_grid_pos, " already exists. Skipping.");
+        return;
+    }
+
+    // 3. 获取或创建流场对象
+    // operator[] 会在 key 不存在时自动创建一个默认构造的对象
+    FlowField& field = flow_fields[p_target_grid_pos];
+
+    // 4. 初始化数据
+    field.target_position = p_target_grid_pos;
+    field.baked_integration = nullptr;
+    field.baked_directions = nullptr;
+
+    // 优先复用已删除流场的数组
+    acquire_field_buffers(field);
+
+    // 5. 进行一些基础的默认值填充（可选）
+    // 例如：将集成场初始化为极大值
+    std::fill(field.integration_field.begin(), field.integration_field.end(), 65535.0f);
+    std::fill(field.flow_directions.begin(), field.flow_directions.end(), Vec2(0, 0));
+    calculation_queue.push(p_target_grid_pos);
+    field.is_computing = true;
+    field.demand = Rect2i();
+    field.counted_demand = Rect2i();
+    field.pending = 0;
+    field.frontier.clear();
+    field.settled_limit = 65535.0f;
+
+    // 如果目标点在地图范围内，将目标点的集成场值设为 0
+    int target_idx = relative_target_grid_pos.y * width + relative_target_grid_pos.x;
+    if (target_idx >= 0 && target_idx < (width * height)) {
+        field.integration_field[target_idx] = 0.0f;
+    }
+    field.touched = Rect2i(relative_target_grid_pos, Vec2i(1, 1));
+
+    // UtilityFunctions::print("Created flow field for target: ", p_target_grid_pos);
+}
+
+void FlowFieldSystem::remove_flow_field(Vec2i p_target_grid_pos) {
+    auto it = flow_fields.find(p_target_grid_pos);
+    if (it == flow_fields.end()) return;
+    if (build.stage != BUILD_IDLE && build.target == p_target_grid_pos) cancel_build();
+    release_field_buffers(it->second);
+    flow_fields.erase(it);
+}
+
+void FlowFieldSystem::clear_all_fields() {
+    cancel_build();
+    for (auto& pair : flow_fields) {
+        release_field_buffers(pair.second);
+    }
+    flow_fields.clear();
+    baked_file.close();
+}
+
+void FlowFieldSystem::acquire_field_buffers(FlowField& r_field) {
+    if (r_field.integration_field.size() != (size_t)size && !free_integration_buffers.empty()) {
+        r_field.integration_field.swap(free_integration_buffers.back());
+        free_integration_buffers.pop_back();
+    }
+    if (r_field.flow_directions.size() != (size_t)size && !free_direction_buffers.empty()) {
+        r_field.flow_directions.swap(free_direction_buffers.back());
+        free_direction_buffers.pop_back();
+    }
+    // 池里没有时才真正分配
+    r_field.integration_field.resize(size);
+    r_field.flow_directions.resize(size);
+}
+
+void FlowFieldSystem::release_field_buffers(FlowField& r_field) {
+    if (r_field.integration_field.size() == (size_t)size && free_integration_buffers.size() < MAX_POOLED_BUFFERS) {
+        free_integration_buffers.push_back(std::move(r_field.integration_field));
+    }
+    if (r_field.flow_directions.size() == (size_t)size && free_direction_buffers.size() < MAX_POOLED_BUFFERS) {
+        free_direction_buffers.push_back(std::move(r_field.flow_directions));
+    }
+    r_field.integration_field = std::vector<float>();
+    r_field.flow_directions = std::vector<Vec2>();
+}
+
+void FlowFieldSystem::make_all_dirty() {
+    // 1. 遍历哈希表中的所有流场
+    for (auto& pair : flow_fields) {
+        FlowField& field = pair.second;
+
+        // 烘焙流场在 set_cost 时已经逐格检查过，仍然有效的不需要重算
+        if (field.is_baked()) continue;
+
+        // 标记为脏数据
+        field.mark_dirty();
+
+        // 重置计算状态
+        // 这样当单位下次调用 get_flow_direction 时，
+        // 逻辑会发现 (is_dirty && !is_computing)，从而将其重新放入计算队列
+        field.is_computing = false;
+    }
+
+    // 2. 清空当前的计算队列
+    // 因为队列里的任务是基于旧地图触发的，已经没有意义了
+    // 清空后，系统会根据单位当前的查询需求重新按优先级入队
+    std::queue<Vec2i> empty_queue;
+    std::swap(calculation_queue, empty_queue);
+    cancel_build();
+}
+
+void FlowFieldSystem::set_cost(Vec2i p_cell_pos, uint8_t p_cost) {
+    // 1. 边界检查：防止索引越界导致程序崩溃
+    Vec2i relative_cell_pos = p_cell_pos - grid_origin;
+    if (relative_cell_pos.x < 0 || relative_cell_pos.x >= width || relative_cell_pos.y < 0 || relative_cell_pos.y >= height) {
+        return;
+    }
+
+    // 2. 计算一维数组索引
+    int index = relative_cell_pos.y * width + relative_cell_pos.x;
+    if (terrain_costs[index] == p_cost) return;
+
+    // 3. 写入地形层，有效代价留到 flush 时合成
+    terrain_costs[index] = p_cost;
+    mark_cost_dirty(Rect2i(relative_cell_pos, Vec2i(1, 1)));
+}
+
+Rect2i FlowFieldSystem::set_cost_region(Rect2i p_region, uint8_t p_cost) {
+    Rect2i region = clip_region(p_region);
+
+    Vec2i min_cell(width, height);
+    Vec2i max_cell(-1, -1);
+    for (int y = region.position.y; y < region.position.y + region.size.y; ++y) {
+        for (int x = region.position.x; x < region.position.x + region.size.x; ++x) {
+            uint8_t& cost = terrain_costs[y * width + x];
+            if (cost == p_cost) continue;
+            cost = p_cost;
+            min_cell = Vec2i(std::min(min_cell.x, x), std::min(min_cell.y, y));
+            max_cell = Vec2i(std::max(max_cell.x, x), std::max(max_cell.y, y));
+        }
+    }
+
+    if (max_cell.x < 0) return Rect2i();
+
+    Rect2i changed(min_cell, max_cell - min_cell + Vec2i(1, 1));
+    mark_cost_dirty(changed);
+    return Rect2i(changed.position + grid_origin, changed.size);
+}
+
+Rect2i FlowFieldSystem::import_cost_map(const uint8_t* p_costs, int p_count) {
+    if (p_count != size) {
+        return Rect2i();
+    }
+
+    Vec2i min_cell(width, height);
+    Vec2i max_cell(-1, -1);
+    for (int index = 0; index < size; ++index) {
+        if (terrain_costs[index] == p_costs[index]) continue;
+        terrain_costs[index] = p_costs[index];
+
+        int x = index % width;
+        int y = index / width;
+        min_cell = Vec2i(std::min(min_cell.x, x), std::min(min_cell.y, y));
+        max_cell = Vec2i(std::max(max_cell.x, x), std::max(max_cell.y, y));
+    }
+
+    if (max_cell.x < 0) return Rect2i();
+
+    Rect2i changed(min_cell, max_cell - min_cell + Vec2i(1, 1));
+    mark_cost_dirty(changed);
+    return Rect2i(changed.position + grid_origin, changed.size);
+}
+
+void FlowFieldSystem::set_building_footprint(Rect2i p_region, bool p_occupied) {
+    Rect2i region = clip_region(p_region);
+    if (!region.has_area()) return;
+
+    for (int y = region.position.y; y < region.position.y + region.size.y; ++y) {
+        for (int x = region.position.x; x < region.position.x + region.size.x; ++x) {
+            uint8_t& count = building_occupancy[y * width + x];
+            if (p_occupied) {
+                if (count < 255) ++count;
+            }
+            else if (count > 0) {
+                --count;
+            }
+        }
+    }
+
+    mark_cost_dirty(region);
+}
+
+void FlowFieldSystem::set_cost_modifier_region(Rect2i p_region, int8_t p_modifier) {
+    Rect2i region = clip_region(p_region);
+    if (!region.has_area()) return;
+
+    for (int y = region.position.y; y < region.position.y + region.size.y; ++y) {
+        int row = y * width;
+        std::fill(cost_modifiers.begin() + row + region.position.x,
+            cost_modifiers.begin() + row + region.position.x + region.size.x, p_modifier);
+    }
+
+    mark_cost_dirty(region);
+}
+
+uint8_t FlowFieldSystem::compose_cost(int p_index) const {
+    if (building_occupancy[p_index] > 0) return 255;
+
+    uint8_t terrain = terrain_costs[p_index];
+    int8_t modifier = cost_modifiers[p_index];
+    if (terrain == 255 || modifier == 0) return terrain;
+
+    return (uint8_t)std::max(1, std::min((int)terrain + modifier, 254));
+}
+
+Rect2i FlowFieldSystem::clip_region(Rect2i p_region) const {
+    Rect2i relative(p_region.position - grid_origin, p_region.size);
+    return relative.intersection(Rect2i(0, 0, width, height));
+}
+
+void FlowFieldSystem::mark_cost_dirty(Rect2i p_relative_region) {
+    if (!p_relative_region.has_area()) return;
+
+    // 与已有的脏矩形相交时合并，保证各矩形互不相交，合成时每个格子只处理一次
+    Rect2i region = p_relative_region;
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < dirty_regions.size(); ++i) {
+            if (dirty_regions[i].intersects(region)) {
+                region = region.merge(dirty_regions[i]);
+                dirty_regions[i] = dirty_regions.back();
+                dirty_regions.pop_back();
+                merged = true;
+                break;
+            }
+        }
+    }
+    dirty_regions.push_back(region);
+
+    if ((int)dirty_regions.size() > MAX_DIRTY_REGIONS) {
+        Rect2i bounds = dirty_regions[0];
+        for (const Rect2i& dirty : dirty_regions) {
+            bounds = bounds.merge(dirty);
+        }
+        dirty_regions.clear();
+        dirty_regions.push_back(bounds);
+    }
+}
+
+Rect2i FlowFieldSystem::flush_cost_layers() {
+    if (dirty_regions.empty()) {
+        return Rect2i();
+    }
+
+    // 只在脏矩形内重新合成，找出有效代价真正变化的格子
+    std::vector<CostChange>& changes = cost_changes;
+    changes.clear();
+    for (const Rect2i& region : dirty_regions) {
+        for (int y = region.position.y; y < region.position.y + region.size.y; ++y) {
+            for (int x = region.position.x; x < region.position.x + region.size.x; ++x) {
+                int index = y * width + x;
+                uint8_t cost = compose_cost(index);
+                if (cost != global_cost_map[index]) {
+                    changes.push_back({ index, cost });
+                }
+            }
+        }
+    }
+    dirty_regions.clear();
+
+    return apply_cost_changes(changes);
+}
+
+Rect2i FlowFieldSystem::apply_cost_changes(const std::vector<CostChange>& p_changes) {
+    if (p_changes.empty()) {
+        return Rect2i();
+    }
+
+    // 1. 按修改前的地图逐个流场检查，只有受影响的流场需要重算
+    //    正在计算队列中的流场出队时会读取新地图，不需要检查
+    for (auto& pair : flow_fields) {
+        FlowField& field = pair.second;
+        if (!field.is_baked() && (field.is_dirty || field.is_computing)) continue;
+
+        for (const CostChange& change : p_changes) {
+            if (is_field_valid_for(field, change.index, change.cost)) continue;
+
+            if (field.is_baked()) {
+                unbake_flow_field(field);
+            }
+            else {
+                // 与 make_all_dirty 相同：下次被查询时重新入队
+                field.mark_dirty();
+            }
+            break;
+        }
+    }
+
+    //    正在计算的流场已经展开过的格子变了，算完之后仍然要重算
+    if (build.stage != BUILD_IDLE && !build.is_stale) {
+        Rect2i touched = build.work.touched;
+        Rect2i affected(touched.position - Vec2i(1, 1), touched.size + Vec2i(2, 2));
+        for (const CostChange& change : p_changes) {
+            if (affected.has_point(Vec2i(change.index % width, change.index / width))) {
+                build.is_stale = true;
+                break;
+            }
+        }
+    }
+
+    // 2. 写入有效代价，同时求出变化范围的包围盒
+    Vec2i min_cell(width, height);
+    Vec2i max_cell(-1, -1);
+    for (const CostChange& change : p_changes) {
+        global_cost_map[change.index] = change.cost;
+
+        int x = change.index % width;
+        int y = change.index / width;
+        min_cell = Vec2i(std::min(min_cell.x, x), std::min(min_cell.y, y));
+        max_cell = Vec2i(std::max(max_cell.x, x), std::max(max_cell.y, y));
+    }
+
+    // 3. 更新分区版本号（同一批修改共用一个版本号）
+    ++cost_version;
+    for (const CostChange& change : p_changes) {
+        int sector = (change.index / width / SECTOR_SIZE) * sector_columns + (change.index % width) / SECTOR_SIZE;
+        sector_versions[sector] = cost_version;
+    }
+
+    return Rect2i(min_cell + grid_origin, max_cell - min_cell + Vec2i(1, 1));
+}
+
+// 流场在某格的方向对应的邻居偏移
+static Vec2i get_direction_offset(const FlowField& p_field, int p_index) {
+    if (p_field.baked_directions) return get_flow_direction_offset(p_field.baked_directions[p_index]);
+    return get_flow_direction_offset(encode_flow_direction(p_field.flow_directions[p_index]));
+}
+
+bool FlowFieldSystem::is_field_valid_for(const FlowField& p_field, int p_index, uint8_t p_new_cost) const {
+    Vec2i relative_target = p_field.target_position - grid_origin;
+    if (relative_target.y * width + relative_target.x == p_index) return false;
+
+    // 有界计算的 frontier 上的积分值还不是最终结果，下面的推理不成立
+    if (p_field.is_partial() && !p_field.is_settled(p_index) && p_field.integration_at(p_index) < 65535.0f) return false;
+
+    int cell_x = p_index % width;
+    int cell_y = p_index / width;
+    float cell_value = p_field.integration_at(p_index);
+    uint8_t old_cost = global_cost_map[p_index];
+    bool wall_changed = (old_cost == 255) != (p_new_cost == 255);
+
+    // 新代价下该格经由邻居能得到的最小积分值
+    float best_value = 65535.0f;
+    for (int y_off = -1; y_off <= 1; ++y_off) {
+        for (int x_off = -1; x_off <= 1; ++x_off) {
+            if (x_off == 0 && y_off == 0) continue;
+            int nx = cell_x + x_off;
+            int ny = cell_y + y_off;
+            if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+
+            int neighbor_idx = ny * width + nx;
+            float move_dist = (x_off != 0 && y_off != 0) ? 1.414f : 1.0f;
+            float neighbor_value = p_field.integration_at(neighbor_idx);
+
+            if (p_new_cost != 255 && neighbor_value < 65535.0f) {
+                best_value = std::min(best_value, neighbor_value + move_dist * (float)p_new_cost);
+            }
+
+            // 邻居的方向指向这个格子，或者墙的增减改变了邻居斜向移动的墙角判断
+            Vec2i offset = get_direction_offset(p_field, neighbor_idx);
+            if (nx + offset.x == cell_x && ny + offset.y == cell_y) return false;
+            if (wall_changed && offset.x != 0 && offset.y != 0 &&
+                ((nx + offset.x == cell_x && ny == cell_y) || (nx == cell_x && ny + offset.y == cell_y))) {
+                return false;
+            }
+
+            // 代价变大：只要没有邻居的最短路径经过这个格子，其它格子的积分值都不变
+            uint8_t neighbor_cost = global_cost_map[neighbor_idx];
+            if (p_new_cost > old_cost && cell_value < 65535.0f && neighbor_cost != 255 &&
+                std::fabs(neighbor_value - (cell_value + move_dist * (float)neighbor_cost)) <= INTEGRATION_EPSILON) {
+                return false;
+            }
+        }
+    }
+
+    // 代价变小：这个格子本身变得更近时可能成为新的捷径
+    if (p_new_cost < old_cost) {
+        if (old_cost == 255) return best_value >= 65535.0f;
+        if (best_value < cell_value - INTEGRATION_EPSILON) return false;
+    }
+
+    return true;
+}
+
+void FlowFieldSystem::bump_sector_versions(Rect2i p_relative_region) {
+    ++cost_version;
+    int sector_x0 = p_relative_region.position.x / SECTOR_SIZE;
+    int sector_y0 = p_relative_region.position.y / SECTOR_SIZE;
+    int sector_x1 = (p_relative_region.position.x + p_relative_region.size.x - 1) / SECTOR_SIZE;
+    int sector_y1 = (p_relative_region.position.y + p_relative_region.size.y - 1) / SECTOR_SIZE;
+    for (int y = sector_y0; y <= sector_y1; ++y) {
+        for (int x = sector_x0; x <= sector_x1; ++x) {
+            sector_versions[y * sector_columns + x] = cost_version;
+        }
+    }
+}
+
+void FlowFieldSystem::restore_cost_layers(const uint8_t* p_terrain, const uint8_t* p_occupancy, const int8_t* p_modifiers) {
+    if (p_terrain) std::copy(p_terrain, p_terrain + size, terrain_costs.begin());
+    std::copy(p_occupancy, p_occupancy + size, building_occupancy.begin());
+    std::copy(p_modifiers, p_modifiers + size, cost_modifiers.begin());
+
+    for (int index = 0; index < size; ++index) {
+        global_cost_map[index] = compose_cost(index);
+    }
+    dirty_regions.clear();
+
+    // 烘焙数据不一定与新地图一致
+    for (auto& pair : flow_fields) {
+        if (pair.second.is_baked()) unbake_flow_field(pair.second);
+    }
+
+    if (size > 0) bump_sector_versions(Rect2i(0, 0, width, height));
+}
+
+uint64_t FlowFieldSystem::get_sector_version(Vec2i p_sector) const {
+    if (p_sector.x < 0 || p_sector.x >= sector_columns || p_sector.y < 0 || p_sector.y >= sector_rows) {
+        return 0;
+    }
+    return sector_versions[p_sector.y * sector_columns + p_sector.x];
+}
+
+bool FlowFieldSystem::is_region_changed_since(Rect2i p_region, uint64_t p_version) const {
+    if (p_version >= cost_version) return false;
+
+    Rect2i region = clip_region(p_region);
+    if (!region.has_area()) return false;
+
+    int sector_x0 = region.position.x / SECTOR_SIZE;
+    int sector_y0 = region.position.y / SECTOR_SIZE;
+    int sector_x1 = (region.position.x + region.size.x - 1) / SECTOR_SIZE;
+    int sector_y1 = (region.position.y + region.size.y - 1) / SECTOR_SIZE;
+    for (int y = sector_y0; y <= sector_y1; ++y) {
+        for (int x = sector_x0; x <= sector_x1; ++x) {
+            if (sector_versions[y * sector_columns + x] > p_version) return true;
+        }
+    }
+    return false;
+}
+
+void FlowFieldSystem::compute_integration_field(Vec2i p_target_grid_pos) {
+    // 1. 查找对应的流场数据
+    auto it = flow_fields.find(p_target_grid_pos);
+    if (it == flow_fields.end()) {
+        return;
+    }
+
+    flush_cost_layers();
+
+    FlowField& field = it->second;
+    if (field.is_baked()) unbake_flow_field(field);
+    compute_integration(field);
+}
+
+void FlowFieldSystem::compute_integration(FlowField& field) {
+    begin_integration(field);
+    Rect2i settled;
+    expand_integration(field, nullptr, settled);
+}
+
+void FlowFieldSystem::begin_integration(FlowField& field) {
+    // 2. 初始化：将所有格子的集成场设为最大值
+    // touched 之外本来就是初始值，只需要重置 touched 之内
+    reset_region(field, field.touched);
+    field.touched = Rect2i();
+    field.frontier.clear();
+    field.settled_limit = 0.0f;
+    field.counted_demand = Rect2i();
+    field.pending = 0;
+
+    // 检查目标点是否越界
+    Vec2i relative_target_grid_pos = field.target_position - grid_origin;
+    if (relative_target_grid_pos.x < 0 || relative_target_grid_pos.x >= width ||
+        relative_target_grid_pos.y < 0 || relative_target_grid_pos.y >= height) {
+        field.settled_limit = 65535.0f;
+        return;
+    }
+
+    // 3. 准备 Dijkstra 优先队列
+    // 堆就是流场的 frontier，有界计算提前停下时留给之后接着展开
+    // 设置目标点代价为 0 并入队
+    int target_idx = relative_target_grid_pos.y * width + relative_target_grid_pos.x;
+    field.integration_field[target_idx] = 0.0f;
+    field.frontier.push_back({ 0.0f, target_idx });
+    field.touched = Rect2i(relative_target_grid_pos, Vec2i(1, 1));
+}
+
+void FlowFieldSystem::reset_region(FlowField& field, Rect2i p_region) const {
+    Rect2i region = p_region.intersection(Rect2i(0, 0, width, height));
+    for (int y = region.position.y; y < region.position.y + region.size.y; ++y) {
+        int row = y * width;
+        std::fill(field.integration_field.begin() + row + region.position.x,
+            field.integration_field.begin() + row + region.position.x + region.size.x, 65535.0f);
+        std::fill(field.flow_directions.begin() + row + region.position.x,
+            field.flow_directions.begin() + row + region.position.x + region.size.x, Vec2(0, 0));
+    }
+}
+
+int64_t FlowFieldSystem::count_pending(FlowField& field, Rect2i p_demand) const {
+    // demand 被清空后重新申请过（不再包含数过的范围）时整块重新数
+    Rect2i counted = field.counted_demand;
+    if (!counted.has_area() || !p_demand.encloses(counted)) {
+        counted = Rect2i();
+        field.pending = 0;
+    }
+
+    // 墙不会被展开，不计入
+    auto count_row = [&](int p_row, int p_x_begin, int p_x_end) {
+        for (int index = p_row + p_x_begin; index < p_row + p_x_end; ++index) {
+            if (global_cost_map[index] != 255 && !field.is_settled(index)) ++field.pending;
+        }
+        return (int64_t)std::max(p_x_end - p_x_begin, 0);
+    };
+
+    int64_t checked = 0;
+    Vec2i end = p_demand.get_end();
+    for (int y = p_demand.position.y; y < end.y; ++y) {
+        int row = y * width;
+        if (counted.has_area() && y >= counted.position.y && y < counted.get_end().y) {
+            // 只数数过的范围左右两侧
+            checked += count_row(row, p_demand.position.x, counted.position.x);
+            checked += count_row(row, counted.get_end().x, end.x);
+        }
+        else {
+            checked += count_row(row, p_demand.position.x, end.x);
+        }
+    }
+    field.counted_demand = p_demand;
+    return checked;
+}
+
+bool FlowFieldSystem::expand_integration(FlowField& field, WorkBudget* p_budget, Rect2i& r_settled) {
+    // demand 内还没确定的格子数保存在 field.pending 中，分多次展开时不重新数；没有 demand 时一直展开到底
+    bool has_demand = false;
+    Rect2i demand = field.demand.intersection(Rect2i(0, 0, width, height));
+    if (is_bounded && demand.has_area()) {
+        has_demand = true;
+        int64_t checked = count_pending(field, demand);
+        if (field.pending == 0) return true;
+        if (p_budget && !p_budget->consume(checked)) return false;
+    }
+
+    // 使用 std::greater 确保它是最小堆（每次弹出代价最小的格子）
+    std::vector<CostIndexPair>& pq = field.frontier;
+    std::greater<CostIndexPair> heap_order;
+    float stop_at = std::numeric_limits<float>::max();
+    Vec2i min_cell(width, height);
+    Vec2i max_cell(-1, -1);
+    int64_t cells_relaxed = 0;
+    bool is_finished = true;
+
+    // 4. 开始扩散
+    while (!pq.empty()) {
+        // demand 都确定之后再多走 bounded_margin，单位稍微走出 demand 时不用马上接着展开
+        if (pq.front().first > stop_at) break;
+
+        // 预算用完：堆和积分值都留在流场里，下次接着展开
+        if (p_budget && !p_budget->consume(1)) {
+            is_finished = false;
+            break;
+        }
+
+        std::pop_heap(pq.begin(), pq.end(), heap_order);
+        CostIndexPair current = pq.back();
+        pq.pop_back();
+
+        float current_dist = current.first;
+        int current_idx = current.second;
+
+        // 优化：如果弹出的代价已经大于记录的代价，跳过
+        if (current_dist > field.integration_field[current_idx]) {
+            continue;
+        }
+
+        // 获取当前坐标
+        int cur_x = current_idx % width;
+        int cur_y = current_idx / width;
+
+        // 弹出即确定
+        min_cell = Vec2i(std::min(min_cell.x, cur_x), std::min(min_cell.y, cur_y));
+        max_cell = Vec2i(std::max(max_cell.x, cur_x), std::max(max_cell.y, cur_y));
+        if (has_demand && field.pending > 0 && demand.has_point(Vec2i(cur_x, cur_y))) {
+            if (--field.pending == 0) {
+                stop_at = current_dist + bounded_margin;
+            }
+        }
+
+        // 5. 检查 8 个方向的邻居
+        for (int x_off = -1; x_off <= 1; x_off++) {
+            for (int y_off = -1; y_off <= 1; y_off++) {
+                if (x_off == 0 && y_off == 0) continue; // 跳过自己
+
+                int nx = cur_x + x_off;
+                int ny = cur_y + y_off;
+
+                // 边界检查
+                if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
+                    int neighbor_idx = ny * width + nx;
+
+                    // 获取邻居格子的地形代价
+                    uint8_t cell_cost = global_cost_map[neighbor_idx];
+
+                    // 如果是墙 (255)，不可通行
+                    if (cell_cost == 255) continue;
+
+                    // 计算移动代价：直线为 1.0，对角线为 1.414 (√2)
+                    float move_dist = (x_off != 0 && y_off != 0) ? 1.414f : 1.0f;
+
+                    // 邻居的总代价 = 当前格子的总代价 + (移动距离 * 地形权重)
+                    float new_dist = current_dist + (move_dist * (float)cell_cost);
+
+                    // 如果找到更短路径，更新并入队
+                    if (new_dist < field.integration_field[neighbor_idx]) {
+                        field.integration_field[neighbor_idx] = new_dist;
+                        pq.push_back({ new_dist, neighbor_idx });
+                        std::push_heap(pq.begin(), pq.end(), heap_order);
+                        ++cells_relaxed;
+                    }
+                }
+            }
+        }
+    }
+
+    SIM_PROFILE_COUNT(COUNTER_CELLS_RELAXED, cells_relaxed);
+
+    // 堆顶（可能是过期的元素）以下的格子都已确定；堆空了就是整张图都算完了
+    field.settled_limit = pq.empty() ? 65535.0f : pq.front().first;
+    if (max_cell.x < 0) return is_finished;
+
+    // 被松弛过的格子都在确定的格子周围一圈以内
+    Rect2i settled(min_cell, max_cell - min_cell + Vec2i(1, 1));
+    Rect2i relaxed(settled.position - Vec2i(1, 1), settled.size + Vec2i(2, 2));
+    field.touched = field.touched.merge(relaxed.intersection(Rect2i(0, 0, width, height)));
+    r_settled = r_settled.has_area() ? r_settled.merge(settled) : settled;
+    return is_finished;
+}
+
+void FlowFieldSystem::request_flow_region(Vec2i p_target_grid_pos, Rect2i p_region) {
+    auto it = flow_fields.find(p_target_grid_pos);
+    if (it == flow_fields.end()) return;
+
+    FlowField& field = it->second;
+    if (field.is_baked()) return;
+
+    Rect2i region = clip_region(p_region);
+    if (!region.has_area()) return;
+
+    // 已经覆盖过的区域不用再数一遍
+    if (field.demand.has_area() && field.demand.encloses(region)) return;
+
+    // 还在排队的流场出队时按新的 demand 计算；脏的流场等重算，不在旧数据上接着展开
+    // 先合成代价：流场因此变脏时 demand 会被清空，这次申请的区域要记进新的 demand
+    bool can_expand = field.is_partial() && !field.is_computing && !field.is_dirty;
+    if (can_expand) {
+        flush_cost_layers();
+    }
+    field.demand = field.demand.has_area() ? field.demand.merge(region) : region;
+    if (!can_expand || field.is_dirty) return;
+
+    Rect2i settled;
+    expand_integration(field, nullptr, settled);
+    if (settled.has_area()) {
+        compute_directions(field, settled);
+        SIM_PROFILE_COUNT(COUNTER_FIELDS_EXPANDED, 1);
+    }
+}
+
+void FlowFieldSystem::compute_flow_directions(Vec2i p_target_grid_pos) {
+    auto it = flow_fields.find(p_target_grid_pos);
+    if (it == flow_fields.end()) return;
+
+    flush_cost_layers();
+
+    FlowField& field = it->second;
+    if (field.is_baked()) unbake_flow_field(field);
+    compute_directions(field);
+}
+
+void FlowFieldSystem::compute_directions(FlowField& field, Rect2i p_region) const {
+    Rect2i region = p_region.intersection(Rect2i(0, 0, width, height));
+    for (int y = region.position.y; y < region.position.y + region.size.y; y++) {
+        for (int x = region.position.x; x < region.position.x + region.size.x; x++) {
+            int current_idx = y * width + x;
+
+            // 如果当前格子本身是墙，方向设为零
+            // 还没确定的格子（有界计算的 frontier 之外）也是零，确定之后再算
+            if (global_cost_map[current_idx] == 255 || !field.is_settled(current_idx)) {
+                field.flow_directions[current_idx] = Vec2(0, 0);
+                continue;
+            }
+
+            float current_min = field.integration_field[current_idx];
+            Vec2 best_direction(0, 0);
+
+            // 检查 8 个方向的邻居
+            for (int x_off = -1; x_off <= 1; x_off++) {
+                for (int y_off = -1; y_off <= 1; y_off++) {
+                    if (x_off == 0 && y_off == 0) continue;
+
+                    int nx = x + x_off;
+                    int ny = y + y_off;
+
+                    // 1. 基础边界检查
+                    if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
+                        int neighbor_idx = ny * width + nx;
+
+                        // 2. 墙壁检查：邻居不能是墙
+                        if (global_cost_map[neighbor_idx] == 255) continue;
+
+                        // 3. 墙角检测 (Corner Cutting Prevention)
+                        // 如果是寻找对角线邻居 (例如 x_off=1, y_off=1)
+                        if (x_off != 0 && y_off != 0) {
+                            // 检查侧向的两个格子是否为墙
+                            // 例如：要去右下角，必须保证 右边 和 下边 都不是墙
+                            int side_neighbor_x = y * width + (x + x_off);
+                            int side_neighbor_y = (y + y_off) * width + x;
+
+                            if (global_cost_map[side_neighbor_x] == 255 ||
+                                global_cost_map[side_neighbor_y] == 255) {
+                                continue; // 只要有一侧是墙，就不允许走对角线
+                            }
+                        }
+
+                        // 4. 寻找最小值
+                        float neighbor_val = field.integration_field[neighbor_idx];
+                        if (neighbor_val < current_min) {
+                            current_min = neighbor_val;
+                            // 方向向量 = 邻居位置 - 当前位置
+                            best_direction = Vec2((float)x_off, (float)y_off);
+                        }
+                    }
+                }
+            }
+
+            // 归一化方向向量，以便单位移动速度一致
+            field.flow_directions[current_idx] = best_direction.normalized();
+        }
+    }
+}
+
+float FlowFieldSystem::get_cost(Vec2i p_grid_pos) {
+    Vec2i relative_grid_pos = p_grid_pos - grid_origin;
+
+    if (relative_grid_pos.x < 0 || relative_grid_pos.x >= width || relative_grid_pos.y < 0 || relative_grid_pos.y >= height) {
+        return -1.0;
+    }
+
+    flush_cost_layers();
+
+    int index = relative_grid_pos.y * width + relative_grid_pos.x;
+    return global_cost_map[index];
+}
+
+float FlowFieldSystem::get_terrain_cost(Vec2i p_grid_pos) const {
+    Vec2i relative_grid_pos = p_grid_pos - grid_origin;
+
+    if (relative_grid_pos.x < 0 || relative_grid_pos.x >= width || relative_grid_pos.y < 0 || relative_grid_pos.y >= height) {
+        return -1.0;
+    }
+
+    int index = relative_grid_pos.y * width + relative_grid_pos.x;
+    return terrain_costs[index];
+}
+
+const FlowField* FlowFieldSystem::use_flow_field(Vec2i p_target_grid_pos) {
+    auto it = flow_fields.find(p_target_grid_pos);
+    if (it == flow_fields.end()) {
+        return nullptr;
+    }
+
+    FlowField& field = it->second;
+    field.last_used_time = clock;
+
+    if (field.is_dirty && !field.is_computing) {
+        calculation_queue.push(p_target_grid_pos);
+        field.is_computing = true;
+    }
+    return &field;
+}
+
+float FlowFieldSystem::get_integration(Vec2 p_world_pos, Vec2 p_target_world_pos) {
+    Vec2i target_grid_pos = world_to_grid(p_target_world_pos);
+    request_flow_region(target_grid_pos, Rect2i(world_to_grid(p_world_pos), Vec2i(1, 1)));
+    const FlowField* field = use_flow_field(target_grid_pos);
+    if (!field) {
+        return -1.0;
+    }
+    return get_integration(*field, p_world_pos);
+}
+
+float FlowFieldSystem::get_integration(const FlowField& p_field, Vec2 p_world_pos) const {
+    Vec2i relative_grid_pos = world_to_grid(p_world_pos) - grid_origin;
+
+    if (relative_grid_pos.x < 0 || relative_grid_pos.x >= width || relative_grid_pos.y < 0 || relative_grid_pos.y >= height) {
+        return -1.0;
+    }
+
+    int index = relative_grid_pos.y * width + relative_grid_pos.x;
+
+    return p_field.integration_at(index);
+}
+
+Vec2 FlowFieldSystem::get_flow_direction(Vec2 p_world_pos, Vec2 p_target_world_pos) {
+    Vec2i target_grid_pos = world_to_grid(p_target_world_pos);
+    request_flow_region(target_grid_pos, Rect2i(world_to_grid(p_world_pos), Vec2i(1, 1)));
+    const FlowField* field = use_flow_field(target_grid_pos);
+    if (!field) {
+        // 如果该目标的流场还没创建，返回零向量
+        return Vec2(0, 0);
+    }
+    return get_flow_direction(*field, p_world_pos);
+}
+
+Vec2 FlowFieldSystem::get_flow_direction(const FlowField& p_field, Vec2 p_world_pos) const {
+    Vec2i relative_grid_pos = world_to_grid(p_world_pos) - grid_origin;
+    
+    if (relative_grid_pos.x < 0 || relative_grid_pos.x >= width || relative_grid_pos.y < 0 || relative_grid_pos.y >= height) {
+        return Vec2(0, 0);
+    }
+
+    int index = relative_grid_pos.y * width + relative_grid_pos.x;
+
+    return p_field.direction_at(index);
+}
+
+Vec2 FlowFieldSystem::get_congested_flow_direction(const FlowField& p_field, Vec2 p_world_pos, const CongestionField& p_congestion, float p_max_speed) const {
+    if (!p_congestion.is_enabled()) {
+        return get_flow_direction(p_field, p_world_pos);
+    }
+
+    Vec2i relative_grid_pos = world_to_grid(p_world_pos) - grid_origin;
+
+    if (relative_grid_pos.x < 0 || relative_grid_pos.x >= width || relative_grid_pos.y < 0 || relative_grid_pos.y >= height) {
+        return Vec2(0, 0);
+    }
+
+    int x = relative_grid_pos.x;
+    int y = relative_grid_pos.y;
+    int current_idx = y * width + x;
+    if (global_cost_map[current_idx] == 255) {
+        return p_field.direction_at(current_idx);
+    }
+
+    // 与 compute_directions 相同的邻居顺序和墙角规则，只考虑积分值比当前格小的邻居，不会绕回头
+    // 拥挤只改变选哪个邻居，总会选一个前进的方向，不会让人群原地等待
+    float current_integration = p_field.integration_at(current_idx);
+    float best_score = std::numeric_limits<float>::max();
+    Vec2 best_direction(0, 0);
+    bool is_congested = false;
+
+    for (int x_off = -1; x_off <= 1; x_off++) {
+        for (int y_off = -1; y_off <= 1; y_off++) {
+            if (x_off == 0 && y_off == 0) continue;
+
+            int nx = x + x_off;
+            int ny = y + y_off;
+            if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+
+            int neighbor_idx = ny * width + nx;
+            if (global_cost_map[neighbor_idx] == 255) continue;
+            if (x_off != 0 && y_off != 0) {
+                if (global_cost_map[y * width + nx] == 255 || global_cost_map[ny * width + x] == 255) continue;
+            }
+
+            float neighbor_val = p_field.integration_at(neighbor_idx);
+            if (neighbor_val >= current_integration) continue;
+
+            Vec2 direction = Vec2((float)x_off, (float)y_off).normalized();
+            float congestion = p_congestion.get_congestion_cost(neighbor_idx, direction, p_max_speed);
+            if (congestion > 0.0f) {
+                // 穿过邻居格的额外代价，斜向的路程更长
+                float step = (x_off != 0 && y_off != 0) ? 1.41421356f : 1.0f;
+                neighbor_val += step * global_cost_map[neighbor_idx] * congestion;
+                is_congested = true;
+            }
+
+            if (neighbor_val < best_score) {
+                best_score = neighbor_val;
+                best_direction = direction;
+            }
+        }
+    }
+
+    if (!is_congested) {
+        return p_field.direction_at(current_idx);
+    }
+    return best_direction;
+}
+
+Vec2i FlowFieldSystem::world_to_grid(Vec2 p_world_pos) const {
+    int32_t gx = (int32_t)std::floor(p_world_pos.x / (float)(cell_size.x));
+    int32_t gy = (int32_t)std::floor(p_world_pos.y / (float)(cell_size.y));
+    return Vec2i(gx, gy);
+}
+
+Vec2i FlowFieldSystem::world_to_relative(Vec2 p_world_pos) const {
+    Vec2i grid_pos = world_to_grid(p_world_pos);
+    return grid_pos - grid_origin;
+}
+
+bool FlowFieldSystem::is_in_grid(Vec2i p_grid_pos) const {
+    int rx = p_grid_pos.x - grid_origin.x;
+    int ry = p_grid_pos.y - grid_origin.y;
+    return (rx >= 0 && rx < width && ry >= 0 && ry < height);
+}
+
+void FlowFieldSystem::get_queued_targets(std::vector<Vec2i>& r_targets) const {
+    std::queue<Vec2i> copy = calculation_queue;
+    r_targets.clear();
+    r_targets.reserve(copy.size());
+    while (!copy.empty()) {
+        r_targets.push_back(copy.front());
+        copy.pop();
+    }
+}
+
+FlowField& FlowFieldSystem::restore_flow_field(Vec2i p_target_grid_pos) {
+    FlowField& field = flow_fields[p_target_grid_pos];
+    field.target_position = p_target_grid_pos;
+    field.baked_integration = nullptr;
+    field.baked_directions = nullptr;
+    acquire_field_buffers(field);
+    // 数据由调用方整张写入；没展开完的堆不保存，这样的流场存档时标记为脏
+    field.demand = Rect2i();
+    field.counted_demand = Rect2i();
+    field.pending = 0;
+    field.touched = Rect2i(0, 0, width, height);
+    field.frontier.clear();
+    field.settled_limit = 65535.0f;
+    return field;
+}
+
+void FlowFieldSystem::restore_queue(const Vec2i* p_targets, int p_count) {
+    cancel_build();
+    std::queue<Vec2i> empty_queue;
+    std::swap(calculation_queue, empty_queue);
+    for (int i = 0; i < p_count; ++i) {
+        calculation_queue.push(p_targets[i]);
+    }
+}
+
+void FlowFieldSystem::restore_clock(double p_clock, double p_cleanup_timer) {
+    clock = p_clock;
+    cleanup_timer = p_cleanup_timer;
+}
@@ -0,0 +1,392 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <chrono>
+#include <unordered_map>
+#include <string>
+
+#include "sim_math.h"
+#include "mapped_file.h"
+
+namespace sim {
+
+    class CongestionField;
+
+    // Dijkstra 优先队列的元素：<积分值, 一维索引>
+    typedef std::pair<float, int> CostIndexPair;
+
+    // 单个流场的数据结构
+    struct FlowField {
+        bool is_dirty = false;       //dirty指cost_map更新后flow_field没有更新
+        bool is_computing = false;       //是否已完成计算
+        double last_used_time = 0.0;       //上次被查询的时间（模拟时钟）
+        Vec2i target_position;           // 该流场的目标网格坐标
+        std::vector<float> integration_field; // Dijkstra 算法生成的集成场 (值越小离目标越近)
+        std::vector<Vec2> flow_directions; // 最终生成的方向向量数组 (单位查询这个)
+
+        // 烘焙流场：数据直接指向映射进内存的烘焙文件，只读，上面两个数组为空
+        const float* baked_integration = nullptr;
+        const uint8_t* baked_directions = nullptr;  // 方向编码，见 decode_flow_direction
+
+        // --- 有界计算 ---
+        // Dijkstra 在 demand 内的格子都确定、再向外多走一段之后停下，没展开完的堆留在 frontier 中，
+        // 之后有单位走到还没确定的格子时从这里接着展开
+        // demand 只在流场有效期间增长；流场变脏时清空，由使用者按自己现在的位置重新申请
+        Rect2i demand;                      // 使用者所在的区域（相对坐标），面积为 0 时整张图一次算完
+        Rect2i touched;                     // 积分值或方向改动过的范围（相对坐标），范围外积分值为 65535、方向为零
+        float settled_limit = 65535.0f;     // 积分值小于它的格子已是最终结果，算完整张图时为 65535
+        std::vector<CostIndexPair> frontier;
+        // demand 内还没确定的格子数，随展开递减；counted_demand 是已经数过的范围，demand 变大时只数新增的部分
+        Rect2i counted_demand;
+        int pending = 0;
+
+        FlowField() = default;
+
+        // 初始化数组大小
+        void reserve(int size) {
+            integration_field.assign(size, 65535.0f);
+            flow_directions.assign(size, Vec2(0, 0));
+            touched = Rect2i();
+        }
+
+        // 代价变了，等待重算；旧的 demand 可能是单位走过的整条路，不带进下一次计算
+        void mark_dirty() {
+            is_dirty = true;
+            demand = Rect2i();
+        }
+
+        bool is_baked() const { return baked_integration != nullptr; }
+
+        // 还有没展开的格子
+        bool is_partial() const { return !frontier.empty(); }
+
+        bool is_settled(int p_index) const { return integration_at(p_index) < settled_limit; }
+
+        float integration_at(int p_index) const;
+        Vec2 direction_at(int p_index) const;
+    };
+
+    // 烘焙文件中的方向编码：0 表示没有方向，1..8 依次对应 8 个邻居
+    uint8_t encode_flow_direction(Vec2 p_direction);
+    Vec2 decode_flow_direction(uint8_t p_code);
+    Vec2i get_flow_direction_offset(uint8_t p_code);
+
+    // 流场系统（与引擎无关），FlowFieldManager 只是它的外壳
+    class FlowFieldSystem {
+    private:
+        int width = 0;       // 地图宽度（格子数）
+        int height = 0;      // 地图高度（格子数）
+        int size = 0;       //总格子数
+        Vec2i grid_origin;       //地图的左上角坐标
+        Vec2i cell_size; // 每个格子的尺寸
+
+        // --- 代价图层 ---
+        // 有效代价：被建筑占用为 255；否则为地形代价，地形不是墙时再叠加动态修正值并限制在 [1, 254]
+        // 修改图层只记录脏矩形，在 flush_cost_layers 时才在脏矩形内重新合成
+        std::vector<uint8_t> terrain_costs;        // 静态地形 (通常 1 为平地，255 为墙)
+        std::vector<uint8_t> building_occupancy;   // 占用该格的建筑数
+        std::vector<int8_t> cost_modifiers;        // 动态修正值（减速区、危险区等）
+        std::vector<uint8_t> global_cost_map;      // 合成后的有效代价，流场算法读取这个
+        std::vector<Rect2i> dirty_regions;         // 尚未合成的区域（相对坐标，互不相交）
+        const int MAX_DIRTY_REGIONS = 16;          // 超过后合并成一个包围盒
+
+        // --- 分区版本号 ---
+        // 每次有效代价变化时 cost_version 加一，并写入受影响分区，使用方保存版本号后即可判断自己关心的区域是否变过
+        std::vector<uint64_t> sector_versions;
+        uint64_t cost_version = 0;
+        int sector_columns = 0;
+        int sector_rows = 0;
+
+        // 哈希表存储：Key 为目标点坐标，Value 为对应的完整流场数据
+        std::unordered_map<Vec2i, FlowField, Vec2iHasher> flow_fields;
+
+        std::queue<Vec2i> calculation_queue;
+
+        MappedFile baked_file;           // 烘焙流场文件，烘焙流场的数据指向这里
+
+        double clock = 0.0;              // 模拟时钟（秒），由 update 累加
+        double cleanup_timer = 0.0;      // 累加时间
+        const double CLEANUP_INTERVAL = 2.0; // 每 2 秒扫描一次
+        const double UNUSED_THRESHOLD = 10.0; // 超过 10 秒没用就删除
+
+        // --- 复用的缓冲区，稳定运行时不向堆申请内存 ---
+        // 删除的流场把数组还到池里，新建流场优先从池里取（只保留与当前地图同样大小的）
+        std::vector<std::vector<float>> free_integration_buffers;
+        std::vector<std::vector<Vec2>> free_direction_buffers;
+        const size_t MAX_POOLED_BUFFERS = 8;
+
+        void acquire_field_buffers(FlowField& r_field);
+        void release_field_buffers(FlowField& r_field);
+
+        // 有界计算：是否开启，以及 demand 都确定之后再向外展开的积分值（平地一格为 1）
+        bool is_bounded = true;
+        float bounded_margin = 16.0f;
+
+        // --- 分时计算 ---
+        // 队首的流场在 build 里计算：Dijkstra 的堆本来就保存在流场里，方向按行扫描，两步都可以随时停下，
+        // 下一次 update 接着算；算完之前流场保留旧数据，算完再和 build 的缓冲区整体交换。
+        // 每次 update 最多用 compute_budget_us 微秒，小的流场一次 update 可以算完好几个。
+        // 用时由墙上时钟决定，每次 update 实际做的工作量写进回放，回放时按工作量停下，结果与录制时一致
+        struct WorkBudget {
+            static const int64_t CHECK_INTERVAL = 256;
+
+            int64_t work = 0;               // 已做的工作量：弹出的格子数 + 计算方向的格子数
+            int64_t work_limit = -1;        // >= 0 时按工作量停下（回放）
+            bool has_deadline = false;
+            std::chrono::steady_clock::time_point deadline;
+
+            // 记入 p_work 个单位的工作，每跨过 CHECK_INTERVAL 检查一次预算，用完时返回 false
+            bool consume(int64_t p_work);
+        };
+
+        enum BuildStage {
+            BUILD_IDLE,
+            BUILD_RESET,                    // 重置缓冲区上一次改动过的范围
+            BUILD_INTEGRATION,
+            BUILD_DIRECTIONS,
+        };
+
+        struct FieldBuild {
+            BuildStage stage = BUILD_IDLE;
+            Vec2i target;
+            int row = 0;                    // 重置 / 方向扫描到的行（相对坐标）
+            bool is_stale = false;          // 计算期间已经展开过的格子的代价变了，算完之后仍然标记为脏
+            FlowField work;                 // 计算用的缓冲区
+        };
+
+        FieldBuild build;
+        int compute_budget_us = 2000;
+        bool has_replay_work = false;
+        int64_t replay_work = -1;           // 回放：下一次 update 的工作量，-1 表示完整计算一个流场
+        int64_t last_update_work = -1;      // 上一次 update 的工作量，按一次一个流场计算时为 -1
+
+        // 推进队首流场的计算，p_budget 为空时一次算完；算完（或队首的流场已经不在了）返回 true
+        bool step_build(WorkBudget* p_budget);
+        void cancel_build();
+
+        // 从头计算积分场：有界计算时只展开到 demand 确定为止
+        void compute_integration(FlowField& r_field);
+
+        // 重置积分场，只放入目标点
+        void begin_integration(FlowField& r_field);
+
+        // 把 p_region（相对坐标）内的积分值和方向恢复为初始值
+        void reset_region(FlowField& r_field, Rect2i p_region) const;
+
+        // 把 p_demand 中还没数过的格子计入 r_field.pending，返回这次检查的格子数
+        int64_t count_pending(FlowField& r_field, Rect2i p_demand) const;
+
+        // 接着 frontier 展开，直到 demand 内的格子都确定（再多走 bounded_margin）
+        // 这次确定的格子的包围盒（相对坐标）并入 r_settled；p_budget 用完时中途返回 false
+        bool expand_integration(FlowField& r_field, WorkBudget* p_budget, Rect2i& r_settled);
+
+        // 只计算 p_region（相对坐标）内的方向，还没确定的格子方向为零
+        void compute_directions(FlowField& r_field, Rect2i p_region) const;
+        void compute_directions(FlowField& r_field) const { compute_directions(r_field, r_field.touched); }
+
+        // 把烘焙流场解码成普通流场并标记为脏，之后按正常流程重算
+        void unbake_flow_field(FlowField& r_field);
+
+        // 把 p_index 格的有效代价改为 p_new_cost 之后流场的数据是否仍然正确
+        // 在写入代价之前调用：邻居的代价从当前地图读取，必须还是计算流场时的值
+        bool is_field_valid_for(const FlowField& p_field, int p_index, uint8_t p_new_cost) const;
+
+        // 合成后有效代价的变化：先逐个流场检查，再写入，只有受影响的流场标记为脏
+        struct CostChange {
+            int index;
+            uint8_t cost;
+        };
+        std::vector<CostChange> cost_changes;      // flush_cost_layers 复用
+        Rect2i apply_cost_changes(const std::vector<CostChange>& p_changes);
+
+        uint8_t compose_cost(int p_index) const;
+
+        // 把网格坐标的矩形裁剪到地图内，返回相对坐标
+        Rect2i clip_region(Rect2i p_region) const;
+
+        void mark_cost_dirty(Rect2i p_relative_region);
+
+        void bump_sector_versions(Rect2i p_relative_region);
+
+        void drop_baked_fields();
+
+    public:
+        void update(double p_delta);
+
+        // 完整计算队首的一个流场（包括已经算了一半的）
+        void process_one_task();
+
+        // 在预算内计算队列中的流场，见 compute_budget_us
+        void process_tasks();
+
+        void cleanup_flow_fields();
+
+        // --- 基础设置 ---
+
+        // 初始化网格尺寸和配置
+        void setup_grid(int p_width, int p_height, Vec2i p_origin, Vec2i p_cell_size);
+
+        // --- 流场生命周期管理 ---
+
+        // 为指定目标点创建一个新流场（如果已存在则重置）
+        void create_flow_field(Vec2i p_target_grid_pos, bool p_overwrite = true);
+
+        // 删除特定的流场
+        void remove_flow_field(Vec2i p_target_grid_pos);
+
+        // 清空所有流场数据
+        void clear_all_fields();
+
+        void make_all_dirty();
+
+        // --- 数据操作与算法 ---
+
+        // 修改地形代价（例如动态添加障碍物）
+        void set_cost(Vec2i p_cell_pos, uint8_t p_cost);
+
+        // 把矩形区域内的地形代价设为同一个值，整块只产生一个脏矩形
+        // 返回地形实际发生变化的格子的包围盒（网格坐标），没有变化时面积为 0
+        Rect2i set_cost_region(Rect2i p_region, uint8_t p_cost);
+
+        // 导入整张地形代价（按行存储，长度必须等于 width * height），返回值同 set_cost_region
+        Rect2i import_cost_map(const uint8_t* p_costs, int p_count);
+
+        // 建筑占用层：占用期间有效代价为 255，移除后恢复原来的地形代价
+        void set_building_footprint(Rect2i p_region, bool p_occupied);
+
+        // 动态修正层：把矩形区域内的修正值设为 p_modifier（0 表示取消修正）
+        void set_cost_modifier_region(Rect2i p_region, int8_t p_modifier);
+
+        // 在脏矩形内重新合成有效代价，并让受影响的流场重算；返回有效代价变化的包围盒
+        // update、计算流场和查询代价之前会自动调用
+        Rect2i flush_cost_layers();
+
+        // [核心] 计算指定目标的集成场 (Dijkstra/BFS)
+        void compute_integration_field(Vec2i p_target_grid_pos);
+
+        // [核心] 计算指定目标的向量方向场 (Gradient)
+        void compute_flow_directions(Vec2i p_target_grid_pos);
+
+        // --- 查询接口 (供单位调用) ---
+
+        // 有效代价
+        float get_cost(Vec2i p_grid_pos);
+
+        float get_terrain_cost(Vec2i p_grid_pos) const;
+
+        // 根据世界坐标和目标坐标，获取该位置与目标的距离
+        float get_integration(Vec2 p_world_pos, Vec2 p_target_world_pos);
+
+        // 根据世界坐标和目标坐标，获取该位置应有的移动方向向量
+        Vec2 get_flow_direction(Vec2 p_world_pos, Vec2 p_target_world_pos);
+
+        // 声明 p_region（网格坐标）内有单位在使用这个流场：有界计算的流场没有覆盖到时立即接着展开
+        // 流场还在计算队列中时只记录下来，出队计算时一并覆盖
+        void request_flow_region(Vec2i p_target_grid_pos, Rect2i p_region);
+
+        void set_bounded_integration(bool p_enabled) { is_bounded = p_enabled; }
+        bool is_bounded_integration() const { return is_bounded; }
+
+        void set_bounded_margin(float p_margin) { bounded_margin = p_margin > 0.0f ? p_margin : 0.0f; }
+        float get_bounded_margin() const { return bounded_margin; }
+
+        // 每次 update 计算流场的时间预算（微秒），0 表示每次 update 完整计算一个流场
+        void set_compute_budget_us(int p_budget) { compute_budget_us = p_budget > 0 ? p_budget : 0; }
+        int get_compute_budget_us() const { return compute_budget_us; }
+
+        // 录制用：上一次 update 因预算用完而停下时的工作量；没有停下（队列算空）时为 int64 最大值，没有按预算计算时为 -1
+        int64_t get_last_update_work() const { return last_update_work; }
+
+        // 回放用：下一次 update 做 p_work 个单位的工作后停下，-1 表示完整计算一个流场
+        void set_replay_work(int64_t p_work) { has_replay_work = true; replay_work = p_work; }
+
+        // 按目标取出流场并记录使用时间（脏的流场顺便加入计算队列），不存在时返回 nullptr
+        // 指针在下一次 update 或删除流场之前有效，单位组每 tick 取一次，组员直接用它查询
+        const FlowField* use_flow_field(Vec2i p_target_grid_pos);
+
+        // 以下查询直接使用已取出的流场，不再查哈希表
+        float get_integration(const FlowField& p_field, Vec2 p_world_pos) const;
+
+        Vec2 get_flow_direction(const FlowField& p_field, Vec2 p_world_pos) const;
+
+        // 在邻居的积分值上叠加拥挤代价，在仍然朝目标前进的邻居中选出绕开人群的方向
+        // 周围都不拥挤时与 get_flow_direction 的结果相同
+        Vec2 get_congested_flow_direction(const FlowField& p_field, Vec2 p_world_pos, const CongestionField& p_congestion, float p_max_speed) const;
+
+        // 将世界坐标转换为格点坐标
+        Vec2i world_to_grid(Vec2 p_world_pos) const;
+
+        Vec2i world_to_relative(Vec2 p_world_pos) const;
+
+        Vec2i get_grid_origin() const { return grid_origin; }
+
+        Vec2i get_cell_size() const { return cell_size; }
+
+        int get_width() const { return width; }
+
+        int get_height() const { return height; }
+
+        double get_clock() const { return clock; }
+
+        double get_cleanup_timer() const { return cleanup_timer; }
+
+        int get_field_count() const { return (int)flow_fields.size(); }
+
+        int get_queue_length() const { return (int)calculation_queue.size(); }
+
+        // 最近一次 flush_cost_layers 时合成的有效代价
+        const std::vector<uint8_t>& get_cost_map() const { return global_cost_map; }
+
+        const std::vector<uint8_t>& get_terrain_costs() const { return terrain_costs; }
+
+        const std::vector<uint8_t>& get_building_occupancy() const { return building_occupancy; }
+
+        const std::vector<int8_t>& get_cost_modifiers() const { return cost_modifiers; }
+
+        // 整体替换三个图层并立即合成（长度都必须等于 width * height），不会把现有流场标记为脏
+        // p_terrain 为 nullptr 时保留当前的地形层
+        void restore_cost_layers(const uint8_t* p_terrain, const uint8_t* p_occupancy, const int8_t* p_modifiers);
+
+        // --- 分区版本号 ---
+
+        static const int SECTOR_SIZE = 16;      // 每个分区 16x16 格
+
+        uint64_t get_cost_version() const { return cost_version; }
+
+        // p_sector 为分区坐标（相对地图左上角）
+        uint64_t get_sector_version(Vec2i p_sector) const;
+
+        // 网格坐标矩形覆盖的分区中，是否有分区在 p_version 之后变化过
+        bool is_region_changed_since(Rect2i p_region, uint64_t p_version) const;
+
+        // --- 存档 ---
+
+        const std::unordered_map<Vec2i, FlowField, Vec2iHasher>& get_flow_fields() const { return flow_fields; }
+
+        // --- 烘焙流场 ---
+
+        // 在当前代价地图上同步计算这些目标的流场并写入烘焙文件（离线步骤）
+        bool bake_flow_fields(const std::string& p_path, const std::vector<Vec2i>& p_targets, std::string& r_error);
+
+        // 映射烘焙文件并把其中的流场作为只读流场加入；文件与当前地图不符时拒绝加载
+        bool load_baked_fields(const std::string& p_path, std::string& r_error);
+
+        int get_baked_field_count() const;
+
+        // 当前代价地图的哈希，用于判断烘焙文件是否过期
+        uint64_t compute_cost_map_hash() const;
+
+        // 按顺序取出计算队列中的目标
+        void get_queued_targets(std::vector<Vec2i>& r_targets) const;
+
+        // 创建一个已分配好缓冲区的空流场，数据由调用方写入（不会加入计算队列）
+        FlowField& restore_flow_field(Vec2i p_target_grid_pos);
+
+        void restore_queue(const Vec2i* p_targets, int p_count);
+
+        void restore_clock(double p_clock, double p_cleanup_timer);
+
+        bool is_in_grid(Vec2i p_grid_pos) const;
+    };
+}
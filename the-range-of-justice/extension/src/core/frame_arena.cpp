@@ -0,0 +1,64 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+
+using namespace sim;
+
+void* FrameArena::allocate_bytes(size_t p_size, size_t p_align) {
+    // 先在当前块和后面已有的块里找
+    while (block_index < blocks.size()) {
+        Block& block = blocks[block_index];
+        size_t aligned = (offset + p_align - 1) & ~(p_align - 1);
+        if (aligned + p_size <= block.capacity) {
+            offset = aligned + p_size;
+            peak = std::max(peak, block_base + offset);
+            return block.data.get() + aligned;
+        }
+        block_base += block.capacity;
+        ++block_index;
+        offset = 0;
+    }
+
+    // 都放不下，追加一块（new[] 的结果按最大对齐要求对齐）
+    Block block;
+    block.capacity = p_size > MIN_BLOCK_SIZE ? p_size : MIN_BLOCK_SIZE;
+    block.data.reset(new uint8_t[block.capacity]);
+    blocks.push_back(std::move(block));
+    block_index = blocks.size() - 1;
+    offset = p_size;
+    peak = std::max(peak, block_base + offset);
+    return blocks.back().data.get();
+}
+
+void FrameArena::rewind(const Marker& p_marker) {
+    block_index = p_marker.block_index;
+    offset = p_marker.offset;
+    block_base = 0;
+    for (size_t i = 0; i < block_index; ++i) {
+        block_base += blocks[i].capacity;
+    }
+}
+
+void FrameArena::reset() {
+    // 上一帧用到了多块：换成一整块，下一帧起一块就够
+    if (blocks.size() > 1) {
+        size_t capacity = get_capacity();
+        blocks.clear();
+        Block block;
+        block.capacity = capacity;
+        block.data.reset(new uint8_t[capacity]);
+        blocks.push_back(std::move(block));
+    }
+
+    block_index = 0;
+    block_base = 0;
+    offset = 0;
+}
+
+size_t FrameArena::get_capacity() const {
+    size_t capacity = 0;
+    for (const Block& block : blocks) {
+        capacity += block.capacity;
+    }
+    return capacity;
+}
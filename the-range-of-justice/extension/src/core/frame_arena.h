@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// 每 tick 的线性分配器：tick 内的临时数组从这里取，tick 开始时 reset 整体释放
+// 当前块用完时再向堆申请新块；reset 时如果这一帧用到了多块，就合并成一块足够大的，
+// 之后稳定运行时不再向堆申请内存
+// 只能放不需要析构的类型；用完就可以丢的数组用 get_marker / rewind 提前归还
+
+namespace sim {
+
+    class FrameArena {
+    public:
+        struct Marker {
+            size_t block_index = 0;
+            size_t offset = 0;
+        };
+
+    private:
+        struct Block {
+            std::unique_ptr<uint8_t[]> data;
+            size_t capacity = 0;
+        };
+
+        static const size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+        std::vector<Block> blocks;
+        size_t block_index = 0;     // 正在使用的块
+        size_t offset = 0;          // 块内已分配的字节数
+        size_t block_base = 0;      // 当前块之前各块的容量之和
+        size_t peak = 0;            // 同时占用的最大字节数（跳过的块尾按已占用计）
+
+        void* allocate_bytes(size_t p_size, size_t p_align);
+
+    public:
+        template <typename T>
+        T* allocate(size_t p_count) {
+            static_assert(std::is_trivially_destructible<T>::value, "FrameArena does not run destructors");
+            return static_cast<T*>(allocate_bytes(p_count * sizeof(T), alignof(T)));
+        }
+
+        Marker get_marker() const { return { block_index, offset }; }
+        // 归还 p_marker 之后分配的所有内存
+        void rewind(const Marker& p_marker);
+
+        // 每 tick 开始时调用，之前分配的指针全部失效
+        void reset();
+
+        size_t get_capacity() const;
+        size_t get_peak() const { return peak; }
+    };
+}
@@ -0,0 +1,307 @@
+#include "influence_map.h"
+#include "unit_system.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace sim;
+
+// 递推结果的绝对值小于它时归零，不让衰减的尾巴落进非规格化浮点数（运算慢几十倍）
+static const float INFLUENCE_MIN_VALUE = 1e-30f;
+
+static inline float flush_tiny(float p_value) {
+    return std::fabs(p_value) < INFLUENCE_MIN_VALUE ? 0.0f : p_value;
+}
+
+// 沿行与行之间的方向递推：r_result[y] = Σ_k p_source[k] * decay^|k - y|
+// 分成 2 * p_rows 段，每段处理一整行（p_columns 个连续的 float），行内没有依赖：
+// 前 p_rows 段由上往下做前向递推，之后的 p_rows 段由下往上做后向递推，r_carry 在段之间保留
+static void propagate_row(const float* p_source, float* r_result, float* r_carry, int p_columns, int p_rows, int p_row, float p_decay) {
+    if (p_row < p_rows) {
+        // 前向：result[y] = source[y] + decay * result[y - 1]
+        int y = p_row;
+        const float* source = p_source + (size_t)y * p_columns;
+        float* result = r_result + (size_t)y * p_columns;
+        if (y == 0) {
+            std::copy(source, source + p_columns, result);
+            return;
+        }
+        const float* previous = result - p_columns;
+        for (int x = 0; x < p_columns; ++x) {
+            result[x] = flush_tiny(source[x] + p_decay * previous[x]);
+        }
+        return;
+    }
+
+    // 后向：再加上下方各行的贡献 carry[y] = decay * (source[y + 1] + carry[y + 1])
+    int y = 2 * p_rows - 1 - p_row;
+    if (y == p_rows - 1) {
+        std::fill(r_carry, r_carry + p_columns, 0.0f);
+    }
+    const float* source = p_source + (size_t)y * p_columns;
+    float* result = r_result + (size_t)y * p_columns;
+    for (int x = 0; x < p_columns; ++x) {
+        result[x] += r_carry[x];
+        r_carry[x] = flush_tiny(p_decay * (r_carry[x] + source[x]));
+    }
+}
+
+static const int TRANSPOSE_BLOCK = 16;
+
+// 分块转置第 p_band 段（第 p_band * TRANSPOSE_BLOCK 行起的 TRANSPOSE_BLOCK 行），块内的读写都留在缓存里
+// 整张是 p_rows 行 p_columns 列 -> p_columns 行 p_rows 列，返回这段的格子数
+static int transpose_band(const float* p_source, float* r_result, int p_columns, int p_rows, int p_band) {
+    int y0 = p_band * TRANSPOSE_BLOCK;
+    int y1 = std::min(y0 + TRANSPOSE_BLOCK, p_rows);
+    for (int x0 = 0; x0 < p_columns; x0 += TRANSPOSE_BLOCK) {
+        int x1 = std::min(x0 + TRANSPOSE_BLOCK, p_columns);
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                r_result[(size_t)x * p_rows + y] = p_source[(size_t)y * p_columns + x];
+            }
+        }
+    }
+    return (y1 - y0) * p_columns;
+}
+
+void InfluenceMap::setup(int p_width, int p_height, Vec2i p_cell_size, Vec2i p_origin) {
+    width = std::max(p_width, 0);
+    height = std::max(p_height, 0);
+    size = width * height;
+    grid_origin = p_origin;
+    cell_size = p_cell_size;
+
+    team_count = 0;
+    refresh_team = 0;
+    refresh_step = 0;
+    refresh_row = 0;
+    layers.clear();
+    is_team_valid.clear();
+
+    for (int layer = 0; layer < INFLUENCE_LAYER_COUNT; ++layer) {
+        sources[layer].assign(size, 0.0f);
+    }
+    work.assign(size, 0.0f);
+    transposed.assign(size, 0.0f);
+    staging.assign(size, 0.0f);
+    carry.assign(std::max(width, height), 0.0f);
+    scores.assign(size, 0.0f);
+}
+
+void InfluenceMap::invalidate() {
+    std::fill(is_team_valid.begin(), is_team_valid.end(), 0);
+}
+
+void InfluenceMap::update(const std::vector<UnitData>& p_units, const std::vector<float>& p_health,
+    const std::vector<float>& p_shield, const UnitTypeTable& p_types) {
+    if (size == 0 || cell_size.x <= 0 || cell_size.y <= 0) return;
+
+    int max_team = -1;
+    for (const UnitData& unit : p_units) {
+        if (unit.team < MAX_TEAMS) {
+            max_team = std::max(max_team, unit.team);
+        }
+    }
+    if (max_team + 1 > team_count) {
+        team_count = max_team + 1;
+        layers.resize((size_t)team_count * INFLUENCE_LAYER_COUNT);
+        for (std::vector<float>& layer : layers) {
+            layer.resize(size, 0.0f);
+        }
+        is_team_valid.resize(team_count, 0);
+    }
+    if (team_count == 0) return;
+
+    // 没有结果的阵营一次做完所有步骤；缓冲区被占用了，进行中的分片从头开始
+    bool has_refreshed = false;
+    for (int team = 0; team < team_count; ++team) {
+        if (is_team_valid[team]) continue;
+        for (int step = 0; step < STEP_COUNT; ++step) {
+            int rows = get_step_rows(step);
+            for (int row = 0; row < rows; ++row) {
+                run_row(team, step, row, p_units, p_health, p_shield, p_types);
+            }
+        }
+        is_team_valid[team] = 1;
+        has_refreshed = true;
+    }
+    if (has_refreshed) {
+        refresh_step = 0;
+        refresh_row = 0;
+        return;
+    }
+
+    // 按段推进，用完 cell_budget 或者这个阵营重算完就停下
+    if (refresh_step == 0 && refresh_row == 0) {
+        refresh_team = (refresh_team + 1) % team_count;
+    }
+    int64_t budget = cell_budget > 0 ? cell_budget : std::numeric_limits<int64_t>::max();
+    while (budget > 0) {
+        budget -= run_row(refresh_team, refresh_step, refresh_row, p_units, p_health, p_shield, p_types);
+        if (++refresh_row < get_step_rows(refresh_step)) continue;
+
+        refresh_row = 0;
+        if (++refresh_step == STEP_COUNT) {
+            refresh_step = 0;
+            break;
+        }
+    }
+}
+
+int InfluenceMap::get_step_rows(int p_step) const {
+    switch (p_step) {
+    case STEP_CLEAR: return height;
+    case STEP_SPLAT: return 1;
+    case STEP_STRENGTH_ROWS:
+    case STEP_THREAT_ROWS: return 2 * height;
+    case STEP_STRENGTH_TRANSPOSE:
+    case STEP_THREAT_TRANSPOSE: return (height + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+    case STEP_STRENGTH_COLUMNS:
+    case STEP_THREAT_COLUMNS: return 2 * width;
+    default: return 0;
+    }
+}
+
+int InfluenceMap::run_row(int p_team, int p_step, int p_row, const std::vector<UnitData>& p_units, const std::vector<float>& p_health,
+    const std::vector<float>& p_shield, const UnitTypeTable& p_types) {
+    // 两层共用 work、transposed 和 staging：一层的几步总是连在一起做完
+    int layer = p_step >= STEP_THREAT_ROWS ? INFLUENCE_THREAT : INFLUENCE_STRENGTH;
+    switch (p_step) {
+    case STEP_CLEAR:
+        for (std::vector<float>& source : sources) {
+            std::fill(source.begin() + (size_t)p_row * width, source.begin() + (size_t)(p_row + 1) * width, 0.0f);
+        }
+        return width * INFLUENCE_LAYER_COUNT;
+    case STEP_SPLAT:
+        splat_team(p_team, p_units, p_health, p_shield, p_types);
+        return std::max((int)p_units.size(), 1);
+    case STEP_STRENGTH_ROWS:
+    case STEP_THREAT_ROWS:
+        propagate_row(sources[layer].data(), work.data(), carry.data(), width, height, p_row, get_decay(layer));
+        return width;
+    case STEP_STRENGTH_TRANSPOSE:
+    case STEP_THREAT_TRANSPOSE:
+        return transpose_band(work.data(), transposed.data(), width, height, p_row);
+    case STEP_STRENGTH_COLUMNS:
+    case STEP_THREAT_COLUMNS:
+        propagate_row(transposed.data(), staging.data(), carry.data(), height, width, p_row, get_decay(layer));
+        if (p_row == 2 * width - 1) {
+            layers[p_team * INFLUENCE_LAYER_COUNT + layer].swap(staging);
+        }
+        return height;
+    default:
+        return 1;
+    }
+}
+
+void InfluenceMap::splat_team(int p_team, const std::vector<UnitData>& p_units, const std::vector<float>& p_health,
+    const std::vector<float>& p_shield, const UnitTypeTable& p_types) {
+    float* strength = sources[INFLUENCE_STRENGTH].data();
+    float* threat = sources[INFLUENCE_THREAT].data();
+    for (size_t i = 0; i < p_units.size(); ++i) {
+        const UnitData& unit = p_units[i];
+        if (unit.team != p_team) continue;
+
+        int x = (int)std::floor(unit.position.x / (float)cell_size.x) - grid_origin.x;
+        int y = (int)std::floor(unit.position.y / (float)cell_size.y) - grid_origin.y;
+        if (x < 0 || x >= width || y < 0 || y >= height) continue;
+
+        const UnitTypeRecord& record = p_types.get(unit.type);
+        float durability_max = record.health_max + record.shield_max;
+        float durability = durability_max > 0.0f ? (p_health[i] + p_shield[i]) / durability_max : 1.0f;
+
+        int index = y * width + x;
+        strength[index] += (float)record.cost * durability;
+        if (record.attack_interval > 0.0f) {
+            threat[index] += record.attack_damage / record.attack_interval * durability;
+        }
+    }
+}
+
+float InfluenceMap::get_decay(int p_layer) const {
+    float decay = p_layer == INFLUENCE_THREAT ? threat_decay : strength_decay;
+    return std::max(0.0f, std::min(decay, 0.99f));
+}
+
+float InfluenceMap::get_value(int p_team, int p_layer, Vec2i p_grid_pos) const {
+    if (p_team < 0 || p_team >= team_count || p_layer < 0 || p_layer >= INFLUENCE_LAYER_COUNT) return 0.0f;
+    int x = p_grid_pos.x - grid_origin.x;
+    int y = p_grid_pos.y - grid_origin.y;
+    if (x < 0 || x >= width || y < 0 || y >= height) return 0.0f;
+    return get_layer(p_team, p_layer)[(size_t)x * height + y];
+}
+
+float InfluenceMap::get_score(int p_team, const InfluenceWeights& p_weights, Vec2i p_grid_pos) const {
+    float score = p_weights.strength * get_value(p_team, INFLUENCE_STRENGTH, p_grid_pos) +
+        p_weights.threat * get_value(p_team, INFLUENCE_THREAT, p_grid_pos);
+    for (int team = 0; team < team_count; ++team) {
+        if (team == p_team) continue;
+        score += p_weights.enemy_strength * get_value(team, INFLUENCE_STRENGTH, p_grid_pos) +
+            p_weights.enemy_threat * get_value(team, INFLUENCE_THREAT, p_grid_pos);
+    }
+    return score;
+}
+
+void InfluenceMap::compute_scores(int p_team, const InfluenceWeights& p_weights) {
+    std::fill(scores.begin(), scores.end(), 0.0f);
+    float* score = scores.data();
+    for (int team = 0; team < team_count; ++team) {
+        bool is_own = team == p_team;
+        float strength_weight = is_own ? p_weights.strength : p_weights.enemy_strength;
+        float threat_weight = is_own ? p_weights.threat : p_weights.enemy_threat;
+        const float* strength = get_layer(team, INFLUENCE_STRENGTH);
+        const float* threat = get_layer(team, INFLUENCE_THREAT);
+        if (strength_weight != 0.0f) {
+            for (int i = 0; i < size; ++i) {
+                score[i] += strength_weight * strength[i];
+            }
+        }
+        if (threat_weight != 0.0f) {
+            for (int i = 0; i < size; ++i) {
+                score[i] += threat_weight * threat[i];
+            }
+        }
+    }
+}
+
+int InfluenceMap::find_top_cells(int p_team, const InfluenceWeights& p_weights, int p_count, bool p_peaks_only, std::vector<InfluenceCell>& r_cells) {
+    r_cells.clear();
+    if (p_count <= 0 || size == 0 || team_count == 0) return 0;
+
+    compute_scores(p_team, p_weights);
+
+    // 小顶堆保留当前最好的 p_count 个，绝大多数格子只和堆顶比较一次
+    auto is_better = [](const InfluenceCell& p_a, const InfluenceCell& p_b) { return p_a.score > p_b.score; };
+    const float* score = scores.data();
+    for (int x = 0; x < width; ++x) {
+        for (int y = 0; y < height; ++y) {
+            int index = x * height + y;
+            float value = score[index];
+            if ((int)r_cells.size() == p_count && value <= r_cells.front().score) continue;
+
+            if (p_peaks_only) {
+                // 与左、上严格比较，与右、下允许相等，平台上只留一个角
+                if (x > 0 && score[index - height] >= value) continue;
+                if (y > 0 && score[index - 1] >= value) continue;
+                if (x < width - 1 && score[index + height] > value) continue;
+                if (y < height - 1 && score[index + 1] > value) continue;
+            }
+
+            InfluenceCell cell;
+            cell.grid_pos = Vec2i(x + grid_origin.x, y + grid_origin.y);
+            cell.score = value;
+            if ((int)r_cells.size() == p_count) {
+                std::pop_heap(r_cells.begin(), r_cells.end(), is_better);
+                r_cells.back() = cell;
+            }
+            else {
+                r_cells.push_back(cell);
+            }
+            std::push_heap(r_cells.begin(), r_cells.end(), is_better);
+        }
+    }
+
+    std::sort_heap(r_cells.begin(), r_cells.end(), is_better);
+    return (int)r_cells.size();
+}
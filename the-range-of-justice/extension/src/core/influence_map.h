@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "sim_math.h"
+
+// 按阵营分层的影响力图（与流场同分辨率），供敌方 AI 查询"哪里敌人强、哪里没人守"
+// 每个阵营两层：
+//   strength：单位价值 (cost) × 剩余生命比例
+//   threat：每秒伤害 × 剩余生命比例
+// 单位的数值先落在所在格子，再按指数衰减扩散：先沿 y、再沿 x 各做一次前向 + 后向递推，
+// 结果等于 Σ 源值 × decay^(|dx| + |dy|)，开销与扩散距离无关。
+// 递推的内层循环每次处理一整行连续的格子，编译器可以直接向量化；沿 x 的那一趟之前先转置，
+// 所以发布出去的图层按列存储（下标 x * height + y）。
+// 衰减的尾巴会一路落进非规格化浮点数的范围，这样的数运算要慢几十倍，所以递推中绝对值很小的结果直接归零。
+// 更新按 tick 分片：阵营轮流重算，每个阵营的重算分成清空、落点、每层沿 y 扩散 / 转置 / 沿 x 扩散几步，
+// 每步再按行切开，每次 update 最多处理 cell_budget 个格子；沿 x 扩散写进暂存图层，整层算完才与发布的图层交换，
+// 查询读到的总是各图层最近一次完整扩散的结果。
+
+namespace sim {
+
+    struct UnitData;
+    class UnitTypeTable;
+
+    enum InfluenceLayer {
+        INFLUENCE_STRENGTH,
+        INFLUENCE_THREAT,
+        INFLUENCE_LAYER_COUNT
+    };
+
+    // 查询的打分方式：各层按权重相加，敌方图层是其他所有阵营之和
+    // 例如 "敌人强的地方" = { 0, 0, 1, 0 }，"敌人有价值但防守薄弱的地方" = { 0, 0, 1, -1 }
+    struct InfluenceWeights {
+        float strength = 0.0f;
+        float threat = 0.0f;
+        float enemy_strength = 0.0f;
+        float enemy_threat = 0.0f;
+    };
+
+    struct InfluenceCell {
+        Vec2i grid_pos;     // 网格坐标（与流场一致）
+        float score;
+    };
+
+    class InfluenceMap {
+    public:
+        static const int MAX_TEAMS = 8;
+
+    private:
+        int width = 0;
+        int height = 0;
+        int size = 0;
+        Vec2i grid_origin;
+        Vec2i cell_size = Vec2i(1, 1);
+
+        // 一个阵营的重算分成几步，每步按行切开
+        enum RefreshStep {
+            STEP_CLEAR,                 // 清空落点缓冲区，每行一段
+            STEP_SPLAT,                 // 单位的数值落到格子上，只有一段
+            STEP_STRENGTH_ROWS,         // 实力层沿 y 扩散：前向每行一段，后向每行一段
+            STEP_STRENGTH_TRANSPOSE,    // 每 16 行一段
+            STEP_STRENGTH_COLUMNS,      // 沿 x 扩散进暂存图层，算完后发布
+            STEP_THREAT_ROWS,
+            STEP_THREAT_TRANSPOSE,
+            STEP_THREAT_COLUMNS,
+            STEP_COUNT
+        };
+
+        int team_count = 0;             // 出现过的最大阵营 + 1
+        int refresh_team = 0;           // 正在重算的阵营
+        int refresh_step = 0;
+        int refresh_row = 0;            // 当前这步做到的段
+        std::vector<std::vector<float>> layers;     // [阵营 * INFLUENCE_LAYER_COUNT + 图层][x * height + y]
+        std::vector<uint8_t> is_team_valid;
+
+        // --- 扩散用的缓冲区（按行存储），在分片的各步之间保留 ---
+        std::vector<float> sources[INFLUENCE_LAYER_COUNT];
+        std::vector<float> work;        // 沿 y 扩散的结果
+        std::vector<float> transposed;
+        std::vector<float> staging;     // 沿 x 扩散的结果，算完后与发布的图层交换
+        std::vector<float> carry;
+        std::vector<float> scores;      // 查询时的打分
+
+        float* get_layer(int p_team, int p_layer) { return layers[p_team * INFLUENCE_LAYER_COUNT + p_layer].data(); }
+        const float* get_layer(int p_team, int p_layer) const { return layers[p_team * INFLUENCE_LAYER_COUNT + p_layer].data(); }
+
+        void splat_team(int p_team, const std::vector<UnitData>& p_units, const std::vector<float>& p_health,
+            const std::vector<float>& p_shield, const UnitTypeTable& p_types);
+        int get_step_rows(int p_step) const;
+        // 做 p_step 的第 p_row 段，返回处理的格子数（计入 cell_budget）
+        int run_row(int p_team, int p_step, int p_row, const std::vector<UnitData>& p_units, const std::vector<float>& p_health,
+            const std::vector<float>& p_shield, const UnitTypeTable& p_types);
+        float get_decay(int p_layer) const;
+        void compute_scores(int p_team, const InfluenceWeights& p_weights);
+
+    public:
+        // 每格的衰减比例，威胁按攻击距离扩散得更远
+        float strength_decay = 0.7f;
+        float threat_decay = 0.85f;
+        // 每次 update 最多处理的格子数（清空、扩散、转置各算一次），<= 0 时每次 update 重算完一个阵营
+        int cell_budget = 1 << 18;
+
+        void setup(int p_width, int p_height, Vec2i p_cell_size, Vec2i p_origin);
+
+        // 每 tick 调用：没有结果的阵营（新出现的、读档后的）立即整个重算，否则在 cell_budget 内推进分片的重算
+        void update(const std::vector<UnitData>& p_units, const std::vector<float>& p_health,
+            const std::vector<float>& p_shield, const UnitTypeTable& p_types);
+
+        // 丢弃所有结果，下一次 update 全部重算
+        void invalidate();
+
+        int get_width() const { return width; }
+        int get_height() const { return height; }
+        int get_team_count() const { return team_count; }
+
+        // p_grid_pos 为网格坐标；阵营或位置超出范围时返回 0
+        float get_value(int p_team, int p_layer, Vec2i p_grid_pos) const;
+        float get_score(int p_team, const InfluenceWeights& p_weights, Vec2i p_grid_pos) const;
+
+        // 打分最高的 p_count 个格子（由高到低），返回实际个数
+        // p_peaks_only 时只取局部极大值，避免结果挤在同一个峰上
+        int find_top_cells(int p_team, const InfluenceWeights& p_weights, int p_count, bool p_peaks_only, std::vector<InfluenceCell>& r_cells);
+    };
+}
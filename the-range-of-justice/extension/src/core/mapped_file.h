@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sim {
+
+    // 只读的内存映射文件（Windows 使用 CreateFileMapping，其余平台使用 mmap）
+    class MappedFile {
+    private:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        void* file_handle = nullptr;
+        void* mapping_handle = nullptr;
+#endif
+
+    public:
+        MappedFile() {}
+        ~MappedFile() { close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& p_path);
+        void close();
+
+        bool is_open() const { return data != nullptr; }
+        const uint8_t* get_data() const { return data; }
+        size_t get_size() const { return size; }
+    };
+}
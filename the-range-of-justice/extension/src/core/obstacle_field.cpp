@@ -0,0 +1,157 @@
+#include "obstacle_field.h"
+#include "flow_field.h"
+
+#include <algorithm>
+
+using namespace sim;
+
+void ObstacleField::update(const FlowFieldSystem& p_flow_field_system) {
+    if (p_flow_field_system.get_width() != width || p_flow_field_system.get_height() != height ||
+        p_flow_field_system.get_grid_origin() != grid_origin || p_flow_field_system.get_cell_size() != cell_size) {
+        width = p_flow_field_system.get_width();
+        height = p_flow_field_system.get_height();
+        grid_origin = p_flow_field_system.get_grid_origin();
+        cell_size = p_flow_field_system.get_cell_size();
+        sector_columns = (width + FlowFieldSystem::SECTOR_SIZE - 1) / FlowFieldSystem::SECTOR_SIZE;
+        sector_rows = (height + FlowFieldSystem::SECTOR_SIZE - 1) / FlowFieldSystem::SECTOR_SIZE;
+        distances.assign(width * height, 0.0f);
+        normals.assign(width * height, Vec2(0, 0));
+        version = 0;
+    }
+    if (width <= 0 || height <= 0) return;
+
+    const std::vector<uint8_t>& costs = p_flow_field_system.get_cost_map();
+    uint64_t cost_version = p_flow_field_system.get_cost_version();
+
+    if (version == 0) {
+        rebuild_region(costs, Rect2i(0, 0, width, height));
+    }
+    else if (cost_version != version) {
+        // 变化的分区向外扩展，覆盖搜索半径内所有可能受影响的格子
+        int reach = (search_radius + FlowFieldSystem::SECTOR_SIZE - 1) / FlowFieldSystem::SECTOR_SIZE;
+        sector_marks.assign(sector_columns * sector_rows, 0);
+        for (int sy = 0; sy < sector_rows; ++sy) {
+            for (int sx = 0; sx < sector_columns; ++sx) {
+                if (p_flow_field_system.get_sector_version(Vec2i(sx, sy)) <= version) continue;
+                for (int y = std::max(sy - reach, 0); y <= std::min(sy + reach, sector_rows - 1); ++y) {
+                    for (int x = std::max(sx - reach, 0); x <= std::min(sx + reach, sector_columns - 1); ++x) {
+                        sector_marks[y * sector_columns + x] = 1;
+                    }
+                }
+            }
+        }
+
+        for (int sy = 0; sy < sector_rows; ++sy) {
+            for (int sx = 0; sx < sector_columns; ++sx) {
+                if (!sector_marks[sy * sector_columns + sx]) continue;
+                Rect2i sector(sx * FlowFieldSystem::SECTOR_SIZE, sy * FlowFieldSystem::SECTOR_SIZE,
+                    FlowFieldSystem::SECTOR_SIZE, FlowFieldSystem::SECTOR_SIZE);
+                rebuild_region(costs, sector.intersection(Rect2i(0, 0, width, height)));
+            }
+        }
+    }
+    version = cost_version;
+}
+
+void ObstacleField::rebuild_region(const std::vector<uint8_t>& p_costs, Rect2i p_relative_region) {
+    Vec2i end = p_relative_region.get_end();
+    for (int y = p_relative_region.position.y; y < end.y; ++y) {
+        for (int x = p_relative_region.position.x; x < end.x; ++x) {
+            rebuild_cell(p_costs, x, y);
+        }
+    }
+}
+
+void ObstacleField::rebuild_cell(const std::vector<uint8_t>& p_costs, int p_x, int p_y) {
+    int index = p_y * width + p_x;
+    bool is_inside = p_costs[index] >= obstacle_cost;
+
+    // 空地找最近的障碍格，障碍格找最近的空地格，取本格中心到那个格子矩形的最近点
+    // 以本格中心为原点，偏移 (dx, dy) 的格子覆盖 [dx * cell - half, dx * cell + half]
+    float half_x = cell_size.x * 0.5f;
+    float half_y = cell_size.y * 0.5f;
+    float max_distance = search_radius * (float)std::min(cell_size.x, cell_size.y);
+    float best_squared = max_distance * max_distance;
+    Vec2 best_point;
+    bool is_found = false;
+
+    for (int dy = -search_radius; dy <= search_radius; ++dy) {
+        int ny = p_y + dy;
+        if (ny < 0 || ny >= height) continue;
+        float qy = dy > 0 ? dy * cell_size.y - half_y : (dy < 0 ? dy * cell_size.y + half_y : 0.0f);
+
+        for (int dx = -search_radius; dx <= search_radius; ++dx) {
+            int nx = p_x + dx;
+            if (nx < 0 || nx >= width) continue;
+            if ((p_costs[ny * width + nx] >= obstacle_cost) == is_inside) continue;
+            float qx = dx > 0 ? dx * cell_size.x - half_x : (dx < 0 ? dx * cell_size.x + half_x : 0.0f);
+
+            float distance_squared = qx * qx + qy * qy;
+            if (distance_squared < best_squared) {
+                best_squared = distance_squared;
+                best_point = Vec2(qx, qy);
+                is_found = true;
+            }
+        }
+    }
+
+    if (!is_found) {
+        distances[index] = is_inside ? -max_distance : max_distance;
+        normals[index] = Vec2(0, 0);
+        return;
+    }
+
+    float distance = std::sqrt(best_squared);
+    if (is_inside) {
+        distances[index] = -distance;
+        normals[index] = best_point / distance;
+    }
+    else {
+        distances[index] = distance;
+        normals[index] = -best_point / distance;
+    }
+}
+
+bool ObstacleField::sample(Vec2 p_world_pos, ObstacleSample& r_sample) const {
+    if (distances.empty()) return false;
+
+    // 以格子中心为采样点的连续坐标
+    float u = p_world_pos.x / (float)cell_size.x - (float)grid_origin.x - 0.5f;
+    float v = p_world_pos.y / (float)cell_size.y - (float)grid_origin.y - 0.5f;
+    if (u < -0.5f || v < -0.5f || u >= width - 0.5f || v >= height - 0.5f) return false;
+
+    int x0 = (int)std::floor(u);
+    int y0 = (int)std::floor(v);
+    float fx = u - (float)x0;
+    float fy = v - (float)y0;
+    int x1 = std::min(x0 + 1, width - 1);
+    int y1 = std::min(y0 + 1, height - 1);
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+
+    int i00 = y0 * width + x0;
+    int i10 = y0 * width + x1;
+    int i01 = y1 * width + x0;
+    int i11 = y1 * width + x1;
+    float w00 = (1.0f - fx) * (1.0f - fy);
+    float w10 = fx * (1.0f - fy);
+    float w01 = (1.0f - fx) * fy;
+    float w11 = fx * fy;
+
+    r_sample.distance = distances[i00] * w00 + distances[i10] * w10 + distances[i01] * w01 + distances[i11] * w11;
+    r_sample.normal = (normals[i00] * w00 + normals[i10] * w10 + normals[i01] * w01 + normals[i11] * w11).normalized();
+    return true;
+}
+
+void ObstacleField::set_obstacle_cost(uint8_t p_cost) {
+    if (p_cost == obstacle_cost) return;
+    obstacle_cost = p_cost;
+    invalidate();
+}
+
+void ObstacleField::set_search_radius(int p_radius) {
+    p_radius = std::max(p_radius, 1);
+    if (p_radius == search_radius) return;
+    search_radius = p_radius;
+    invalidate();
+}
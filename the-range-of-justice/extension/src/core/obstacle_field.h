@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "sim_math.h"
+
+namespace sim {
+
+    class FlowFieldSystem;
+
+    // 单位位置处到最近障碍的距离
+    struct ObstacleSample {
+        float distance = 0.0f;      // 带符号距离（世界单位），在障碍内部为负
+        Vec2 normal;                // 远离最近障碍的单位向量，附近没有障碍时为 0
+    };
+
+    // 墙壁距离场：由有效代价预先算出每个格子中心到最近障碍的带符号距离和远离障碍的方向
+    // 单位每 tick 只做一次双线性插值就能得到墙壁的排斥方向和穿入深度，与墙的数量无关
+    //
+    // 只在 search_radius 格的范围内找障碍，更远处的距离一律记为 search_radius 格（方向为 0）
+    // 代价变化后按 FlowFieldSystem 的分区版本号只重算受影响的分区（向外扩展 search_radius 格）
+    class ObstacleField {
+    private:
+        int width = 0;
+        int height = 0;
+        Vec2i grid_origin;
+        Vec2i cell_size;
+        int sector_columns = 0;
+        int sector_rows = 0;
+
+        std::vector<float> distances;   // 每个格子中心的带符号距离
+        std::vector<Vec2> normals;      // 每个格子中心远离障碍的方向
+        std::vector<uint8_t> sector_marks;  // 本次需要重算的分区
+
+        uint64_t version = 0;           // 已同步到的代价版本，0 表示需要整体重建
+        uint8_t obstacle_cost = 255;    // 有效代价不小于这个值的格子视为障碍
+        int search_radius = 4;          // 格
+
+        void rebuild_cell(const std::vector<uint8_t>& p_costs, int p_x, int p_y);
+        void rebuild_region(const std::vector<uint8_t>& p_costs, Rect2i p_relative_region);
+
+    public:
+        // 与代价地图同步，在 FlowFieldSystem::update 之后调用（此时有效代价已合成）
+        void update(const FlowFieldSystem& p_flow_field_system);
+
+        // 下一次 update 时整体重建
+        void invalidate() { version = 0; }
+
+        // 双线性插值取样，位置在地图外时返回 false
+        bool sample(Vec2 p_world_pos, ObstacleSample& r_sample) const;
+
+        void set_obstacle_cost(uint8_t p_cost);
+        uint8_t get_obstacle_cost() const { return obstacle_cost; }
+
+        void set_search_radius(int p_radius);
+        int get_search_radius() const { return search_radius; }
+    };
+}
@@ -0,0 +1,176 @@
+#include "orca.h"
+
+#include <algorithm>
+
+using namespace sim;
+
+static const float ORCA_EPSILON = 0.00001f;
+
+void OrcaSolver::add_neighbour(Vec2 p_velocity, Vec2 p_relative_position, Vec2 p_relative_velocity,
+    float p_combined_radius, float p_time_horizon, float p_delta) {
+    float distance_squared = p_relative_position.length_squared();
+    float combined_radius_squared = p_combined_radius * p_combined_radius;
+
+    OrcaLine line;
+    Vec2 u;
+
+    if (distance_squared > combined_radius_squared) {
+        // 尚未碰撞：速度障碍是截断的圆锥
+        float inverse_horizon = 1.0f / p_time_horizon;
+        Vec2 w = p_relative_velocity - p_relative_position * inverse_horizon;
+        float w_length_squared = w.length_squared();
+        float dot_product = w.dot(p_relative_position);
+
+        if (dot_product < 0.0f && dot_product * dot_product > combined_radius_squared * w_length_squared) {
+            // 投影到截断圆上
+            float w_length = std::sqrt(w_length_squared);
+            if (w_length < ORCA_EPSILON) return;
+            Vec2 unit_w = w / w_length;
+            line.direction = Vec2(unit_w.y, -unit_w.x);
+            u = unit_w * (p_combined_radius * inverse_horizon - w_length);
+        }
+        else {
+            // 投影到圆锥的两条边上
+            float leg = std::sqrt(distance_squared - combined_radius_squared);
+            if (p_relative_position.cross(w) > 0.0f) {
+                line.direction = Vec2(p_relative_position.x * leg - p_relative_position.y * p_combined_radius,
+                    p_relative_position.x * p_combined_radius + p_relative_position.y * leg) / distance_squared;
+            }
+            else {
+                line.direction = -Vec2(p_relative_position.x * leg + p_relative_position.y * p_combined_radius,
+                    -p_relative_position.x * p_combined_radius + p_relative_position.y * leg) / distance_squared;
+            }
+            u = line.direction * p_relative_velocity.dot(line.direction) - p_relative_velocity;
+        }
+    }
+    else {
+        // 已经重叠：要求在这一步之内分开
+        if (p_delta <= 0.0) return;
+        float inverse_delta = 1.0f / p_delta;
+        Vec2 w = p_relative_velocity - p_relative_position * inverse_delta;
+        float w_length = w.length();
+        if (w_length < ORCA_EPSILON) return;
+        Vec2 unit_w = w / w_length;
+        line.direction = Vec2(unit_w.y, -unit_w.x);
+        u = unit_w * (p_combined_radius * inverse_delta - w_length);
+    }
+
+    line.point = p_velocity + u * 0.5f;
+    lines.push_back(line);
+}
+
+Vec2 OrcaSolver::solve(Vec2 p_preferred_velocity, float p_max_speed) {
+    Vec2 result;
+    int line_fail = linear_program2(lines, p_max_speed, p_preferred_velocity, false, result);
+    if (line_fail < (int)lines.size()) {
+        linear_program3(line_fail, p_max_speed, result);
+    }
+    return result;
+}
+
+// 在第 p_line_no 条线上、速度圆内，满足前面所有约束的最优点
+bool OrcaSolver::linear_program1(const std::vector<OrcaLine>& p_lines, int p_line_no, float p_radius, Vec2 p_opt_velocity, bool p_direction_opt, Vec2& r_result) const {
+    const OrcaLine& line = p_lines[p_line_no];
+    float dot_product = line.point.dot(line.direction);
+    float discriminant = dot_product * dot_product + p_radius * p_radius - line.point.length_squared();
+    if (discriminant < 0.0f) {
+        // 速度圆与这条线不相交
+        return false;
+    }
+
+    float sqrt_discriminant = std::sqrt(discriminant);
+    float t_left = -dot_product - sqrt_discriminant;
+    float t_right = -dot_product + sqrt_discriminant;
+
+    for (int i = 0; i < p_line_no; ++i) {
+        float denominator = line.direction.cross(p_lines[i].direction);
+        float numerator = p_lines[i].direction.cross(line.point - p_lines[i].point);
+
+        if (std::fabs(denominator) <= ORCA_EPSILON) {
+            // 两线平行
+            if (numerator < 0.0f) return false;
+            continue;
+        }
+
+        float t = numerator / denominator;
+        if (denominator >= 0.0f) {
+            t_right = std::min(t_right, t);
+        }
+        else {
+            t_left = std::max(t_left, t);
+        }
+        if (t_left > t_right) return false;
+    }
+
+    if (p_direction_opt) {
+        r_result = line.point + line.direction * (p_opt_velocity.dot(line.direction) > 0.0f ? t_right : t_left);
+    }
+    else {
+        float t = line.direction.dot(p_opt_velocity - line.point);
+        t = std::max(t_left, std::min(t, t_right));
+        r_result = line.point + line.direction * t;
+    }
+    return true;
+}
+
+// 返回第一条无法满足的约束的下标，全部满足时返回约束数
+int OrcaSolver::linear_program2(const std::vector<OrcaLine>& p_lines, float p_radius, Vec2 p_opt_velocity, bool p_direction_opt, Vec2& r_result) const {
+    if (p_direction_opt) {
+        r_result = p_opt_velocity * p_radius;
+    }
+    else if (p_opt_velocity.length_squared() > p_radius * p_radius) {
+        r_result = p_opt_velocity.normalized() * p_radius;
+    }
+    else {
+        r_result = p_opt_velocity;
+    }
+
+    for (int i = 0; i < (int)p_lines.size(); ++i) {
+        if (p_lines[i].direction.cross(p_lines[i].point - r_result) > 0.0f) {
+            Vec2 previous = r_result;
+            if (!linear_program1(p_lines, i, p_radius, p_opt_velocity, p_direction_opt, r_result)) {
+                r_result = previous;
+                return i;
+            }
+        }
+    }
+    return (int)p_lines.size();
+}
+
+// 约束不可行时，最小化对各约束的最大违反距离
+void OrcaSolver::linear_program3(int p_begin_line, float p_radius, Vec2& r_result) {
+    float distance = 0.0f;
+
+    for (int i = p_begin_line; i < (int)lines.size(); ++i) {
+        if (lines[i].direction.cross(lines[i].point - r_result) <= distance) continue;
+
+        projected_lines.clear();
+        for (int j = 0; j < i; ++j) {
+            OrcaLine line;
+            float determinant = lines[i].direction.cross(lines[j].direction);
+
+            if (std::fabs(determinant) <= ORCA_EPSILON) {
+                if (lines[i].direction.dot(lines[j].direction) > 0.0f) {
+                    // 同向平行
+                    continue;
+                }
+                line.point = (lines[i].point + lines[j].point) * 0.5f;
+            }
+            else {
+                line.point = lines[i].point + lines[i].direction *
+                    (lines[j].direction.cross(lines[i].point - lines[j].point) / determinant);
+            }
+
+            line.direction = (lines[j].direction - lines[i].direction).normalized();
+            projected_lines.push_back(line);
+        }
+
+        Vec2 previous = r_result;
+        if (linear_program2(projected_lines, p_radius, Vec2(-lines[i].direction.y, lines[i].direction.x), true, r_result) < (int)projected_lines.size()) {
+            // 理论上不会发生，只可能是浮点误差
+            r_result = previous;
+        }
+
+        distance = lines[i].direction.cross(lines[i].point - r_result);
+    }
+}
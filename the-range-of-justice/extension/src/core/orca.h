@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "sim_math.h"
+
+// ORCA (Optimal Reciprocal Collision Avoidance) 局部避让
+// 每个邻居给出一条半平面约束（OrcaLine 左侧为允许的速度），在最大速度的圆内
+// 求离期望速度最近的可行速度；约束互相矛盾时退而求最小化最大违反量的速度。
+// 线性规划部分按 van den Berg 等人的 RVO2 算法实现。
+
+namespace sim {
+
+    struct OrcaLine {
+        Vec2 point;
+        Vec2 direction;     // 单位向量，可行区域在方向的左侧
+    };
+
+    // 单个单位的求解器：先逐个加入邻居，再求解；缓冲区在多次求解之间复用，不会每次分配
+    class OrcaSolver {
+    private:
+        std::vector<OrcaLine> lines;
+        std::vector<OrcaLine> projected_lines;
+
+        bool linear_program1(const std::vector<OrcaLine>& p_lines, int p_line_no, float p_radius, Vec2 p_opt_velocity, bool p_direction_opt, Vec2& r_result) const;
+        int linear_program2(const std::vector<OrcaLine>& p_lines, float p_radius, Vec2 p_opt_velocity, bool p_direction_opt, Vec2& r_result) const;
+        void linear_program3(int p_begin_line, float p_radius, Vec2& r_result);
+
+    public:
+        void clear() { lines.clear(); }
+
+        // p_relative_position = 邻居位置 - 自身位置，p_relative_velocity = 自身速度 - 邻居速度
+        // 双方各承担一半的避让；已经重叠时在 p_delta 内分开
+        void add_neighbour(Vec2 p_velocity, Vec2 p_relative_position, Vec2 p_relative_velocity,
+            float p_combined_radius, float p_time_horizon, float p_delta);
+
+        int get_line_count() const { return (int)lines.size(); }
+
+        Vec2 solve(Vec2 p_preferred_velocity, float p_max_speed);
+    };
+}
@@ -0,0 +1,160 @@
+#include "profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+using namespace sim;
+
+static const char* PHASE_NAMES[PHASE_COUNT] = {
+    "hover",
+    "spatial_grid",
+    "flow_field_update",
+    "groups",
+    "unit_loop",
+    "damage",
+    "influence",
+    "multimesh",
+};
+
+static const char* COUNTER_NAMES[COUNTER_COUNT] = {
+    "fields_computed",
+    "neighbours_visited",
+    "cells_relaxed",
+    "fields_expanded",
+};
+
+const char* sim::get_phase_name(int p_phase) {
+    if (p_phase < 0 || p_phase >= PHASE_COUNT) return "";
+    return PHASE_NAMES[p_phase];
+}
+
+const char* sim::get_counter_name(int p_counter) {
+    if (p_counter < 0 || p_counter >= COUNTER_COUNT) return "";
+    return COUNTER_NAMES[p_counter];
+}
+
+Profiler& Profiler::get() {
+    static Profiler instance;
+    return instance;
+}
+
+int64_t Profiler::now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::begin_frame() {
+    uint64_t frame = write_count.load(std::memory_order_relaxed);
+    current = ProfileFrame();
+    current.frame = frame;
+    current.start_us = now_us();
+    in_frame = true;
+}
+
+void Profiler::end_frame() {
+    if (!in_frame) return;
+    in_frame = false;
+    current.end_us = now_us();
+
+    uint64_t frame = write_count.load(std::memory_order_relaxed);
+    Slot& slot = slots[frame % CAPACITY];
+
+    // seqlock：先置为奇数，写完数据后再置为偶数
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.data = current;
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+    write_count.store(frame + 1, std::memory_order_release);
+}
+
+void Profiler::add_phase(int p_phase, int64_t p_start_us, int64_t p_end_us) {
+    if (current.phase_us[p_phase] == 0) {
+        current.phase_start_us[p_phase] = p_start_us;
+    }
+    current.phase_us[p_phase] += p_end_us - p_start_us;
+}
+
+int Profiler::get_frames(int p_count, std::vector<ProfileFrame>& r_frames) const {
+    r_frames.clear();
+
+    uint64_t written = write_count.load(std::memory_order_acquire);
+    uint64_t available = written < (uint64_t)CAPACITY ? written : (uint64_t)CAPACITY;
+    uint64_t count = p_count < 0 ? 0 : (uint64_t)p_count;
+    if (count > available) count = available;
+
+    r_frames.reserve(count);
+    for (uint64_t frame = written - count; frame < written; ++frame) {
+        const Slot& slot = slots[frame % CAPACITY];
+
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        ProfileFrame copy = slot.data;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+
+        // 读的过程中被写入方覆盖了，丢弃这一帧
+        if (before != after || copy.frame != frame) continue;
+        r_frames.push_back(copy);
+    }
+
+    return (int)r_frames.size();
+}
+
+std::string Profiler::to_chrome_trace(int p_count) const {
+    std::vector<ProfileFrame> frames;
+    get_frames(p_count, frames);
+
+    std::string json = "{\"traceEvents\":[";
+    char buffer[256];
+    bool first = true;
+
+    auto append = [&](int p_length) {
+        if (!first) json += ",";
+        json.append(buffer, p_length);
+        first = false;
+    };
+
+    for (const ProfileFrame& frame : frames) {
+        append(std::snprintf(buffer, sizeof(buffer),
+            "{\"name\":\"tick\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%lld,\"dur\":%lld,\"args\":{\"frame\":%llu}}",
+            (long long)frame.start_us, (long long)(frame.end_us - frame.start_us), (unsigned long long)frame.frame));
+
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            if (frame.phase_us[phase] == 0) continue;
+            append(std::snprintf(buffer, sizeof(buffer),
+                "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%lld,\"dur\":%lld}",
+                PHASE_NAMES[phase], (long long)frame.phase_start_us[phase], (long long)frame.phase_us[phase]));
+        }
+
+        for (int counter = 0; counter < COUNTER_COUNT; ++counter) {
+            append(std::snprintf(buffer, sizeof(buffer),
+                "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%lld,\"args\":{\"value\":%lld}}",
+                COUNTER_NAMES[counter], (long long)frame.start_us, (long long)frame.counters[counter]));
+        }
+    }
+
+    json += "],\"displayTimeUnit\":\"ms\"}";
+    return json;
+}
+
+bool Profiler::write_chrome_trace(const std::string& p_path, int p_count) const {
+    std::ofstream file(p_path, std::ios::binary);
+    if (!file) return false;
+
+    std::string json = to_chrome_trace(p_count);
+    file.write(json.data(), json.size());
+    return (bool)file;
+}
+
+void Profiler::reset() {
+    current = ProfileFrame();
+    in_frame = false;
+    for (Slot& slot : slots) {
+        slot.sequence.store(0, std::memory_order_relaxed);
+        slot.data = ProfileFrame();
+    }
+    write_count.store(0, std::memory_order_release);
+}
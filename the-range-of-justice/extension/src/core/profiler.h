@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 分阶段的 tick 计时器
+// 只有定义了 SIM_PROFILING 才会编译进去，否则所有宏都展开为空，没有任何开销
+// （SIM_PROFILE_COUNT 的参数在关闭时仍会被求值，只能传没有副作用的表达式）
+//
+// 用法：
+//   SIM_PROFILE_FRAME_BEGIN();
+//   { SIM_PROFILE_SCOPE(sim::PHASE_SPATIAL_GRID); update_spatial_grid(); }
+//   SIM_PROFILE_COUNT(sim::COUNTER_CELLS_RELAXED, relaxed);
+//   SIM_PROFILE_FRAME_END();
+
+namespace sim {
+
+    enum ProfilePhase {
+        PHASE_HOVER,                // 鼠标悬停与点选
+        PHASE_SPATIAL_GRID,         // update_spatial_grid
+        PHASE_FLOW_FIELD_UPDATE,    // FlowFieldSystem::update
+        PHASE_GROUPS,               // 单位组的统计、到达判定和重新寻路
+        PHASE_UNIT_LOOP,            // 状态 / 选择 / 受力 / 移动
+        PHASE_DAMAGE,               // 伤害结算
+        PHASE_INFLUENCE,            // 影响力图
+        PHASE_MULTIMESH,            // update_multimesh_buffer
+        PHASE_COUNT
+    };
+
+    enum ProfileCounter {
+        COUNTER_FIELDS_COMPUTED,    // 本帧完成计算的流场数
+        COUNTER_NEIGHBOURS_VISITED, // 排斥力计算中访问的邻居数
+        COUNTER_CELLS_RELAXED,      // Dijkstra 中成功松弛的格子数
+        COUNTER_FIELDS_EXPANDED,    // 有界计算的流场接着展开的次数
+        COUNTER_COUNT
+    };
+
+    const char* get_phase_name(int p_phase);
+    const char* get_counter_name(int p_counter);
+
+    // 一帧的统计数据
+    struct ProfileFrame {
+        uint64_t frame = 0;
+        int64_t start_us = 0;                       // 帧开始时间（微秒，单调时钟）
+        int64_t end_us = 0;
+        int64_t phase_start_us[PHASE_COUNT] = {};   // 阶段第一次进入的时间（用于 trace）
+        int64_t phase_us[PHASE_COUNT] = {};         // 阶段累计耗时
+        int64_t counters[COUNTER_COUNT] = {};
+    };
+
+    // 单写多读的无锁环形缓冲区
+    // 写入方是模拟线程；读取方用每个槽位的序号 (seqlock) 判断读到的数据是否完整
+    class Profiler {
+    public:
+        static const int CAPACITY = 256;
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> sequence{ 0 };    // 奇数表示正在写入
+            ProfileFrame data;
+        };
+
+        Slot slots[CAPACITY];
+        std::atomic<uint64_t> write_count{ 0 };     // 已提交的帧数
+
+        ProfileFrame current;                       // 只有模拟线程访问
+        bool in_frame = false;
+
+    public:
+        static Profiler& get();
+        static int64_t now_us();
+
+        void begin_frame();
+        void end_frame();
+
+        void add_phase(int p_phase, int64_t p_start_us, int64_t p_end_us);
+        void add_counter(int p_counter, int64_t p_value) { current.counters[p_counter] += p_value; }
+
+        // 取出最近 p_count 帧（由旧到新），返回实际取到的帧数
+        int get_frames(int p_count, std::vector<ProfileFrame>& r_frames) const;
+
+        // 最近 p_count 帧的 Chrome trace (chrome://tracing / Perfetto) JSON
+        std::string to_chrome_trace(int p_count) const;
+        bool write_chrome_trace(const std::string& p_path, int p_count) const;
+
+        void reset();
+    };
+
+    class ProfileScope {
+    private:
+        int phase;
+        int64_t start_us;
+
+    public:
+        explicit ProfileScope(int p_phase) : phase(p_phase), start_us(Profiler::now_us()) {}
+        ~ProfileScope() { Profiler::get().add_phase(phase, start_us, Profiler::now_us()); }
+    };
+}
+
+#ifdef SIM_PROFILING
+#define SIM_PROFILE_CONCAT_INNER(a, b) a##b
+#define SIM_PROFILE_CONCAT(a, b) SIM_PROFILE_CONCAT_INNER(a, b)
+#define SIM_PROFILE_SCOPE(p_phase) ::sim::ProfileScope SIM_PROFILE_CONCAT(_sim_profile_scope_, __LINE__)(p_phase)
+#define SIM_PROFILE_COUNT(p_counter, p_value) ::sim::Profiler::get().add_counter((p_counter), (p_value))
+#define SIM_PROFILE_FRAME_BEGIN() ::sim::Profiler::get().begin_frame()
+#define SIM_PROFILE_FRAME_END() ::sim::Profiler::get().end_frame()
+#else
+#define SIM_PROFILE_SCOPE(p_phase) ((void)0)
+#define SIM_PROFILE_COUNT(p_counter, p_value) ((void)(p_value))
+#define SIM_PROFILE_FRAME_BEGIN() ((void)0)
+#define SIM_PROFILE_FRAME_END() ((void)0)
+#endif
@@ -0,0 +1,713 @@
+#include "replay.h"
+
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+using namespace sim;
+
+// 写入单位状态时使用的固定布局（不直接写 UnitData，避免结构体填充和字段顺序影响格式）
+struct ReplayUnitState {
+    int32_t id;
+    float position_x, position_y;
+    float velocity_x, velocity_y;
+    float target_x, target_y;
+    int32_t target_grid_x, target_grid_y;
+    int32_t state;
+    int32_t type;
+    int32_t is_selected;
+    float health;
+    float shield;
+    int32_t group_id;   // 后来加入，旧日志中没有这个字段
+    uint8_t lod_tier, lod_countdown, lod_elapsed, lod_combat_ticks;    // 同上
+    int32_t team;       // 同上
+};
+
+// 旧日志中单位状态的长度
+static const uint32_t REPLAY_UNIT_STATE_MIN_SIZE = offsetof(ReplayUnitState, group_id);
+
+struct ReplayBuildingState {
+    int32_t id;
+    int32_t grid_x, grid_y;
+    int32_t size_x, size_y;
+    int32_t type;
+};
+
+struct ReplaySelection {
+    int32_t state;
+    float mouse_x, mouse_y;
+    float box_x, box_y, box_w, box_h;
+    int32_t selected_unit_id;
+    int32_t selected_type;
+};
+
+static ReplaySelection pack_selection(const SelectionInput& p_selection) {
+    ReplaySelection packed;
+    packed.state = p_selection.state;
+    packed.mouse_x = p_selection.mouse_position.x;
+    packed.mouse_y = p_selection.mouse_position.y;
+    packed.box_x = p_selection.selecting_box.position.x;
+    packed.box_y = p_selection.selecting_box.position.y;
+    packed.box_w = p_selection.selecting_box.size.x;
+    packed.box_h = p_selection.selecting_box.size.y;
+    packed.selected_unit_id = p_selection.selected_unit_id;
+    packed.selected_type = p_selection.selected_type;
+    return packed;
+}
+
+static SelectionInput unpack_selection(const ReplaySelection& p_packed) {
+    SelectionInput selection;
+    selection.state = (SelectionState)p_packed.state;
+    selection.mouse_position = Vec2(p_packed.mouse_x, p_packed.mouse_y);
+    selection.selecting_box = Rect2(Vec2(p_packed.box_x, p_packed.box_y), Vec2(p_packed.box_w, p_packed.box_h));
+    selection.selected_unit_id = p_packed.selected_unit_id;
+    selection.selected_type = p_packed.selected_type;
+    return selection;
+}
+
+// ---------------------------------------------------------------------------
+// ReplayRecorder
+// ---------------------------------------------------------------------------
+
+ReplayRecorder& ReplayRecorder::get() {
+    static ReplayRecorder instance;
+    return instance;
+}
+
+ReplayRecorder::~ReplayRecorder() {
+    stop();
+}
+
+bool ReplayRecorder::start(const std::string& p_path) {
+    stop();
+
+    file = std::fopen(p_path.c_str(), "wb");
+    if (!file) return false;
+
+    buffer.clear();
+    buffer.reserve(FLUSH_SIZE * 2);
+    tick = 0;
+    expected_selection = SelectionInput();
+    has_expected_lod_view = false;
+    recorded_type_revision = 0;
+
+    ReplayHeader header = { REPLAY_MAGIC, REPLAY_VERSION };
+    write(header);
+    return true;
+}
+
+void ReplayRecorder::stop() {
+    if (!file) return;
+
+    flush();
+    std::fclose(file);
+    file = nullptr;
+}
+
+void ReplayRecorder::flush() {
+    if (!file || buffer.empty()) return;
+
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+    std::fflush(file);
+    buffer.clear();
+}
+
+void ReplayRecorder::write_bytes(const void* p_data, size_t p_size) {
+    const uint8_t* bytes = (const uint8_t*)p_data;
+    buffer.insert(buffer.end(), bytes, bytes + p_size);
+}
+
+void ReplayRecorder::begin_record(ReplayRecordType p_type, uint32_t p_payload_size) {
+    write((uint8_t)p_type);
+    write(tick);
+    write(p_payload_size);
+}
+
+void ReplayRecorder::record_current_state(const FlowFieldSystem& p_flow_fields, const UnitSystem& p_units, const BuildingSystem* p_buildings) {
+    if (!file) return;
+
+    record_setup(p_flow_fields.get_width(), p_flow_fields.get_height(), p_flow_fields.get_cell_size(), p_flow_fields.get_grid_origin());
+
+    const std::vector<uint8_t>& terrain = p_flow_fields.get_terrain_costs();
+    begin_record(REPLAY_COST_MAP, (uint32_t)terrain.size());
+    write_bytes(terrain.data(), terrain.size());
+
+    const std::vector<uint8_t>& occupancy = p_flow_fields.get_building_occupancy();
+    const std::vector<int8_t>& modifiers = p_flow_fields.get_cost_modifiers();
+    begin_record(REPLAY_COST_LAYERS, (uint32_t)(occupancy.size() + modifiers.size()));
+    write_bytes(occupancy.data(), occupancy.size());
+    write_bytes(modifiers.data(), modifiers.size());
+
+    if (p_units.get_unit_types()) {
+        record_unit_types(*p_units.get_unit_types());
+    }
+
+    for (int i = 0; i < p_units.get_unit_count(); ++i) {
+        const UnitData& unit = p_units.units[i];
+        ReplayUnitState state;
+        state.id = unit.id;
+        state.position_x = unit.position.x;
+        state.position_y = unit.position.y;
+        state.velocity_x = unit.velocity.x;
+        state.velocity_y = unit.velocity.y;
+        state.target_x = unit.target_pos.x;
+        state.target_y = unit.target_pos.y;
+        state.target_grid_x = unit.target_grid.x;
+        state.target_grid_y = unit.target_grid.y;
+        state.state = unit.state;
+        state.type = unit.type;
+        state.is_selected = unit.is_selected ? 1 : 0;
+        state.health = p_units.unit_health[i];
+        state.shield = p_units.unit_shield[i];
+        state.group_id = unit.group_id;
+        state.lod_tier = unit.lod_tier;
+        state.lod_countdown = unit.lod_countdown;
+        state.lod_elapsed = unit.lod_elapsed;
+        state.lod_combat_ticks = unit.lod_combat_ticks;
+        state.team = unit.team;
+
+        begin_record(REPLAY_UNIT_STATE, sizeof(state));
+        write(state);
+    }
+
+    if (p_buildings) {
+        for (const auto& it : p_buildings->get_buildings()) {
+            const BuildingData& building = it.second;
+            ReplayBuildingState state = { building.id, building.grid_pos.x, building.grid_pos.y, building.size.x, building.size.y, building.type };
+            begin_record(REPLAY_BUILDING_STATE, sizeof(state));
+            write(state);
+        }
+    }
+}
+
+void ReplayRecorder::record_unit_types(const UnitTypeTable& p_types) {
+    recorded_type_revision = p_types.get_revision();
+    for (int type = 0; type < p_types.get_type_count(); ++type) {
+        begin_record(REPLAY_UNIT_TYPE, sizeof(int32_t) + sizeof(UnitTypeRecord));
+        write((int32_t)type);
+        write(p_types.get(type));
+    }
+}
+
+void ReplayRecorder::sync_unit_types(const UnitSystem& p_units) {
+    const UnitTypeTable* types = p_units.get_unit_types();
+    if (types && types->get_revision() != recorded_type_revision) {
+        record_unit_types(*types);
+    }
+}
+
+void ReplayRecorder::record_setup(int p_width, int p_height, Vec2i p_cell_size, Vec2i p_origin) {
+    if (!file) return;
+
+    begin_record(REPLAY_SETUP, 6 * sizeof(int32_t));
+    write((int32_t)p_width);
+    write((int32_t)p_height);
+    write(p_cell_size.x);
+    write(p_cell_size.y);
+    write(p_origin.x);
+    write(p_origin.y);
+}
+
+void ReplayRecorder::record_set_cost(Vec2i p_cell_pos, uint8_t p_cost) {
+    if (!file) return;
+
+    begin_record(REPLAY_SET_COST, 2 * sizeof(int32_t) + 1);
+    write(p_cell_pos.x);
+    write(p_cell_pos.y);
+    write(p_cost);
+}
+
+void ReplayRecorder::record_set_cost_region(Rect2i p_region, uint8_t p_cost) {
+    if (!file) return;
+
+    begin_record(REPLAY_SET_COST_REGION, 4 * sizeof(int32_t) + 1);
+    write(p_region.position.x);
+    write(p_region.position.y);
+    write(p_region.size.x);
+    write(p_region.size.y);
+    write(p_cost);
+}
+
+void ReplayRecorder::record_import_cost_map(const uint8_t* p_costs, int p_count) {
+    if (!file) return;
+
+    begin_record(REPLAY_COST_MAP, (uint32_t)p_count);
+    write_bytes(p_costs, p_count);
+}
+
+void ReplayRecorder::record_set_cost_modifier(Rect2i p_region, int8_t p_modifier) {
+    if (!file) return;
+
+    begin_record(REPLAY_SET_COST_MODIFIER, 4 * sizeof(int32_t) + 1);
+    write(p_region.position.x);
+    write(p_region.position.y);
+    write(p_region.size.x);
+    write(p_region.size.y);
+    write(p_modifier);
+}
+
+void ReplayRecorder::record_spawn(const UnitSystem& p_units, Vec2 p_world_pos, int p_type, int p_team) {
+    if (!file) return;
+
+    // 出生时的生命值和护盾取自类型表，必须先写入
+    sync_unit_types(p_units);
+
+    begin_record(REPLAY_SPAWN, 2 * sizeof(float) + 2 * sizeof(int32_t));
+    write(p_world_pos.x);
+    write(p_world_pos.y);
+    write((int32_t)p_type);
+    write((int32_t)p_team);
+}
+
+void ReplayRecorder::record_despawn(int p_unit_id) {
+    if (!file) return;
+
+    begin_record(REPLAY_DESPAWN, sizeof(int32_t));
+    write((int32_t)p_unit_id);
+}
+
+void ReplayRecorder::record_command_move(const int* p_unit_ids, int p_count, Vec2 p_target_world_pos) {
+    if (!file) return;
+
+    begin_record(REPLAY_COMMAND_MOVE, 2 * sizeof(float) + sizeof(int32_t) + p_count * sizeof(int32_t));
+    write(p_target_world_pos.x);
+    write(p_target_world_pos.y);
+    write((int32_t)p_count);
+    for (int i = 0; i < p_count; ++i) {
+        write((int32_t)p_unit_ids[i]);
+    }
+}
+
+void ReplayRecorder::record_damage(int p_target_id, int p_attacker_id, float p_damage, int p_attack_type) {
+    if (!file) return;
+
+    begin_record(REPLAY_DAMAGE, 3 * sizeof(int32_t) + sizeof(float));
+    write((int32_t)p_target_id);
+    write((int32_t)p_attacker_id);
+    write(p_damage);
+    write((int32_t)p_attack_type);
+}
+
+void ReplayRecorder::record_place_building(Vec2i p_grid_pos, Vec2i p_size, int p_type) {
+    if (!file) return;
+
+    begin_record(REPLAY_PLACE_BUILDING, 5 * sizeof(int32_t));
+    write(p_grid_pos.x);
+    write(p_grid_pos.y);
+    write(p_size.x);
+    write(p_size.y);
+    write((int32_t)p_type);
+}
+
+void ReplayRecorder::record_remove_building(int p_building_id) {
+    if (!file) return;
+
+    begin_record(REPLAY_REMOVE_BUILDING, sizeof(int32_t));
+    write((int32_t)p_building_id);
+}
+
+void ReplayRecorder::record_tick_begin(double p_delta, const SelectionInput& p_selection, const UnitSystem& p_units) {
+    if (!file) return;
+
+    sync_unit_types(p_units);
+
+    // 只有玩家操作改变了选择输入时才需要写
+    ReplaySelection packed = pack_selection(p_selection);
+    ReplaySelection expected = pack_selection(expected_selection);
+    if (std::memcmp(&packed, &expected, sizeof(ReplaySelection)) != 0) {
+        begin_record(REPLAY_SELECTION, sizeof(ReplaySelection));
+        write(packed);
+    }
+
+    // 镜头矩形决定单位的更新频率，同样只在变化时写
+    Rect2 view;
+    bool has_view = p_units.get_lod_view(view);
+    if (has_view != has_expected_lod_view || (has_view &&
+        (view.position != expected_lod_view.position || view.size != expected_lod_view.size))) {
+        begin_record(REPLAY_SET_LOD_VIEW, sizeof(int32_t) + 4 * sizeof(float));
+        write((int32_t)(has_view ? 1 : 0));
+        write(view.position.x);
+        write(view.position.y);
+        write(view.size.x);
+        write(view.size.y);
+        has_expected_lod_view = has_view;
+        expected_lod_view = view;
+    }
+
+    begin_record(REPLAY_TICK, sizeof(double));
+    write(p_delta);
+}
+
+void ReplayRecorder::record_tick_end(const SelectionInput& p_selection, const UnitSystem& p_units) {
+    if (!file) return;
+
+    expected_selection = p_selection;
+
+    // 流场按时间预算计算时，每 tick 做了多少工作取决于机器快慢，回放时按记录的工作量计算
+    const FlowFieldSystem* flow_fields = p_units.get_flow_field_system();
+    if (flow_fields && flow_fields->get_last_update_work() >= 0) {
+        begin_record(REPLAY_FIELD_WORK, sizeof(int64_t));
+        write(flow_fields->get_last_update_work());
+    }
+    ++tick;
+
+    if (checksum_interval > 0 && tick % checksum_interval == 0) {
+        begin_record(REPLAY_CHECKSUM, sizeof(uint64_t));
+        write(p_units.compute_checksum());
+    }
+
+    if (buffer.size() >= FLUSH_SIZE) {
+        flush();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ReplayPlayer
+// ---------------------------------------------------------------------------
+
+template <typename T>
+static T read_value(const uint8_t*& p_cursor) {
+    T value;
+    std::memcpy(&value, p_cursor, sizeof(T));
+    p_cursor += sizeof(T);
+    return value;
+}
+
+bool ReplayPlayer::load(const std::string& p_path) {
+    data.clear();
+    cursor = 0;
+    ticks_played = 0;
+    checksum_mismatches = 0;
+    checksums_verified = 0;
+    selection = SelectionInput();
+    error.clear();
+
+    FILE* file = std::fopen(p_path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + p_path;
+        return false;
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    long length = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    if (length > 0) {
+        data.resize((size_t)length);
+        if (std::fread(data.data(), 1, data.size(), file) != data.size()) {
+            data.clear();
+        }
+    }
+    std::fclose(file);
+
+    ReplayHeader header;
+    if (data.size() < sizeof(header)) {
+        error = "file too short";
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION) {
+        error = "not a replay file or unsupported version";
+        return false;
+    }
+
+    cursor = sizeof(header);
+    return true;
+}
+
+bool ReplayPlayer::step(SimulationRefs& p_target) {
+    const size_t record_header_size = 1 + 2 * sizeof(uint32_t);
+
+    while (cursor + record_header_size <= data.size()) {
+        const uint8_t* p = data.data() + cursor;
+        uint8_t type = read_value<uint8_t>(p);
+        read_value<uint32_t>(p); // tick 只用于查看日志，回放靠 REPLAY_TICK 推进
+        uint32_t size = read_value<uint32_t>(p);
+
+        if (cursor + record_header_size + size > data.size()) {
+            error = "truncated record";
+            cursor = data.size();
+            return false;
+        }
+        cursor += record_header_size + size;
+
+        bool ticked = false;
+        if (!apply_record(p_target, type, p, size, ticked)) {
+            cursor = data.size();
+            return false;
+        }
+        if (ticked) {
+            return true;
+        }
+    }
+
+    cursor = data.size();
+    return false;
+}
+
+bool ReplayPlayer::peek_field_work(int64_t& r_work) const {
+    const size_t record_header_size = 1 + 2 * sizeof(uint32_t);
+    if (cursor + record_header_size + sizeof(int64_t) > data.size()) return false;
+
+    const uint8_t* p = data.data() + cursor;
+    uint8_t type = read_value<uint8_t>(p);
+    read_value<uint32_t>(p);
+    uint32_t size = read_value<uint32_t>(p);
+    if (type != REPLAY_FIELD_WORK || size < sizeof(int64_t)) return false;
+
+    r_work = read_value<int64_t>(p);
+    return true;
+}
+
+// 定长记录的负载大小，变长记录返回最小长度
+static uint32_t get_min_payload_size(uint8_t p_type) {
+    switch (p_type) {
+    case REPLAY_SETUP: return 6 * sizeof(int32_t);
+    case REPLAY_UNIT_TYPE: return sizeof(int32_t) + sizeof(UnitTypeRecord);
+    case REPLAY_UNIT_STATE: return REPLAY_UNIT_STATE_MIN_SIZE;
+    case REPLAY_BUILDING_STATE: return sizeof(ReplayBuildingState);
+    case REPLAY_SET_COST: return 2 * sizeof(int32_t) + 1;
+    case REPLAY_SPAWN: return 2 * sizeof(float) + sizeof(int32_t);       // 后面可能跟着阵营
+    case REPLAY_DESPAWN: return sizeof(int32_t);
+    case REPLAY_COMMAND_MOVE: return 2 * sizeof(float) + sizeof(int32_t);
+    case REPLAY_DAMAGE: return 3 * sizeof(int32_t) + sizeof(float);
+    case REPLAY_PLACE_BUILDING: return 5 * sizeof(int32_t);
+    case REPLAY_REMOVE_BUILDING: return sizeof(int32_t);
+    case REPLAY_SELECTION: return sizeof(ReplaySelection);
+    case REPLAY_TICK: return sizeof(double);
+    case REPLAY_CHECKSUM: return sizeof(uint64_t);
+    case REPLAY_SET_COST_REGION: return 4 * sizeof(int32_t) + 1;
+    case REPLAY_SET_COST_MODIFIER: return 4 * sizeof(int32_t) + 1;
+    case REPLAY_SET_LOD_VIEW: return sizeof(int32_t) + 4 * sizeof(float);
+    case REPLAY_FIELD_WORK: return sizeof(int64_t);
+    default: return 0;
+    }
+}
+
+bool ReplayPlayer::apply_record(SimulationRefs& p_target, uint8_t p_type, const uint8_t* p_payload, uint32_t p_size, bool& r_ticked) {
+    const uint8_t* p = p_payload;
+    if (p_size < get_min_payload_size(p_type)) {
+        error = "malformed record";
+        return false;
+    }
+    bool is_input = p_type <= REPLAY_REMOVE_BUILDING || p_type >= REPLAY_SET_COST_REGION;
+    if (p_type != REPLAY_SETUP && is_input && !p_target.units->is_ready()) {
+        error = "input before setup";
+        return false;
+    }
+    FlowFieldSystem* flow_fields = p_target.flow_fields;
+    UnitSystem* units = p_target.units;
+    BuildingSystem* buildings = p_target.buildings;
+
+    switch (p_type) {
+    case REPLAY_SETUP: {
+        int width = read_value<int32_t>(p);
+        int height = read_value<int32_t>(p);
+        Vec2i cell_size, origin;
+        cell_size.x = read_value<int32_t>(p);
+        cell_size.y = read_value<int32_t>(p);
+        origin.x = read_value<int32_t>(p);
+        origin.y = read_value<int32_t>(p);
+
+        units->set_flow_field_system(flow_fields);
+        units->set_unit_types(p_target.unit_types);
+        if (buildings) {
+            buildings->set_flow_field_system(flow_fields);
+            buildings->set_unit_system(units);
+        }
+        units->setup(width, height, cell_size, origin);
+        break;
+    }
+    case REPLAY_COST_MAP:
+        if (p_size != flow_fields->get_cost_map().size()) {
+            error = "cost map size does not match the grid";
+            return false;
+        }
+        flow_fields->import_cost_map(p, (int)p_size);
+        break;
+    case REPLAY_UNIT_TYPE: {
+        int type = read_value<int32_t>(p);
+        if (!is_valid_unit_type(type)) {
+            error = "malformed record";
+            return false;
+        }
+        UnitTypeRecord record = read_value<UnitTypeRecord>(p);
+        p_target.unit_types->set_record(type, record);
+        break;
+    }
+    case REPLAY_UNIT_STATE: {
+        ReplayUnitState state;
+        state.group_id = -1;
+        state.lod_tier = LOD_FULL;
+        state.lod_countdown = 0;
+        state.lod_elapsed = 0;
+        state.lod_combat_ticks = 0;
+        state.team = 0;
+        std::memcpy(&state, p, std::min<size_t>(p_size, sizeof(state)));
+        // 单位是逐条恢复的，这里还不知道总数；组 ID 的上界由 rebuild_groups 检查（超出单位数的当作没有组）
+        if (!is_valid_unit_type(state.type) || state.group_id < -1) {
+            error = "malformed record";
+            return false;
+        }
+        UnitData unit;
+        unit.id = state.id;
+        unit.position = Vec2(state.position_x, state.position_y);
+        unit.velocity = Vec2(state.velocity_x, state.velocity_y);
+        unit.target_pos = Vec2(state.target_x, state.target_y);
+        unit.target_grid = Vec2i(state.target_grid_x, state.target_grid_y);
+        unit.state = (UnitState)state.state;
+        unit.type = state.type;
+        unit.is_selected = state.is_selected != 0;
+        unit.group_id = state.group_id;
+        unit.lod_tier = state.lod_tier;
+        unit.lod_countdown = state.lod_countdown;
+        unit.lod_elapsed = state.lod_elapsed;
+        unit.lod_combat_ticks = state.lod_combat_ticks;
+        unit.team = state.team;
+        units->restore_unit(unit, state.health, state.shield);
+        break;
+    }
+    case REPLAY_BUILDING_STATE: {
+        ReplayBuildingState state = read_value<ReplayBuildingState>(p);
+        if (buildings) {
+            BuildingData building;
+            building.id = state.id;
+            building.grid_pos = Vec2i(state.grid_x, state.grid_y);
+            building.size = Vec2i(state.size_x, state.size_y);
+            building.type = state.type;
+            buildings->restore_building(building);
+        }
+        break;
+    }
+    case REPLAY_SET_COST: {
+        Vec2i cell;
+        cell.x = read_value<int32_t>(p);
+        cell.y = read_value<int32_t>(p);
+        flow_fields->set_cost(cell, read_value<uint8_t>(p));
+        break;
+    }
+    case REPLAY_SET_COST_REGION: {
+        Rect2i region;
+        region.position.x = read_value<int32_t>(p);
+        region.position.y = read_value<int32_t>(p);
+        region.size.x = read_value<int32_t>(p);
+        region.size.y = read_value<int32_t>(p);
+        flow_fields->set_cost_region(region, read_value<uint8_t>(p));
+        break;
+    }
+    case REPLAY_COST_LAYERS: {
+        size_t cells = flow_fields->get_cost_map().size();
+        if (p_size != 2 * cells) {
+            error = "cost layers size does not match the grid";
+            return false;
+        }
+        flow_fields->restore_cost_layers(nullptr, p, (const int8_t*)(p + cells));
+        break;
+    }
+    case REPLAY_SET_COST_MODIFIER: {
+        Rect2i region;
+        region.position.x = read_value<int32_t>(p);
+        region.position.y = read_value<int32_t>(p);
+        region.size.x = read_value<int32_t>(p);
+        region.size.y = read_value<int32_t>(p);
+        flow_fields->set_cost_modifier_region(region, read_value<int8_t>(p));
+        break;
+    }
+    case REPLAY_SET_LOD_VIEW: {
+        bool has_view = read_value<int32_t>(p) != 0;
+        Rect2 view;
+        view.position.x = read_value<float>(p);
+        view.position.y = read_value<float>(p);
+        view.size.x = read_value<float>(p);
+        view.size.y = read_value<float>(p);
+        if (has_view) {
+            units->set_lod_view(view);
+        }
+        else {
+            units->clear_lod_view();
+        }
+        break;
+    }
+    case REPLAY_SPAWN: {
+        float x = read_value<float>(p);
+        float y = read_value<float>(p);
+        int type = read_value<int32_t>(p);
+        if (!is_valid_unit_type(type)) {
+            error = "malformed record";
+            return false;
+        }
+        // 旧日志中没有阵营
+        int team = p_size >= get_min_payload_size(p_type) + sizeof(int32_t) ? read_value<int32_t>(p) : 0;
+        units->spawn_unit(Vec2(x, y), type, team);
+        break;
+    }
+    case REPLAY_DESPAWN:
+        units->despawn_unit(read_value<int32_t>(p));
+        break;
+    case REPLAY_COMMAND_MOVE: {
+        float x = read_value<float>(p);
+        float y = read_value<float>(p);
+        int count = read_value<int32_t>(p);
+        if (count < 0 || p_size != get_min_payload_size(p_type) + count * sizeof(int32_t)) {
+            error = "malformed record";
+            return false;
+        }
+        std::vector<int> ids(count);
+        for (int i = 0; i < count; ++i) {
+            ids[i] = read_value<int32_t>(p);
+        }
+        units->command_units_to_move(ids.data(), count, Vec2(x, y));
+        break;
+    }
+    case REPLAY_DAMAGE: {
+        int target_id = read_value<int32_t>(p);
+        int attacker_id = read_value<int32_t>(p);
+        float damage = read_value<float>(p);
+        units->apply_damage(target_id, attacker_id, damage, read_value<int32_t>(p));
+        break;
+    }
+    case REPLAY_PLACE_BUILDING: {
+        Vec2i grid_pos, size;
+        grid_pos.x = read_value<int32_t>(p);
+        grid_pos.y = read_value<int32_t>(p);
+        size.x = read_value<int32_t>(p);
+        size.y = read_value<int32_t>(p);
+        int type = read_value<int32_t>(p);
+        if (buildings) buildings->place_building(grid_pos, size, type);
+        break;
+    }
+    case REPLAY_REMOVE_BUILDING: {
+        int building_id = read_value<int32_t>(p);
+        if (buildings) buildings->remove_building(building_id);
+        break;
+    }
+    case REPLAY_SELECTION:
+        selection = unpack_selection(read_value<ReplaySelection>(p));
+        break;
+    case REPLAY_TICK: {
+        // 没有工作量记录的 tick（录制时没有按预算计算）每 tick 完整计算一个流场
+        int64_t field_work = -1;
+        peek_field_work(field_work);
+        flow_fields->set_replay_work(field_work);
+        units->tick(read_value<double>(p), selection);
+        ++ticks_played;
+        r_ticked = true;
+        break;
+    }
+    case REPLAY_FIELD_WORK:
+        // 已经在 REPLAY_TICK 中使用
+        break;
+    case REPLAY_CHECKSUM: {
+        uint64_t expected = read_value<uint64_t>(p);
+        ++checksums_verified;
+        if (units->compute_checksum() != expected) {
+            ++checksum_mismatches;
+        }
+        break;
+    }
+    default:
+        // 更新版本写入的记录，跳过
+        break;
+    }
+
+    return true;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "sim_math.h"
+#include "flow_field.h"
+#include "unit_types.h"
+#include "unit_system.h"
+#include "building_system.h"
+#include "simulation_refs.h"
+
+// 回放日志：记录初始状态和每个 tick 的外部输入，无界面地重新运行即可复现一局比赛的性能表现
+//
+// 文件格式（小端）：
+//   ReplayHeader
+//   { uint8 type, uint32 tick, uint32 payload_size, payload } ...
+// payload_size 使读取方可以跳过不认识的记录
+
+namespace sim {
+
+    const uint32_t REPLAY_MAGIC = 0x594C5052; // "RPLY"
+    const uint32_t REPLAY_VERSION = 2;      // 2: REPLAY_FIELD_WORK 的工作量包括重置缓冲区和统计 demand
+
+    struct ReplayHeader {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    enum ReplayRecordType : uint8_t {
+        // --- 初始状态 ---
+        REPLAY_SETUP = 1,           // width, height, cell_size, origin
+        REPLAY_COST_MAP,            // 完整的地形代价（录制中途整体导入时也使用这条记录）
+        REPLAY_UNIT_TYPE,           // type, UnitTypeRecord
+        REPLAY_UNIT_STATE,          // 开始录制时已经存在的单位
+        REPLAY_BUILDING_STATE,      // 开始录制时已经存在的建筑
+
+        // --- 输入 ---
+        REPLAY_SET_COST,
+        REPLAY_SPAWN,               // x, y, type, team（旧日志没有 team）
+        REPLAY_DESPAWN,
+        REPLAY_COMMAND_MOVE,
+        REPLAY_DAMAGE,
+        REPLAY_PLACE_BUILDING,
+        REPLAY_REMOVE_BUILDING,
+        REPLAY_SELECTION,           // 与上一 tick 结束时不同的选择输入
+
+        // --- 帧 ---
+        REPLAY_TICK,                // delta，表示执行一次 tick
+        REPLAY_CHECKSUM,            // tick 之后的状态校验和
+
+        // --- 后来加入的输入（追加在末尾，保持旧日志的编号不变） ---
+        REPLAY_SET_COST_REGION,     // x, y, w, h, cost
+        REPLAY_COST_LAYERS,         // 初始状态：建筑占用层 + 动态修正层
+        REPLAY_SET_COST_MODIFIER,   // x, y, w, h, modifier
+        REPLAY_SET_LOD_VIEW,        // has_view, x, y, w, h：与上一 tick 不同的镜头矩形
+        REPLAY_FIELD_WORK,          // int64 work：紧跟在 REPLAY_TICK 之后，这个 tick 按时间预算计算流场的工作量
+    };
+
+    // 录制器（单例）：各个 Manager 在接收到外部输入时调用 record_*，没有在录制时直接返回
+    class ReplayRecorder {
+    private:
+        FILE* file = nullptr;
+        std::vector<uint8_t> buffer;
+        uint32_t tick = 0;
+
+        SelectionInput expected_selection;      // 回放方在下一 tick 开始时会持有的选择输入
+        bool has_expected_lod_view = false;     // 回放方当前的镜头矩形
+        Rect2 expected_lod_view;
+        uint64_t recorded_type_revision = 0;
+
+        static const size_t FLUSH_SIZE = 64 * 1024;
+
+        void begin_record(ReplayRecordType p_type, uint32_t p_payload_size);
+        void write_bytes(const void* p_data, size_t p_size);
+        template <typename T>
+        void write(const T& p_value) { write_bytes(&p_value, sizeof(T)); }
+        void flush();
+
+        void record_unit_types(const UnitTypeTable& p_types);
+        // 单位类型表在上次写入之后被修改过（加载数值、调试参数等）时整表重新写入
+        void sync_unit_types(const UnitSystem& p_units);
+
+    public:
+        // 每隔多少 tick 写一次校验和
+        int checksum_interval = 60;
+
+        static ReplayRecorder& get();
+
+        ~ReplayRecorder();
+
+        bool start(const std::string& p_path);
+        void stop();
+        bool is_recording() const { return file != nullptr; }
+
+        // 录制开始时系统已经初始化：写入当前的完整状态
+        void record_current_state(const FlowFieldSystem& p_flow_fields, const UnitSystem& p_units, const BuildingSystem* p_buildings);
+
+        void record_setup(int p_width, int p_height, Vec2i p_cell_size, Vec2i p_origin);
+        void record_set_cost(Vec2i p_cell_pos, uint8_t p_cost);
+        void record_set_cost_region(Rect2i p_region, uint8_t p_cost);
+        void record_import_cost_map(const uint8_t* p_costs, int p_count);
+        void record_set_cost_modifier(Rect2i p_region, int8_t p_modifier);
+        void record_spawn(const UnitSystem& p_units, Vec2 p_world_pos, int p_type, int p_team = 0);
+        void record_despawn(int p_unit_id);
+        void record_command_move(const int* p_unit_ids, int p_count, Vec2 p_target_world_pos);
+        void record_damage(int p_target_id, int p_attacker_id, float p_damage, int p_attack_type);
+        void record_place_building(Vec2i p_grid_pos, Vec2i p_size, int p_type);
+        void record_remove_building(int p_building_id);
+
+        // 在 UnitSystem::tick 前后调用
+        void record_tick_begin(double p_delta, const SelectionInput& p_selection, const UnitSystem& p_units);
+        void record_tick_end(const SelectionInput& p_selection, const UnitSystem& p_units);
+    };
+
+    // 回放器：一次性读入整个日志，按 tick 推进
+    class ReplayPlayer {
+    private:
+        std::vector<uint8_t> data;
+        size_t cursor = 0;
+        uint32_t ticks_played = 0;
+        int checksum_mismatches = 0;
+        int checksums_verified = 0;
+        SelectionInput selection;
+        std::string error;
+
+        bool apply_record(SimulationRefs& p_target, uint8_t p_type, const uint8_t* p_payload, uint32_t p_size, bool& r_ticked);
+
+        // 下一条记录是 REPLAY_FIELD_WORK 时取出其中的工作量
+        bool peek_field_work(int64_t& r_work) const;
+
+    public:
+        bool load(const std::string& p_path);
+        const std::string& get_error() const { return error; }
+
+        // 应用输入直到（包括）下一个 REPLAY_TICK；日志结束时返回 false
+        bool step(SimulationRefs& p_target);
+
+        bool is_finished() const { return cursor >= data.size(); }
+        uint32_t get_ticks_played() const { return ticks_played; }
+        int get_checksum_mismatches() const { return checksum_mismatches; }
+        int get_checksums_verified() const { return checksums_verified; }
+    };
+}
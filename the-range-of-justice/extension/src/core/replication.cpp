@@ -0,0 +1,473 @@
+#include "replication.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "flow_field.h"
+
+using namespace sim;
+
+static const float TAU = 6.28318530717958647692f;
+static const int64_t REPLICATION_MAX_TYPE = 0xFFFF;
+
+namespace {
+
+    // 追加写入数据包
+    struct PacketWriter {
+        std::vector<uint8_t>& buffer;
+
+        void write_byte(uint8_t p_value) { buffer.push_back(p_value); }
+
+        void write_varint(uint64_t p_value) {
+            while (p_value >= 0x80) {
+                buffer.push_back((uint8_t)(p_value | 0x80));
+                p_value >>= 7;
+            }
+            buffer.push_back((uint8_t)p_value);
+        }
+
+        // zigzag：绝对值小的负数也只占一两个字节
+        void write_signed(int64_t p_value) {
+            write_varint(((uint64_t)p_value << 1) ^ (uint64_t)(p_value >> 63));
+        }
+    };
+
+    // 带边界检查的读取，越界后所有读取都失败
+    struct PacketReader {
+        const uint8_t* data;
+        size_t size;
+        size_t cursor = 0;
+
+        bool read_byte(uint8_t& r_value) {
+            if (cursor >= size) return false;
+            r_value = data[cursor++];
+            return true;
+        }
+
+        bool read_varint(uint64_t& r_value) {
+            r_value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                uint8_t byte;
+                if (!read_byte(byte)) return false;
+                r_value |= (uint64_t)(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) return true;
+            }
+            return false;
+        }
+
+        bool read_signed(int64_t& r_value) {
+            uint64_t value;
+            if (!read_varint(value)) return false;
+            r_value = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+            return true;
+        }
+
+        // 读出的差值加到 r_value 上
+        bool read_delta(int32_t& r_value) {
+            int64_t delta;
+            if (!read_signed(delta)) return false;
+            r_value = (int32_t)(r_value + delta);
+            return true;
+        }
+    };
+
+    // 在 p_base 的基础上有变化的字段
+    uint8_t get_change_mask(const ReplicatedUnit& p_base, const ReplicatedUnit& p_unit) {
+        uint8_t mask = 0;
+        if (p_unit.x != p_base.x || p_unit.y != p_base.y) mask |= REPLICATE_POSITION;
+        if (p_unit.velocity_x != p_base.velocity_x || p_unit.velocity_y != p_base.velocity_y) mask |= REPLICATE_VELOCITY;
+        if (p_unit.heading != p_base.heading) mask |= REPLICATE_HEADING;
+        if (p_unit.state != p_base.state) mask |= REPLICATE_STATE;
+        if (p_unit.health != p_base.health) mask |= REPLICATE_HEALTH;
+        if (p_unit.shield != p_base.shield) mask |= REPLICATE_SHIELD;
+        if (p_unit.type != p_base.type || p_unit.team != p_base.team) mask |= REPLICATE_IDENTITY;
+        return mask;
+    }
+
+    void write_fields(PacketWriter& p_writer, const ReplicatedUnit& p_base, const ReplicatedUnit& p_unit, uint8_t p_mask) {
+        if (p_mask & REPLICATE_POSITION) {
+            p_writer.write_signed((int64_t)p_unit.x - p_base.x);
+            p_writer.write_signed((int64_t)p_unit.y - p_base.y);
+        }
+        if (p_mask & REPLICATE_VELOCITY) {
+            p_writer.write_signed((int64_t)p_unit.velocity_x - p_base.velocity_x);
+            p_writer.write_signed((int64_t)p_unit.velocity_y - p_base.velocity_y);
+        }
+        if (p_mask & REPLICATE_HEADING) p_writer.write_byte(p_unit.heading);
+        if (p_mask & REPLICATE_STATE) p_writer.write_byte(p_unit.state);
+        if (p_mask & REPLICATE_HEALTH) p_writer.write_signed((int64_t)p_unit.health - p_base.health);
+        if (p_mask & REPLICATE_SHIELD) p_writer.write_signed((int64_t)p_unit.shield - p_base.shield);
+        if (p_mask & REPLICATE_IDENTITY) {
+            p_writer.write_signed(p_unit.type);
+            p_writer.write_byte(p_unit.team);
+        }
+    }
+
+    bool read_fields(PacketReader& p_reader, uint8_t p_mask, ReplicatedUnit& r_unit) {
+        if (p_mask & REPLICATE_POSITION) {
+            if (!p_reader.read_delta(r_unit.x) || !p_reader.read_delta(r_unit.y)) return false;
+        }
+        if (p_mask & REPLICATE_VELOCITY) {
+            if (!p_reader.read_delta(r_unit.velocity_x) || !p_reader.read_delta(r_unit.velocity_y)) return false;
+        }
+        if ((p_mask & REPLICATE_HEADING) && !p_reader.read_byte(r_unit.heading)) return false;
+        if ((p_mask & REPLICATE_STATE) && !p_reader.read_byte(r_unit.state)) return false;
+        if ((p_mask & REPLICATE_HEALTH) && !p_reader.read_delta(r_unit.health)) return false;
+        if ((p_mask & REPLICATE_SHIELD) && !p_reader.read_delta(r_unit.shield)) return false;
+        if (p_mask & REPLICATE_IDENTITY) {
+            int64_t type;
+            // 客户端按类型扩展本地的类型表，不接受离谱的值
+            if (!p_reader.read_signed(type) || type < 0 || type > REPLICATION_MAX_TYPE || !p_reader.read_byte(r_unit.team)) return false;
+            r_unit.type = (int32_t)type;
+        }
+        return true;
+    }
+
+    bool is_id_less(const ReplicatedUnit& p_a, const ReplicatedUnit& p_b) {
+        return p_a.id < p_b.id;
+    }
+}
+
+// --- 量化 ---
+
+static int32_t quantize(float p_value, float p_steps_per_unit) {
+    return (int32_t)std::lround((double)p_value * p_steps_per_unit);
+}
+
+ReplicatedUnit sim::quantize_unit(const ReplicationQuantizer& p_quantizer, Vec2i p_cell_size, const UnitData& p_unit, float p_health, float p_shield) {
+    float position_x = (float)p_quantizer.position_steps / (float)std::max(p_cell_size.x, 1);
+    float position_y = (float)p_quantizer.position_steps / (float)std::max(p_cell_size.y, 1);
+    float velocity_x = (float)p_quantizer.velocity_steps / (float)std::max(p_cell_size.x, 1);
+    float velocity_y = (float)p_quantizer.velocity_steps / (float)std::max(p_cell_size.y, 1);
+
+    ReplicatedUnit unit;
+    unit.id = p_unit.id;
+    unit.x = quantize(p_unit.position.x, position_x);
+    unit.y = quantize(p_unit.position.y, position_y);
+    unit.velocity_x = quantize(p_unit.velocity.x, velocity_x);
+    unit.velocity_y = quantize(p_unit.velocity.y, velocity_y);
+    unit.health = quantize(p_health, (float)p_quantizer.health_steps);
+    unit.shield = quantize(p_shield, (float)p_quantizer.health_steps);
+    unit.type = p_unit.type;
+    unit.heading = (uint8_t)(quantize(p_unit.heading, 256.0f / TAU) & 0xFF);
+    unit.state = (uint8_t)p_unit.state;
+    unit.team = (uint8_t)p_unit.team;
+    return unit;
+}
+
+void sim::dequantize_unit(const ReplicationQuantizer& p_quantizer, Vec2i p_cell_size, const ReplicatedUnit& p_unit,
+    UnitData& r_unit, float& r_health, float& r_shield) {
+    float position_x = (float)std::max(p_cell_size.x, 1) / (float)std::max(p_quantizer.position_steps, 1);
+    float position_y = (float)std::max(p_cell_size.y, 1) / (float)std::max(p_quantizer.position_steps, 1);
+    float velocity_x = (float)std::max(p_cell_size.x, 1) / (float)std::max(p_quantizer.velocity_steps, 1);
+    float velocity_y = (float)std::max(p_cell_size.y, 1) / (float)std::max(p_quantizer.velocity_steps, 1);
+    float health = 1.0f / (float)std::max(p_quantizer.health_steps, 1);
+
+    r_unit.id = p_unit.id;
+    r_unit.position = Vec2(p_unit.x * position_x, p_unit.y * position_y);
+    r_unit.velocity = Vec2(p_unit.velocity_x * velocity_x, p_unit.velocity_y * velocity_y);
+    r_unit.target_pos = r_unit.position;
+    r_unit.state = p_unit.state == MOVING ? MOVING : IDLE;
+    r_unit.type = p_unit.type;
+    r_unit.team = p_unit.team;
+    r_unit.group_id = -1;
+    // 取 [-π, π)，与 Vec2::angle 的范围一致
+    r_unit.heading = (p_unit.heading < 128 ? p_unit.heading : p_unit.heading - 256) * (TAU / 256.0f);
+    r_health = p_unit.health * health;
+    r_shield = p_unit.shield * health;
+}
+
+// --- 服务端 ---
+
+int ReplicationServer::add_client() {
+    for (int i = 0; i < (int)clients.size(); ++i) {
+        if (!clients[i].is_active) {
+            clients[i] = Client();
+            clients[i].is_active = true;
+            return i;
+        }
+    }
+    clients.emplace_back();
+    clients.back().is_active = true;
+    return (int)clients.size() - 1;
+}
+
+void ReplicationServer::remove_client(int p_client) {
+    if (!is_client_valid(p_client)) return;
+    clients[p_client] = Client();
+}
+
+bool ReplicationServer::is_client_valid(int p_client) const {
+    return p_client >= 0 && p_client < (int)clients.size() && clients[p_client].is_active;
+}
+
+void ReplicationServer::set_client_interest(int p_client, const Rect2& p_interest) {
+    if (!is_client_valid(p_client)) return;
+    clients[p_client].interest = p_interest;
+    clients[p_client].has_interest = true;
+}
+
+void ReplicationServer::clear_client_interest(int p_client) {
+    if (!is_client_valid(p_client)) return;
+    clients[p_client].has_interest = false;
+}
+
+void ReplicationServer::acknowledge(int p_client, uint32_t p_sequence) {
+    if (!is_client_valid(p_client)) return;
+    Client& client = clients[p_client];
+    if (p_sequence > client.acknowledged && p_sequence < client.next_sequence) {
+        client.acknowledged = p_sequence;
+    }
+}
+
+const ReplicationSnapshot* ReplicationServer::get_baseline(const Client& p_client) const {
+    if (p_client.acknowledged == 0) return nullptr;
+    if (p_client.next_sequence - p_client.acknowledged >= REPLICATION_HISTORY) return nullptr;
+
+    const ReplicationSnapshot& snapshot = p_client.history[p_client.acknowledged % REPLICATION_HISTORY];
+    return snapshot.sequence == p_client.acknowledged ? &snapshot : nullptr;
+}
+
+uint32_t ReplicationServer::encode(int p_client, UnitSystem& p_units, uint32_t p_tick, std::vector<uint8_t>& r_packet) {
+    r_packet.clear();
+    if (!is_client_valid(p_client) || !p_units.get_flow_field_system()) return 0;
+    Client& client = clients[p_client];
+    Vec2i cell_size = p_units.get_flow_field_system()->get_cell_size();
+
+    // 1. 关注区域内的单位，量化后按 ID 排序
+    current.units.clear();
+    if (client.has_interest) {
+        interest_indices.clear();
+        p_units.collect_units_in_rect(client.interest, interest_indices);
+        for (int index : interest_indices) {
+            current.units.push_back(quantize_unit(quantizer, cell_size, p_units.units[index], p_units.unit_health[index], p_units.unit_shield[index]));
+        }
+    }
+    else {
+        for (int index = 0; index < p_units.get_unit_count(); ++index) {
+            current.units.push_back(quantize_unit(quantizer, cell_size, p_units.units[index], p_units.unit_health[index], p_units.unit_shield[index]));
+        }
+    }
+    std::sort(current.units.begin(), current.units.end(), is_id_less);
+
+    const ReplicationSnapshot* baseline = get_baseline(client);
+    static const std::vector<ReplicatedUnit> empty;
+    const std::vector<ReplicatedUnit>& base_units = baseline ? baseline->units : empty;
+
+    // 2. 与基准逐个比较（两边都按 ID 排好序）：新出现的单位所有字段都与默认值比较，并且总是带上类型和阵营
+    change_masks.resize(current.units.size());
+    int changed_count = 0;
+    int removed_count = 0;
+    size_t base_index = 0;
+    for (size_t i = 0; i < current.units.size(); ++i) {
+        const ReplicatedUnit& unit = current.units[i];
+        while (base_index < base_units.size() && base_units[base_index].id < unit.id) {
+            ++removed_count;
+            ++base_index;
+        }
+        uint8_t mask;
+        if (base_index < base_units.size() && base_units[base_index].id == unit.id) {
+            mask = get_change_mask(base_units[base_index], unit);
+            ++base_index;
+        }
+        else {
+            mask = get_change_mask(ReplicatedUnit(), unit) | REPLICATE_IDENTITY;
+        }
+        change_masks[i] = mask;
+        if (mask) ++changed_count;
+    }
+    removed_count += (int)(base_units.size() - base_index);
+
+    // 3. 写数据包
+    current.sequence = client.next_sequence++;
+    PacketWriter writer = { r_packet };
+    writer.write_byte(REPLICATION_VERSION);
+    writer.write_varint(current.sequence);
+    writer.write_varint(baseline ? baseline->sequence : 0);
+    writer.write_varint(p_tick);
+
+    writer.write_varint(removed_count);
+    int32_t previous_id = -1;
+    size_t current_index = 0;
+    for (const ReplicatedUnit& base : base_units) {
+        while (current_index < current.units.size() && current.units[current_index].id < base.id) ++current_index;
+        if (current_index < current.units.size() && current.units[current_index].id == base.id) continue;
+        writer.write_varint((uint64_t)((int64_t)base.id - previous_id));
+        previous_id = base.id;
+    }
+
+    writer.write_varint(changed_count);
+    previous_id = -1;
+    base_index = 0;
+    for (size_t i = 0; i < current.units.size(); ++i) {
+        const ReplicatedUnit& unit = current.units[i];
+        while (base_index < base_units.size() && base_units[base_index].id < unit.id) ++base_index;
+        bool has_base = base_index < base_units.size() && base_units[base_index].id == unit.id;
+        uint8_t mask = change_masks[i];
+        if (!mask) continue;
+
+        writer.write_varint((uint64_t)((int64_t)unit.id - previous_id));
+        previous_id = unit.id;
+        writer.write_byte(mask);
+        write_fields(writer, has_base ? base_units[base_index] : ReplicatedUnit(), unit, mask);
+    }
+
+    // 4. 存进历史，被换出来的旧数组下一次编码时复用
+    uint32_t sequence = current.sequence;
+    std::swap(client.history[sequence % REPLICATION_HISTORY], current);
+    return sequence;
+}
+
+// --- 客户端 ---
+
+const ReplicationSnapshot* ReplicationClient::get_latest_snapshot() const {
+    if (latest == 0) return nullptr;
+    return &history[latest % REPLICATION_HISTORY];
+}
+
+bool ReplicationClient::decode(const uint8_t* p_data, size_t p_size, std::string& r_error) {
+    r_error.clear();
+    PacketReader reader = { p_data, p_size };
+
+    uint8_t version;
+    uint64_t sequence, baseline_sequence, tick;
+    if (!reader.read_byte(version) || !reader.read_varint(sequence) || !reader.read_varint(baseline_sequence) || !reader.read_varint(tick)) {
+        r_error = "truncated header";
+        return false;
+    }
+    if (version != REPLICATION_VERSION) {
+        r_error = "unsupported version " + std::to_string(version);
+        return false;
+    }
+    if (sequence == 0 || sequence > UINT32_MAX || baseline_sequence >= sequence) {
+        r_error = "invalid sequence";
+        return false;
+    }
+    // 乱序或重复到达的旧包
+    if (sequence <= latest) return false;
+
+    static const std::vector<ReplicatedUnit> empty;
+    const std::vector<ReplicatedUnit>* base_units = &empty;
+    if (baseline_sequence != 0) {
+        const ReplicationSnapshot& baseline = history[baseline_sequence % REPLICATION_HISTORY];
+        if (baseline.sequence != baseline_sequence) {
+            r_error = "baseline " + std::to_string(baseline_sequence) + " is not in history";
+            return false;
+        }
+        base_units = &baseline.units;
+    }
+
+    // 1. 移除的 ID
+    uint64_t removed_count;
+    if (!reader.read_varint(removed_count) || removed_count > base_units->size()) {
+        r_error = "invalid removed count";
+        return false;
+    }
+    removed_ids.clear();
+    int64_t id = -1;
+    for (uint64_t i = 0; i < removed_count; ++i) {
+        uint64_t delta;
+        if (!reader.read_varint(delta) || delta == 0 || id + (int64_t)delta > INT32_MAX) {
+            r_error = "invalid removed id";
+            return false;
+        }
+        id += (int64_t)delta;
+        removed_ids.push_back((int32_t)id);
+    }
+
+    // 2. 按 ID 顺序合并基准、移除列表和变化的单位
+    uint64_t changed_count;
+    if (!reader.read_varint(changed_count) || changed_count > p_size) {
+        r_error = "invalid changed count";
+        return false;
+    }
+    decoded.units.clear();
+    size_t base_index = 0;
+    size_t removed_index = 0;
+    // 基准中 ID 小于 p_id 的单位（去掉移除的）原样保留
+    auto copy_base_until = [&](int64_t p_id) {
+        while (base_index < base_units->size() && (*base_units)[base_index].id < p_id) {
+            const ReplicatedUnit& base = (*base_units)[base_index++];
+            while (removed_index < removed_ids.size() && removed_ids[removed_index] < base.id) ++removed_index;
+            if (removed_index < removed_ids.size() && removed_ids[removed_index] == base.id) continue;
+            decoded.units.push_back(base);
+        }
+    };
+
+    id = -1;
+    for (uint64_t i = 0; i < changed_count; ++i) {
+        uint64_t delta;
+        uint8_t mask;
+        if (!reader.read_varint(delta) || delta == 0 || id + (int64_t)delta > INT32_MAX || !reader.read_byte(mask)) {
+            r_error = "invalid unit entry";
+            return false;
+        }
+        id += (int64_t)delta;
+        copy_base_until(id);
+
+        ReplicatedUnit unit;
+        if (base_index < base_units->size() && (*base_units)[base_index].id == id) {
+            unit = (*base_units)[base_index++];
+        }
+        unit.id = (int32_t)id;
+        if (!read_fields(reader, mask, unit)) {
+            r_error = "invalid unit fields";
+            return false;
+        }
+        decoded.units.push_back(unit);
+    }
+    copy_base_until(INT64_MAX);
+
+    if (reader.cursor != p_size) {
+        r_error = "trailing bytes";
+        return false;
+    }
+
+    // 3. 存进历史
+    decoded.sequence = (uint32_t)sequence;
+    std::swap(history[sequence % REPLICATION_HISTORY], decoded);
+    latest = (uint32_t)sequence;
+    latest_tick = (uint32_t)tick;
+    return true;
+}
+
+void ReplicationClient::apply(UnitSystem& r_units) {
+    const ReplicationSnapshot* snapshot = get_latest_snapshot();
+    if (!snapshot || !r_units.get_flow_field_system()) return;
+    Vec2i cell_size = r_units.get_flow_field_system()->get_cell_size();
+
+    size_t count = snapshot->units.size();
+    restore_units.resize(count);
+    restore_health.resize(count);
+    restore_shield.resize(count);
+
+    int next_unit_id = r_units.get_next_unit_id();
+    for (size_t i = 0; i < count; ++i) {
+        UnitData& unit = restore_units[i];
+        unit = UnitData();
+        dequantize_unit(quantizer, cell_size, snapshot->units[i], unit, restore_health[i], restore_shield[i]);
+
+        // 渲染从本地的上一个状态插值到新状态，刚出现的单位没有上一个状态
+        int index = r_units.get_unit_index(unit.id);
+        if (index >= 0) {
+            unit.previous_position = r_units.units[index].position;
+            unit.previous_heading = r_units.units[index].heading;
+        }
+        else {
+            unit.previous_position = unit.position;
+            unit.previous_heading = unit.heading;
+        }
+        next_unit_id = std::max(next_unit_id, unit.id + 1);
+    }
+
+    r_units.restore_units(restore_units.data(), restore_health.data(), restore_shield.data(), (int)count, next_unit_id);
+}
+
+void ReplicationClient::reset() {
+    for (ReplicationSnapshot& snapshot : history) {
+        snapshot.sequence = 0;
+        snapshot.units.clear();
+    }
+    latest = 0;
+    latest_tick = 0;
+}
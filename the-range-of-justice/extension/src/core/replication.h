@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sim_math.h"
+#include "unit_system.h"
+
+// 向观战端 / 局域网客户端同步单位状态
+//
+// 服务端每 tick 为每个客户端编码一个数据包：
+//   - 只包含客户端关注区域内的单位（通过空间网格查询）
+//   - 位置、速度按流场格子的尺寸量化成整数
+//   - 以客户端最近确认收到的快照为基准做差分，没有变化的单位不写，变化的单位带一个字段掩码，
+//     只写变化的字段（与基准的差值，变长整数）；离开关注区域或死亡的单位只写 ID
+//   - 基准不可用（还没确认过，或者确认的快照已经太旧）时发送完整状态
+// 客户端解码后得到与服务端完全相同的量化状态，再整体写入本地的 UnitSystem
+//
+// 数据包布局（变长整数为 LEB128，有符号数先做 zigzag）：
+//   uint8 version
+//   varint sequence, varint baseline (0 表示完整状态), varint tick
+//   varint removed_count, removed_count 个 ID（升序，差分）
+//   varint changed_count, changed_count 条 { varint ID 差分, uint8 字段掩码, 掩码中的字段 }
+//
+// 编解码与传输无关：数据包可以走 UDP，也可以在同一个进程里直接交给客户端
+
+namespace sim {
+
+    const uint8_t REPLICATION_VERSION = 1;
+
+    // 一个快照最多能被引用多久（按序号计），客户端确认得更晚时退回完整状态
+    const uint32_t REPLICATION_HISTORY = 32;
+
+    // 字段掩码
+    enum ReplicationField : uint8_t {
+        REPLICATE_POSITION = 1 << 0,
+        REPLICATE_VELOCITY = 1 << 1,
+        REPLICATE_HEADING = 1 << 2,
+        REPLICATE_STATE = 1 << 3,
+        REPLICATE_HEALTH = 1 << 4,
+        REPLICATE_SHIELD = 1 << 5,
+        REPLICATE_IDENTITY = 1 << 6,    // 类型和阵营，只在单位第一次出现时发送
+        REPLICATE_ALL = 0x7F,
+    };
+
+    // 量化步长：位置以格子的 1 / position_steps 为单位，速度以每秒格子的 1 / velocity_steps 为单位，
+    // 生命和护盾以 1 / health_steps 为单位。格子尺寸取自 UnitSystem 所用的流场网格，两端必须相同
+    struct ReplicationQuantizer {
+        int position_steps = 64;
+        int velocity_steps = 16;
+        int health_steps = 8;
+    };
+
+    // 量化后的单位状态，快照中按 ID 升序排列
+    struct ReplicatedUnit {
+        int32_t id = -1;
+        int32_t x = 0, y = 0;
+        int32_t velocity_x = 0, velocity_y = 0;
+        int32_t health = 0, shield = 0;
+        int32_t type = 0;
+        uint8_t heading = 0;        // 一圈 256 档
+        uint8_t state = 0;
+        uint8_t team = 0;
+    };
+
+    struct ReplicationSnapshot {
+        uint32_t sequence = 0;      // 0 表示空位
+        std::vector<ReplicatedUnit> units;
+    };
+
+    // 服务端：每个客户端一份已发送快照的历史
+    class ReplicationServer {
+    private:
+        struct Client {
+            bool is_active = false;
+            bool has_interest = false;
+            Rect2 interest;                 // 关注区域（世界坐标），没有设置时发送所有单位
+            uint32_t next_sequence = 1;
+            uint32_t acknowledged = 0;      // 客户端确认收到的最新序号
+            ReplicationSnapshot history[REPLICATION_HISTORY];
+        };
+
+        std::vector<Client> clients;        // 下标即客户端 ID
+        ReplicationQuantizer quantizer;
+
+        // 编码用的缓冲区，跨 tick 复用
+        std::vector<int> interest_indices;
+        std::vector<uint8_t> change_masks;  // 与 current.units 对应
+        ReplicationSnapshot current;
+
+        // 基准快照：确认过且还在历史中，否则返回 nullptr（发送完整状态）
+        const ReplicationSnapshot* get_baseline(const Client& p_client) const;
+
+    public:
+        int add_client();
+        void remove_client(int p_client);
+        bool is_client_valid(int p_client) const;
+
+        void set_client_interest(int p_client, const Rect2& p_interest);
+        void clear_client_interest(int p_client);
+
+        // 客户端收到并解码了序号为 p_sequence 的数据包；乱序到达的旧确认忽略
+        void acknowledge(int p_client, uint32_t p_sequence);
+
+        void set_quantizer(const ReplicationQuantizer& p_quantizer) { quantizer = p_quantizer; }
+        const ReplicationQuantizer& get_quantizer() const { return quantizer; }
+
+        // 为 p_client 编码当前状态，数据包写入 r_packet（覆盖原内容），返回数据包的序号，客户端无效时返回 0
+        uint32_t encode(int p_client, UnitSystem& p_units, uint32_t p_tick, std::vector<uint8_t>& r_packet);
+    };
+
+    // 客户端：解码数据包，把最新的快照写入本地的 UnitSystem
+    class ReplicationClient {
+    private:
+        ReplicationQuantizer quantizer;
+        ReplicationSnapshot history[REPLICATION_HISTORY];
+        uint32_t latest = 0;                // 已解码的最新序号
+        uint32_t latest_tick = 0;
+
+        // 解码用的缓冲区：解码成功后与历史中的空位交换
+        ReplicationSnapshot decoded;
+        std::vector<int32_t> removed_ids;
+
+        // 写入 UnitSystem 时复用的数组
+        std::vector<UnitData> restore_units;
+        std::vector<float> restore_health;
+        std::vector<float> restore_shield;
+
+    public:
+        void set_quantizer(const ReplicationQuantizer& p_quantizer) { quantizer = p_quantizer; }
+        const ReplicationQuantizer& get_quantizer() const { return quantizer; }
+
+        // 解码一个数据包；比已解码的最新快照旧的包直接丢弃（返回 false，r_error 为空）
+        // 格式错误或者基准快照不在历史中时返回 false 并给出原因，已有的状态不变
+        bool decode(const uint8_t* p_data, size_t p_size, std::string& r_error);
+
+        // 应当回复给服务端的确认序号，0 表示还没有收到过
+        uint32_t get_acknowledgement() const { return latest; }
+        uint32_t get_latest_tick() const { return latest_tick; }
+        const ReplicationSnapshot* get_latest_snapshot() const;
+
+        // 用最新的快照整体替换 p_units 中的单位；原来就有的单位保留当前位置和朝向作为插值的起点
+        void apply(UnitSystem& r_units);
+
+        void reset();
+    };
+
+    // 量化 / 反量化，服务端和客户端共用，保证两边对同一个整数得到同样的浮点数
+    ReplicatedUnit quantize_unit(const ReplicationQuantizer& p_quantizer, Vec2i p_cell_size, const UnitData& p_unit, float p_health, float p_shield);
+    void dequantize_unit(const ReplicationQuantizer& p_quantizer, Vec2i p_cell_size, const ReplicatedUnit& p_unit, UnitData& r_unit, float& r_health, float& r_shield);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// 模拟核心使用的最小数学类型
+// 与 Godot 的 Vector2 / Vector2i / Rect2 语义保持一致（float 精度），但不依赖引擎
+
+namespace sim {
+
+    struct Vec2i {
+        int32_t x = 0;
+        int32_t y = 0;
+
+        Vec2i() {}
+        Vec2i(int32_t p_x, int32_t p_y) : x(p_x), y(p_y) {}
+
+        Vec2i operator+(const Vec2i& p_v) const { return Vec2i(x + p_v.x, y + p_v.y); }
+        Vec2i operator-(const Vec2i& p_v) const { return Vec2i(x - p_v.x, y - p_v.y); }
+        Vec2i operator*(int32_t p_s) const { return Vec2i(x * p_s, y * p_s); }
+        Vec2i operator/(int32_t p_s) const { return Vec2i(x / p_s, y / p_s); }
+        Vec2i& operator+=(const Vec2i& p_v) { x += p_v.x; y += p_v.y; return *this; }
+        Vec2i& operator-=(const Vec2i& p_v) { x -= p_v.x; y -= p_v.y; return *this; }
+        bool operator==(const Vec2i& p_v) const { return x == p_v.x && y == p_v.y; }
+        bool operator!=(const Vec2i& p_v) const { return x != p_v.x || y != p_v.y; }
+    };
+
+    struct Vec2 {
+        float x = 0.0f;
+        float y = 0.0f;
+
+        Vec2() {}
+        Vec2(float p_x, float p_y) : x(p_x), y(p_y) {}
+
+        Vec2 operator+(const Vec2& p_v) const { return Vec2(x + p_v.x, y + p_v.y); }
+        Vec2 operator-(const Vec2& p_v) const { return Vec2(x - p_v.x, y - p_v.y); }
+        Vec2 operator-() const { return Vec2(-x, -y); }
+        Vec2 operator*(float p_s) const { return Vec2(x * p_s, y * p_s); }
+        Vec2 operator/(float p_s) const { return Vec2(x / p_s, y / p_s); }
+        Vec2& operator+=(const Vec2& p_v) { x += p_v.x; y += p_v.y; return *this; }
+        Vec2& operator-=(const Vec2& p_v) { x -= p_v.x; y -= p_v.y; return *this; }
+        Vec2& operator*=(float p_s) { x *= p_s; y *= p_s; return *this; }
+        Vec2& operator/=(float p_s) { x /= p_s; y /= p_s; return *this; }
+        bool operator==(const Vec2& p_v) const { return x == p_v.x && y == p_v.y; }
+        bool operator!=(const Vec2& p_v) const { return x != p_v.x || y != p_v.y; }
+
+        float length_squared() const { return x * x + y * y; }
+        float length() const { return std::sqrt(x * x + y * y); }
+        float dot(const Vec2& p_v) const { return x * p_v.x + y * p_v.y; }
+        float cross(const Vec2& p_v) const { return x * p_v.y - y * p_v.x; }
+        float angle() const { return std::atan2(y, x); }
+        float distance_squared_to(const Vec2& p_v) const { return (p_v - *this).length_squared(); }
+        float distance_to(const Vec2& p_v) const { return (p_v - *this).length(); }
+
+        Vec2 normalized() const {
+            float l = x * x + y * y;
+            if (l != 0.0f) {
+                l = std::sqrt(l);
+                return Vec2(x / l, y / l);
+            }
+            return *this;
+        }
+
+        Vec2 limit_length(float p_len) const {
+            float l = length();
+            if (l > 0.0f && p_len < l) {
+                return Vec2(x / l * p_len, y / l * p_len);
+            }
+            return *this;
+        }
+
+        Vec2 min(const Vec2& p_v) const { return Vec2(x < p_v.x ? x : p_v.x, y < p_v.y ? y : p_v.y); }
+        Vec2 max(const Vec2& p_v) const { return Vec2(x > p_v.x ? x : p_v.x, y > p_v.y ? y : p_v.y); }
+        Vec2 abs() const { return Vec2(std::fabs(x), std::fabs(y)); }
+    };
+
+    inline Vec2 operator*(float p_s, const Vec2& p_v) { return p_v * p_s; }
+
+    struct Rect2 {
+        Vec2 position;
+        Vec2 size;
+
+        Rect2() {}
+        Rect2(const Vec2& p_position, const Vec2& p_size) : position(p_position), size(p_size) {}
+
+        Vec2 get_end() const { return position + size; }
+
+        bool has_point(const Vec2& p_point) const {
+            return p_point.x >= position.x && p_point.y >= position.y &&
+                p_point.x < position.x + size.x && p_point.y < position.y + size.y;
+        }
+    };
+
+    struct Rect2i {
+        Vec2i position;
+        Vec2i size;
+
+        Rect2i() {}
+        Rect2i(const Vec2i& p_position, const Vec2i& p_size) : position(p_position), size(p_size) {}
+        Rect2i(int32_t p_x, int32_t p_y, int32_t p_w, int32_t p_h) : position(p_x, p_y), size(p_w, p_h) {}
+
+        Vec2i get_end() const { return position + size; }
+        bool has_area() const { return size.x > 0 && size.y > 0; }
+
+        bool has_point(const Vec2i& p_point) const {
+            return p_point.x >= position.x && p_point.y >= position.y &&
+                p_point.x < position.x + size.x && p_point.y < position.y + size.y;
+        }
+
+        bool intersects(const Rect2i& p_rect) const {
+            return position.x < p_rect.position.x + p_rect.size.x && p_rect.position.x < position.x + size.x &&
+                position.y < p_rect.position.y + p_rect.size.y && p_rect.position.y < position.y + size.y;
+        }
+
+        // p_rect 整个在这个矩形内（p_rect 面积为 0 时也成立）
+        bool encloses(const Rect2i& p_rect) const {
+            return p_rect.position.x >= position.x && p_rect.position.y >= position.y &&
+                p_rect.position.x + p_rect.size.x <= position.x + size.x &&
+                p_rect.position.y + p_rect.size.y <= position.y + size.y;
+        }
+
+        // 包含两个矩形的最小矩形
+        Rect2i merge(const Rect2i& p_rect) const {
+            Vec2i begin(std::min(position.x, p_rect.position.x), std::min(position.y, p_rect.position.y));
+            Vec2i end(std::max(position.x + size.x, p_rect.position.x + p_rect.size.x),
+                std::max(position.y + size.y, p_rect.position.y + p_rect.size.y));
+            return Rect2i(begin, end - begin);
+        }
+
+        // 两个矩形的交集，不相交时面积为 0
+        Rect2i intersection(const Rect2i& p_rect) const {
+            Vec2i begin(std::max(position.x, p_rect.position.x), std::max(position.y, p_rect.position.y));
+            Vec2i end(std::min(position.x + size.x, p_rect.position.x + p_rect.size.x),
+                std::min(position.y + size.y, p_rect.position.y + p_rect.size.y));
+            if (end.x <= begin.x || end.y <= begin.y) return Rect2i(begin, Vec2i(0, 0));
+            return Rect2i(begin, end - begin);
+        }
+    };
+
+    // 为 Vec2i 提供哈希支持，以便将其用作 unordered_map 的 Key
+    struct Vec2iHasher {
+        size_t operator()(const Vec2i& v) const {
+            // 将两个 32 位整数组合成一个 64 位哈希值
+            return ((uint64_t)v.x << 32) | (uint32_t)v.y;
+        }
+    };
+}
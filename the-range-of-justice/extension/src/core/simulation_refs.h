@@ -0,0 +1,17 @@
+#pragma once
+
+namespace sim {
+
+    class FlowFieldSystem;
+    class UnitTypeTable;
+    class UnitSystem;
+    class BuildingSystem;
+
+    // 一局模拟所涉及的各个系统（由调用方持有），供回放、存档等整体操作使用
+    struct SimulationRefs {
+        FlowFieldSystem* flow_fields = nullptr;
+        UnitTypeTable* unit_types = nullptr;
+        UnitSystem* units = nullptr;
+        BuildingSystem* buildings = nullptr;   // 可以为空
+    };
+}
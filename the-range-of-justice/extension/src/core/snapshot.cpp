@@ -0,0 +1,349 @@
+#include "snapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include "flow_field.h"
+#include "unit_types.h"
+#include "unit_system.h"
+#include "building_system.h"
+
+using namespace sim;
+
+static_assert(std::is_trivially_copyable<UnitData>::value, "UnitData is written to snapshots as raw bytes");
+static_assert(std::is_trivially_copyable<BuildingData>::value, "BuildingData is written to snapshots as raw bytes");
+static_assert(std::is_trivially_copyable<UnitTypeRecord>::value, "UnitTypeRecord is written to snapshots as raw bytes");
+
+static const uint64_t SNAPSHOT_ALIGNMENT = 16;
+
+static uint64_t align_up(uint64_t p_value) {
+    return (p_value + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1);
+}
+
+namespace {
+
+    // 写入时先登记所有块，再一次性分配并拷贝
+    struct BlockSource {
+        uint32_t type;
+        uint32_t element_size;
+        uint64_t count;
+        const void* data;
+    };
+
+    // 读取时按目录定位出的块（指向读入的缓冲区，不做拷贝）
+    struct BlockView {
+        const uint8_t* data = nullptr;
+        uint64_t count = 0;
+    };
+}
+
+bool sim::write_snapshot(const SimulationRefs& p_refs, bool p_include_flow_fields, std::vector<uint8_t>& r_buffer) {
+    const FlowFieldSystem* flow_fields = p_refs.flow_fields;
+    const UnitSystem* units = p_refs.units;
+    const UnitTypeTable* unit_types = p_refs.unit_types;
+    const BuildingSystem* buildings = p_refs.buildings;
+    if (!flow_fields || !units || !unit_types) return false;
+
+    // 尚未合成的图层修改先让流场处理掉，读档后的流场状态才与图层一致
+    p_refs.flow_fields->flush_cost_layers();
+
+    SnapshotGrid grid = {};
+    grid.width = flow_fields->get_width();
+    grid.height = flow_fields->get_height();
+    grid.cell_size_x = flow_fields->get_cell_size().x;
+    grid.cell_size_y = flow_fields->get_cell_size().y;
+    grid.origin_x = flow_fields->get_grid_origin().x;
+    grid.origin_y = flow_fields->get_grid_origin().y;
+    grid.next_unit_id = units->get_next_unit_id();
+    grid.next_building_id = buildings ? buildings->get_next_building_id() : 0;
+    grid.clock = flow_fields->get_clock();
+    grid.cleanup_timer = flow_fields->get_cleanup_timer();
+
+    std::vector<uint8_t> type_defaults(unit_types->get_type_count());
+    for (int i = 0; i < unit_types->get_type_count(); ++i) {
+        type_defaults[i] = unit_types->is_using_defaults(i) ? 1 : 0;
+    }
+
+    std::vector<BuildingData> building_list;
+    if (buildings) {
+        building_list.reserve(buildings->get_building_count());
+        for (const auto& it : buildings->get_buildings()) {
+            building_list.push_back(it.second);
+        }
+    }
+
+    std::vector<BlockSource> sources;
+    sources.push_back({ SNAPSHOT_GRID, sizeof(SnapshotGrid), 1, &grid });
+    sources.push_back({ SNAPSHOT_COST_MAP, 1, flow_fields->get_terrain_costs().size(), flow_fields->get_terrain_costs().data() });
+    sources.push_back({ SNAPSHOT_BUILDING_OCCUPANCY, 1, flow_fields->get_building_occupancy().size(), flow_fields->get_building_occupancy().data() });
+    sources.push_back({ SNAPSHOT_COST_MODIFIERS, 1, flow_fields->get_cost_modifiers().size(), flow_fields->get_cost_modifiers().data() });
+    sources.push_back({ SNAPSHOT_UNIT_TYPES, sizeof(UnitTypeRecord), (uint64_t)unit_types->get_type_count(),
+        unit_types->get_type_count() ? &unit_types->get(0) : nullptr });
+    sources.push_back({ SNAPSHOT_UNIT_TYPE_DEFAULTS, 1, type_defaults.size(), type_defaults.data() });
+    sources.push_back({ SNAPSHOT_UNITS, sizeof(UnitData), units->units.size(), units->units.data() });
+    sources.push_back({ SNAPSHOT_UNIT_HEALTH, sizeof(float), units->unit_health.size(), units->unit_health.data() });
+    sources.push_back({ SNAPSHOT_UNIT_SHIELD, sizeof(float), units->unit_shield.size(), units->unit_shield.data() });
+    sources.push_back({ SNAPSHOT_BUILDINGS, sizeof(BuildingData), building_list.size(), building_list.data() });
+
+    // 流场：描述数组 + 两个按流场顺序首尾相接的大数组（数据块单独拷贝，见下）
+    std::vector<SnapshotField> fields;
+    std::vector<const FlowField*> field_sources;
+    std::vector<Vec2i> queue;
+    uint64_t cells = (uint64_t)grid.width * grid.height;
+    if (p_include_flow_fields) {
+        for (const auto& it : flow_fields->get_flow_fields()) {
+            const FlowField& field = it.second;
+            SnapshotField entry = {};
+            entry.target_x = it.first.x;
+            entry.target_y = it.first.y;
+            // 有界计算没展开完的堆不保存，读档后按脏流场重算
+            entry.is_dirty = (field.is_dirty || (field.is_partial() && !field.is_computing)) ? 1 : 0;
+            entry.is_computing = field.is_computing ? 1 : 0;
+            entry.last_used_time = field.last_used_time;
+            fields.push_back(entry);
+            field_sources.push_back(&field);
+        }
+        flow_fields->get_queued_targets(queue);
+
+        sources.push_back({ SNAPSHOT_FIELDS, sizeof(SnapshotField), fields.size(), fields.data() });
+        sources.push_back({ SNAPSHOT_FIELD_INTEGRATION, sizeof(float), fields.size() * cells, nullptr });
+        sources.push_back({ SNAPSHOT_FIELD_DIRECTIONS, sizeof(Vec2), fields.size() * cells, nullptr });
+        sources.push_back({ SNAPSHOT_FIELD_QUEUE, sizeof(Vec2i), queue.size(), queue.data() });
+    }
+
+    // --- 计算布局 ---
+    uint64_t offset = align_up(sizeof(SnapshotHeader) + sources.size() * sizeof(SnapshotBlock));
+    std::vector<SnapshotBlock> directory(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        directory[i].type = sources[i].type;
+        directory[i].element_size = sources[i].element_size;
+        directory[i].offset = offset;
+        directory[i].count = sources[i].count;
+        offset = align_up(offset + sources[i].count * sources[i].element_size);
+    }
+
+    r_buffer.assign(offset, 0);
+    uint8_t* base = r_buffer.data();
+
+    SnapshotHeader header = {};
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.block_count = (uint32_t)directory.size();
+    header.file_size = offset;
+    std::memcpy(base, &header, sizeof(header));
+    std::memcpy(base + sizeof(header), directory.data(), directory.size() * sizeof(SnapshotBlock));
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        uint8_t* dst = base + directory[i].offset;
+        uint64_t bytes = sources[i].count * sources[i].element_size;
+
+        if (sources[i].type == SNAPSHOT_FIELD_INTEGRATION) {
+            for (const FlowField* field : field_sources) {
+                // 烘焙流场只在映射的文件中，按普通流场的格式展开写入
+                const float* integration = field->is_baked() ? field->baked_integration : field->integration_field.data();
+                std::memcpy(dst, integration, cells * sizeof(float));
+                dst += cells * sizeof(float);
+            }
+        }
+        else if (sources[i].type == SNAPSHOT_FIELD_DIRECTIONS) {
+            for (const FlowField* field : field_sources) {
+                if (field->is_baked()) {
+                    for (uint64_t index = 0; index < cells; ++index) {
+                        Vec2 direction = field->direction_at((int)index);
+                        std::memcpy(dst, &direction, sizeof(Vec2));
+                        dst += sizeof(Vec2);
+                    }
+                }
+                else {
+                    std::memcpy(dst, field->flow_directions.data(), cells * sizeof(Vec2));
+                    dst += cells * sizeof(Vec2);
+                }
+            }
+        }
+        else if (bytes > 0) {
+            std::memcpy(dst, sources[i].data, bytes);
+        }
+    }
+
+    return true;
+}
+
+bool sim::read_snapshot(const uint8_t* p_data, size_t p_size, SimulationRefs& p_refs, std::string& r_error) {
+    FlowFieldSystem* flow_fields = p_refs.flow_fields;
+    UnitSystem* units = p_refs.units;
+    UnitTypeTable* unit_types = p_refs.unit_types;
+    BuildingSystem* buildings = p_refs.buildings;
+    if (!flow_fields || !units || !unit_types) {
+        r_error = "missing target systems";
+        return false;
+    }
+
+    // --- 校验文件头和目录 ---
+    SnapshotHeader header;
+    if (p_size < sizeof(header)) {
+        r_error = "file too short";
+        return false;
+    }
+    std::memcpy(&header, p_data, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION) {
+        r_error = "not a snapshot or unsupported version";
+        return false;
+    }
+    if (header.file_size != p_size || sizeof(header) + (uint64_t)header.block_count * sizeof(SnapshotBlock) > p_size) {
+        r_error = "truncated snapshot";
+        return false;
+    }
+
+    // 按类型找到各块的位置（指针修正），数据仍在读入的缓冲区中
+    const uint32_t max_type = SNAPSHOT_COST_MODIFIERS;
+    BlockView views[max_type + 1];
+    static const uint32_t element_sizes[max_type + 1] = {
+        0,
+        sizeof(SnapshotGrid), 1, sizeof(UnitTypeRecord), 1,
+        sizeof(UnitData), sizeof(float), sizeof(float), sizeof(BuildingData),
+        sizeof(SnapshotField), sizeof(float), sizeof(Vec2), sizeof(Vec2i),
+        1, 1,
+    };
+
+    const uint8_t* directory = p_data + sizeof(header);
+    for (uint32_t i = 0; i < header.block_count; ++i) {
+        SnapshotBlock block;
+        std::memcpy(&block, directory + i * sizeof(SnapshotBlock), sizeof(block));
+
+        // 不认识的块来自更新的版本，跳过
+        if (block.type == 0 || block.type > max_type) continue;
+
+        if (block.element_size != element_sizes[block.type]) {
+            r_error = "snapshot was written with a different data layout";
+            return false;
+        }
+        if (block.offset > p_size || block.count > (p_size - block.offset) / block.element_size) {
+            r_error = "block out of range";
+            return false;
+        }
+        views[block.type].data = p_data + block.offset;
+        views[block.type].count = block.count;
+    }
+
+    if (views[SNAPSHOT_GRID].count != 1) {
+        r_error = "missing grid block";
+        return false;
+    }
+    SnapshotGrid grid;
+    std::memcpy(&grid, views[SNAPSHOT_GRID].data, sizeof(grid));
+
+    uint64_t cells = (uint64_t)grid.width * grid.height;
+    uint64_t unit_count = views[SNAPSHOT_UNITS].count;
+    uint64_t field_count = views[SNAPSHOT_FIELDS].count;
+    if (grid.width <= 0 || grid.height <= 0 ||
+        views[SNAPSHOT_COST_MAP].count != cells ||
+        views[SNAPSHOT_BUILDING_OCCUPANCY].count != cells ||
+        views[SNAPSHOT_COST_MODIFIERS].count != cells ||
+        views[SNAPSHOT_UNIT_TYPE_DEFAULTS].count != views[SNAPSHOT_UNIT_TYPES].count ||
+        views[SNAPSHOT_UNIT_HEALTH].count != unit_count ||
+        views[SNAPSHOT_UNIT_SHIELD].count != unit_count ||
+        views[SNAPSHOT_FIELD_INTEGRATION].count != field_count * cells ||
+        views[SNAPSHOT_FIELD_DIRECTIONS].count != field_count * cells) {
+        r_error = "inconsistent block sizes";
+        return false;
+    }
+
+    // 类型表按类型 ID 直接下标，超范围的 ID 会让 ensure_type 分配巨大的表
+    if (views[SNAPSHOT_UNIT_TYPES].count > (uint64_t)MAX_UNIT_TYPE + 1) {
+        r_error = "too many unit types";
+        return false;
+    }
+    const UnitData* snapshot_units = (const UnitData*)views[SNAPSHOT_UNITS].data;
+    for (uint64_t i = 0; i < unit_count; ++i) {
+        if (!is_valid_unit_type(snapshot_units[i].type)) {
+            r_error = "unit type out of range";
+            return false;
+        }
+        // 组表按组 ID 直接下标，运行时保证 ID 小于单位数
+        if (snapshot_units[i].group_id < -1 || snapshot_units[i].group_id >= (int64_t)unit_count) {
+            r_error = "group id out of range";
+            return false;
+        }
+    }
+
+    // --- 校验通过，开始整块恢复 ---
+    Vec2i cell_size(grid.cell_size_x, grid.cell_size_y);
+    Vec2i origin(grid.origin_x, grid.origin_y);
+
+    units->set_flow_field_system(flow_fields);
+    units->set_unit_types(unit_types);
+    if (buildings) {
+        buildings->set_flow_field_system(flow_fields);
+        buildings->set_unit_system(units);
+    }
+    units->setup(grid.width, grid.height, cell_size, origin);
+
+    flow_fields->clear_all_fields();
+    flow_fields->restore_cost_layers(views[SNAPSHOT_COST_MAP].data, views[SNAPSHOT_BUILDING_OCCUPANCY].data,
+        (const int8_t*)views[SNAPSHOT_COST_MODIFIERS].data);
+    flow_fields->restore_clock(grid.clock, grid.cleanup_timer);
+
+    unit_types->restore((const UnitTypeRecord*)views[SNAPSHOT_UNIT_TYPES].data,
+        views[SNAPSHOT_UNIT_TYPE_DEFAULTS].data, (int)views[SNAPSHOT_UNIT_TYPES].count);
+
+    // 块是 16 字节对齐的，可以直接当作数组使用
+    units->restore_units(snapshot_units,
+        (const float*)views[SNAPSHOT_UNIT_HEALTH].data,
+        (const float*)views[SNAPSHOT_UNIT_SHIELD].data,
+        (int)unit_count, grid.next_unit_id);
+
+    if (buildings) {
+        buildings->restore_buildings((const BuildingData*)views[SNAPSHOT_BUILDINGS].data,
+            (int)views[SNAPSHOT_BUILDINGS].count, grid.next_building_id);
+    }
+
+    const SnapshotField* fields = (const SnapshotField*)views[SNAPSHOT_FIELDS].data;
+    const float* integration = (const float*)views[SNAPSHOT_FIELD_INTEGRATION].data;
+    const Vec2* directions = (const Vec2*)views[SNAPSHOT_FIELD_DIRECTIONS].data;
+    for (uint64_t i = 0; i < field_count; ++i) {
+        FlowField& field = flow_fields->restore_flow_field(Vec2i(fields[i].target_x, fields[i].target_y));
+        std::memcpy(field.integration_field.data(), integration + i * cells, cells * sizeof(float));
+        std::memcpy(field.flow_directions.data(), directions + i * cells, cells * sizeof(Vec2));
+        field.is_dirty = fields[i].is_dirty != 0;
+        field.is_computing = fields[i].is_computing != 0;
+        field.last_used_time = fields[i].last_used_time;
+    }
+    flow_fields->restore_queue((const Vec2i*)views[SNAPSHOT_FIELD_QUEUE].data, (int)views[SNAPSHOT_FIELD_QUEUE].count);
+
+    return true;
+}
+
+bool sim::save_snapshot(const std::string& p_path, const SimulationRefs& p_refs, bool p_include_flow_fields) {
+    std::vector<uint8_t> buffer;
+    if (!write_snapshot(p_refs, p_include_flow_fields, buffer)) return false;
+
+    FILE* file = std::fopen(p_path.c_str(), "wb");
+    if (!file) return false;
+
+    bool ok = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool sim::load_snapshot(const std::string& p_path, SimulationRefs& p_refs, std::string& r_error) {
+    FILE* file = std::fopen(p_path.c_str(), "rb");
+    if (!file) {
+        r_error = "cannot open " + p_path;
+        return false;
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    long length = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+
+    std::vector<uint8_t> buffer(length > 0 ? (size_t)length : 0);
+    bool ok = buffer.empty() || std::fread(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    std::fclose(file);
+    if (!ok) {
+        r_error = "read error";
+        return false;
+    }
+
+    return read_snapshot(buffer.data(), buffer.size(), p_refs, r_error);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "simulation_refs.h"
+
+// 整局模拟状态的二进制存档
+//
+// 文件布局（小端，所有块 16 字节对齐）：
+//   SnapshotHeader
+//   SnapshotBlock[block_count]      块目录：类型、元素大小、偏移、元素个数
+//   块数据 ...
+//
+// 每个块都是内存中数组的原样拷贝，读档 = 一次读文件 + 按目录定位各块 + 整块拷回，
+// 不做逐个对象的解析。元素大小记录在目录中，结构体布局变化后旧存档会被拒绝而不是读错。
+
+namespace sim {
+
+    const uint32_t SNAPSHOT_MAGIC = 0x50414E53; // "SNAP"
+    const uint32_t SNAPSHOT_VERSION = 7;     // 2: 代价地图按图层保存；3: UnitData 加入 group_id；4: UnitData 加入 LOD 调度字段；5: UnitData 加入插值用的朝向和上一 tick 位置；6: 去掉 anim_time；7: UnitData 加入阵营
+
+    enum SnapshotBlockType : uint32_t {
+        SNAPSHOT_GRID = 1,              // SnapshotGrid (1 个)
+        SNAPSHOT_COST_MAP,              // uint8_t[width * height]，地形层
+        SNAPSHOT_UNIT_TYPES,            // UnitTypeRecord[]
+        SNAPSHOT_UNIT_TYPE_DEFAULTS,    // uint8_t[]，该行是否使用调试默认值
+        SNAPSHOT_UNITS,                 // UnitData[]
+        SNAPSHOT_UNIT_HEALTH,           // float[]
+        SNAPSHOT_UNIT_SHIELD,           // float[]
+        SNAPSHOT_BUILDINGS,             // BuildingData[]
+        SNAPSHOT_FIELDS,                // SnapshotField[]（可选，以下三块同）
+        SNAPSHOT_FIELD_INTEGRATION,     // float[field_count * width * height]
+        SNAPSHOT_FIELD_DIRECTIONS,      // Vec2[field_count * width * height]
+        SNAPSHOT_FIELD_QUEUE,           // Vec2i[]，计算队列
+        SNAPSHOT_BUILDING_OCCUPANCY,    // uint8_t[width * height]
+        SNAPSHOT_COST_MODIFIERS,        // int8_t[width * height]
+    };
+
+    struct SnapshotHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t block_count;
+        uint32_t reserved;
+        uint64_t file_size;
+    };
+
+    struct SnapshotBlock {
+        uint32_t type;
+        uint32_t element_size;
+        uint64_t offset;        // 相对文件开头
+        uint64_t count;
+    };
+
+    struct SnapshotGrid {
+        int32_t width;
+        int32_t height;
+        int32_t cell_size_x, cell_size_y;
+        int32_t origin_x, origin_y;
+        int32_t next_unit_id;
+        int32_t next_building_id;
+        double clock;
+        double cleanup_timer;
+    };
+
+    struct SnapshotField {
+        int32_t target_x, target_y;
+        uint8_t is_dirty;
+        uint8_t is_computing;
+        uint8_t padding[6];
+        double last_used_time;
+    };
+
+    // 把整局状态序列化到内存中（一整块连续缓冲区）
+    bool write_snapshot(const SimulationRefs& p_refs, bool p_include_flow_fields, std::vector<uint8_t>& r_buffer);
+
+    // 从内存中恢复状态，失败时 r_error 给出原因，目标系统保持不变
+    bool read_snapshot(const uint8_t* p_data, size_t p_size, SimulationRefs& p_refs, std::string& r_error);
+
+    bool save_snapshot(const std::string& p_path, const SimulationRefs& p_refs, bool p_include_flow_fields);
+    bool load_snapshot(const std::string& p_path, SimulationRefs& p_refs, std::string& r_error);
+}
@@ -0,0 +1,1375 @@
+#include "unit_system.h"
+#include "profiler.h"
+
+#include <algorithm>
+
+using namespace sim;
+
+static int clamp_team(int p_team) {
+    return std::max(0, std::min(p_team, InfluenceMap::MAX_TEAMS - 1));
+}
+
+UnitSystem::UnitSystem() {
+    units.reserve(1000);
+}
+
+void UnitSystem::setup(int p_width, int p_height, Vec2i p_cell_size, Vec2i p_origin) {
+    if (!flow_field_system) return;
+
+    flow_field_system->setup_grid(p_width, p_height, p_origin, p_cell_size);
+    influence_map.setup(p_width, p_height, p_cell_size, p_origin);
+
+    unit_grid_width = p_width / 2;
+    unit_grid_height = p_height / 2;
+    unit_grid_size = unit_grid_width * unit_grid_height;
+    unit_grid_cell_size = p_cell_size * 2;
+
+    unit_grid_starts.assign(unit_grid_size + 1, 0);
+    unit_grid_cursors.assign(unit_grid_size, 0);
+    unit_grid_indices.clear();
+    unit_grid_team_masks.assign(unit_grid_size, 0);
+    is_spatial_grid_dirty = true;
+
+    groups.clear();
+    free_group_ids.clear();
+
+    is_setup = true;
+}
+
+int UnitSystem::spawn_unit(Vec2 p_world_pos, int p_type, int p_team) {
+    // 类型表按类型 ID 直接下标，表外的类型不能生成
+    if (!is_valid_unit_type(p_type)) return -1;
+
+    // 1. 创建一个新的单位数据结构
+    UnitData new_unit;
+
+    // 保证类型表中有这一行（数值统一从类型表读取，单位本身不再存）
+    unit_types->ensure_type(p_type);
+
+    // 2. 分配唯一 ID 并自增计数器
+    new_unit.id = next_unit_id++;
+
+    // 3. 初始化物理属性
+    new_unit.position = p_world_pos;
+    new_unit.previous_position = p_world_pos;
+
+    // 4. 初始化状态(待完善，根据单位类型应有不同的初始化)
+    new_unit.velocity = Vec2(0, 0);
+    new_unit.state = IDLE;
+    new_unit.type = p_type;
+    new_unit.team = clamp_team(p_team);
+    new_unit.target_grid = Vec2i(-1, -1); // 初始没有目标
+
+    // 5. 存入 vector
+    units.push_back(new_unit);
+    id_to_index[new_unit.id] = units.size() - 1;
+    is_spatial_grid_dirty = true;
+
+    const UnitTypeRecord& record = get_type_record(new_unit);
+    unit_health.push_back(record.health_max);
+    unit_shield.push_back(record.shield_max);
+
+    // 6. 返回 ID，以便 GDScript 记录并关联对应的 Sprite
+    return new_unit.id;
+}
+
+void UnitSystem::despawn_unit(int p_unit_id) {
+    auto it = id_to_index.find(p_unit_id);
+    if (it == id_to_index.end()) return;
+
+    size_t index_to_remove = it->second;
+    size_t last_unit_idx = units.size() - 1;
+
+    if (index_to_remove != last_unit_idx) {
+        // 1. 获取最后一个单位的数据
+        UnitData& last_unit = units.back();
+
+        // 2. 将最后一个单位移动到要删除的位置
+        units[index_to_remove] = last_unit;
+        unit_health[index_to_remove] = unit_health.back();
+        unit_shield[index_to_remove] = unit_shield.back();
+
+        // 3. 更新被移动单位在哈希表中的索引
+        id_to_index[last_unit.id] = index_to_remove;
+    }
+
+    // 4. 删除 vector 最后一个元素，并从哈希表中移除目标 ID
+    units.pop_back();
+    unit_health.pop_back();
+    unit_shield.pop_back();
+    id_to_index.erase(p_unit_id);
+    is_spatial_grid_dirty = true;
+}
+
+void UnitSystem::restore_unit(const UnitData& p_unit, float p_health, float p_shield) {
+    if (p_unit.id < 0 || id_to_index.count(p_unit.id) || !is_valid_unit_type(p_unit.type)) return;
+
+    unit_types->ensure_type(p_unit.type);
+
+    units.push_back(p_unit);
+    units.back().previous_position = p_unit.position;
+    units.back().previous_heading = p_unit.heading;
+    id_to_index[p_unit.id] = units.size() - 1;
+    unit_health.push_back(p_health);
+    unit_shield.push_back(p_shield);
+
+    if (p_unit.id >= next_unit_id) {
+        next_unit_id = p_unit.id + 1;
+    }
+    is_groups_dirty = true;
+    is_spatial_grid_dirty = true;
+}
+
+void UnitSystem::restore_units(const UnitData* p_units, const float* p_health, const float* p_shield, int p_count, int p_next_unit_id) {
+    units.assign(p_units, p_units + p_count);
+    unit_health.assign(p_health, p_health + p_count);
+    unit_shield.assign(p_shield, p_shield + p_count);
+
+    id_to_index.clear();
+    id_to_index.reserve(p_count);
+    for (int i = 0; i < p_count; ++i) {
+        id_to_index[units[i].id] = i;
+        unit_types->ensure_type(units[i].type);
+    }
+    next_unit_id = p_next_unit_id;
+    is_groups_dirty = true;
+    is_spatial_grid_dirty = true;
+    influence_map.invalidate();
+}
+
+void UnitSystem::command_units_to_move(const int* p_unit_ids, int p_count, Vec2 p_target_world_pos) {
+    if (!flow_field_system) return;
+
+    Vec2i target_grid_pos = flow_field_system->world_to_grid(p_target_world_pos);
+
+    if (!(flow_field_system->is_in_grid(target_grid_pos))) return;
+
+    flow_field_system->create_flow_field(target_grid_pos, false);
+
+    // 一次命令一个组，组员原来所在的组在下一 tick 统计时自然缩小或释放
+    int group_id = create_group(p_target_world_pos, target_grid_pos);
+
+    Rect2 bounds;
+    bool has_bounds = false;
+    for (int i = 0; i < p_count; i++) {
+        // 使用哈希表直接定位
+        auto it = id_to_index.find(p_unit_ids[i]);
+        if (it != id_to_index.end()) {
+            UnitData& unit = units[it->second];
+            if (!has_bounds) {
+                bounds = Rect2(unit.position, Vec2(0, 0));
+                has_bounds = true;
+            }
+            else {
+                Vec2 begin = bounds.position.min(unit.position);
+                Vec2 end = bounds.get_end().max(unit.position);
+                bounds = Rect2(begin, end - begin);
+            }
+            unit.target_pos = p_target_world_pos;
+            unit.target_grid = target_grid_pos;
+            unit.group_id = group_id;
+            unit.state = MOVING;
+            unit.lod_countdown = 0;     // 降频的单位也在下一 tick 响应命令
+        }
+    }
+
+    // 流场计算时只需要覆盖到这些单位
+    if (has_bounds) {
+        request_field_region(target_grid_pos, bounds);
+    }
+}
+
+void UnitSystem::request_field_region(Vec2i p_target_grid, const Rect2& p_bounds) {
+    // 向外多留一格，单位在格子边上时邻居格也已确定
+    Vec2i begin = flow_field_system->world_to_grid(p_bounds.position) - Vec2i(1, 1);
+    Vec2i end = flow_field_system->world_to_grid(p_bounds.get_end()) + Vec2i(2, 2);
+    flow_field_system->request_flow_region(p_target_grid, Rect2i(begin, end - begin));
+}
+
+void UnitSystem::command_selected_units_to_move(Vec2 p_target_world_pos) {
+    FrameArena::Marker marker = frame_arena.get_marker();
+    int* ids = frame_arena.allocate<int>(units.size());
+    int count = 0;
+    for (const UnitData& unit : units) {
+        if (unit.is_selected) ids[count++] = unit.id;
+    }
+    if (count > 0) {
+        command_units_to_move(ids, count, p_target_world_pos);
+    }
+    frame_arena.rewind(marker);
+}
+
+void UnitSystem::apply_damage(int p_target_id, int p_attacker_id, float p_damage, int p_attack_type) {
+    auto it = id_to_index.find(p_target_id);
+    if (it == id_to_index.end()) return;
+
+    // 交战双方保持全速更新一段时间
+    units[it->second].lod_combat_ticks = (uint8_t)LOD_COMBAT_TICKS;
+    auto attacker = id_to_index.find(p_attacker_id);
+    if (attacker != id_to_index.end()) {
+        units[attacker->second].lod_combat_ticks = (uint8_t)LOD_COMBAT_TICKS;
+    }
+
+    int armor_type = get_type_record(units[it->second]).armor_type;
+    damage_system.push_hit(p_target_id, p_attacker_id, p_damage, p_attack_type, armor_type);
+}
+
+void UnitSystem::resolve_damage() {
+    if (!damage_system.has_pending_hits()) return;
+
+    damage_system.resolve(id_to_index, unit_health.data(), unit_shield.data(), (int)units.size());
+
+    const std::vector<int>& dead_indices = damage_system.get_dead_indices();
+    if (dead_indices.empty()) return;
+
+    dead_ids.clear();
+    for (int unit_idx : dead_indices) {
+        dead_ids.push_back(units[unit_idx].id);
+    }
+    std::sort(dead_ids.begin(), dead_ids.end());
+
+    // 一个 tick 只通知一次（此时单位还在，仍可以查询死亡位置），然后统一移除
+    if (on_units_died) {
+        on_units_died(dead_ids);
+    }
+    for (int unit_id : dead_ids) {
+        despawn_unit(unit_id);
+    }
+}
+
+void UnitSystem::update_spatial_grid() {
+    int unit_count = (int)units.size();
+    unit_teams.resize(unit_count);
+    unit_cells.resize(unit_count);
+    team_sorted_units.resize(unit_count);
+    std::fill(unit_grid_starts.begin(), unit_grid_starts.end(), 0);
+    std::fill(unit_grid_team_masks.begin(), unit_grid_team_masks.end(), 0);
+    off_grid_units.clear();
+    // 单位陆续被挤出地图时 push_back 不再扩容
+    off_grid_units.reserve(unit_count);
+
+    // 1. 每个单位所在的格子，顺便统计每格的单位数（先记在下一格的起点上）
+    std::fill(team_unit_counts, team_unit_counts + InfluenceMap::MAX_TEAMS, 0);
+    for (int i = 0; i < unit_count; ++i) {
+        int team = clamp_team(units[i].team);
+        unit_teams[i] = (uint8_t)team;
+        ++team_unit_counts[team];
+
+        Vec2i rel_pos = flow_field_system->world_to_relative(units[i].position);
+
+        // 缩放到单位网格（单位网格尺寸是流场的 2 倍）
+        int ux = rel_pos.x / 2;
+        int uy = rel_pos.y / 2;
+
+        if (ux >= 0 && ux < unit_grid_width && uy >= 0 && uy < unit_grid_height) {
+            int grid_idx = uy * unit_grid_width + ux;
+            unit_cells[i] = grid_idx;
+            ++unit_grid_starts[grid_idx + 1];
+            unit_grid_team_masks[grid_idx] |= (uint8_t)(1 << team);
+        }
+        else {
+            unit_cells[i] = -1;
+        }
+    }
+
+    // 2. 前缀和得到每格的起点
+    for (int grid_idx = 0; grid_idx < unit_grid_size; ++grid_idx) {
+        unit_grid_starts[grid_idx + 1] += unit_grid_starts[grid_idx];
+        unit_grid_cursors[grid_idx] = unit_grid_starts[grid_idx];
+    }
+    unit_grid_indices.resize(unit_grid_size > 0 ? unit_grid_starts[unit_grid_size] : 0);
+
+    // 3. 按阵营排好的顺序依次放入格子，每个格子里自然按阵营分段（只有一个阵营时顺序与下标相同）
+    int team_offsets[InfluenceMap::MAX_TEAMS];
+    int offset = 0;
+    for (int team = 0; team < InfluenceMap::MAX_TEAMS; ++team) {
+        team_offsets[team] = offset;
+        offset += team_unit_counts[team];
+    }
+    for (int i = 0; i < unit_count; ++i) {
+        team_sorted_units[team_offsets[unit_teams[i]]++] = i;
+    }
+
+    for (int i : team_sorted_units) {
+        int grid_idx = unit_cells[i];
+        if (grid_idx >= 0) {
+            unit_grid_indices[unit_grid_cursors[grid_idx]++] = i;
+        }
+        else {
+            off_grid_units.push_back(i);
+        }
+    }
+    is_spatial_grid_dirty = false;
+}
+
+void UnitSystem::update_congestion() {
+    congestion_field.reset(*flow_field_system);
+    if (congestion_field.weight <= 0.0f) return;
+
+    for (const UnitData& unit : units) {
+        congestion_field.splat(unit.position, unit.velocity);
+    }
+}
+
+int UnitSystem::gather_nearby_units(Vec2 p_world_pos, float p_radius, const int*& r_indices) {
+    Vec2i rel_pos = flow_field_system->world_to_relative(p_world_pos);
+    int ux = rel_pos.x / 2;
+    int uy = rel_pos.y / 2;
+    int dx = int(p_radius / unit_grid_cell_size.x) + 1;
+    int dy = int(p_radius / unit_grid_cell_size.y) + 1;
+    int x_begin = std::max(ux - dx, 0);
+    int x_end = std::min(ux + dx, unit_grid_width - 1);
+    int y_begin = std::max(uy - dy, 0);
+    int y_end = std::min(uy + dy, unit_grid_height - 1);
+
+    // 先按格子里的单位数申请足够的空间，再筛选距离
+    int capacity = 0;
+    for (int nx = x_begin; nx <= x_end; ++nx) {
+        for (int ny = y_begin; ny <= y_end; ++ny) {
+            capacity += get_cell(ny * unit_grid_width + nx).size();
+        }
+    }
+    int* indices = frame_arena.allocate<int>(capacity);
+
+    // 检查 3x3 范围内的格子
+    int count = 0;
+    for (int nx = x_begin; nx <= x_end; ++nx) {
+        for (int ny = y_begin; ny <= y_end; ++ny) {
+            for (int unit_idx : get_cell(ny * unit_grid_width + nx)) {
+                if (p_world_pos.distance_squared_to(units[unit_idx].position) < p_radius * p_radius) {
+                    indices[count++] = unit_idx;
+                }
+            }
+        }
+    }
+    r_indices = indices;
+    return count;
+}
+
+std::vector<int> UnitSystem::get_nearby_units(Vec2 p_world_pos, float p_radius) {
+    FrameArena::Marker marker = frame_arena.get_marker();
+    const int* indices = nullptr;
+    int count = gather_nearby_units(p_world_pos, p_radius, indices);
+    std::vector<int> nearby_indices(indices, indices + count);
+    frame_arena.rewind(marker);
+    return nearby_indices;
+}
+
+void UnitSystem::collect_units_in_rect(const Rect2& p_rect, std::vector<int>& r_indices) {
+    if (!is_setup || !flow_field_system) return;
+    if (is_spatial_grid_dirty) {
+        update_spatial_grid();
+    }
+
+    // 网格是按 tick 开始时的位置建的，单位在 tick 内移动不超过一格，所以向外多查一圈
+    Vec2i begin = flow_field_system->world_to_relative(p_rect.position);
+    Vec2i end = flow_field_system->world_to_relative(p_rect.get_end());
+    int x_begin = std::max(begin.x / 2 - 1, 0);
+    int y_begin = std::max(begin.y / 2 - 1, 0);
+    int x_end = std::min(end.x / 2 + 1, unit_grid_width - 1);
+    int y_end = std::min(end.y / 2 + 1, unit_grid_height - 1);
+
+    for (int y = y_begin; y <= y_end; ++y) {
+        for (int x = x_begin; x <= x_end; ++x) {
+            for (int unit_idx : get_cell(y * unit_grid_width + x)) {
+                if (p_rect.has_point(units[unit_idx].position)) {
+                    r_indices.push_back(unit_idx);
+                }
+            }
+        }
+    }
+    for (int unit_idx : off_grid_units) {
+        if (p_rect.has_point(units[unit_idx].position)) {
+            r_indices.push_back(unit_idx);
+        }
+    }
+}
+
+void UnitSystem::collect_units_in_radius(Vec2 p_world_pos, float p_radius, std::vector<int>& r_indices) {
+    // 先按外接矩形收集，再原地筛掉圆外的单位
+    size_t begin = r_indices.size();
+    collect_units_in_rect(Rect2(p_world_pos - Vec2(p_radius, p_radius), Vec2(p_radius * 2.0f, p_radius * 2.0f)), r_indices);
+
+    size_t count = begin;
+    for (size_t i = begin; i < r_indices.size(); ++i) {
+        if (p_world_pos.distance_squared_to(units[r_indices[i]].position) < p_radius * p_radius) {
+            r_indices[count++] = r_indices[i];
+        }
+    }
+    r_indices.resize(count);
+}
+
+UnitSystem::CellSpan UnitSystem::get_team_range(const CellSpan& p_cell, int p_team) const {
+    const int* begin = std::lower_bound(p_cell.first, p_cell.last, p_team,
+        [this](int p_unit_idx, int p_value) { return unit_teams[p_unit_idx] < p_value; });
+    const int* end = std::upper_bound(begin, p_cell.last, p_team,
+        [this](int p_value, int p_unit_idx) { return p_value < unit_teams[p_unit_idx]; });
+    return { begin, end };
+}
+
+int UnitSystem::collect_team_units(Vec2 p_world_pos, int p_team, float p_radius, bool p_is_enemy, int p_limit, std::vector<int>* r_indices) {
+    if (!is_setup || !flow_field_system) return 0;
+    if (is_spatial_grid_dirty) {
+        update_spatial_grid();
+    }
+
+    int team = clamp_team(p_team);
+    uint8_t team_bit = (uint8_t)(1 << team);
+    float radius_squared = p_radius * p_radius;
+    int count = 0;
+
+    // 在 [p_first, p_last) 中数距离以内的单位，数够了返回 true
+    auto scan = [&](const int* p_first, const int* p_last) {
+        for (const int* it = p_first; it != p_last; ++it) {
+            int unit_idx = *it;
+            if (p_world_pos.distance_squared_to(units[unit_idx].position) >= radius_squared) continue;
+            if (r_indices) r_indices->push_back(unit_idx);
+            if (++count == p_limit) return true;
+        }
+        return false;
+    };
+
+    // 网格是按 tick 开始时的位置建的，与 get_nearby_units 一样向外多查一格
+    Vec2i rel_pos = flow_field_system->world_to_relative(p_world_pos);
+    int ux = rel_pos.x / 2;
+    int uy = rel_pos.y / 2;
+    int dx = int(p_radius / unit_grid_cell_size.x) + 1;
+    int dy = int(p_radius / unit_grid_cell_size.y) + 1;
+
+    for (int ny = std::max(uy - dy, 0); ny <= std::min(uy + dy, unit_grid_height - 1); ++ny) {
+        for (int nx = std::max(ux - dx, 0); nx <= std::min(ux + dx, unit_grid_width - 1); ++nx) {
+            int grid_idx = ny * unit_grid_width + nx;
+            uint8_t mask = unit_grid_team_masks[grid_idx];
+            CellSpan cell = get_cell(grid_idx);
+
+            if (p_is_enemy) {
+                if ((mask & ~team_bit) == 0) continue;
+                if ((mask & team_bit) == 0) {
+                    if (scan(cell.first, cell.last)) return count;
+                    continue;
+                }
+                CellSpan own = get_team_range(cell, team);
+                if (scan(cell.first, own.first) || scan(own.last, cell.last)) return count;
+            }
+            else {
+                if ((mask & team_bit) == 0) continue;
+                if (mask == team_bit) {
+                    if (scan(cell.first, cell.last)) return count;
+                    continue;
+                }
+                CellSpan own = get_team_range(cell, team);
+                if (scan(own.first, own.last)) return count;
+            }
+        }
+    }
+
+    for (int unit_idx : off_grid_units) {
+        if ((unit_teams[unit_idx] == team) == p_is_enemy) continue;
+        if (p_world_pos.distance_squared_to(units[unit_idx].position) >= radius_squared) continue;
+        if (r_indices) r_indices->push_back(unit_idx);
+        if (++count == p_limit) return count;
+    }
+    return count;
+}
+
+bool UnitSystem::has_enemy_in_radius(Vec2 p_world_pos, int p_team, float p_radius) {
+    return collect_team_units(p_world_pos, p_team, p_radius, true, 1, nullptr) > 0;
+}
+
+int UnitSystem::count_allies_in_radius(Vec2 p_world_pos, int p_team, float p_radius) {
+    return collect_team_units(p_world_pos, p_team, p_radius, false, 0, nullptr);
+}
+
+void UnitSystem::collect_enemies_in_radius(Vec2 p_world_pos, int p_team, float p_radius, std::vector<int>& r_indices) {
+    collect_team_units(p_world_pos, p_team, p_radius, true, 0, &r_indices);
+}
+
+int UnitSystem::find_nearest_enemy(Vec2 p_world_pos, int p_team, float p_radius) {
+    if (!is_setup || !flow_field_system) return -1;
+    if (is_spatial_grid_dirty) {
+        update_spatial_grid();
+    }
+
+    int team = clamp_team(p_team);
+    uint8_t team_bit = (uint8_t)(1 << team);
+    int best_idx = -1;
+    float best_distance_squared = p_radius * p_radius;
+
+    auto scan = [&](const int* p_first, const int* p_last) {
+        for (const int* it = p_first; it != p_last; ++it) {
+            int unit_idx = *it;
+            float distance_squared = p_world_pos.distance_squared_to(units[unit_idx].position);
+            if (distance_squared < best_distance_squared ||
+                (distance_squared == best_distance_squared && best_idx != -1 && unit_idx < best_idx)) {
+                best_distance_squared = distance_squared;
+                best_idx = unit_idx;
+            }
+        }
+    };
+
+    auto scan_cell = [&](int p_x, int p_y) {
+        if (p_x < 0 || p_x >= unit_grid_width || p_y < 0 || p_y >= unit_grid_height) return;
+        int grid_idx = p_y * unit_grid_width + p_x;
+        uint8_t mask = unit_grid_team_masks[grid_idx];
+        if ((mask & ~team_bit) == 0) return;
+
+        CellSpan cell = get_cell(grid_idx);
+        if ((mask & team_bit) == 0) {
+            scan(cell.first, cell.last);
+            return;
+        }
+        CellSpan own = get_team_range(cell, team);
+        scan(cell.first, own.first);
+        scan(own.last, cell.last);
+    };
+
+    // 从所在格子一圈一圈向外找；第 ring 圈的格子离查询点至少 ring - 1 个格子宽，
+    // 再减去单位在 tick 内可能移出格子的一格，已经找到的更近时停止
+    Vec2i rel_pos = flow_field_system->world_to_relative(p_world_pos);
+    int ux = rel_pos.x / 2;
+    int uy = rel_pos.y / 2;
+    int max_ring = std::max(int(p_radius / unit_grid_cell_size.x), int(p_radius / unit_grid_cell_size.y)) + 1;
+    float cell_extent = (float)std::min(unit_grid_cell_size.x, unit_grid_cell_size.y);
+
+    for (int ring = 0; ring <= max_ring; ++ring) {
+        if (ring >= 2) {
+            float gap = (ring - 2) * cell_extent;
+            if (best_idx != -1 && gap * gap > best_distance_squared) break;
+        }
+        if (ring == 0) {
+            scan_cell(ux, uy);
+            continue;
+        }
+        for (int nx = ux - ring; nx <= ux + ring; ++nx) {
+            scan_cell(nx, uy - ring);
+            scan_cell(nx, uy + ring);
+        }
+        for (int ny = uy - ring + 1; ny <= uy + ring - 1; ++ny) {
+            scan_cell(ux - ring, ny);
+            scan_cell(ux + ring, ny);
+        }
+    }
+
+    for (const int& unit_idx : off_grid_units) {
+        if (unit_teams[unit_idx] == team) continue;
+        scan(&unit_idx, &unit_idx + 1);
+    }
+    return best_idx;
+}
+
+void UnitSystem::tick(double p_delta, SelectionInput& p_selection) {
+    if (!is_ready()) { return; }
+
+    frame_arena.reset();
+
+    store_previous_transforms();
+
+    {
+        SIM_PROFILE_SCOPE(PHASE_HOVER);
+        update_hover(p_selection);
+    }
+
+    {
+        SIM_PROFILE_SCOPE(PHASE_SPATIAL_GRID);
+        update_spatial_grid();
+        update_lod_cells();
+        update_congestion();
+    }
+
+    {
+        SIM_PROFILE_SCOPE(PHASE_FLOW_FIELD_UPDATE);
+        flow_field_system->update(p_delta);
+        obstacle_field.update(*flow_field_system);
+    }
+
+    {
+        SIM_PROFILE_SCOPE(PHASE_GROUPS);
+        if (p_selection.state == SELECTING_TARGET_POSITION) {
+            command_selected_units_to_move(p_selection.mouse_position);
+        }
+        update_groups();
+    }
+
+    {
+        SIM_PROFILE_SCOPE(PHASE_UNIT_LOOP);
+        if (avoidance_mode == AVOIDANCE_ORCA) {
+            update_units_orca(p_selection, p_delta);
+        }
+        else {
+            for (int unit_idx = 0; unit_idx < units.size(); ++unit_idx) {
+                UnitData& unit = units[unit_idx];
+                // 降频的单位在跳过的 tick 里只按当前速度移动（仍做墙壁修正）
+                int steps = advance_lod(unit);
+                if (steps > 0) {
+                    update_state(unit);
+                }
+                update_selection_state_and_target_position(unit, p_selection);
+
+                // 每个单位每 tick 只取样一次，受力和位置修正共用
+                ObstacleSample wall;
+                obstacle_field.sample(unit.position, wall);
+                if (steps > 0) {
+                    update_velocity(unit, wall, p_delta, steps);
+                }
+                move(unit, wall, p_delta);
+            }
+        }
+    }
+
+    {
+        SIM_PROFILE_SCOPE(PHASE_DAMAGE);
+        resolve_damage();
+    }
+
+    if (influence_enabled) {
+        SIM_PROFILE_SCOPE(PHASE_INFLUENCE);
+        influence_map.update(units, unit_health, unit_shield, *unit_types);
+    }
+
+    if ((p_selection.state == SINGLE_SELECTING) ||
+        (p_selection.state == TYPE_SELECTING) ||
+        (p_selection.state == BOX_SELECTION_ENDED) ||
+        (p_selection.state == SELECTING_TARGET_POSITION)) {
+        p_selection.state = NOT_SELECTING;
+    }
+}
+
+void UnitSystem::store_previous_transforms() {
+    for (UnitData& unit : units) {
+        unit.previous_position = unit.position;
+        unit.previous_heading = unit.heading;
+    }
+}
+
+void UnitSystem::update_hover(SelectionInput& p_selection) {
+    p_selection.selected_unit_id = -1;
+    for (int unit_idx = 0; unit_idx < units.size(); ++unit_idx) {
+        UnitData& unit = units[unit_idx];
+        float selection_radius = get_type_record(unit).selection_radius;
+        if ((p_selection.mouse_position.distance_squared_to(unit.position) <
+            selection_radius * selection_radius) &&
+            (p_selection.state != BOX_SELECTING)) {
+            unit.is_mouse_on = true;
+        }
+        else {
+            unit.is_mouse_on = false;
+        }
+        if ((p_selection.state == SINGLE_SELECTING) ||
+            (p_selection.state == TYPE_SELECTING)) {
+            if (unit.is_mouse_on) {
+                p_selection.selected_unit_id = unit.id;
+                p_selection.selected_type = unit.type;
+            }
+        }
+    }
+}
+
+Vec2 UnitSystem::get_flow(UnitData& p_unit) {
+    const UnitGroup* group = get_unit_group(p_unit);
+    if (!group || !group->field) {
+        return Vec2(0, 0);
+    }
+    if (group->has_line_of_sight) {
+        return (group->target_pos - p_unit.position).normalized();
+    }
+    float speed = get_type_record(p_unit).move_speed;
+    Vec2 flow = flow_field_system->get_congested_flow_direction(*group->field, p_unit.position, congestion_field, speed);
+    return flow;
+}
+
+Vec2 UnitSystem::get_separation(UnitData& p_unit) {
+    bool is_IDLE = (p_unit.state == IDLE);
+    Vec2 separation = Vec2(0, 0);
+
+    float radius = get_type_record(p_unit).collision_radius;
+    FrameArena::Marker marker = frame_arena.get_marker();
+    const int* nearby_indices = nullptr;
+    int nearby_count = gather_nearby_units(p_unit.position, radius * separation_radius_factor, nearby_indices);
+    SIM_PROFILE_COUNT(COUNTER_NEIGHBOURS_VISITED, (int64_t)nearby_count);
+    for (int i = 0; i < nearby_count; ++i) {
+        const UnitData& nearby_unit = units[nearby_indices[i]];
+        Vec2 radius_vector = nearby_unit.position - p_unit.position;
+        float length_squared = radius_vector.length_squared();
+        if (length_squared < 10e-12) {
+            continue;
+        }
+        if (is_IDLE) {
+            if (nearby_unit.state == IDLE) {
+                separation -= radius_vector / length_squared;
+            }
+            else {
+                separation -= 2 * radius_vector / length_squared;
+            }
+        }
+        else {
+            if (nearby_unit.state == IDLE) {
+                separation -= 0.5 * radius_vector / length_squared;
+            }
+            else {
+                separation -= radius_vector / length_squared;
+            }
+        }
+    }
+
+    frame_arena.rewind(marker);
+
+    separation = separation.limit_length(separation_limit);
+    return separation;
+}
+
+Vec2 UnitSystem::get_friction(UnitData& p_unit) {
+    return (-p_unit.velocity);
+}
+
+Vec2 UnitSystem::get_wall_repulsion(UnitData& p_unit, const ObstacleSample& p_wall) {
+    float range = get_type_record(p_unit).collision_radius * wall_repulsion_range_factor;
+    if (range <= 0.0f || p_wall.distance >= range) {
+        return Vec2(0, 0);
+    }
+    // 距离越近越强，贴墙时为 1
+    float strength = std::min((range - p_wall.distance) / range, 1.0f);
+    return p_wall.normal * strength;
+}
+
+Vec2 UnitSystem::get_force(UnitData& p_unit, const ObstacleSample& p_wall) {
+    Vec2 force = Vec2(0, 0);
+    switch (p_unit.state) {
+    case IDLE:
+        force = get_friction(p_unit) * friction_factor + get_separation(p_unit) * separation_factor;
+        break;
+    case MOVING:
+        force = get_flow(p_unit) * flow_factor + get_separation(p_unit) * separation_factor;
+        break;
+    }
+    force += get_wall_repulsion(p_unit, p_wall) * wall_repulsion_factor;
+    return force;
+}
+
+void UnitSystem::update_state(UnitData& p_unit) {
+    UnitGroup* group = get_unit_group(p_unit);
+    switch (p_unit.state) {
+    case IDLE:
+        // 整组都停下后离开组，组在下一 tick 释放
+        if (group && group->moving_count == 0) {
+            p_unit.group_id = -1;
+        }
+        break;
+    case MOVING:
+        if (!group || !group->field) {
+            p_unit.state = IDLE;
+            p_unit.velocity = Vec2(0, 0);
+            break;
+        }
+        // 目标可能被组重新选过
+        p_unit.target_pos = group->target_pos;
+        p_unit.target_grid = group->target_grid;
+
+        if ((group->is_arrived && p_unit.position.distance_squared_to(group->target_pos) <= group->arrival_radius * group->arrival_radius) ||
+            flow_field_system->get_integration(*group->field, p_unit.position) <= desired_integration) {
+            p_unit.state = IDLE;
+            p_unit.velocity = Vec2(0, 0);
+        }
+        break;
+    }
+}
+
+void UnitSystem::update_velocity(UnitData& p_unit, const ObstacleSample& p_wall, double p_delta, int p_steps) {
+    Vec2 force = get_force(p_unit, p_wall);
+    if (force.length_squared() < force_threshold_squared) {
+        force = Vec2(0, 0);
+    }
+
+    float speed = get_type_record(p_unit).move_speed;
+    switch (p_unit.state) {
+    case IDLE: {
+        // 摩擦力的显式积分在 friction_factor * 步长 > 2 时发散：步长超过 FRICTION_STEP（低频模拟、LOD 降频）时
+        // 摩擦按若干个 FRICTION_STEP 小步的衰减系数处理，其余的力按总时长积分
+        double duration = p_delta * p_steps;
+        int friction_steps = std::max(p_steps, (int)std::ceil(duration / FRICTION_STEP - 1e-6));
+        if (friction_steps > 1 && force.length_squared() > 0.0f) {
+            Vec2 friction = get_friction(p_unit) * friction_factor;
+            float decay = (float)std::pow(1.0 - friction_factor * duration / friction_steps, friction_steps);
+            p_unit.velocity = p_unit.velocity * decay + (force - friction) * duration;
+        }
+        else {
+            p_unit.velocity += force * p_delta;
+        }
+        p_unit.velocity = (p_unit.velocity).limit_length(speed);
+        break;
+    }
+    case MOVING:
+        p_unit.velocity += force * (p_delta * p_steps);
+        p_unit.velocity = (p_unit.velocity).limit_length(speed);
+        break;
+    }
+
+    if ((p_unit.velocity).length_squared() < velocity_threshold_squared) {
+        p_unit.velocity = Vec2(0, 0);
+    }
+}
+
+void UnitSystem::move(UnitData& p_unit, const ObstacleSample& p_wall, double p_delta) {
+    Vec2 step = p_unit.velocity * p_delta;
+    p_unit.position += step;
+    if (p_unit.velocity.length_squared() > 0.1f) {
+        p_unit.heading = p_unit.velocity.angle();
+    }
+
+    if (p_wall.normal.length_squared() == 0.0f) return;
+
+    // 移动后的距离用取样点的一阶近似估算，不再重新取样
+    float radius = get_type_record(p_unit).collision_radius;
+    float distance = p_wall.distance + step.dot(p_wall.normal);
+    if (distance >= radius) return;
+
+    p_unit.position += p_wall.normal * (radius - distance);
+
+    // 去掉朝墙里的速度分量，保留沿墙滑动的部分
+    float into_wall = p_unit.velocity.dot(p_wall.normal);
+    if (into_wall < 0.0f) {
+        p_unit.velocity -= p_wall.normal * into_wall;
+    }
+}
+
+void UnitSystem::update_lod_cells() {
+    is_lod_active = lod_enabled && has_lod_view && unit_grid_size > 0;
+    if (!is_lod_active) return;
+
+    lod_cell_tiers.resize(unit_grid_size);
+    lod_cell_areas.assign(unit_grid_size, 0.0f);
+
+    // 镜头矩形（向外扩展后）覆盖的空间网格范围，两端都包含
+    auto to_cell_range = [this](float p_margin, Vec2i& r_begin, Vec2i& r_end) {
+        Vec2 margin(p_margin, p_margin);
+        Vec2i begin = flow_field_system->world_to_relative(lod_view.position - margin);
+        Vec2i end = flow_field_system->world_to_relative(lod_view.get_end() + margin);
+        r_begin = Vec2i(begin.x / 2, begin.y / 2);
+        r_end = Vec2i(end.x / 2, end.y / 2);
+    };
+    Vec2i full_begin, full_end, half_begin, half_end;
+    to_cell_range(lod_view_margin, full_begin, full_end);
+    to_cell_range(lod_view_margin + lod_half_distance, half_begin, half_end);
+
+    if (lod_contact_density > 0.0f) {
+        for (int grid_idx = 0; grid_idx < unit_grid_size; ++grid_idx) {
+            for (int unit_idx : get_cell(grid_idx)) {
+                float radius = get_type_record(units[unit_idx]).collision_radius;
+                lod_cell_areas[grid_idx] += 3.14159265f * radius * radius;
+            }
+        }
+    }
+    float contact_area = lod_contact_density * 9.0f * (float)unit_grid_cell_size.x * (float)unit_grid_cell_size.y;
+
+    for (int y = 0; y < unit_grid_height; ++y) {
+        for (int x = 0; x < unit_grid_width; ++x) {
+            int grid_idx = y * unit_grid_width + x;
+            LodTier tier = LOD_QUARTER;
+            if (x >= full_begin.x && x <= full_end.x && y >= full_begin.y && y <= full_end.y) {
+                tier = LOD_FULL;
+            }
+            else if (x >= half_begin.x && x <= half_end.x && y >= half_begin.y && y <= half_end.y) {
+                tier = LOD_HALF;
+            }
+
+            // 拥挤处排斥力变化快，降频会让单位互相穿插
+            if (tier != LOD_FULL && lod_contact_density > 0.0f && !get_cell(grid_idx).empty()) {
+                float area = 0.0f;
+                for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, unit_grid_height - 1); ++ny) {
+                    for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, unit_grid_width - 1); ++nx) {
+                        area += lod_cell_areas[ny * unit_grid_width + nx];
+                    }
+                }
+                if (area >= contact_area) tier = LOD_FULL;
+            }
+            lod_cell_tiers[grid_idx] = (uint8_t)tier;
+        }
+    }
+}
+
+LodTier UnitSystem::get_lod_tier(const UnitData& p_unit) const {
+    if (!is_lod_active || p_unit.lod_combat_ticks > 0 || p_unit.is_selected || p_unit.is_mouse_on) {
+        return LOD_FULL;
+    }
+    // 与 update_spatial_grid 的换算一致
+    Vec2i rel_pos = flow_field_system->world_to_relative(p_unit.position);
+    int ux = rel_pos.x / 2;
+    int uy = rel_pos.y / 2;
+    if (ux < 0 || ux >= unit_grid_width || uy < 0 || uy >= unit_grid_height) {
+        return LOD_FULL;
+    }
+    return (LodTier)lod_cell_tiers[uy * unit_grid_width + ux];
+}
+
+int UnitSystem::advance_lod(UnitData& p_unit) {
+    if (p_unit.lod_combat_ticks > 0) --p_unit.lod_combat_ticks;
+    if (p_unit.lod_elapsed < 255) ++p_unit.lod_elapsed;
+
+    // 升到全速立即更新，其余的级别变化等到本来就要更新的那个 tick
+    LodTier tier = get_lod_tier(p_unit);
+    if (p_unit.lod_countdown > 1 && tier != LOD_FULL) {
+        --p_unit.lod_countdown;
+        return 0;
+    }
+
+    int steps = p_unit.lod_elapsed;
+    int interval = 1 << tier;
+    if (tier > p_unit.lod_tier) {
+        // 降级时按 ID 错开第一次更新，同时降级的单位轮流分到之后的各个 tick
+        p_unit.lod_countdown = (uint8_t)(1 + p_unit.id % interval);
+    }
+    else {
+        p_unit.lod_countdown = (uint8_t)interval;
+    }
+    p_unit.lod_tier = (uint8_t)tier;
+    p_unit.lod_elapsed = 0;
+    return steps;
+}
+
+void UnitSystem::update_units_orca(const SelectionInput& p_selection, double p_delta) {
+    int count = (int)units.size();
+    orca_positions.resize(count);
+    orca_velocities.resize(count);
+    orca_preferred.resize(count);
+    orca_radii.resize(count);
+    orca_walls.resize(count);
+    orca_results.resize(count);
+
+    // 1. 状态、选择和期望速度（流场方向 + 墙壁排斥，按最大速度缩放）
+    for (int unit_idx = 0; unit_idx < count; ++unit_idx) {
+        UnitData& unit = units[unit_idx];
+        update_state(unit);
+        update_selection_state_and_target_position(unit, p_selection);
+
+        const UnitTypeRecord& record = get_type_record(unit);
+        ObstacleSample& wall = orca_walls[unit_idx];
+        wall = ObstacleSample();
+        obstacle_field.sample(unit.position, wall);
+
+        Vec2 preferred = unit.state == MOVING ? get_flow(unit) : Vec2(0, 0);
+        preferred += get_wall_repulsion(unit, wall);
+        orca_preferred[unit_idx] = preferred.limit_length(1.0f) * record.move_speed;
+        orca_positions[unit_idx] = unit.position;
+        orca_velocities[unit_idx] = unit.velocity;
+        orca_radii[unit_idx] = record.collision_radius;
+    }
+
+    // 2. 逐个求解，只读连续数组
+    for (int unit_idx = 0; unit_idx < count; ++unit_idx) {
+        float radius = orca_radii[unit_idx];
+        collect_orca_neighbours(unit_idx, radius * orca_neighbour_radius_factor);
+        SIM_PROFILE_COUNT(COUNTER_NEIGHBOURS_VISITED, (int64_t)orca_neighbours.size());
+
+        Vec2 position = orca_positions[unit_idx];
+        Vec2 velocity = orca_velocities[unit_idx];
+        orca_solver.clear();
+        for (const OrcaNeighbour& neighbour : orca_neighbours) {
+            orca_solver.add_neighbour(velocity, orca_positions[neighbour.index] - position,
+                velocity - orca_velocities[neighbour.index], radius + orca_radii[neighbour.index],
+                orca_time_horizon, (float)p_delta);
+        }
+        orca_results[unit_idx] = orca_solver.solve(orca_preferred[unit_idx], get_type_record(units[unit_idx]).move_speed);
+    }
+
+    // 3. 写回速度并移动
+    for (int unit_idx = 0; unit_idx < count; ++unit_idx) {
+        UnitData& unit = units[unit_idx];
+        unit.velocity = orca_results[unit_idx];
+        if (unit.velocity.length_squared() < velocity_threshold_squared) {
+            unit.velocity = Vec2(0, 0);
+        }
+        move(unit, orca_walls[unit_idx], p_delta);
+    }
+}
+
+void UnitSystem::collect_orca_neighbours(int p_unit_idx, float p_radius) {
+    orca_neighbours.clear();
+
+    Vec2 position = orca_positions[p_unit_idx];
+    Vec2i rel_pos = flow_field_system->world_to_relative(position);
+    int ux = rel_pos.x / 2;
+    int uy = rel_pos.y / 2;
+    int dx = int(p_radius / unit_grid_cell_size.x) + 1;
+    int dy = int(p_radius / unit_grid_cell_size.y) + 1;
+    float radius_squared = p_radius * p_radius;
+
+    for (int ny = std::max(uy - dy, 0); ny <= std::min(uy + dy, unit_grid_height - 1); ++ny) {
+        for (int nx = std::max(ux - dx, 0); nx <= std::min(ux + dx, unit_grid_width - 1); ++nx) {
+            for (int unit_idx : get_cell(ny * unit_grid_width + nx)) {
+                if (unit_idx == p_unit_idx) continue;
+                float distance_squared = position.distance_squared_to(orca_positions[unit_idx]);
+                if (distance_squared < radius_squared) {
+                    orca_neighbours.push_back({ distance_squared, unit_idx });
+                }
+            }
+        }
+    }
+
+    // 只保留最近的几个，并按距离排序（约束的顺序会影响线性规划的结果，距离相同时按下标）
+    auto closer = [](const OrcaNeighbour& p_a, const OrcaNeighbour& p_b) {
+        return p_a.distance_squared < p_b.distance_squared ||
+            (p_a.distance_squared == p_b.distance_squared && p_a.index < p_b.index);
+    };
+    int keep = std::max(orca_max_neighbours, 0);
+    if ((int)orca_neighbours.size() > keep) {
+        std::nth_element(orca_neighbours.begin(), orca_neighbours.begin() + keep, orca_neighbours.end(), closer);
+        orca_neighbours.resize(keep);
+    }
+    std::sort(orca_neighbours.begin(), orca_neighbours.end(), closer);
+}
+
+int UnitSystem::create_group(Vec2 p_target_pos, Vec2i p_target_grid) {
+    int group_id;
+    if (free_group_ids.empty()) {
+        group_id = (int)groups.size();
+        groups.emplace_back();
+        // 解散小队时 push_back 不再扩容
+        free_group_ids.reserve(groups.capacity());
+    }
+    else {
+        group_id = free_group_ids.back();
+        free_group_ids.pop_back();
+    }
+
+    UnitGroup& group = groups[group_id];
+    group = UnitGroup();
+    group.is_active = true;
+    group.target_pos = p_target_pos;
+    group.target_grid = p_target_grid;
+    group.cost_version = flow_field_system->get_cost_version();
+    return group_id;
+}
+
+void UnitSystem::rebuild_groups() {
+    groups.clear();
+    free_group_ids.clear();
+
+    // 先恢复有 ID 的组，目标取自组员身上的副本；超出范围的 ID（坏数据）当作没有组，下面按目标重新分组
+    for (UnitData& unit : units) {
+        if (unit.group_id >= (int)units.size() || unit.group_id < -1) {
+            unit.group_id = -1;
+        }
+        if (unit.group_id < 0) continue;
+        if (unit.group_id >= (int)groups.size()) {
+            groups.resize(unit.group_id + 1);
+        }
+        UnitGroup& group = groups[unit.group_id];
+        if (!group.is_active) {
+            group.is_active = true;
+            group.target_pos = unit.target_pos;
+            group.target_grid = unit.target_grid;
+        }
+    }
+
+    // 没有组的移动单位（旧数据）按目标分组
+    std::unordered_map<Vec2i, int, Vec2iHasher> target_groups;
+    for (UnitData& unit : units) {
+        if (unit.group_id >= 0 || unit.state != MOVING) continue;
+        auto it = target_groups.find(unit.target_grid);
+        if (it == target_groups.end()) {
+            it = target_groups.emplace(unit.target_grid, (int)groups.size()).first;
+            groups.emplace_back();
+            groups.back().is_active = true;
+            groups.back().target_pos = unit.target_pos;
+            groups.back().target_grid = unit.target_grid;
+        }
+        unit.group_id = it->second;
+    }
+
+    // 空闲 ID 从大到小压入，之后先复用小的
+    for (int group_id = (int)groups.size() - 1; group_id >= 0; --group_id) {
+        if (!groups[group_id].is_active) free_group_ids.push_back(group_id);
+    }
+    is_groups_dirty = false;
+}
+
+void UnitSystem::update_groups() {
+    if (is_groups_dirty) {
+        rebuild_groups();
+    }
+    if (groups.empty()) return;
+
+    for (UnitGroup& group : groups) {
+        group.member_count = 0;
+        group.moving_count = 0;
+        group.arrived_count = 0;
+        group.radius_squared_sum = 0.0f;
+        group.centroid = Vec2(0, 0);
+    }
+
+    // 一次遍历统计所有组
+    for (const UnitData& unit : units) {
+        if (unit.group_id < 0 || unit.group_id >= (int)groups.size()) continue;
+        UnitGroup& group = groups[unit.group_id];
+        if (!group.is_active) continue;
+
+        float radius = get_type_record(unit).collision_radius;
+        if (group.member_count == 0) {
+            group.bounds = Rect2(unit.position, Vec2(0, 0));
+        }
+        else {
+            Vec2 begin = group.bounds.position.min(unit.position);
+            Vec2 end = group.bounds.get_end().max(unit.position);
+            group.bounds = Rect2(begin, end - begin);
+        }
+        ++group.member_count;
+        if (unit.state == MOVING) {
+            ++group.moving_count;
+        }
+        else {
+            ++group.arrived_count;
+        }
+        group.radius_squared_sum += radius * radius;
+        group.centroid += unit.position;
+    }
+
+    uint64_t cost_version = flow_field_system->get_cost_version();
+    for (int group_id = 0; group_id < (int)groups.size(); ++group_id) {
+        UnitGroup& group = groups[group_id];
+        if (!group.is_active) continue;
+
+        if (group.member_count == 0) {
+            group.is_active = false;
+            group.field = nullptr;
+            free_group_ids.push_back(group_id);
+            continue;
+        }
+        group.centroid /= (float)group.member_count;
+
+        // 目标附近的代价变过才检查目标格是否还能到达
+        if (flow_field_system->is_region_changed_since(Rect2i(group.target_grid, Vec2i(1, 1)), group.cost_version)) {
+            retarget_group(group);
+        }
+        group.cost_version = cost_version;
+
+        group.field = flow_field_system->use_flow_field(group.target_grid);
+        if (!group.field) {
+            // 流场被清掉了（例如调试时清空），重新创建
+            flow_field_system->create_flow_field(group.target_grid, false);
+            group.field = flow_field_system->use_flow_field(group.target_grid);
+        }
+
+        // 有界计算的流场还没覆盖到组员时接着展开
+        // 流场变脏时 demand 会清空，已经到达的组也要申请，重算时只覆盖组员现在所在的区域
+        request_field_region(group.target_grid, group.bounds);
+
+        // 紧密排列（约 90% 的面积利用率）时整组占据的半径
+        group.arrival_radius = std::sqrt(group.radius_squared_sum / 0.9f) * group_arrival_factor;
+        if (!group.is_arrived && group.arrived_count > 0) {
+            group.is_arrived = group.centroid.distance_squared_to(group.target_pos) <= group.arrival_radius * group.arrival_radius;
+        }
+
+        update_group_sight(group);
+    }
+
+    // 活动的组都有组员，组数不会超过单位数
+    if (groups.size() > units.size()) {
+        compact_groups();
+    }
+}
+
+void UnitSystem::compact_groups() {
+    std::vector<int> remap(groups.size(), -1);
+    int count = 0;
+    for (int group_id = 0; group_id < (int)groups.size(); ++group_id) {
+        if (!groups[group_id].is_active) continue;
+        remap[group_id] = count;
+        if (count != group_id) {
+            groups[count] = groups[group_id];
+        }
+        ++count;
+    }
+    groups.resize(count);
+    free_group_ids.clear();
+
+    for (UnitData& unit : units) {
+        if (unit.group_id >= 0 && unit.group_id < (int)remap.size()) {
+            unit.group_id = remap[unit.group_id];
+        }
+    }
+}
+
+void UnitSystem::update_group_sight(UnitGroup& r_group) {
+    if (r_group.moving_count == 0) {
+        r_group.has_line_of_sight = false;
+        return;
+    }
+
+    Vec2 begin = r_group.bounds.position;
+    Vec2 end = r_group.bounds.get_end();
+
+    if (r_group.has_line_of_sight) {
+        Vec2 sight_begin = r_group.sight_bounds.position;
+        Vec2 sight_end = r_group.sight_bounds.get_end();
+        bool is_inside = begin.x >= sight_begin.x && begin.y >= sight_begin.y && end.x <= sight_end.x && end.y <= sight_end.y;
+
+        // 上次检查的包围盒与目标张成的区域（网格坐标）
+        Vec2i cell_begin = flow_field_system->world_to_grid(sight_begin.min(r_group.target_pos));
+        Vec2i cell_end = flow_field_system->world_to_grid(sight_end.max(r_group.target_pos));
+        Rect2i swept(cell_begin, cell_end - cell_begin + Vec2i(1, 1));
+
+        if (is_inside && !flow_field_system->is_region_changed_since(swept, r_group.sight_version)) {
+            return;
+        }
+    }
+    else if (--r_group.sight_countdown > 0) {
+        return;
+    }
+
+    // 包围盒（向外扩两格）四角和重心都能直线看到目标时，组员不再沿 8 方向的流场走折线
+    Vec2i cell_size = flow_field_system->get_cell_size();
+    Vec2 margin((float)cell_size.x * 2.0f, (float)cell_size.y * 2.0f);
+    begin -= margin;
+    end += margin;
+    r_group.has_line_of_sight =
+        has_line_of_sight(r_group.centroid, r_group.target_pos) &&
+        has_line_of_sight(begin, r_group.target_pos) &&
+        has_line_of_sight(Vec2(end.x, begin.y), r_group.target_pos) &&
+        has_line_of_sight(Vec2(begin.x, end.y), r_group.target_pos) &&
+        has_line_of_sight(end, r_group.target_pos);
+    r_group.sight_bounds = Rect2(begin, end - begin);
+    r_group.sight_version = flow_field_system->get_cost_version();
+    r_group.sight_countdown = SIGHT_RECHECK_TICKS;
+}
+
+void UnitSystem::retarget_group(UnitGroup& r_group) {
+    if (flow_field_system->get_cost(r_group.target_grid) != 255) return;
+
+    // 由近到远一圈一圈地找，同一圈内按固定顺序，结果是确定的
+    const int MAX_SEARCH_RADIUS = 16;
+    for (int radius = 1; radius <= MAX_SEARCH_RADIUS; ++radius) {
+        for (int dy = -radius; dy <= radius; ++dy) {
+            for (int dx = -radius; dx <= radius; ++dx) {
+                if (std::abs(dx) != radius && std::abs(dy) != radius) continue;
+                Vec2i cell = r_group.target_grid + Vec2i(dx, dy);
+                float cost = flow_field_system->get_cost(cell);
+                if (cost < 0.0f || cost >= 255.0f) continue;
+
+                Vec2i cell_size = flow_field_system->get_cell_size();
+                r_group.target_grid = cell;
+                r_group.target_pos = Vec2((cell.x + 0.5f) * cell_size.x, (cell.y + 0.5f) * cell_size.y);
+                r_group.is_arrived = false;
+                flow_field_system->create_flow_field(cell, false);
+                return;
+            }
+        }
+    }
+}
+
+bool UnitSystem::has_line_of_sight(Vec2 p_from, Vec2 p_to) const {
+    // 按半个格子的步长沿线段取样，经过的格子必须都是平地（有效代价为 1）
+    const std::vector<uint8_t>& costs = flow_field_system->get_cost_map();
+    Vec2i cell_size = flow_field_system->get_cell_size();
+    Vec2i origin = flow_field_system->get_grid_origin();
+    int width = flow_field_system->get_width();
+    int height = flow_field_system->get_height();
+
+    float step = 0.5f * (float)std::min(cell_size.x, cell_size.y);
+    int steps = (int)std::ceil(p_from.distance_to(p_to) / step);
+    Vec2i previous(-1, -1);
+    for (int i = 0; i <= steps; ++i) {
+        Vec2 point = steps > 0 ? p_from + (p_to - p_from) * ((float)i / steps) : p_from;
+        Vec2i cell = flow_field_system->world_to_grid(point) - origin;
+        if (cell == previous) continue;
+        previous = cell;
+        if (cell.x < 0 || cell.x >= width || cell.y < 0 || cell.y >= height) return false;
+        if (costs[cell.y * width + cell.x] != 1) return false;
+    }
+    return true;
+}
+
+UnitGroup* UnitSystem::get_unit_group(const UnitData& p_unit) {
+    if (p_unit.group_id < 0 || p_unit.group_id >= (int)groups.size()) return nullptr;
+    UnitGroup& group = groups[p_unit.group_id];
+    return group.is_active ? &group : nullptr;
+}
+
+const UnitGroup* UnitSystem::get_group(int p_group_id) const {
+    if (p_group_id < 0 || p_group_id >= (int)groups.size() || !groups[p_group_id].is_active) return nullptr;
+    return &groups[p_group_id];
+}
+
+void UnitSystem::update_selection_state_and_target_position(UnitData& p_unit, const SelectionInput& p_selection) {
+    switch (p_selection.state) {
+    case NOT_SELECTING:
+        break;
+    case SINGLE_SELECTING:
+        if (p_selection.selected_unit_id == -1) {
+            break;
+        }
+        else {
+            if (p_selection.selected_unit_id == p_unit.id) {
+                p_unit.is_selected = !p_unit.is_selected;
+            }
+            else {
+                p_unit.is_selected = false;
+            }
+        }
+        break;
+    case TYPE_SELECTING:
+        if (p_selection.selected_unit_id == -1) {
+            break;
+        }
+        else {
+            if (p_selection.selected_type == p_unit.type) {
+                p_unit.is_selected = true;
+            }
+            else {
+                p_unit.is_selected = false;
+            }
+        }
+        break;
+    case BOX_SELECTING:
+        if (p_selection.selecting_box.has_point(p_unit.position)) {
+            p_unit.is_mouse_on = true;
+        }
+        else {
+            p_unit.is_mouse_on = false;
+        }
+        break;
+    case BOX_SELECTION_ENDED:
+        if (p_selection.selecting_box.has_point(p_unit.position)) {
+            p_unit.is_selected = true;
+        }
+        else {
+            p_unit.is_selected = false;
+        }
+        break;
+    case SELECTING_TARGET_POSITION:
+        // 在 tick 开头由 command_selected_units_to_move 统一下达
+        break;
+    }
+}
+
+int UnitSystem::get_unit_index(int p_unit_id) const {
+    auto it = id_to_index.find(p_unit_id);
+
+    if (it != id_to_index.end()) {
+        return (int)it->second;
+    }
+
+    return -1;
+}
+
+uint64_t UnitSystem::compute_checksum() const {
+    // FNV-1a，按数组顺序混入每个单位的关键状态
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void* p_data, size_t p_size) {
+        const uint8_t* bytes = (const uint8_t*)p_data;
+        for (size_t i = 0; i < p_size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    for (size_t i = 0; i < units.size(); ++i) {
+        const UnitData& unit = units[i];
+        int32_t state = unit.state;
+        mix(&unit.id, sizeof(unit.id));
+        mix(&unit.position, sizeof(unit.position));
+        mix(&unit.velocity, sizeof(unit.velocity));
+        mix(&state, sizeof(state));
+        mix(&unit_health[i], sizeof(float));
+        mix(&unit_shield[i], sizeof(float));
+    }
+    return hash;
+}
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+#include "sim_math.h"
+#include "flow_field.h"
+#include "obstacle_field.h"
+#include "congestion_field.h"
+#include "orca.h"
+#include "unit_types.h"
+#include "damage_system.h"
+#include "influence_map.h"
+#include "frame_arena.h"
+
+namespace sim {
+
+    // 与 UnitManager::UnitState 的顺序一致
+    enum UnitState {
+        IDLE,        // 待机
+        MOVING,      // 移动中
+    };
+
+    // 局部避让方式，与 UnitManager 的 avoidance_mode 属性一致
+    // ORCA 只减少单位互相穿插：速度每 tick 直接换成求解结果，密集人群中转向比力模型频繁，耗时约为两倍，行进也更慢
+    // （sim_bench --avoidance：5000 个单位对穿，力模型 5.1 ms/tick、抖动 0.26 度/tick、重叠 7211 对，
+    //  ORCA 10.5 ms/tick、1.11 度/tick、4416 对）
+    enum AvoidanceMode {
+        AVOIDANCE_FORCES,   // 流场力 + 排斥力积分（默认）
+        AVOIDANCE_ORCA,     // 速度障碍：流场给出期望速度，ORCA 求出不碰撞的速度
+    };
+
+    // 模拟细节层级：镜头外、周围空旷的单位降低受力计算的频率，跳过的 tick 仍按当前速度移动
+    enum LodTier {
+        LOD_FULL,       // 每 tick 更新
+        LOD_HALF,       // 每 2 tick 更新一次
+        LOD_QUARTER,    // 每 4 tick 更新一次
+    };
+
+    // 与 SelectionManager::SelectionState 的顺序一致
+    enum SelectionState {
+        NOT_SELECTING,
+        SINGLE_SELECTING,
+        TYPE_SELECTING,
+        BOX_SELECTING,
+        BOX_SELECTION_ENDED,
+        SELECTING_TARGET_POSITION
+    };
+
+    // 每 tick 交给模拟的选择输入（由 SelectionManager 拷贝而来，模拟结束后再拷回去）
+    struct SelectionInput {
+        SelectionState state = NOT_SELECTING;
+        Vec2 mouse_position = Vec2(-1000000, -1000000);
+        Rect2 selecting_box;
+        int selected_unit_id = -1;
+        int selected_type = 0;
+    };
+
+    struct UnitData {
+        int id;                 // 唯一标识符
+        Vec2 position;       // 当前世界坐标
+        Vec2 velocity;       // 当前速度向量
+        Vec2 target_pos;		//目标的世界坐标
+        Vec2i target_grid;   // 目标的网格坐标（与流场坐标一致，不同于unit_grid中的坐标）
+        UnitState state;        // 状态机
+        int type;			// 单位种类（速度、半径等数值从 UnitTypeTable 中查）
+        int group_id = -1;     // 所属单位组（移动命令），-1 表示不在组内；target_pos / target_grid 是组目标的副本
+        int team = 0;           // 阵营（0 ~ InfluenceMap::MAX_TEAMS - 1），影响力图和按阵营的邻居查询据此分层
+
+        bool is_selected = false;
+        bool is_mouse_on = false;
+
+        // --- 渲染插值 ---
+        // 模拟频率低于显示频率时，渲染在上一 tick 与当前 tick 之间插值
+        float heading = 0.0f;           // 朝向（弧度），停下后保持最后的移动方向
+        Vec2 previous_position;         // 上一 tick 结束时的位置
+        float previous_heading = 0.0f;
+
+        // --- LOD 调度 ---
+        uint8_t lod_tier = LOD_FULL;
+        uint8_t lod_countdown = 0;      // 距下次更新的 tick 数
+        uint8_t lod_elapsed = 0;        // 距上次更新的 tick 数，更新时按这么多 tick 积分
+        uint8_t lod_combat_ticks = 0;   // 受到或造成伤害后保持全速更新的剩余 tick 数
+
+        UnitData() : id(-1), state(IDLE), type(0) {}
+    };
+
+    // 单位组：每次移动命令创建一个，组员共享目标、流场和到达状态
+    // 查流场、到达判定、目标失效后的重新寻路和视线检查每 tick 每组只做一次
+    // 除了目标以外都是每 tick 重新统计的，不需要存档（恢复单位后按组员的 group_id 重建）
+    struct UnitGroup {
+        bool is_active = false;
+        Vec2 target_pos;
+        Vec2i target_grid;
+        uint64_t cost_version = 0;      // 上次检查目标格时的代价版本
+
+        // --- 每 tick 统计 ---
+        int member_count = 0;
+        int moving_count = 0;
+        int arrived_count = 0;          // 已经停下的组员
+        float radius_squared_sum = 0.0f;
+        Vec2 centroid;
+        Rect2 bounds;
+        float arrival_radius = 0.0f;    // 整组集结后大约占据的半径
+        bool is_arrived = false;        // 已有组员到达且重心进入 arrival_radius，此后进入该范围的组员直接停下
+        bool has_line_of_sight = false; // 包围盒到目标之间都是平地，组员直接朝目标走
+        const FlowField* field = nullptr;   // 本 tick 使用的流场
+
+        // 视线检查的缓存：有视线时，包围盒没有超出上次检查的范围、沿途代价没变就沿用结果；
+        // 没有视线时每隔 SIGHT_RECHECK_TICKS 重查一次
+        Rect2 sight_bounds;             // 上次检查时的包围盒（向外扩了两格）
+        uint64_t sight_version = 0;
+        int sight_countdown = 0;
+    };
+
+    // 单位模拟（与引擎无关），UnitManager 只是它的外壳
+    class UnitSystem {
+    private:
+        FlowFieldSystem* flow_field_system = nullptr;
+        UnitTypeTable* unit_types = nullptr;
+        std::unordered_map<int, size_t> id_to_index;
+        int next_unit_id = 0;
+
+        // --- 空间网格 (Unit Grid) ---
+        // 每一个格子存储该区域内的单位在 units 数组中的索引(index)
+        // 所有格子的下标按格子顺序连续存放（CSR）：格子 y * width + x 的单位是
+        // unit_grid_indices 中 [unit_grid_starts[i], unit_grid_starts[i + 1]) 这一段
+        // 每 tick 用计数排序重建，数组长度只随单位数变化，不会逐格扩容
+        // 格子的尺寸是流场中格子的两倍
+        std::vector<int> unit_grid_starts;      // unit_grid_size + 1 个
+        std::vector<int> unit_grid_cursors;     // 重建时每格的写入位置
+        std::vector<int> unit_grid_indices;
+        std::vector<int> unit_cells;            // 与 units 下标对应的格子，-1 表示不在网格内
+
+        // 一个格子里的单位下标（只读视图，网格重建后失效）
+        struct CellSpan {
+            const int* first;
+            const int* last;
+            const int* begin() const { return first; }
+            const int* end() const { return last; }
+            int size() const { return (int)(last - first); }
+            bool empty() const { return first == last; }
+        };
+        CellSpan get_cell(int p_grid_idx) const {
+            const int* data = unit_grid_indices.data();
+            return { data + unit_grid_starts[p_grid_idx], data + unit_grid_starts[p_grid_idx + 1] };
+        }
+
+        int unit_grid_width = 0;
+        int unit_grid_height = 0;
+        int unit_grid_size = 0;
+        Vec2i unit_grid_cell_size = Vec2i(0, 0);
+        std::vector<int> off_grid_units;        // 不在网格范围内的单位，按矩形查询时单独检查
+        bool is_spatial_grid_dirty = true;      // 增删过单位，网格里的下标已经失效
+
+        // --- 按阵营分段 ---
+        // 每个格子里的下标按阵营分段（同一阵营内仍按下标递增），再配上格子的阵营掩码：
+        // 按阵营查询时没有目标阵营的格子直接跳过，有的格子二分找到那一段，不逐个读 UnitData
+        std::vector<uint8_t> unit_grid_team_masks;  // 第 n 位表示格子里有阵营 n 的单位
+        std::vector<uint8_t> unit_teams;            // 与 units 下标对应
+        std::vector<int> team_sorted_units;         // 建网格时按阵营排好的下标
+        int team_unit_counts[InfluenceMap::MAX_TEAMS] = {};
+
+        // 格子中阵营 p_team 的那一段
+        CellSpan get_team_range(const CellSpan& p_cell, int p_team) const;
+        // 本方 (p_is_enemy = false) 或敌方单位中与 p_world_pos 距离小于 p_radius 的，
+        // 下标追加到 r_indices（可以为空），数到 p_limit 个就停（<= 0 不限），返回个数
+        int collect_team_units(Vec2 p_world_pos, int p_team, float p_radius, bool p_is_enemy, int p_limit, std::vector<int>* r_indices);
+
+        bool is_setup = false;
+
+        // tick 内临时数组的分配器，每 tick 开始时清空
+        FrameArena frame_arena;
+
+        // 让目标的流场覆盖到 p_bounds（世界坐标）内的单位
+        void request_field_region(Vec2i p_target_grid, const Rect2& p_bounds);
+
+        // 半径内的单位下标写进 frame_arena，返回个数；调用方用完后可以 rewind
+        int gather_nearby_units(Vec2 p_world_pos, float p_radius, const int*& r_indices);
+
+        // 墙壁距离场，单位与墙、建筑的碰撞只查这一张表
+        ObstacleField obstacle_field;
+
+        // 拥挤场，移动中的单位据此绕开人群
+        CongestionField congestion_field;
+
+        // --- ORCA 批量求解的缓冲区（与 units 下标对应） ---
+        // 先把位置、速度拷成连续数组，所有单位都用上一 tick 的速度求解，结果与遍历顺序无关
+        struct OrcaNeighbour {
+            float distance_squared;
+            int index;
+        };
+        OrcaSolver orca_solver;
+        std::vector<Vec2> orca_positions;
+        std::vector<Vec2> orca_velocities;
+        std::vector<Vec2> orca_preferred;
+        std::vector<float> orca_radii;
+        std::vector<ObstacleSample> orca_walls;
+        std::vector<Vec2> orca_results;
+        std::vector<OrcaNeighbour> orca_neighbours;
+
+        void update_units_orca(const SelectionInput& p_selection, double p_delta);
+        // 在空间网格中找出最近的 orca_max_neighbours 个邻居
+        void collect_orca_neighbours(int p_unit_idx, float p_radius);
+
+        // --- 单位组 ---
+        std::vector<UnitGroup> groups;      // 下标即组 ID，保持在 [0, 单位数) 内（读档按这个范围校验）
+        std::vector<int> free_group_ids;    // 已释放的 ID，后进先出
+        bool is_groups_dirty = false;       // 恢复过单位，需要按 group_id 重建
+
+        int create_group(Vec2 p_target_pos, Vec2i p_target_grid);
+        void rebuild_groups();
+        void update_groups();
+        // 解散的组多了以后 ID 可能超过单位数，按原顺序重新编号
+        void compact_groups();
+        // 目标格被建筑等占用后，把目标移到附近最近的可通行格
+        void retarget_group(UnitGroup& r_group);
+        bool has_line_of_sight(Vec2 p_from, Vec2 p_to) const;
+        void update_group_sight(UnitGroup& r_group);
+        const int SIGHT_RECHECK_TICKS = 15;
+        UnitGroup* get_unit_group(const UnitData& p_unit);
+
+        DamageSystem damage_system;
+        std::vector<int> dead_ids;
+
+        // 按阵营的影响力图，每 tick 结算伤害之后轮流重算一个阵营
+        InfluenceMap influence_map;
+
+        // --- LOD ---
+        // 镜头矩形由外壳每 tick 传入（回放中作为输入记录），没有设置时所有单位全速更新
+        Rect2 lod_view;
+        bool has_lod_view = false;
+        bool is_lod_active = false;
+        std::vector<uint8_t> lod_cell_tiers;    // 与空间网格对应
+        std::vector<float> lod_cell_areas;      // 每格单位占地面积之和
+        const int LOD_COMBAT_TICKS = 60;
+
+        // 摩擦力积分的最大步长（秒），与 60 Hz 的物理帧一致
+        const double FRICTION_STEP = 1.0 / 60.0;
+
+        // 按镜头距离和周围单位数给每个空间网格格子定级
+        void update_lod_cells();
+        LodTier get_lod_tier(const UnitData& p_unit) const;
+        // 推进单位的 LOD 计数，返回本 tick 要积分的 tick 数，0 表示本 tick 跳过
+        int advance_lod(UnitData& p_unit);
+
+    public:
+        // --- 力的参数 ---
+        float flow_factor = 2000.0f;
+        float separation_factor = 10000.0f;
+        float separation_radius_factor = 3.0f;		//排斥力半径与单位半径的比值
+        float separation_limit = 1000.0f;
+        float friction_factor = 100.0f;
+        float force_threshold_squared = 1.0f;
+        float velocity_threshold_squared = 1.0f;
+        float desired_integration = 0.1f;
+        float group_arrival_factor = 1.2f;          //整组的到达半径与组员紧密排列时半径的比值
+        float wall_repulsion_factor = 4000.0f;
+        float wall_repulsion_range_factor = 1.5f;	//墙壁排斥力作用距离与单位半径的比值
+
+        // --- 避让参数 ---
+        AvoidanceMode avoidance_mode = AVOIDANCE_FORCES;
+        int orca_max_neighbours = 10;
+        float orca_time_horizon = 0.5f;             // 秒，只避让这段时间内会发生的碰撞
+        float orca_neighbour_radius_factor = 4.0f;  //邻居搜索半径与单位半径的比值
+
+        // --- LOD 参数（只作用于力模型，ORCA 需要每 tick 的邻居速度） ---
+        bool lod_enabled = true;
+        float lod_view_margin = 256.0f;     // 镜头外这个距离内仍全速更新
+        float lod_half_distance = 2048.0f;  // 再往外这个距离内每 2 tick 更新，更远的每 4 tick
+        float lod_contact_density = 0.8f;   // 3x3 空间网格内单位占地面积的比例达到这个值（已经挤在一起）视为接触，全速更新；0 表示不检查
+
+        // --- 影响力图（默认关闭，由读取它的 AI 打开） ---
+        bool influence_enabled = false;
+
+        std::vector<UnitData> units;
+
+        // --- 战斗数据 (与 units 平行的数组，方便批量结算) ---
+        std::vector<float> unit_health;
+        std::vector<float> unit_shield;
+
+        // 每 tick 死亡的单位（id 升序），在单位被移除之前调用
+        std::function<void(const std::vector<int>&)> on_units_died;
+
+        UnitSystem();
+
+        // --- 系统管理 ---
+        void set_flow_field_system(FlowFieldSystem* p_system) { flow_field_system = p_system; }
+        FlowFieldSystem* get_flow_field_system() const { return flow_field_system; }
+        void set_unit_types(UnitTypeTable* p_table) { unit_types = p_table; }
+        const UnitTypeTable* get_unit_types() const { return unit_types; }
+        ObstacleField& get_obstacle_field() { return obstacle_field; }
+        const ObstacleField& get_obstacle_field() const { return obstacle_field; }
+        CongestionField& get_congestion_field() { return congestion_field; }
+        const CongestionField& get_congestion_field() const { return congestion_field; }
+        const FrameArena& get_frame_arena() const { return frame_arena; }
+        InfluenceMap& get_influence_map() { return influence_map; }
+        const InfluenceMap& get_influence_map() const { return influence_map; }
+        void setup(int p_width, int p_height, Vec2i p_cell_size, Vec2i p_origin);
+        bool is_ready() const { return is_setup && flow_field_system && unit_types; }
+
+        // --- 单位生命周期 ---
+        int spawn_unit(Vec2 p_world_pos, int p_type, int p_team = 0);
+        void despawn_unit(int p_unit_id);
+        // 按原样恢复一个单位（保留 ID），用于回放和读档
+        void restore_unit(const UnitData& p_unit, float p_health, float p_shield);
+        // 整体替换所有单位（三个数组按下标一一对应）
+        void restore_units(const UnitData* p_units, const float* p_health, const float* p_shield, int p_count, int p_next_unit_id);
+        void command_units_to_move(const int* p_unit_ids, int p_count, Vec2 p_target_world_pos);
+        // 鼠标指定目标：所有选中的单位组成一组
+        void command_selected_units_to_move(Vec2 p_target_world_pos);
+
+        // --- 伤害 ---
+        void apply_damage(int p_target_id, int p_attacker_id, float p_damage, int p_attack_type);
+        void resolve_damage();
+
+        // --- 空间网格核心操作 ---
+        void update_spatial_grid();
+        // 把单位的位置和速度分摊到拥挤场
+        void update_congestion();
+        std::vector<int> get_nearby_units(Vec2 p_world_pos, float p_radius);
+        // 位置在矩形内的单位下标（追加到 r_indices），只枚举矩形覆盖的网格格子；
+        // 两次 tick 之间增删过单位时先重建网格
+        void collect_units_in_rect(const Rect2& p_rect, std::vector<int>& r_indices);
+        // 与单位中心距离小于 p_radius 的单位下标（追加到 r_indices），同样只枚举覆盖到的格子
+        void collect_units_in_radius(Vec2 p_world_pos, float p_radius, std::vector<int>& r_indices);
+
+        // --- 按阵营查询 ---
+        // 敌方是 p_team 以外的所有阵营；与 collect_units_in_rect 一样，增删过单位时先重建网格
+        // 半径内最近的敌方单位的下标，没有时返回 -1（距离相同时取下标小的）
+        int find_nearest_enemy(Vec2 p_world_pos, int p_team, float p_radius);
+        bool has_enemy_in_radius(Vec2 p_world_pos, int p_team, float p_radius);
+        int count_allies_in_radius(Vec2 p_world_pos, int p_team, float p_radius);
+        void collect_enemies_in_radius(Vec2 p_world_pos, int p_team, float p_radius, std::vector<int>& r_indices);
+
+        // --- 核心循环 ---
+        void tick(double p_delta, SelectionInput& p_selection);
+        // tick 开始时保存上一 tick 的位置和朝向，供渲染插值
+        void store_previous_transforms();
+
+        // --- 逻辑计算 ---
+        void update_hover(SelectionInput& p_selection);
+        Vec2 get_flow(UnitData& p_unit);
+        Vec2 get_separation(UnitData& p_unit);
+        Vec2 get_friction(UnitData& p_unit);
+        Vec2 get_wall_repulsion(UnitData& p_unit, const ObstacleSample& p_wall);
+        Vec2 get_force(UnitData& p_unit, const ObstacleSample& p_wall);
+        void update_state(UnitData& p_unit);
+        // p_steps > 1 时一次积分 p_steps 个 tick（LOD 降频的单位）
+        void update_velocity(UnitData& p_unit, const ObstacleSample& p_wall, double p_delta, int p_steps = 1);
+        // 移动后按墙壁距离修正位置，不让单位嵌进墙里
+        void move(UnitData& p_unit, const ObstacleSample& p_wall, double p_delta);
+        void update_selection_state_and_target_position(UnitData& p_unit, const SelectionInput& p_selection);
+
+        // --- LOD ---
+        void set_lod_view(const Rect2& p_view) { lod_view = p_view; has_lod_view = true; }
+        void clear_lod_view() { has_lod_view = false; }
+        bool get_lod_view(Rect2& r_view) const { r_view = lod_view; return has_lod_view; }
+
+        // --- 查询 ---
+        const UnitTypeRecord& get_type_record(const UnitData& p_unit) const { return unit_types->get(p_unit.type); }
+        int get_unit_index(int p_unit_id) const;
+        int get_unit_count() const { return (int)units.size(); }
+        int get_next_unit_id() const { return next_unit_id; }
+        const UnitGroup* get_group(int p_group_id) const;
+        int get_group_count() const { return (int)(groups.size() - free_group_ids.size()); }
+
+        // 单位状态的校验和，用于确认回放结果与录制时一致
+        uint64_t compute_checksum() const;
+    };
+}
@@ -0,0 +1,46 @@
+#include "unit_types.h"
+
+using namespace sim;
+
+void UnitTypeTable::ensure_type(int p_type) {
+    if (!is_valid_unit_type(p_type) || has_type(p_type)) return;
+
+    records.resize(p_type + 1);
+    uses_defaults.resize(p_type + 1, true);
+    ++revision;
+}
+
+void UnitTypeTable::set_record(int p_type, const UnitTypeRecord& p_record) {
+    if (!is_valid_unit_type(p_type)) return;
+
+    ensure_type(p_type);
+    uses_defaults[p_type] = false;
+    records[p_type] = p_record;
+    ++revision;
+}
+
+void UnitTypeTable::apply_defaults(float p_speed, float p_radius, float p_selection_radius) {
+    for (int i = 0; i < (int)records.size(); ++i) {
+        if (uses_defaults[i]) {
+            records[i].move_speed = p_speed;
+            records[i].collision_radius = p_radius;
+            records[i].selection_radius = p_selection_radius;
+        }
+    }
+    ++revision;
+}
+
+void UnitTypeTable::clear() {
+    records.clear();
+    uses_defaults.clear();
+    ++revision;
+}
+
+void UnitTypeTable::restore(const UnitTypeRecord* p_records, const uint8_t* p_uses_defaults, int p_count) {
+    records.assign(p_records, p_records + p_count);
+    uses_defaults.resize(p_count);
+    for (int i = 0; i < p_count; ++i) {
+        uses_defaults[i] = p_uses_defaults[i] != 0;
+    }
+    ++revision;
+}
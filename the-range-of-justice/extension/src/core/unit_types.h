@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace sim {
+
+    // 单位类型的紧凑数据 (POD)
+    // 由 UnitStats 编译而来，热循环只读这个表，不直接访问 Resource
+    // 枚举字段的取值与 game_definitions.h 中的定义一致
+    struct UnitTypeRecord {
+        // --- 移动 ---
+        float move_speed = 200.0f;
+        float turn_speed = 5.0f;
+        float collision_radius = 10.0f;
+        float selection_radius = 12.0f;
+
+        // --- 生存 ---
+        float health_max = 100.0f;
+        float health_regen = 1.0f;
+        float shield_max = 0.0f;
+        float shield_regen = 0.0f;
+
+        // --- 攻击 ---
+        float attack_damage = 10.0f;
+        float attack_range = 100.0f;
+        float attack_interval = 1.0f;
+        float splash_radius = 0.0f;
+        float projectile_speed = 500.0f;
+
+        // --- 其他 ---
+        float sight_range = 300.0f;
+        float aggro_range = 250.0f;
+        float build_time = 5.0f;
+        int32_t cost = 100;
+        uint32_t unit_tags = 0;            // TAG_NONE
+
+        uint8_t armor_type = 0;            // ARMOR_LIGHT
+        uint8_t attack_type = 0;           // ATTACK_PHYSICAL
+        uint8_t move_type = 0;             // MOVE_GROUND
+        uint8_t target_priority = 0;       // PRIORITY_CLOSEST
+    };
+
+    // 类型表允许的最大类型 ID。表按 ID 直接下标，来自文件的类型超过它时拒绝，避免按坏数据分配巨大的表
+    const int MAX_UNIT_TYPE = 0xFFFF;
+
+    inline bool is_valid_unit_type(int p_type) { return p_type >= 0 && p_type <= MAX_UNIT_TYPE; }
+
+    // 单位类型表：以 UnitType 为下标的连续数组
+    class UnitTypeTable {
+    private:
+        std::vector<UnitTypeRecord> records;
+        std::vector<bool> uses_defaults;         // 该行是否还在使用调试默认值
+        uint64_t revision = 0;                   // 每次修改加一
+
+    public:
+        bool has_type(int p_type) const { return p_type >= 0 && p_type < (int)records.size(); }
+
+        // 保证表中存在该行，不存在则以默认值补齐；超出 [0, MAX_UNIT_TYPE] 的类型忽略
+        void ensure_type(int p_type);
+
+        // 写入一行已编译好的数据；超出 [0, MAX_UNIT_TYPE] 的类型忽略
+        void set_record(int p_type, const UnitTypeRecord& p_record);
+
+        // 没有写入过数据的行使用调试参数
+        void apply_defaults(float p_speed, float p_radius, float p_selection_radius);
+
+        void clear();
+
+        int get_type_count() const { return (int)records.size(); }
+
+        uint64_t get_revision() const { return revision; }
+
+        bool is_using_defaults(int p_type) const { return uses_defaults[p_type]; }
+
+        // 整体替换（读档）
+        void restore(const UnitTypeRecord* p_records, const uint8_t* p_uses_defaults, int p_count);
+
+        const UnitTypeRecord& get(int p_type) const { return records[p_type]; }
+    };
+}
@@ -1,61 +1,23 @@
 #pragma once
 
-#include <vector>
-#include <queue>
-#include <unordered_map>
-
 #include <godot_cpp/classes/node2d.hpp>
+#include <godot_cpp/classes/tile_map_layer.hpp>
 #include <godot_cpp/variant/vector2.hpp>
 #include <godot_cpp/variant/vector2i.hpp>
-#include <godot_cpp/classes/time.hpp>
-
-namespace godot {
+#include <godot_cpp/variant/packed_vector2i_array.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/rect2i.hpp>
 
-    // 为 Vector2i 提供哈希支持，以便将其用作 unordered_map 的 Key
-    struct Vector2iHasher {
-        size_t operator()(const Vector2i& v) const {
-            // 将两个 32 位整数组合成一个 64 位哈希值
-            return ((uint64_t)v.x << 32) | (uint32_t)v.y;
-        }
-    };
+#include "core/flow_field.h"
 
-    // 单个流场的数据结构
-    struct FlowField {
-        bool is_dirty = false;       //dirty指cost_map更新后flow_field没有更新
-        bool is_computing = false;       //是否已完成计算
-        float last_used_time;       //上次被查询的时间
-        Vector2i target_position;           // 该流场的目标网格坐标
-        std::vector<float> integration_field; // Dijkstra 算法生成的集成场 (值越小离目标越近)
-        std::vector<Vector2> flow_directions; // 最终生成的方向向量数组 (单位查询这个)
-
-        FlowField() = default;
-
-        // 初始化数组大小
-        void reserve(int size) {
-            integration_field.assign(size, 65535.0f);
-            flow_directions.assign(size, Vector2(0, 0));
-        }
-    };
+namespace godot {
 
+    // 流场管理器：对模拟核心 sim::FlowFieldSystem 的薄封装，只负责与 Godot 交互
     class FlowFieldManager : public Node2D {
         GDCLASS(FlowFieldManager, Node2D)
 
     private:
-        int width;       // 地图宽度（格子数）
-        int height;      // 地图高度（格子数）
-        int size;       //总格子数
-        Vector2i grid_origin;       //地图的左上角坐标
-        Vector2i cell_size; // 每个格子的尺寸
-        std::vector<uint8_t> global_cost_map;      // 障碍物权重 (通常 1 为平地，255 为墙)
-
-        // 哈希表存储：Key 为目标点坐标，Value 为对应的完整流场数据
-        std::unordered_map<Vector2i, FlowField, Vector2iHasher> flow_fields;
-
-        std::queue<Vector2i> calculation_queue;
-
-        double cleanup_timer = 0.0;      // 累加时间
-        const double CLEANUP_INTERVAL = 2.0; // 每 2 秒扫描一次
-        const double UNUSED_THRESHOLD = 10.0; // 超过 10 秒没用就删除
+        sim::FlowFieldSystem core;
 
     protected:
         static void _bind_methods();
@@ -64,11 +26,9 @@ namespace godot {
         FlowFieldManager();
         ~FlowFieldManager();
 
-        void update(double p_delta);
-
-        void process_one_task();
+        sim::FlowFieldSystem& get_core() { return core; }
 
-        void cleanup_flow_fields();
+        void update(double p_delta);
 
         // --- 基础设置 ---
 
@@ -93,6 +53,29 @@ namespace godot {
         // 修改特定流场的代价地图（例如动态添加障碍物）
         void set_cost(Vector2i p_cell_pos, uint8_t p_cost);
 
+        // --- 批量修改（每次调用只产生一个变化区域，流场只标记一次重算） ---
+
+        // 把矩形区域内的代价设为同一个值，返回实际发生变化的格子的包围盒
+        Rect2i set_cost_region(Rect2i p_region, uint8_t p_cost);
+
+        // 导入整张代价地图（按行存储，长度为 width * height），返回值同上
+        Rect2i import_cost_map(const PackedByteArray& p_costs);
+
+        // 直接从 TileMapLayer 的自定义数据层读取代价：
+        // bool 类型的层为 true 时取 p_cost，int / float 类型的层直接作为代价；空格子取 p_empty_cell_cost（-1 表示不修改）
+        Rect2i import_tile_map_layer(TileMapLayer* p_layer, const String& p_custom_data_layer, uint8_t p_cost = 255, int p_empty_cell_cost = 255);
+
+        // --- 图层 ---
+        // set_cost 系列修改的是地形层；建筑占用层由 BuildingManager 维护；动态修正层叠加在地形之上（墙除外）
+
+        // 把矩形区域内的代价修正值设为 p_modifier（-127..127，0 表示取消）
+        void set_cost_modifier_region(Rect2i p_region, int p_modifier);
+
+        // 有效代价每次变化时递增；保存该值后用 is_region_changed_since 判断某个区域是否变过（按 16x16 分区）
+        int64_t get_cost_version();
+
+        bool is_region_changed_since(Rect2i p_region, int64_t p_version);
+
         // [核心] 计算指定目标的集成场 (Dijkstra/BFS)
         void compute_integration_field(Vector2i p_target_grid_pos);
 
@@ -119,7 +102,32 @@ namespace godot {
         Vector2i get_cell_size();
 
         bool is_in_grid(Vector2i p_grid_pos);
+
+        // --- 有界计算 ---
+        // 开启时流场只展开到使用它的单位所在的区域（再多走 bounded_margin），单位走出去时再接着展开
+        void set_bounded_integration(bool p_val) { core.set_bounded_integration(p_val); }
+        bool get_bounded_integration() const { return core.is_bounded_integration(); }
+
+        // 单位所在区域都确定之后再向外展开的积分值（平地一格为 1）
+        void set_bounded_margin(float p_val) { core.set_bounded_margin(p_val); }
+        float get_bounded_margin() const { return core.get_bounded_margin(); }
+
+        // --- 计算预算 ---
+        // 每个物理帧计算流场最多用的微秒数，算不完的下一帧接着算；为 0 时每帧只算一个流场
+        void set_compute_budget_us(int p_val) { core.set_compute_budget_us(p_val); }
+        int get_compute_budget_us() const { return core.get_compute_budget_us(); }
+
+        // --- 烘焙流场 ---
+
+        // 在当前代价地图上预先计算这些目标的流场并写入文件（离线步骤，见 tools/bake_flow_fields.gd）
+        bool bake_flow_fields(const String& p_path, const PackedVector2iArray& p_targets);
+
+        // 映射烘焙文件，文件中的流场在代价修改影响到它们之前直接使用，不需要计算
+        // 文件必须以普通文件的形式存在于磁盘上（不能在 .pck 中）
+        bool load_baked_fields(const String& p_path);
+
+        int get_baked_field_count();
     };
 
 
-}
\ No newline at end of file
+}
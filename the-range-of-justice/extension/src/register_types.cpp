@@ -5,6 +5,7 @@
 #include "building_manager.h"
 #include "unit_stats.h"
 #include "unit_loader.h"
+#include "unit_type_registry.h"
 
 #include <gdextension_interface.h>
 #include <godot_cpp/core/defs.hpp>
@@ -21,12 +22,14 @@ void initialize_module(ModuleInitializationLevel p_level) {
 	GDREGISTER_CLASS(UnitManager);
 	GDREGISTER_CLASS(BuildingManager);
 	GDREGISTER_CLASS(UnitStats);
+	GDREGISTER_CLASS(UnitLoader);
 }
 
 void uninitialize_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+	UnitTypeRegistry::get_singleton()->clear();
 }
 
 extern "C" {
@@ -40,9 +43,4 @@ extern "C" {
 
 		return init_obj.init();
 	}
-}
-
-void initialize_example_module(ModuleInitializationLevel p_level) {
-	// ...
-	ClassDB::register_class<UnitLoader>(); 
 }
\ No newline at end of file
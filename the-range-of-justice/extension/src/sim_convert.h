@@ -0,0 +1,22 @@
+#pragma once
+
+#include <godot_cpp/variant/vector2.hpp>
+#include <godot_cpp/variant/vector2i.hpp>
+#include <godot_cpp/variant/rect2.hpp>
+#include <godot_cpp/variant/rect2i.hpp>
+
+#include "core/sim_math.h"
+
+// Godot 数学类型与模拟核心数学类型之间的转换
+namespace godot {
+
+    inline sim::Vec2 to_sim(const Vector2& p_v) { return sim::Vec2(p_v.x, p_v.y); }
+    inline sim::Vec2i to_sim(const Vector2i& p_v) { return sim::Vec2i(p_v.x, p_v.y); }
+    inline sim::Rect2 to_sim(const Rect2& p_r) { return sim::Rect2(to_sim(p_r.position), to_sim(p_r.size)); }
+    inline sim::Rect2i to_sim(const Rect2i& p_r) { return sim::Rect2i(to_sim(p_r.position), to_sim(p_r.size)); }
+
+    inline Vector2 to_godot(const sim::Vec2& p_v) { return Vector2(p_v.x, p_v.y); }
+    inline Vector2i to_godot(const sim::Vec2i& p_v) { return Vector2i(p_v.x, p_v.y); }
+    inline Rect2 to_godot(const sim::Rect2& p_r) { return Rect2(to_godot(p_r.position), to_godot(p_r.size)); }
+    inline Rect2i to_godot(const sim::Rect2i& p_r) { return Rect2i(to_godot(p_r.position), to_godot(p_r.size)); }
+}
@@ -1,5 +1,15 @@
 // src/unit_loader.cpp
 #include "unit_loader.h"
+#include "unit_type_registry.h"
+#include "unit_pack.h"
+#include "unit_manager.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+
+#include <godot_cpp/classes/dir_access.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
 using namespace godot;
@@ -41,27 +51,23 @@ int UnitLoader::_parse_enum(String p_key, String p_value) {
         if (p_value == "Highest_value") return PRIORITY_HIGHEST_VALUE;
         if (p_value.is_valid_int()) return p_value.to_int();
     }
+
+    // --- UnitType (决定写入类型表的哪一行) ---
+    else if (p_key == "unit_type") {
+        if (p_value == "Square") return UnitManager::SQUARE;
+        if (p_value.is_valid_int()) return p_value.to_int();
+        return -1;
+    }
     // 默认情况：返回一个标记值（如 -999）或者尝试直接转 int
     if (p_value.is_valid_int()) return p_value.to_int();
     return 0; // 默认 fallback
 }
 
-Ref<UnitStats> UnitLoader::load_stats_from_txt(String p_path, Ref<UnitStats> p_target) {
-    // [关键点]：热重载的核心
-    // 如果传入了 p_target，我们直接操作它（内存地址不变，引用它的单位会自动更新）
-    // 如果没传，我们才 new 一个新的。
-    Ref<UnitStats> stats = p_target;
-    if (stats.is_null()) {
-        stats.instantiate();
-    }
-
-    if (!FileAccess::file_exists(p_path)) {
-        UtilityFunctions::print("Error: Config not found: ", p_path);
-        return stats;
-    }
-
+int UnitLoader::_parse_txt(String p_path, Ref<UnitStats> p_stats) {
     Ref<FileAccess> file = FileAccess::open(p_path, FileAccess::READ);
-    if (file.is_null()) return stats;
+    if (file.is_null()) return -1;
+
+    int unit_type = -1;
 
     while (file->get_position() < file->get_length()) {
         String line = file->get_line().strip_edges();
@@ -75,22 +81,236 @@ Ref<UnitStats> UnitLoader::load_stats_from_txt(String p_path, Ref<UnitStats> p_t
 
         // [修改] 智能设值
         // 如果是已知的枚举 key，走 _parse_enum
-        if (key == "armor_type" || key == "attack_type") {
+        if (key == "unit_type") {
+            unit_type = _parse_enum(key, value_str);
+            if (unit_type > sim::MAX_UNIT_TYPE) {
+                UtilityFunctions::print("Error: unit_type out of range (max ", sim::MAX_UNIT_TYPE, "): ", p_path);
+                unit_type = -1;
+            }
+        }
+        else if (key == "armor_type" || key == "attack_type" || key == "move_type" || key == "target_priority") {
             int enum_val = _parse_enum(key, value_str);
-            stats->set(key, enum_val);
+            p_stats->set(key, enum_val);
         }
         else {
             // 普通属性 (float/int)，直接转换
             float val_float = value_str.to_float();
-            stats->set(key, val_float);
+            p_stats->set(key, val_float);
+        }
+    }
+
+    return unit_type;
+}
+
+void UnitLoader::_copy_stats(const UnitStats& p_from, UnitStats& r_to) {
+    r_to.health_max = p_from.health_max;
+    r_to.health_regen = p_from.health_regen;
+    r_to.shield_max = p_from.shield_max;
+    r_to.shield_regen = p_from.shield_regen;
+    r_to.armor_type = p_from.armor_type;
+
+    r_to.attack_damage = p_from.attack_damage;
+    r_to.attack_range = p_from.attack_range;
+    r_to.attack_interval = p_from.attack_interval;
+    r_to.splash_radius = p_from.splash_radius;
+    r_to.attack_type = p_from.attack_type;
+    r_to.projectile_speed = p_from.projectile_speed;
+    r_to.target_priority = p_from.target_priority;
+
+    r_to.move_speed = p_from.move_speed;
+    r_to.turn_speed = p_from.turn_speed;
+    r_to.collision_radius = p_from.collision_radius;
+    r_to.selection_radius = p_from.selection_radius;
+    r_to.move_type = p_from.move_type;
+
+    r_to.sight_range = p_from.sight_range;
+    r_to.aggro_range = p_from.aggro_range;
+    r_to.cost = p_from.cost;
+    r_to.build_time = p_from.build_time;
+    r_to.unit_tags = p_from.unit_tags;
+}
+
+PackedStringArray UnitLoader::_list_definitions(String p_dir) {
+    PackedStringArray result;
+    PackedStringArray files = DirAccess::get_files_at(p_dir);
+    for (int i = 0; i < files.size(); ++i) {
+        if (files[i].ends_with(".txt")) {
+            result.push_back(p_dir.path_join(files[i]));
         }
     }
+    // 排序保证每次编译出的包内容一致
+    result.sort();
+    return result;
+}
+
+Ref<UnitStats> UnitLoader::load_stats_from_txt(String p_path, Ref<UnitStats> p_target) {
+    // [关键点]：热重载的核心
+    // 如果传入了 p_target，我们直接操作它（内存地址不变，引用它的单位会自动更新）
+    // 如果没传，我们才 new 一个新的。
+    Ref<UnitStats> stats = p_target;
+    if (stats.is_null()) {
+        stats.instantiate();
+    }
+
+    if (!FileAccess::file_exists(p_path)) {
+        UtilityFunctions::print("Error: Config not found: ", p_path);
+        return stats;
+    }
+
+    _parse_txt(p_path, stats);
+
+    // 重建类型表中引用了该资源的行，单位下一帧就会读到新数值
+    UnitTypeRegistry::get_singleton()->rebuild_rows(stats.ptr());
 
     UtilityFunctions::print("Loaded/Reloaded stats: ", p_path);
     return stats;
 }
 
+Error UnitLoader::compile_pack(String p_source_dir, String p_pack_path) {
+    PackedStringArray files = _list_definitions(p_source_dir);
+
+    std::vector<UnitPackEntry> entries;
+    entries.reserve(files.size());
+
+    for (int i = 0; i < files.size(); ++i) {
+        Ref<UnitStats> stats;
+        stats.instantiate();
+
+        int unit_type = _parse_txt(files[i], stats);
+        if (unit_type < 0) {
+            UtilityFunctions::print("Warning: Missing unit_type, skipped: ", files[i]);
+            continue;
+        }
+
+        UnitPackEntry entry;
+        entry.type = unit_type;
+        UnitTypeRegistry::compile(*stats.ptr(), entry.record);
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const UnitPackEntry& a, const UnitPackEntry& b) {
+        return a.type < b.type;
+    });
+
+    // 头 + 记录写进一块连续内存，一次写出
+    UnitPackHeader header;
+    header.count = (uint32_t)entries.size();
+
+    PackedByteArray bytes;
+    bytes.resize(sizeof(UnitPackHeader) + entries.size() * sizeof(UnitPackEntry));
+    memcpy(bytes.ptrw(), &header, sizeof(UnitPackHeader));
+    if (!entries.empty()) {
+        memcpy(bytes.ptrw() + sizeof(UnitPackHeader), entries.data(), entries.size() * sizeof(UnitPackEntry));
+    }
+
+    Ref<FileAccess> file = FileAccess::open(p_pack_path, FileAccess::WRITE);
+    if (file.is_null()) {
+        UtilityFunctions::print("Error: Cannot write unit pack: ", p_pack_path);
+        return FileAccess::get_open_error();
+    }
+    file->store_buffer(bytes);
+
+    UtilityFunctions::print("Compiled unit pack: ", p_pack_path, " (", (int)entries.size(), " types)");
+    return OK;
+}
+
+int UnitLoader::load_pack(String p_pack_path) {
+    // 整个包只读一次，不逐行解析、不走 Object::set
+    PackedByteArray bytes = FileAccess::get_file_as_bytes(p_pack_path);
+    if (bytes.size() < (int64_t)sizeof(UnitPackHeader)) {
+        UtilityFunctions::print("Error: Unit pack not found or empty: ", p_pack_path);
+        return -1;
+    }
+
+    UnitPackHeader header;
+    memcpy(&header, bytes.ptr(), sizeof(UnitPackHeader));
+
+    if (header.magic != UNIT_PACK_MAGIC || header.version != UNIT_PACK_VERSION ||
+        header.record_size != sizeof(UnitTypeRecord)) {
+        UtilityFunctions::print("Error: Unit pack is outdated, recompile it: ", p_pack_path);
+        return -1;
+    }
+
+    uint64_t expected_size = sizeof(UnitPackHeader) + (uint64_t)header.count * sizeof(UnitPackEntry);
+    if ((uint64_t)bytes.size() < expected_size) {
+        UtilityFunctions::print("Error: Unit pack is truncated: ", p_pack_path);
+        return -1;
+    }
+
+    // 先检查所有类型 ID，坏包不会写入一半：类型表按 ID 直接下标，超范围的 ID 会让表分配到几十亿行
+    const uint8_t* entry_data = bytes.ptr() + sizeof(UnitPackHeader);
+    for (uint32_t i = 0; i < header.count; ++i) {
+        int32_t type;
+        memcpy(&type, entry_data + i * sizeof(UnitPackEntry) + offsetof(UnitPackEntry, type), sizeof(int32_t));
+        if (!sim::is_valid_unit_type(type)) {
+            UtilityFunctions::print("Error: Unit pack has an invalid unit type (", type, "): ", p_pack_path);
+            return -1;
+        }
+    }
+
+    UnitTypeRegistry* registry = UnitTypeRegistry::get_singleton();
+    for (uint32_t i = 0; i < header.count; ++i) {
+        UnitPackEntry entry;
+        memcpy(&entry, entry_data + i * sizeof(UnitPackEntry), sizeof(UnitPackEntry));
+        registry->set_record(entry.type, entry.record);
+    }
+
+    UtilityFunctions::print("Loaded unit pack: ", p_pack_path, " (", (int)header.count, " types)");
+    return (int)header.count;
+}
+
+void UnitLoader::watch_directory(String p_dir) {
+    watch_dir = p_dir;
+    watched_mtimes.clear();
+
+    // 第一次轮询会把所有文件都解析一遍
+    poll_changes();
+}
+
+PackedStringArray UnitLoader::poll_changes() {
+    PackedStringArray reloaded;
+    if (watch_dir.is_empty()) return reloaded;
+
+    UnitTypeRegistry* registry = UnitTypeRegistry::get_singleton();
+    PackedStringArray files = _list_definitions(watch_dir);
+
+    for (int i = 0; i < files.size(); ++i) {
+        String path = files[i];
+        uint64_t modified_time = FileAccess::get_modified_time(path);
+
+        // 修改时间没变的文件直接跳过
+        if (watched_mtimes.has(path) && (uint64_t)watched_mtimes[path] == modified_time) continue;
+        watched_mtimes[path] = modified_time;
+
+        Ref<UnitStats> stats;
+        stats.instantiate();
+        int unit_type = _parse_txt(path, stats);
+        if (unit_type < 0) continue;
+
+        // 如果该类型绑定了 UnitStats，就把刚解析的数值拷进原资源（不再解析第二遍），让引用它的地方也看到新数值
+        Ref<UnitStats> source = registry->get_source(unit_type);
+        if (source.is_valid()) {
+            _copy_stats(*stats.ptr(), *source.ptr());
+            registry->rebuild_rows(source.ptr());
+        }
+        else {
+            UnitTypeRecord record;
+            UnitTypeRegistry::compile(*stats.ptr(), record);
+            registry->set_record(unit_type, record);
+        }
+
+        reloaded.push_back(path);
+    }
+
+    return reloaded;
+}
+
 void UnitLoader::_bind_methods() {
     // [修改] 绑定时记得把第二个参数也暴露出来
     ClassDB::bind_static_method("UnitLoader", D_METHOD("load_stats_from_txt", "path", "target_resource"), &UnitLoader::load_stats_from_txt, DEFVAL(Variant()));
+    ClassDB::bind_static_method("UnitLoader", D_METHOD("compile_pack", "source_dir", "pack_path"), &UnitLoader::compile_pack);
+    ClassDB::bind_static_method("UnitLoader", D_METHOD("load_pack", "pack_path"), &UnitLoader::load_pack);
+
+    ClassDB::bind_method(D_METHOD("watch_directory", "dir"), &UnitLoader::watch_directory);
+    ClassDB::bind_method(D_METHOD("poll_changes"), &UnitLoader::poll_changes);
 }
\ No newline at end of file
@@ -2,21 +2,52 @@
 
 #include <godot_cpp/classes/ref_counted.hpp>
 #include <godot_cpp/classes/file_access.hpp>
-#include "unit_stats.h" 
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include "unit_stats.h"
 
 namespace godot {
 
     class UnitLoader : public RefCounted {
         GDCLASS(UnitLoader, RefCounted)
 
+    private:
+        // --- 开发模式：监视定义目录 ---
+        String watch_dir;
+        Dictionary watched_mtimes;       // 文件路径 -> 上次解析时的修改时间
+
     protected:
         static void _bind_methods();
         //从字符到枚举的转换
         static int _parse_enum(String p_key, String p_value);
 
+        // 文本前端：把一个 txt 定义解析进 p_stats，返回文件里声明的 unit_type（没有声明返回 -1）
+        static int _parse_txt(String p_path, Ref<UnitStats> p_stats);
+
+        static PackedStringArray _list_definitions(String p_dir);
+
+        // 把解析好的数值整体拷进另一个资源（热重载绑定的资源时用）
+        static void _copy_stats(const UnitStats& p_from, UnitStats& r_to);
+
     public:
         // 输入 txt 文件路径，返回一个填充好数据的 UnitStats 资源
         static Ref<UnitStats> load_stats_from_txt(String p_path, Ref<UnitStats> p_target = nullptr);
+
+        // --- 二进制包 ---
+
+        // 构建步骤：把目录下所有 txt 定义编译成一个二进制包
+        static Error compile_pack(String p_source_dir, String p_pack_path);
+
+        // 运行时：一次读入整个包，直接拷进类型表，返回载入的类型数（失败返回 -1）
+        static int load_pack(String p_pack_path);
+
+        // --- 开发模式 ---
+
+        // 开始监视目录（会先完整解析一遍）
+        void watch_directory(String p_dir);
+
+        // 只重新解析修改过的文件，返回这次重新解析的文件列表
+        PackedStringArray poll_changes();
     };
 
-}
\ No newline at end of file
+}
@@ -1,13 +1,37 @@
 #include "unit_manager.h"
 
-#include <queue>
+#include <cstring>
 
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+#include <godot_cpp/variant/packed_float64_array.hpp>
+
+#include "sim_convert.h"
+#include "core/profiler.h"
+#include "core/replay.h"
+#include "core/snapshot.h"
+#include "building_manager.h"
 
 using namespace godot;
 
 UnitManager::UnitManager() {
-    units.reserve(1000);
+    flow_field_manager = nullptr;
+    selection_manager = nullptr;
+    unit_types = UnitTypeRegistry::get_singleton();
+    core.units.reserve(1000);
+
+    // 一个 tick 只发一次信号（此时单位还在，脚本仍可以查询死亡位置），然后由核心统一移除
+    core.on_units_died = [this](const std::vector<int>& p_dead_ids) {
+        PackedInt32Array dead_ids;
+        dead_ids.resize(p_dead_ids.size());
+        for (int i = 0; i < (int)p_dead_ids.size(); ++i) {
+            dead_ids.set(i, p_dead_ids[i]);
+        }
+        emit_signal("units_died", dead_ids);
+    };
 }
 
 UnitManager::~UnitManager() {}
@@ -20,433 +44,619 @@ void UnitManager::setup_system(int p_width, int p_height, Vector2i p_cell_size,
     
     flow_field_manager->setup_grid(p_width, p_height, p_origin, p_cell_size);
 
-    unit_grid_width = p_width / 2;
-    unit_grid_height = p_height / 2;
-    unit_grid_size = unit_grid_width * unit_grid_height;
-    unit_grid_cell_size = p_cell_size * 2;
-
-    unit_grid.resize(unit_grid_size);
+    sim::ReplayRecorder::get().record_setup(p_width, p_height, to_sim(p_cell_size), to_sim(p_origin));
 
-    for (int i = 0; i < unit_grid_size; ++i) {
-        unit_grid[i].reserve(10);
-    }
+    core.set_flow_field_system(&flow_field_manager->get_core());
+    core.set_unit_types(&unit_types->get_table());
+    core.setup(p_width, p_height, to_sim(p_cell_size), to_sim(p_origin));
 
     is_setup = true;
 }
 
-int UnitManager::spawn_unit(Vector2 p_world_pos, UnitType p_type) {
-    // 1. 创建一个新的单位数据结构
-    UnitData new_unit;
+void UnitManager::register_unit_type(UnitType p_type, Ref<UnitStats> p_stats) {
+    unit_types->register_type(p_type, p_stats);
+}
 
-    //调试
-    new_unit.radius = unit_radius;
-    new_unit.selection_radius = unit_selection_radius;
-    new_unit.speed = unit_speed;
+void UnitManager::ensure_unit_type(UnitType p_type) {
+    if (unit_types->has_type(p_type)) return;
 
-    // 2. 分配唯一 ID 并自增计数器
-    new_unit.id = next_unit_id++;
+    unit_types->ensure_type(p_type);
+    apply_unit_defaults();
+}
 
-    // 3. 初始化物理属性
-    new_unit.position = p_world_pos;
+void UnitManager::apply_unit_defaults() {
+    unit_types->apply_defaults(unit_speed, unit_radius, unit_selection_radius);
+}
 
-    // 4. 初始化状态(待完善，根据单位类型应有不同的初始化)
-    new_unit.velocity = Vector2(0, 0);
-    new_unit.state = IDLE;
-    new_unit.type = p_type;
-    new_unit.target_grid = Vector2i(-1, -1); // 初始没有目标
+int UnitManager::spawn_unit(Vector2 p_world_pos, UnitType p_type, int p_team) {
+    ERR_FAIL_COND_V_MSG(!sim::is_valid_unit_type((int)p_type), -1, "Unit type is out of range.");
 
-    // 5. 存入 vector
-    // 注意：如果单位非常多，建议在 UnitManager 构造函数里先调用 units.reserve(1000)
-    units.push_back(new_unit);
-    id_to_index[new_unit.id] = units.size() - 1;
+    // 保证类型表中有这一行（数值统一从类型表读取，单位本身不再存）
+    ensure_unit_type(p_type);
+    sim::ReplayRecorder::get().record_spawn(core, to_sim(p_world_pos), (int)p_type, p_team);
 
-    // 6. 返回 ID，以便 GDScript 记录并关联对应的 Sprite
-    return new_unit.id;
+    // 返回 ID，以便 GDScript 记录并关联对应的 Sprite
+    return core.spawn_unit(to_sim(p_world_pos), (int)p_type, p_team);
 }
 
 void UnitManager::despawn_unit(int p_unit_id) {
-    auto it = id_to_index.find(p_unit_id);
-    if (it == id_to_index.end()) return;
+    sim::ReplayRecorder::get().record_despawn(p_unit_id);
+    core.despawn_unit(p_unit_id);
+}
 
-    size_t index_to_remove = it->second;
-    int last_unit_idx = units.size() - 1;
+void UnitManager::apply_damage(int p_target_id, int p_attacker_id, float p_damage, AttackType p_attack_type) {
+    sim::ReplayRecorder::get().record_damage(p_target_id, p_attacker_id, p_damage, (int)p_attack_type);
+    core.apply_damage(p_target_id, p_attacker_id, p_damage, (int)p_attack_type);
+}
 
-    if (index_to_remove != last_unit_idx) {
-        // 1. 获取最后一个单位的数据
-        UnitData& last_unit = units.back();
+void UnitManager::command_units_to_move(const PackedInt32Array& p_unit_ids, Vector2 p_target_world_pos) {
+    if (!flow_field_manager) return;
 
-        // 2. 将最后一个单位移动到要删除的位置
-        units[index_to_remove] = last_unit;
+    // PackedInt32Array 的存储就是连续的 int32，直接交给核心，不再逐个转换 Variant
+    const int* ids = p_unit_ids.ptr();
+    int count = (int)p_unit_ids.size();
+    sim::ReplayRecorder::get().record_command_move(ids, count, to_sim(p_target_world_pos));
+    core.command_units_to_move(ids, count, to_sim(p_target_world_pos));
+}
 
-        // 3. 更新被移动单位在哈希表中的索引
-        id_to_index[last_unit.id] = index_to_remove;
-    }
+sim::SelectionInput UnitManager::read_selection_input() const {
+    sim::SelectionInput input;
+    input.state = (sim::SelectionState)selection_manager->state;
+    input.mouse_position = to_sim(selection_manager->mouse_position);
+    input.selecting_box = to_sim(selection_manager->selecting_box);
+    input.selected_unit_id = selection_manager->selected_unit_id;
+    input.selected_type = selection_manager->selected_type;
+    return input;
+}
 
-    // 4. 删除 vector 最后一个元素，并从哈希表中移除目标 ID
-    units.pop_back();
-    id_to_index.erase(p_unit_id);
+void UnitManager::write_selection_output(const sim::SelectionInput& p_input) {
+    selection_manager->state = (SelectionManager::SelectionState)p_input.state;
+    selection_manager->selected_unit_id = p_input.selected_unit_id;
+    selection_manager->selected_type = p_input.selected_type;
 }
 
-void UnitManager::command_units_to_move(Array p_unit_ids, Vector2 p_target_world_pos) {
-    if (!flow_field_manager) return;
+double UnitManager::get_sim_step() const {
+    if (sim_rate > 0.0) return 1.0 / sim_rate;
+    return 1.0 / std::max(Engine::get_singleton()->get_physics_ticks_per_second(), 1);
+}
 
-    Vector2i target_grid_pos = flow_field_manager->world_to_grid(p_target_world_pos);
+void UnitManager::simulate_tick(double p_delta) {
+    sim::ReplayRecorder& recorder = sim::ReplayRecorder::get();
 
-    if (!(flow_field_manager->is_in_grid(target_grid_pos))) return;
+    update_lod_view();
 
-    flow_field_manager->create_flow_field(target_grid_pos, false);
+    sim::SelectionInput selection = read_selection_input();
+    recorder.record_tick_begin(p_delta, selection, core);
+    core.tick(p_delta, selection);
+    recorder.record_tick_end(selection, core);
+    write_selection_output(selection);
+    ++tick_count;
+}
 
-    for (int i = 0; i < p_unit_ids.size(); i++) {
-        int uid = p_unit_ids[i];
+// 性能分析的一帧对应一个显示帧，包含这一帧里跑的所有 tick 和渲染
+void UnitManager::_process(double p_delta) {
+    if (!is_setup || !flow_field_manager || !selection_manager) { return; }
 
-        // 使用哈希表直接定位
-        auto it = id_to_index.find(uid);
-        if (it != id_to_index.end()) {
-            UnitData& unit = units[it->second];
-            unit.target_pos = p_target_world_pos;
-            unit.target_grid = target_grid_pos;
-            unit.state = MOVING;
+    SIM_PROFILE_FRAME_BEGIN();
+
+    double step = get_sim_step();
+    if (is_replica) {
+        // 状态由 apply_replication 写入，假定快照按 tick 的频率到达
+        replica_elapsed += p_delta;
+        {
+            SIM_PROFILE_SCOPE(sim::PHASE_MULTIMESH);
+            update_multimesh_buffer(p_delta, (float)std::min(replica_elapsed / step, 1.0));
         }
+        SIM_PROFILE_FRAME_END();
+        return;
     }
-}
 
-void UnitManager::update_spatial_grid() {
-    for (int i = 0; i < unit_grid_size; ++i) {
-        unit_grid[i].clear();
+    sim_accumulator += p_delta;
+    int steps = 0;
+    while (sim_accumulator >= step && steps < max_sim_steps) {
+        simulate_tick(step);
+        sim_accumulator -= step;
+        ++steps;
+    }
+    if (sim_accumulator >= step) {
+        // 模拟追不上显示（卡顿或负载过高），放慢游戏时间而不是越积越多
+        sim_accumulator = std::fmod(sim_accumulator, step);
     }
-    for (int i = 0; i < units.size(); ++i) {
-        Vector2i rel_pos = flow_field_manager->world_to_relative(units[i].position);
 
-        // 缩放到单位网格（单位网格尺寸是流场的 2 倍）
-        int ux = rel_pos.x / 2;
-        int uy = rel_pos.y / 2;
+    {
+        SIM_PROFILE_SCOPE(sim::PHASE_MULTIMESH);
+        update_multimesh_buffer(p_delta, (float)(sim_accumulator / step));
+    }
+
+    SIM_PROFILE_FRAME_END();
+}
 
-        if (ux >= 0 && ux < unit_grid_width && uy >= 0 && uy < unit_grid_height) {
-            int grid_idx = uy * unit_grid_width + ux;
-            unit_grid[grid_idx].push_back(i);
+// 沿较短的方向插值角度（与 Godot 的 lerp_angle 相同）
+static float lerp_angle(float p_from, float p_to, float p_weight) {
+    float difference = std::fmod(p_to - p_from, (float)Math_TAU);
+    float distance = std::fmod(2.0f * difference, (float)Math_TAU) - difference;
+    return p_from + distance * p_weight;
+}
+
+Rect2 UnitManager::get_visible_world_rect() const {
+    // 可见区域从屏幕坐标换算到世界坐标（画布变换的逆）
+    Transform2D screen_to_world = get_canvas_transform().affine_inverse();
+    Rect2 screen = get_viewport_rect();
+    Vector2 a = screen_to_world.xform(screen.position);
+    Vector2 b = screen_to_world.xform(screen.position + screen.size);
+    Vector2 begin(std::min(a.x, b.x), std::min(a.y, b.y));
+    Vector2 end(std::max(a.x, b.x), std::max(a.y, b.y));
+    return Rect2(begin, end - begin);
+}
+
+void UnitManager::update_lod_view() {
+    if (!is_inside_tree()) return;
+    core.set_lod_view(to_sim(get_visible_world_rect()));
+}
+
+void UnitManager::update_multimesh_buffer(double p_delta, float p_alpha) {
+    if (!multimesh_instance) return;
+
+    Ref<MultiMesh> mesh_res = multimesh_instance->get_multimesh();
+    if (mesh_res.is_null()) return;
+
+    std::vector<UnitData>& units = core.units;
+    ++render_frame;
+
+    // 1. 只收集镜头附近的单位（按空间网格枚举），渲染开销与屏幕上的单位数成正比
+    render_indices.clear();
+    if (is_inside_tree()) {
+        Rect2 view = get_visible_world_rect().grow(render_margin);
+        core.collect_units_in_rect(to_sim(view), render_indices);
+    }
+    if ((int)unit_render_slots.size() < core.get_next_unit_id()) {
+        unit_render_slots.resize(core.get_next_unit_id(), -1);
+    }
+
+    // 2. 仍在视野内的单位保留原来的实例，新进入的稍后分配
+    new_render_units.clear();
+    for (int unit_idx : render_indices) {
+        int unit_id = units[unit_idx].id;
+        int slot = unit_render_slots[unit_id];
+        if (slot >= 0 && slot < (int)render_slots.size() && render_slots[slot].unit_id == unit_id) {
+            render_slots[slot].last_seen_frame = render_frame;
+        }
+        else {
+            new_render_units.push_back(unit_idx);
         }
     }
-}
 
-std::vector<int> UnitManager::get_nearby_units(Vector2 p_world_pos, float p_radius) {
-    std::vector<int> nearby_indices;
-    Vector2i rel_pos = flow_field_manager->world_to_relative(p_world_pos);
-    int ux = rel_pos.x / 2;
-    int uy = rel_pos.y / 2;
-    int dx = int(p_radius / unit_grid_cell_size.x) + 1;
-    int dy = int(p_radius / unit_grid_cell_size.y) + 1;
-
-    // 检查 3x3 范围内的格子
-    for (int nx = ux - dx; nx <= ux + dx; ++nx) {
-        for (int ny = uy - dy; ny <= uy + dy; ++ny) {
-            if (nx >= 0 && nx < unit_grid_width && ny >= 0 && ny < unit_grid_height) {
-                int grid_idx = ny * unit_grid_width + nx;
-                const auto& cell = unit_grid[grid_idx];
-                for (int unit_idx : cell) {
-                    if (p_world_pos.distance_squared_to(units[unit_idx].position) < p_radius * p_radius) {
-                        nearby_indices.push_back(unit_idx);
-                    }
-                }
-            }
+    // 3. 离开视野或已经死亡的单位让出实例：用最后一个实例填上空位，保持有效实例连续
+    for (int slot = (int)render_slots.size() - 1; slot >= 0; --slot) {
+        if (render_slots[slot].last_seen_frame == render_frame) continue;
+
+        int unit_id = render_slots[slot].unit_id;
+        if (unit_id >= 0 && unit_id < (int)unit_render_slots.size() && unit_render_slots[unit_id] == slot) {
+            unit_render_slots[unit_id] = -1;
+        }
+        int last = (int)render_slots.size() - 1;
+        if (slot != last) {
+            render_slots[slot] = render_slots[last];
+            render_slots[slot].is_written = false;
+            unit_render_slots[render_slots[slot].unit_id] = slot;
         }
+        render_slots.pop_back();
     }
-    return nearby_indices;
-}
 
-void UnitManager::_physics_process(double p_delta) {
-    if (!is_setup || !flow_field_manager || !selection_manager) { return; }
+    for (int unit_idx : new_render_units) {
+        RenderSlot slot;
+        slot.unit_id = units[unit_idx].id;
+        slot.last_seen_frame = render_frame;
+        unit_render_slots[slot.unit_id] = (int)render_slots.size();
+        render_slots.push_back(slot);
+    }
+    int render_count = (int)render_slots.size();
 
-    selection_manager->selected_unit_id = -1;
-    for (int unit_idx = 0; unit_idx < units.size(); ++unit_idx) {
-        UnitData& unit = units[unit_idx];
-        if (((selection_manager->mouse_position).distance_squared_to(unit.position) <
-            (unit.selection_radius) * (unit.selection_radius)) &&
-            (selection_manager->state != selection_manager->BOX_SELECTING)) {
-            unit.is_mouse_on = true;            
+    // 实例数只增不减（重新分配会清空缓冲区），多出来的部分用 visible_instance_count 隐藏
+    if (mesh_res->get_instance_count() < render_count) {
+        mesh_res->set_instance_count(std::max(render_count + render_count / 2, 256));
+        for (RenderSlot& slot : render_slots) {
+            slot.is_written = false;
         }
-        else {
-            unit.is_mouse_on = false;
+    }
+    if (mesh_res->get_visible_instance_count() != render_count) {
+        mesh_res->set_visible_instance_count(render_count);
+    }
+
+    // 4. 只写变化的部分：静止的单位不产生任何写入
+    for (int unit_idx : render_indices) {
+        const UnitData& unit = units[unit_idx];
+        int instance = unit_render_slots[unit.id];
+        RenderSlot& slot = render_slots[instance];
+
+        // 位置和朝向在上一 tick 与当前 tick 之间插值
+        float heading = lerp_angle(unit.previous_heading, unit.heading, p_alpha);
+        sim::Vec2 interpolated = unit.previous_position + (unit.position - unit.previous_position) * p_alpha;
+        Vector2 position = to_godot(interpolated);
+        int heading_bucket = (int)std::floor(heading / (float)Math_TAU * RENDER_HEADING_BUCKETS);
+
+        if (!slot.is_written || heading_bucket != slot.heading_bucket ||
+            position.distance_squared_to(slot.position) >= RENDER_POSITION_EPSILON * RENDER_POSITION_EPSILON) {
+            Transform2D xform;
+            xform.set_rotation(heading + (Math_PI / 2.0f));
+            xform.set_origin(position);
+            mesh_res->set_instance_transform_2d(instance, xform);
+            slot.position = position;
+            slot.heading_bucket = heading_bucket;
         }
-        if ((selection_manager->state == selection_manager->SINGLE_SELECTING) ||
-            (selection_manager->state == selection_manager->TYPE_SELECTING)) {
-            if (unit.is_mouse_on) {
-                selection_manager->selected_unit_id = unit.id;
-                selection_manager->selected_type = (int)(unit.type);
+
+        // 移动动画在第二行，待机动画在第一行
+        int row = unit.state == sim::MOVING ? 1 : 0;
+        if (!slot.is_written || row != slot.row) {
+            // 按 ID 错开动画相位，避免所有单位同步播放
+            float phase = (float)(((uint32_t)unit.id * 2654435761u) >> 8) / (float)(1 << 24);
+            // 我们利用 Color 的四个通道传递：x: 动画相位, y: 行索引, z: 预留, w: 预留
+            // 注意：在 Shader 中这对应 INSTANCE_CUSTOM
+            mesh_res->set_instance_custom_data(instance, Color(phase, float(row), 0, 0));
+            slot.row = row;
+        }
+
+        //处理颜色：0 普通，1 鼠标悬停，2 选中
+        int highlight = unit.is_mouse_on ? 1 : (unit.is_selected ? 2 : 0);
+        if (!slot.is_written || highlight != slot.highlight) {
+            Color display_color;
+            switch (highlight) {
+            case 1:
+                display_color = Color(1.2, 1.2, 1.2);
+                break;
+            case 2:
+                display_color = Color(1.5, 1.5, 1.5);
+                break;
+            default:
+                display_color = Color(1.0, 1.0, 1.0);
+                break;
             }
+            mesh_res->set_instance_color(instance, display_color);
+            slot.highlight = highlight;
         }
+
+        slot.is_written = true;
     }
+}
 
-    update_spatial_grid();
-    flow_field_manager->update(p_delta);
+Vector2 UnitManager::get_unit_position(int p_unit_id) const {
+    int index = core.get_unit_index(p_unit_id);
 
-    for (int unit_idx = 0; unit_idx < units.size(); ++unit_idx) {
-        UnitData& unit = units[unit_idx];
-        update_state(unit);
-        update_selection_state_and_target_position(unit);
-        update_velocity(unit, p_delta);
-        move(unit, p_delta);
-    }
-    if ((selection_manager->state == selection_manager->SINGLE_SELECTING) ||
-        (selection_manager->state == selection_manager->TYPE_SELECTING) ||
-        (selection_manager->state == selection_manager->BOX_SELECTION_ENDED) ||
-        (selection_manager->state == selection_manager->SELECTING_TARGET_POSITION)) {
-        selection_manager->state = selection_manager->NOT_SELECTING;
+    if (index != -1) {
+        return to_godot(core.units[index].position);
     }
 
-    update_multimesh_buffer(p_delta);
+    return Vector2(0, 0);
 }
 
-Vector2 UnitManager::get_flow(UnitData& p_unit) {
-    Vector2 flow = flow_field_manager->get_flow_direction(p_unit.position, p_unit.target_pos);
-    return flow;
+int UnitManager::get_unit_state(int p_unit_id) const {
+    int index = core.get_unit_index(p_unit_id);
+
+    if (index != -1) {
+        return (int)(core.units[index].state);
+    }
+
+    return (int)(IDLE);
 }
 
-Vector2 UnitManager::get_separation(UnitData& p_unit) {
-    bool is_IDLE = (p_unit.state == IDLE);
-    Vector2 separation = Vector2(0, 0);
+PackedVector2Array UnitManager::get_positions(const PackedInt32Array& p_unit_ids) const {
+    PackedVector2Array positions;
+    positions.resize(p_unit_ids.size());
+    const int32_t* ids = p_unit_ids.ptr();
+    Vector2* out = positions.ptrw();
 
-    for (int unit_idx : get_nearby_units(p_unit.position, p_unit.radius * separation_radius_factor)) {
-        const UnitData& nearby_unit = units[unit_idx];
-        Vector2 radius_vector = nearby_unit.position - p_unit.position;
-        float length_squared = radius_vector.length_squared();
-        if (length_squared < 10e-12) {
-            continue;
-        }
-        if (is_IDLE) {
-            if (nearby_unit.state == IDLE) {
-                separation -= radius_vector / length_squared;
-            }
-            else {
-                separation -= 2 * radius_vector / length_squared;
-            }
-        }
-        else {
-            if (nearby_unit.state == IDLE) {
-                separation -= 0.5 * radius_vector / length_squared;
-            }
-            else {
-                separation -= radius_vector / length_squared;
-            }
-        }
+    for (int64_t i = 0; i < p_unit_ids.size(); i++) {
+        int index = core.get_unit_index(ids[i]);
+        out[i] = index != -1 ? to_godot(core.units[index].position) : Vector2(0, 0);
     }
+    return positions;
+}
 
-    separation = separation.limit_length(separation_limit);
-    return separation;
+PackedInt32Array UnitManager::get_states(const PackedInt32Array& p_unit_ids) const {
+    PackedInt32Array states;
+    states.resize(p_unit_ids.size());
+    const int32_t* ids = p_unit_ids.ptr();
+    int32_t* out = states.ptrw();
+
+    for (int64_t i = 0; i < p_unit_ids.size(); i++) {
+        int index = core.get_unit_index(ids[i]);
+        out[i] = index != -1 ? (int32_t)core.units[index].state : (int32_t)IDLE;
+    }
+    return states;
 }
 
-Vector2 UnitManager::get_friction(UnitData& p_unit) {
-    return (-p_unit.velocity);
+PackedInt32Array UnitManager::get_all_unit_ids() const {
+    PackedInt32Array ids;
+    ids.resize(core.units.size());
+    int32_t* out = ids.ptrw();
+
+    for (size_t i = 0; i < core.units.size(); i++) {
+        out[i] = core.units[i].id;
+    }
+    return ids;
 }
 
-Vector2 UnitManager::get_force(UnitData& p_unit) {
-    Vector2 force = Vector2(0, 0);
-    switch (p_unit.state) {
-    case IDLE:
-        force = get_friction(p_unit) * friction_factor + get_separation(p_unit) * separation_factor;
-        break;
-    case MOVING:
-        force = get_flow(p_unit) * flow_factor + get_separation(p_unit) * separation_factor;
-        break;
+PackedVector2Array UnitManager::get_all_positions() const {
+    PackedVector2Array positions;
+    positions.resize(core.units.size());
+    Vector2* out = positions.ptrw();
+
+    for (size_t i = 0; i < core.units.size(); i++) {
+        out[i] = to_godot(core.units[i].position);
     }
-    return force;
+    return positions;
 }
 
-void UnitManager::update_state(UnitData& p_unit) {
-    switch (p_unit.state) {
-    case IDLE:
-        break;
-    case MOVING:
-        if (flow_field_manager->get_integration(p_unit.position, p_unit.target_pos) <= desired_integration) {
-            p_unit.state = IDLE;
-            p_unit.velocity = Vector2(0, 0);
-        }
-        break;
+static PackedInt32Array indices_to_ids(const std::vector<sim::UnitData>& p_units, const std::vector<int>& p_indices) {
+    PackedInt32Array ids;
+    ids.resize(p_indices.size());
+    int32_t* out = ids.ptrw();
+    for (size_t i = 0; i < p_indices.size(); i++) {
+        out[i] = p_units[p_indices[i]].id;
     }
+    return ids;
 }
 
-void UnitManager::update_velocity(UnitData& p_unit, double p_delta) {
-    Vector2 force = get_force(p_unit);
-    if (force.length_squared() < force_threshold_squared) {
-        force = Vector2(0, 0);
+PackedInt32Array UnitManager::query_units_in_rect(Rect2 p_rect) {
+    query_indices.clear();
+    core.collect_units_in_rect(to_sim(p_rect.abs()), query_indices);
+
+    return indices_to_ids(core.units, query_indices);
+}
+
+PackedInt32Array UnitManager::query_units_in_radius(Vector2 p_world_pos, float p_radius) {
+    query_indices.clear();
+    if (p_radius > 0.0f) {
+        core.collect_units_in_radius(to_sim(p_world_pos), p_radius, query_indices);
     }
-    
-    switch (p_unit.state) {
-    case IDLE:
-        p_unit.velocity += force * p_delta;
-        p_unit.velocity = (p_unit.velocity).limit_length(p_unit.speed);
-        break;
-    case MOVING:
-        p_unit.velocity += force * p_delta;
-        p_unit.velocity = (p_unit.velocity).limit_length(p_unit.speed);
-        break;
+
+    return indices_to_ids(core.units, query_indices);
+}
+
+float UnitManager::get_unit_health(int p_unit_id) const {
+    int index = core.get_unit_index(p_unit_id);
+
+    if (index != -1) {
+        return core.unit_health[index];
     }
 
-    if ((p_unit.velocity).length_squared() < velocity_threshold_squared) {
-        p_unit.velocity= Vector2(0, 0);
+    return 0.0f;
+}
+
+float UnitManager::get_unit_shield(int p_unit_id) const {
+    int index = core.get_unit_index(p_unit_id);
+
+    if (index != -1) {
+        return core.unit_shield[index];
     }
+
+    return 0.0f;
 }
 
-void UnitManager::move(UnitData& p_unit, double p_delta) {
-    p_unit.position += p_unit.velocity * p_delta;
-    if (p_unit.id == 1) {
-        UtilityFunctions::print(p_unit.velocity);
+int UnitManager::get_unit_team(int p_unit_id) const {
+    int index = core.get_unit_index(p_unit_id);
+
+    if (index != -1) {
+        return core.units[index].team;
     }
+
+    return 0;
 }
 
-void UnitManager::update_multimesh_buffer(double p_delta) {
-    if (!multimesh_instance) return;
+int UnitManager::find_nearest_enemy(Vector2 p_world_pos, int p_team, float p_radius) {
+    int index = core.find_nearest_enemy(to_sim(p_world_pos), p_team, p_radius);
+    return index != -1 ? core.units[index].id : -1;
+}
 
-    Ref<MultiMesh> mesh_res = multimesh_instance->get_multimesh();
-    if (mesh_res.is_null()) return;
+bool UnitManager::has_enemy_in_radius(Vector2 p_world_pos, int p_team, float p_radius) {
+    return core.has_enemy_in_radius(to_sim(p_world_pos), p_team, p_radius);
+}
 
-    int current_unit_count = units.size();
+int UnitManager::count_allies_in_radius(Vector2 p_world_pos, int p_team, float p_radius) {
+    return core.count_allies_in_radius(to_sim(p_world_pos), p_team, p_radius);
+}
+
+static sim::InfluenceWeights to_influence_weights(Vector4 p_weights) {
+    sim::InfluenceWeights weights;
+    weights.strength = p_weights.x;
+    weights.threat = p_weights.y;
+    weights.enemy_strength = p_weights.z;
+    weights.enemy_threat = p_weights.w;
+    return weights;
+}
+
+float UnitManager::get_influence(int p_team, Vector2 p_world_pos, Vector4 p_weights) const {
+    const sim::FlowFieldSystem* flow_fields = core.get_flow_field_system();
+    if (!flow_fields) return 0.0f;
+
+    sim::Vec2i grid_pos = flow_fields->world_to_grid(to_sim(p_world_pos));
+    return core.get_influence_map().get_score(p_team, to_influence_weights(p_weights), grid_pos);
+}
+
+Array UnitManager::find_influence_peaks(int p_team, Vector4 p_weights, int p_count, bool p_peaks_only) {
+    Array result;
+    const sim::FlowFieldSystem* flow_fields = core.get_flow_field_system();
+    if (!flow_fields) return result;
 
-    // 1. 如果单位数量变化，调整 MultiMesh 的实例数量
-    if (mesh_res->get_instance_count() != current_unit_count) {
-        mesh_res->set_instance_count(current_unit_count);
+    std::vector<sim::InfluenceCell> cells;
+    core.get_influence_map().find_top_cells(p_team, to_influence_weights(p_weights), p_count, p_peaks_only, cells);
+
+    sim::Vec2i cell_size = flow_fields->get_cell_size();
+    for (const sim::InfluenceCell& cell : cells) {
+        Dictionary peak;
+        peak["position"] = Vector2((cell.grid_pos.x + 0.5f) * cell_size.x, (cell.grid_pos.y + 0.5f) * cell_size.y);
+        peak["score"] = cell.score;
+        result.push_back(peak);
     }
+    return result;
+}
 
-    // 动画配置（可以做成成员变量）
-    float fps = 10.0f;           // 每秒 10 帧
-    int total_idle_frames = 2;   // 待机动画帧数
-    int total_move_frames = 2;   // 移动动画帧数
+bool UnitManager::start_replay_recording(const String& p_path, Node* p_building_manager) {
+    String path = ProjectSettings::get_singleton()->globalize_path(p_path);
+    sim::ReplayRecorder& recorder = sim::ReplayRecorder::get();
+    if (!recorder.start(path.utf8().get_data())) return false;
 
-    // 2. 遍历单位并更新变换矩阵
-    for (int i = 0; i < current_unit_count; ++i) {
-        UnitData& unit = units[i];
+    if (is_setup) {
+        BuildingManager* building_manager = Object::cast_to<BuildingManager>(p_building_manager);
+        recorder.record_current_state(flow_field_manager->get_core(), core,
+            building_manager ? &building_manager->get_core() : nullptr);
+    }
+    return true;
+}
 
-        // 创建变换矩阵：设置位置、旋转（可选）和缩放
-        // 注意：如果你需要单位朝向移动方向，可以利用 unit.velocity.angle()
-        Transform2D xform;
+void UnitManager::stop_replay_recording() {
+    sim::ReplayRecorder::get().stop();
+}
 
-        // 如果单位正在移动，旋转它以指向移动方向
-        if (unit.velocity.length_squared() > 0.1f) {
-            float rotation_angle = unit.velocity.angle() + (Math_PI / 2.0f);
-            xform.set_rotation(rotation_angle);
-        }
+bool UnitManager::is_recording_replay() const {
+    return sim::ReplayRecorder::get().is_recording();
+}
 
-        xform.set_origin(unit.position);
+sim::SimulationRefs UnitManager::get_simulation_refs(Node* p_building_manager) {
+    BuildingManager* building_manager = Object::cast_to<BuildingManager>(p_building_manager);
 
-        // 将变换应用到第 i 个实例
-        mesh_res->set_instance_transform_2d(i, xform);
+    sim::SimulationRefs refs;
+    refs.flow_fields = flow_field_manager ? &flow_field_manager->get_core() : nullptr;
+    refs.unit_types = &unit_types->get_table();
+    refs.units = &core;
+    refs.buildings = building_manager ? &building_manager->get_core() : nullptr;
+    return refs;
+}
 
-        //计算动画帧
-        int frame_index = 0;
-        int row_index = 0;
+bool UnitManager::save_snapshot(const String& p_path, Node* p_building_manager, bool p_include_flow_fields) {
+    if (!is_setup) return false;
 
-        if (unit.state == MOVING) {
-            frame_index = (int)(unit.anim_time * fps) % total_move_frames;
-            row_index = 1; // 移动动画在第二行
-        }
-        else {
-            frame_index = (int)(unit.anim_time * fps) % total_idle_frames;
-            row_index = 0; // 待机动画在第一行
-        }
+    String path = ProjectSettings::get_singleton()->globalize_path(p_path);
+    bool ok = sim::save_snapshot(path.utf8().get_data(), get_simulation_refs(p_building_manager), p_include_flow_fields);
+    if (!ok) {
+        UtilityFunctions::print("Error: Cannot write snapshot: ", p_path);
+    }
+    return ok;
+}
 
-        // 我们利用 Color 的四个通道传递：x: 帧索引, y: 行索引, z: 预留, w: 预留
-        // 注意：在 Shader 中这对应 INSTANCE_CUSTOM
-        mesh_res->set_instance_custom_data(i, Color(float(frame_index), float(row_index), 0, 0));
+bool UnitManager::load_snapshot(const String& p_path, Node* p_building_manager) {
+    if (!flow_field_manager) {
+        flow_field_manager = get_node<FlowFieldManager>("../FlowFieldManager");
+        if (!flow_field_manager) return false;
+    }
 
-        //处理颜色
-        Color display_color;
-        if (unit.is_selected) {
-            if (unit.is_mouse_on) {
-                display_color = Color(1.2, 1.2, 1.2);
-            }
-            else {
-                display_color = Color(1.5, 1.5, 1.5);
-            }
-        }
-        else {
-            if (unit.is_mouse_on) {
-                display_color = Color(1.2, 1.2, 1.2);
-            }
-            else {
-                display_color = Color(1.0, 1.0, 1.0);
-            }
-        }
-        mesh_res->set_instance_color(i, display_color);
-        
-        unit.anim_time += p_delta; // 更新动画计时器
+    String path = ProjectSettings::get_singleton()->globalize_path(p_path);
+    sim::SimulationRefs refs = get_simulation_refs(p_building_manager);
+    std::string error;
+    if (!sim::load_snapshot(path.utf8().get_data(), refs, error)) {
+        UtilityFunctions::print("Error: Cannot load snapshot: ", p_path, " (", error.c_str(), ")");
+        return false;
     }
+
+    is_setup = true;
+    return true;
 }
 
-void UnitManager::update_selection_state_and_target_position(UnitData& p_unit) {
-    switch (selection_manager->state) {
-    case (selection_manager->NOT_SELECTING):
-        break;
-    case (selection_manager->SINGLE_SELECTING):
-        if (selection_manager->selected_unit_id == -1) {
-            break;
-        }
-        else {
-            if (selection_manager->selected_unit_id == p_unit.id) {
-                p_unit.is_selected = !p_unit.is_selected;
-            }
-            else {
-                p_unit.is_selected = false;
-            }
-        }
-        break;
-    case (selection_manager->TYPE_SELECTING):
-        if (selection_manager->selected_unit_id == -1) {
-            break;
-        }
-        else {
-            if (selection_manager->selected_type == (int)(p_unit.type)) {
-                p_unit.is_selected = true;
-            }
-            else {
-                p_unit.is_selected = false;
-            }
-        }
-        break;
-    case (selection_manager->BOX_SELECTING):
-        if ((selection_manager->selecting_box).has_point(p_unit.position)) {
-            p_unit.is_mouse_on = true;
-        }
-        else {
-            p_unit.is_mouse_on = false;
-        }
-        break;
-    case (selection_manager->BOX_SELECTION_ENDED):
-        if ((selection_manager->selecting_box).has_point(p_unit.position)) {
-            p_unit.is_selected = true;
-        }
-        else {
-            p_unit.is_selected = false;
-        }
-        break;
-    case (selection_manager->SELECTING_TARGET_POSITION):
-        if (p_unit.is_selected) {
-            Vector2i target_grid_pos = flow_field_manager->world_to_grid(selection_manager->mouse_position);
-            flow_field_manager->create_flow_field(target_grid_pos, false);
-            p_unit.target_pos = selection_manager->mouse_position;
-            p_unit.target_grid = target_grid_pos;
-            p_unit.state = MOVING;
-        }
-        break;
+int UnitManager::add_replication_client() {
+    return replication_server.add_client();
+}
+
+void UnitManager::remove_replication_client(int p_client) {
+    replication_server.remove_client(p_client);
+}
+
+void UnitManager::set_replication_interest(int p_client, Rect2 p_interest) {
+    if (p_interest.has_area()) {
+        replication_server.set_client_interest(p_client, to_sim(p_interest));
+    }
+    else {
+        replication_server.clear_client_interest(p_client);
     }
 }
 
-Vector2 UnitManager::get_unit_position(int p_unit_id) const {
-    auto it = id_to_index.find(p_unit_id);
-    
-    if (it != id_to_index.end()) {
-        return units[it->second].position;
+PackedByteArray UnitManager::encode_replication(int p_client) {
+    PackedByteArray bytes;
+    if (!is_setup) return bytes;
+
+    replication_server.encode(p_client, core, tick_count, replication_packet);
+    bytes.resize(replication_packet.size());
+    if (!replication_packet.empty()) {
+        memcpy(bytes.ptrw(), replication_packet.data(), replication_packet.size());
     }
+    return bytes;
+}
 
-    return Vector2(0, 0);
+void UnitManager::acknowledge_replication(int p_client, int p_sequence) {
+    if (p_sequence <= 0) return;
+    replication_server.acknowledge(p_client, (uint32_t)p_sequence);
 }
 
-int UnitManager::get_unit_state(int p_unit_id) const {
-    auto it = id_to_index.find(p_unit_id);
+int UnitManager::apply_replication(const PackedByteArray& p_packet) {
+    if (!is_setup) return 0;
 
-    if (it != id_to_index.end()) {
-        return (int)(units[it->second].state);
+    std::string error;
+    if (!replication_client.decode(p_packet.ptr(), (size_t)p_packet.size(), error)) {
+        if (!error.empty()) {
+            UtilityFunctions::print("Error: Cannot apply replication packet (", error.c_str(), ")");
+        }
+        return 0;
     }
+    replication_client.apply(core);
+    replica_elapsed = 0.0;
+    return (int)replication_client.get_acknowledgement();
+}
 
-    return (int)(IDLE);
+bool UnitManager::is_profiling_enabled() const {
+#ifdef SIM_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+Dictionary UnitManager::get_profile_frames(int p_count) const {
+    std::vector<sim::ProfileFrame> frames;
+    sim::Profiler::get().get_frames(p_count, frames);
+
+    int count = (int)frames.size();
+    PackedInt64Array frame_ids;
+    PackedFloat64Array tick_ms;
+    frame_ids.resize(count);
+    tick_ms.resize(count);
+
+    Dictionary phases;
+    for (int phase = 0; phase < sim::PHASE_COUNT; ++phase) {
+        PackedFloat64Array phase_ms;
+        phase_ms.resize(count);
+        for (int i = 0; i < count; ++i) {
+            phase_ms.set(i, frames[i].phase_us[phase] / 1000.0);
+        }
+        phases[sim::get_phase_name(phase)] = phase_ms;
+    }
+
+    Dictionary counters;
+    for (int counter = 0; counter < sim::COUNTER_COUNT; ++counter) {
+        PackedInt64Array values;
+        values.resize(count);
+        for (int i = 0; i < count; ++i) {
+            values.set(i, frames[i].counters[counter]);
+        }
+        counters[sim::get_counter_name(counter)] = values;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        frame_ids.set(i, (int64_t)frames[i].frame);
+        tick_ms.set(i, (frames[i].end_us - frames[i].start_us) / 1000.0);
+    }
+
+    // 每一项都是按帧排列（由旧到新）的数组，时间单位为毫秒
+    Dictionary result;
+    result["enabled"] = is_profiling_enabled();
+    result["frames"] = frame_ids;
+    result["tick_ms"] = tick_ms;
+    result["phases"] = phases;
+    result["counters"] = counters;
+    return result;
+}
+
+bool UnitManager::dump_profile_trace(const String& p_path, int p_count) const {
+    String path = ProjectSettings::get_singleton()->globalize_path(p_path);
+    return sim::Profiler::get().write_chrome_trace(path.utf8().get_data(), p_count);
 }
 
 void UnitManager::set_multimesh_instance(Node* p_node) {
@@ -468,14 +678,46 @@ void UnitManager::_bind_methods() {
     BIND_ENUM_CONSTANT(SQUARE);
 
     ClassDB::bind_method(D_METHOD("setup_system", "width", "height", "cell_size", "grid_origin"), &UnitManager::setup_system);
-    ClassDB::bind_method(D_METHOD("spawn_unit", "world_position", "type"), &UnitManager::spawn_unit);
+    ClassDB::bind_method(D_METHOD("register_unit_type", "type", "stats"), &UnitManager::register_unit_type);
+    ClassDB::bind_method(D_METHOD("spawn_unit", "world_position", "type", "team"), &UnitManager::spawn_unit, DEFVAL(0));
     ClassDB::bind_method(D_METHOD("command_units_to_move", "unit_ids", "target_world_pos"), &UnitManager::command_units_to_move);
     ClassDB::bind_method(D_METHOD("get_unit_position", "unit_id"), &UnitManager::get_unit_position);
     ClassDB::bind_method(D_METHOD("get_unit_state", "unit_id"), &UnitManager::get_unit_state);
+    ClassDB::bind_method(D_METHOD("get_positions", "unit_ids"), &UnitManager::get_positions);
+    ClassDB::bind_method(D_METHOD("get_states", "unit_ids"), &UnitManager::get_states);
+    ClassDB::bind_method(D_METHOD("get_all_unit_ids"), &UnitManager::get_all_unit_ids);
+    ClassDB::bind_method(D_METHOD("get_all_positions"), &UnitManager::get_all_positions);
+    ClassDB::bind_method(D_METHOD("query_units_in_rect", "rect"), &UnitManager::query_units_in_rect);
+    ClassDB::bind_method(D_METHOD("query_units_in_radius", "world_position", "radius"), &UnitManager::query_units_in_radius);
+    ClassDB::bind_method(D_METHOD("apply_damage", "target_id", "attacker_id", "damage", "attack_type"), &UnitManager::apply_damage);
+    ClassDB::bind_method(D_METHOD("get_unit_health", "unit_id"), &UnitManager::get_unit_health);
+    ClassDB::bind_method(D_METHOD("get_unit_shield", "unit_id"), &UnitManager::get_unit_shield);
+    ClassDB::bind_method(D_METHOD("get_unit_team", "unit_id"), &UnitManager::get_unit_team);
+    ClassDB::bind_method(D_METHOD("find_nearest_enemy", "world_position", "team", "radius"), &UnitManager::find_nearest_enemy);
+    ClassDB::bind_method(D_METHOD("has_enemy_in_radius", "world_position", "team", "radius"), &UnitManager::has_enemy_in_radius);
+    ClassDB::bind_method(D_METHOD("count_allies_in_radius", "world_position", "team", "radius"), &UnitManager::count_allies_in_radius);
+    ClassDB::bind_method(D_METHOD("get_influence", "team", "world_position", "weights"), &UnitManager::get_influence);
+    ClassDB::bind_method(D_METHOD("find_influence_peaks", "team", "weights", "count", "peaks_only"), &UnitManager::find_influence_peaks, DEFVAL(8), DEFVAL(true));
+    ClassDB::bind_method(D_METHOD("start_replay_recording", "path", "building_manager"), &UnitManager::start_replay_recording, DEFVAL(Variant()));
+    ClassDB::bind_method(D_METHOD("stop_replay_recording"), &UnitManager::stop_replay_recording);
+    ClassDB::bind_method(D_METHOD("is_recording_replay"), &UnitManager::is_recording_replay);
+    ClassDB::bind_method(D_METHOD("save_snapshot", "path", "building_manager", "include_flow_fields"), &UnitManager::save_snapshot, DEFVAL(Variant()), DEFVAL(false));
+    ClassDB::bind_method(D_METHOD("load_snapshot", "path", "building_manager"), &UnitManager::load_snapshot, DEFVAL(Variant()));
+    ClassDB::bind_method(D_METHOD("add_replication_client"), &UnitManager::add_replication_client);
+    ClassDB::bind_method(D_METHOD("remove_replication_client", "client"), &UnitManager::remove_replication_client);
+    ClassDB::bind_method(D_METHOD("set_replication_interest", "client", "interest"), &UnitManager::set_replication_interest);
+    ClassDB::bind_method(D_METHOD("encode_replication", "client"), &UnitManager::encode_replication);
+    ClassDB::bind_method(D_METHOD("acknowledge_replication", "client", "sequence"), &UnitManager::acknowledge_replication);
+    ClassDB::bind_method(D_METHOD("apply_replication", "packet"), &UnitManager::apply_replication);
+    ClassDB::bind_method(D_METHOD("is_profiling_enabled"), &UnitManager::is_profiling_enabled);
+    ClassDB::bind_method(D_METHOD("get_profile_frames", "count"), &UnitManager::get_profile_frames, DEFVAL(60));
+    ClassDB::bind_method(D_METHOD("dump_profile_trace", "path", "count"), &UnitManager::dump_profile_trace, DEFVAL(sim::Profiler::CAPACITY));
     ClassDB::bind_method(D_METHOD("set_multimesh_instance", "node"), &UnitManager::set_multimesh_instance);
     ClassDB::bind_method(D_METHOD("set_flow_field_manager", "node"), &UnitManager::set_flow_field_manager);
     ClassDB::bind_method(D_METHOD("set_selection_manager", "node"), &UnitManager::set_selection_manager);
 
+    ADD_SIGNAL(MethodInfo("units_died", PropertyInfo(Variant::PACKED_INT32_ARRAY, "unit_ids")));
+
     //调试
     // 1. 先绑定所有方法 (Getter/Setter)
     ClassDB::bind_method(D_METHOD("get_unit_speed"), &UnitManager::get_unit_speed);
@@ -502,6 +744,63 @@ void UnitManager::_bind_methods() {
     ClassDB::bind_method(D_METHOD("get_friction_factor"), &UnitManager::get_friction_factor);
     ClassDB::bind_method(D_METHOD("set_friction_factor", "p_val"), &UnitManager::set_friction_factor);
 
+    ClassDB::bind_method(D_METHOD("get_wall_repulsion_factor"), &UnitManager::get_wall_repulsion_factor);
+    ClassDB::bind_method(D_METHOD("set_wall_repulsion_factor", "p_val"), &UnitManager::set_wall_repulsion_factor);
+
+    ClassDB::bind_method(D_METHOD("get_wall_repulsion_range_factor"), &UnitManager::get_wall_repulsion_range_factor);
+    ClassDB::bind_method(D_METHOD("set_wall_repulsion_range_factor", "p_val"), &UnitManager::set_wall_repulsion_range_factor);
+
+    ClassDB::bind_method(D_METHOD("get_wall_cost"), &UnitManager::get_wall_cost);
+    ClassDB::bind_method(D_METHOD("set_wall_cost", "p_val"), &UnitManager::set_wall_cost);
+
+    ClassDB::bind_method(D_METHOD("get_congestion_factor"), &UnitManager::get_congestion_factor);
+    ClassDB::bind_method(D_METHOD("set_congestion_factor", "p_val"), &UnitManager::set_congestion_factor);
+
+    ClassDB::bind_method(D_METHOD("get_avoidance_mode"), &UnitManager::get_avoidance_mode);
+    ClassDB::bind_method(D_METHOD("set_avoidance_mode", "p_val"), &UnitManager::set_avoidance_mode);
+
+    ClassDB::bind_method(D_METHOD("get_orca_max_neighbours"), &UnitManager::get_orca_max_neighbours);
+    ClassDB::bind_method(D_METHOD("set_orca_max_neighbours", "p_val"), &UnitManager::set_orca_max_neighbours);
+
+    ClassDB::bind_method(D_METHOD("get_orca_time_horizon"), &UnitManager::get_orca_time_horizon);
+    ClassDB::bind_method(D_METHOD("set_orca_time_horizon", "p_val"), &UnitManager::set_orca_time_horizon);
+
+    ClassDB::bind_method(D_METHOD("get_orca_neighbour_radius_factor"), &UnitManager::get_orca_neighbour_radius_factor);
+    ClassDB::bind_method(D_METHOD("set_orca_neighbour_radius_factor", "p_val"), &UnitManager::set_orca_neighbour_radius_factor);
+
+    ClassDB::bind_method(D_METHOD("get_render_margin"), &UnitManager::get_render_margin);
+    ClassDB::bind_method(D_METHOD("set_render_margin", "p_val"), &UnitManager::set_render_margin);
+
+    ClassDB::bind_method(D_METHOD("get_sim_rate"), &UnitManager::get_sim_rate);
+    ClassDB::bind_method(D_METHOD("set_sim_rate", "p_val"), &UnitManager::set_sim_rate);
+
+    ClassDB::bind_method(D_METHOD("get_max_sim_steps"), &UnitManager::get_max_sim_steps);
+    ClassDB::bind_method(D_METHOD("set_max_sim_steps", "p_val"), &UnitManager::set_max_sim_steps);
+
+    ClassDB::bind_method(D_METHOD("get_lod_enabled"), &UnitManager::get_lod_enabled);
+    ClassDB::bind_method(D_METHOD("set_lod_enabled", "p_val"), &UnitManager::set_lod_enabled);
+
+    ClassDB::bind_method(D_METHOD("get_lod_view_margin"), &UnitManager::get_lod_view_margin);
+    ClassDB::bind_method(D_METHOD("set_lod_view_margin", "p_val"), &UnitManager::set_lod_view_margin);
+
+    ClassDB::bind_method(D_METHOD("get_lod_half_distance"), &UnitManager::get_lod_half_distance);
+    ClassDB::bind_method(D_METHOD("set_lod_half_distance", "p_val"), &UnitManager::set_lod_half_distance);
+
+    ClassDB::bind_method(D_METHOD("get_lod_contact_density"), &UnitManager::get_lod_contact_density);
+    ClassDB::bind_method(D_METHOD("set_lod_contact_density", "p_val"), &UnitManager::set_lod_contact_density);
+
+    ClassDB::bind_method(D_METHOD("get_influence_enabled"), &UnitManager::get_influence_enabled);
+    ClassDB::bind_method(D_METHOD("set_influence_enabled", "p_val"), &UnitManager::set_influence_enabled);
+
+    ClassDB::bind_method(D_METHOD("get_influence_strength_decay"), &UnitManager::get_influence_strength_decay);
+    ClassDB::bind_method(D_METHOD("set_influence_strength_decay", "p_val"), &UnitManager::set_influence_strength_decay);
+
+    ClassDB::bind_method(D_METHOD("get_influence_threat_decay"), &UnitManager::get_influence_threat_decay);
+    ClassDB::bind_method(D_METHOD("set_influence_threat_decay", "p_val"), &UnitManager::set_influence_threat_decay);
+
+    ClassDB::bind_method(D_METHOD("get_influence_cell_budget"), &UnitManager::get_influence_cell_budget);
+    ClassDB::bind_method(D_METHOD("set_influence_cell_budget", "p_val"), &UnitManager::set_influence_cell_budget);
+
     ClassDB::bind_method(D_METHOD("get_force_threshold_squared"), &UnitManager::get_force_threshold_squared);
     ClassDB::bind_method(D_METHOD("set_force_threshold_squared", "p_val"), &UnitManager::set_force_threshold_squared);
 
@@ -511,6 +810,9 @@ void UnitManager::_bind_methods() {
     ClassDB::bind_method(D_METHOD("get_desired_integration"), &UnitManager::get_desired_integration);
     ClassDB::bind_method(D_METHOD("set_desired_integration", "p_val"), &UnitManager::set_desired_integration);
 
+    ClassDB::bind_method(D_METHOD("get_replica"), &UnitManager::get_replica);
+    ClassDB::bind_method(D_METHOD("set_replica", "p_val"), &UnitManager::set_replica);
+
     // 2. 注册属性到 Godot 属性面板
 
     ADD_GROUP("Unit Defaults", "unit_");
@@ -524,6 +826,36 @@ void UnitManager::_bind_methods() {
     ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "separation_limit"), "set_separation_limit", "get_separation_limit");
     ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "separation_radius_factor"), "set_separation_radius_factor", "get_separation_radius_factor");
     ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "friction_factor"), "set_friction_factor", "get_friction_factor");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "wall_repulsion_factor"), "set_wall_repulsion_factor", "get_wall_repulsion_factor");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "wall_repulsion_range_factor"), "set_wall_repulsion_range_factor", "get_wall_repulsion_range_factor");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "congestion_factor"), "set_congestion_factor", "get_congestion_factor");
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "wall_cost", PROPERTY_HINT_RANGE, "1,255"), "set_wall_cost", "get_wall_cost");
+
+    ADD_GROUP("Avoidance Settings", "");
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "avoidance_mode", PROPERTY_HINT_ENUM, "Forces,ORCA"), "set_avoidance_mode", "get_avoidance_mode");
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "orca_max_neighbours"), "set_orca_max_neighbours", "get_orca_max_neighbours");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "orca_time_horizon"), "set_orca_time_horizon", "get_orca_time_horizon");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "orca_neighbour_radius_factor"), "set_orca_neighbour_radius_factor", "get_orca_neighbour_radius_factor");
+
+    ADD_GROUP("Render Settings", "render_");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "render_margin"), "set_render_margin", "get_render_margin");
+
+    ADD_GROUP("Simulation Settings", "");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "sim_rate", PROPERTY_HINT_RANGE, "0,240,1,suffix:Hz"), "set_sim_rate", "get_sim_rate");
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "max_sim_steps", PROPERTY_HINT_RANGE, "1,16"), "set_max_sim_steps", "get_max_sim_steps");
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "replica"), "set_replica", "get_replica");
+
+    ADD_GROUP("LOD Settings", "lod_");
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "lod_enabled"), "set_lod_enabled", "get_lod_enabled");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "lod_view_margin"), "set_lod_view_margin", "get_lod_view_margin");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "lod_half_distance"), "set_lod_half_distance", "get_lod_half_distance");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "lod_contact_density"), "set_lod_contact_density", "get_lod_contact_density");
+
+    ADD_GROUP("Influence Settings", "influence_");
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "influence_enabled"), "set_influence_enabled", "get_influence_enabled");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "influence_strength_decay", PROPERTY_HINT_RANGE, "0,0.99,0.01"), "set_influence_strength_decay", "get_influence_strength_decay");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "influence_threat_decay", PROPERTY_HINT_RANGE, "0,0.99,0.01"), "set_influence_threat_decay", "get_influence_threat_decay");
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "influence_cell_budget"), "set_influence_cell_budget", "get_influence_cell_budget");
 
     ADD_GROUP("Threshold Settings", "");
     ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "force_threshold_squared"), "set_force_threshold_squared", "get_force_threshold_squared");
@@ -1,24 +1,36 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
 
 #include <godot_cpp/classes/node2d.hpp>
 #include <godot_cpp/variant/vector2.hpp>
 #include <godot_cpp/variant/vector2i.hpp>
+#include <godot_cpp/variant/vector4.hpp>
 #include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_vector2_array.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
 #include <godot_cpp/classes/multi_mesh_instance2d.hpp>
 #include <godot_cpp/classes/multi_mesh.hpp>
 
 #include "flow_field_manager.h"
 #include "selection_manager.h"
+#include "unit_type_registry.h"
+#include "game_definitions.h"
+#include "core/unit_system.h"
+#include "core/simulation_refs.h"
+#include "core/replication.h"
 
 namespace godot {
 
+	// 单位管理器：对模拟核心 sim::UnitSystem 的薄封装
+	// 负责选择输入、渲染 (MultiMesh) 和向 GDScript 暴露接口
 	class UnitManager : public Node2D {
 		GDCLASS(UnitManager, Node2D)
 
 	public:
+		// 与 sim::UnitState 的顺序一致
 		enum UnitState {
 			IDLE,        // 待机
 			MOVING,      // 移动中
@@ -28,60 +40,78 @@ namespace godot {
 			SQUARE
 		};
 
-		//这三个参数是为了调试而设的
+		//这三个参数是为了调试而设的（作为未绑定 UnitStats 的类型的默认值）
 		float unit_speed = 200.0f;
 		float unit_radius = 28.0f;
 		float unit_selection_radius = 32.0f;
 
-		struct UnitData {
-			int id;                 // 唯一标识符
-			Vector2 position;       // 当前世界坐标
-			Vector2 velocity;       // 当前速度向量
-			Vector2 target_pos;		//目标的世界坐标
-			Vector2i target_grid;   // 目标的网格坐标（与流场坐标一致，不同于unit_grid中的坐标）
-			float speed;            // 移动速度
-			float radius;           // 碰撞半径（用于单位间排斥）
-			UnitState state;        // 状态机
-			UnitType type;			// 单位种类
-			
-			bool is_selected = false;
-			bool is_mouse_on = false;
-			float selection_radius;
-
-			float anim_time = 0.0f; // 累计播放时间
-
-			UnitData() : id(-1), speed(200.0f), radius(28.0f), state(IDLE), selection_radius(32.0f) {}
-		};
+		typedef sim::UnitData UnitData;
 
 	private:
 		FlowFieldManager *flow_field_manager;
 		SelectionManager *selection_manager;
-		std::unordered_map<int, size_t> id_to_index;
-		int next_unit_id = 0;
-
-		// --- 空间网格 (Unit Grid) ---
-		// 每一个格子存储该区域内的单位在 units 数组中的索引(index)
-		// 使用 1D 数组模拟 2D 网格：unit_grid[y * width + x]
-		// 格子的尺寸是流场中格子的两倍
-		std::vector<std::vector<int>> unit_grid;
-
-		int unit_grid_width = 0;
-		int unit_grid_height = 0;
-		int unit_grid_size = 0;
-		Vector2i unit_grid_cell_size = Vector2i(0, 0);
-
-		float flow_factor = 2000.0f;
-		float separation_factor = 10000.0f;
-		float separation_radius_factor = 3.0f;		//排斥力半径与单位半径的比值
-		float separation_limit = 1000.0f;
-		float friction_factor = 100.0f;
-		float force_threshold_squared = 1.0f;
-		float velocity_threshold_squared = 1.0f;
-		float desired_integration = 0.1f;
+		UnitTypeRegistry *unit_types;
+
+		sim::UnitSystem core;
 
 		bool is_setup = false;
 		MultiMeshInstance2D* multimesh_instance = nullptr;
 
+		// --- 固定步长模拟 ---
+		// 模拟以 sim_rate 的固定步长运行（0 表示与物理帧率相同），渲染每个显示帧在两个 tick 之间插值
+		double sim_rate = 0.0;
+		int max_sim_steps = 4;          // 每个显示帧最多追赶的 tick 数，超出的时间直接丢弃
+		double sim_accumulator = 0.0;   // 尚未模拟的时间
+
+		double get_sim_step() const;
+		void simulate_tick(double p_delta);
+		uint32_t tick_count = 0;
+
+		// --- 状态同步 ---
+		// 服务端：每个客户端一份已发送快照的历史，按客户端确认过的快照差分编码
+		// 客户端（replica 为 true）：本地不模拟，单位状态全部来自 apply_replication，渲染在两次快照之间插值
+		sim::ReplicationServer replication_server;
+		sim::ReplicationClient replication_client;
+		std::vector<uint8_t> replication_packet;
+		bool is_replica = false;
+		double replica_elapsed = 0.0;   // 距上一次应用快照的时间
+
+		// SelectionManager 与模拟核心之间的输入输出拷贝
+		sim::SelectionInput read_selection_input() const;
+		void write_selection_output(const sim::SelectionInput& p_input);
+
+		sim::SimulationRefs get_simulation_refs(Node* p_building_manager);
+
+		// 当前镜头看到的世界矩形
+		Rect2 get_visible_world_rect() const;
+		// 把镜头矩形交给模拟核心，决定单位的 LOD 级别
+		void update_lod_view();
+
+		// --- 渲染 ---
+		float render_margin = 128.0f;       // 镜头外这个距离内的单位也写入 MultiMesh（单位贴图的大小）
+		std::vector<int> render_indices;    // 本帧要渲染的单位下标
+		std::vector<int> query_indices;     // 批量查询复用的下标数组
+
+		// 每个可见单位在可见期间固定占用一个 MultiMesh 实例，只有写入的内容变化时才重新写
+		// 动画帧由 shader 根据 TIME 和实例的相位计算，CPU 不再每帧推进
+		struct RenderSlot {
+			int unit_id = -1;
+			uint64_t last_seen_frame = 0;
+			bool is_written = false;        // 实例缓冲区被重新分配或换了单位后需要整体重写
+			Vector2 position;               // 上次写入的值
+			int heading_bucket = 0;
+			int row = 0;
+			int highlight = 0;
+		};
+		std::vector<RenderSlot> render_slots;   // 下标即实例下标，前 visible_instance_count 个有效
+		std::vector<int> unit_render_slots;     // 按单位 ID 索引，-1 表示不在屏幕上
+		std::vector<int> new_render_units;      // 本帧刚进入视野的单位下标
+		uint64_t render_frame = 0;
+
+		// 位置变化小于这个值（像素）且朝向在同一个桶内时不重写变换
+		const float RENDER_POSITION_EPSILON = 0.25f;
+		const int RENDER_HEADING_BUCKETS = 128;
+
 	protected:
 		static void _bind_methods();
 
@@ -89,78 +119,192 @@ namespace godot {
 		UnitManager();
 		~UnitManager();
 
-		std::vector<UnitData> units;
+		sim::UnitSystem& get_core() { return core; }
 
 		// --- 系统管理 ---
 		void setup_system(int p_width, int p_height, Vector2i p_cell_size, Vector2i p_origin);
 
+		// --- 单位类型 ---
+		void register_unit_type(UnitType p_type, Ref<UnitStats> p_stats);
+		void ensure_unit_type(UnitType p_type);
+		void apply_unit_defaults();
+
 		// --- 单位生命周期 ---
-		int spawn_unit(Vector2 p_world_pos, UnitType p_type);
+		int spawn_unit(Vector2 p_world_pos, UnitType p_type, int p_team = 0);
 		void despawn_unit(int p_unit_id);
-		void command_units_to_move(Array p_unit_ids, Vector2 p_target_world_pos);
+		void command_units_to_move(const PackedInt32Array& p_unit_ids, Vector2 p_target_world_pos);
 
-		// --- 空间网格核心操作 ---
-		void update_spatial_grid();
-		std::vector<int> get_nearby_units(Vector2 p_world_pos, float p_radius);
+		// --- 伤害 ---
+		// 只追加命中记录，在本 tick 末尾统一结算
+		void apply_damage(int p_target_id, int p_attacker_id, float p_damage, AttackType p_attack_type);
 
 		// --- 核心循环 ---
-		virtual void _physics_process(double p_delta) override;
-
-		// --- 逻辑计算 ---
-		Vector2 get_flow(UnitData& p_unit);
-		Vector2 get_separation(UnitData& p_unit);
-		Vector2 get_friction(UnitData& p_unit);
-		Vector2 get_force(UnitData& p_unit);
-		void update_state(UnitData& p_unit);
-		void update_velocity(UnitData& p_unit, double p_delta);
-		void move(UnitData& p_unit, double p_delta);
+		virtual void _process(double p_delta) override;
 
-		void update_multimesh_buffer(double p_delta);
-
-		void update_selection_state_and_target_position(UnitData& p_unit);
+		// p_alpha：当前显示时刻在上一 tick 与当前 tick 之间的位置（0 ~ 1）
+		void update_multimesh_buffer(double p_delta, float p_alpha);
 
 		// 获取数据供 Godot 渲染
 		Vector2 get_unit_position(int p_unit_id) const;
 		int get_unit_state(int p_unit_id) const;
+		float get_unit_health(int p_unit_id) const;
+		float get_unit_shield(int p_unit_id) const;
+		int get_unit_team(int p_unit_id) const;
+
+		// --- 批量查询：一次调用返回整组数据，脚本每帧不必逐个单位调用 ---
+		// 与 p_unit_ids 一一对应，不存在的 ID 位置为 (0, 0)、状态为 IDLE
+		PackedVector2Array get_positions(const PackedInt32Array& p_unit_ids) const;
+		PackedInt32Array get_states(const PackedInt32Array& p_unit_ids) const;
+		// 所有存活单位的 ID 和位置，两个数组顺序相同
+		PackedInt32Array get_all_unit_ids() const;
+		PackedVector2Array get_all_positions() const;
+		// 位置在矩形内 / 半径内的单位 ID，只枚举覆盖到的空间网格格子
+		PackedInt32Array query_units_in_rect(Rect2 p_rect);
+		PackedInt32Array query_units_in_radius(Vector2 p_world_pos, float p_radius);
+
+		// --- 按阵营查询（敌方是 p_team 以外的所有阵营） ---
+		// 半径内最近的敌方单位 ID，没有时返回 -1
+		int find_nearest_enemy(Vector2 p_world_pos, int p_team, float p_radius);
+		bool has_enemy_in_radius(Vector2 p_world_pos, int p_team, float p_radius);
+		int count_allies_in_radius(Vector2 p_world_pos, int p_team, float p_radius);
+
+		// --- 影响力图 ---
+		// p_weights 依次是本方实力、本方威胁、敌方实力、敌方威胁的权重，敌方为其他所有阵营之和
+		float get_influence(int p_team, Vector2 p_world_pos, Vector4 p_weights) const;
+		// 打分最高的 p_count 个格子，由高到低，每项为 { "position": 格子中心的世界坐标, "score": 打分 }
+		Array find_influence_peaks(int p_team, Vector4 p_weights, int p_count, bool p_peaks_only);
+		// --- 回放录制 ---
+		// 在 setup_system 之前开始录制可以得到完整的初始状态；之后开始则先写入当前状态的快照
+		bool start_replay_recording(const String& p_path, Node* p_building_manager = nullptr);
+		void stop_replay_recording();
+		bool is_recording_replay() const;
+
+		// --- 状态同步 ---
+		// 返回客户端 ID；数据包的传输（UDP、本地回环等）由脚本负责
+		int add_replication_client();
+		void remove_replication_client(int p_client);
+		// 只同步关注区域（世界坐标）内的单位，大小为零时同步所有单位
+		void set_replication_interest(int p_client, Rect2 p_interest);
+		// 编码当前状态，客户端无效时返回空数组
+		PackedByteArray encode_replication(int p_client);
+		void acknowledge_replication(int p_client, int p_sequence);
+		// 客户端：解码并应用数据包，返回应当回复给服务端的确认序号；包过期或无效时返回 0
+		int apply_replication(const PackedByteArray& p_packet);
+
+		void set_replica(bool p_val) { is_replica = p_val; replica_elapsed = 0.0; replication_client.reset(); }
+		bool get_replica() const { return is_replica; }
+
+		// --- 存档 ---
+		// 整局状态（单位、代价地图、建筑，可选地包括已经算好的流场）的二进制存档
+		bool save_snapshot(const String& p_path, Node* p_building_manager = nullptr, bool p_include_flow_fields = false);
+		bool load_snapshot(const String& p_path, Node* p_building_manager = nullptr);
+
+		// --- 性能分析 (需要以 SIM_PROFILING 编译) ---
+		bool is_profiling_enabled() const;
+		Dictionary get_profile_frames(int p_count) const;
+		bool dump_profile_trace(const String& p_path, int p_count) const;
+
 		void set_multimesh_instance(Node* p_node);
 		void set_flow_field_manager(Node* p_node);
 		void set_selection_manager(Node* p_node);
 
 		//调试
-		void set_unit_speed(float p_val) { unit_speed = p_val; }
+		void set_unit_speed(float p_val) { unit_speed = p_val; apply_unit_defaults(); }
 		float get_unit_speed() const { return unit_speed; }
 
-		void set_unit_radius(float p_val) { unit_radius = p_val; }
+		void set_unit_radius(float p_val) { unit_radius = p_val; apply_unit_defaults(); }
 		float get_unit_radius() const { return unit_radius; }
 
-		void set_unit_selection_radius(float p_val) { unit_selection_radius = p_val; }
+		void set_unit_selection_radius(float p_val) { unit_selection_radius = p_val; apply_unit_defaults(); }
 		float get_unit_selection_radius() const { return unit_selection_radius; }
 
-		void set_flow_factor(float p_val) { flow_factor = p_val; }
-		float get_flow_factor() const { return flow_factor; }
+		void set_flow_factor(float p_val) { core.flow_factor = p_val; }
+		float get_flow_factor() const { return core.flow_factor; }
+
+		void set_separation_factor(float p_val) { core.separation_factor = p_val; }
+		float get_separation_factor() const { return core.separation_factor; }
+
+		void set_separation_limit(float p_val) { core.separation_limit = p_val; }
+		float get_separation_limit() const { return core.separation_limit; }
+
+		void set_separation_radius_factor(float p_val) { core.separation_radius_factor = p_val; }
+		float get_separation_radius_factor() const { return core.separation_radius_factor; }
+
+		void set_friction_factor(float p_val) { core.friction_factor = p_val; }
+		float get_friction_factor() const { return core.friction_factor; }
+
+		void set_wall_repulsion_factor(float p_val) { core.wall_repulsion_factor = p_val; }
+		float get_wall_repulsion_factor() const { return core.wall_repulsion_factor; }
+
+		void set_wall_repulsion_range_factor(float p_val) { core.wall_repulsion_range_factor = p_val; }
+		float get_wall_repulsion_range_factor() const { return core.wall_repulsion_range_factor; }
+
+		// 有效代价不小于这个值的格子按墙处理（单位会被挡住）
+		void set_wall_cost(int p_val) { core.get_obstacle_field().set_obstacle_cost((uint8_t)std::max(1, std::min(p_val, 255))); }
+		int get_wall_cost() const { return core.get_obstacle_field().get_obstacle_cost(); }
+
+		// 0 表示关闭拥挤绕行
+		void set_congestion_factor(float p_val) { core.get_congestion_field().weight = p_val; }
+		float get_congestion_factor() const { return core.get_congestion_field().weight; }
+
+		// 0 为力模型，1 为 ORCA（与 sim::AvoidanceMode 一致）
+		// ORCA 只用来减少单位重叠，不能减少抖动：转向更频繁，耗时约为力模型的两倍
+		void set_avoidance_mode(int p_val) { core.avoidance_mode = (sim::AvoidanceMode)std::max(0, std::min(p_val, (int)sim::AVOIDANCE_ORCA)); }
+		int get_avoidance_mode() const { return core.avoidance_mode; }
+
+		void set_orca_max_neighbours(int p_val) { core.orca_max_neighbours = std::max(p_val, 0); }
+		int get_orca_max_neighbours() const { return core.orca_max_neighbours; }
+
+		void set_orca_time_horizon(float p_val) { core.orca_time_horizon = std::max(p_val, 0.01f); }
+		float get_orca_time_horizon() const { return core.orca_time_horizon; }
+
+		void set_orca_neighbour_radius_factor(float p_val) { core.orca_neighbour_radius_factor = p_val; }
+		float get_orca_neighbour_radius_factor() const { return core.orca_neighbour_radius_factor; }
+
+		void set_render_margin(float p_val) { render_margin = std::max(p_val, 0.0f); }
+		float get_render_margin() const { return render_margin; }
+
+		void set_sim_rate(double p_val) { sim_rate = std::max(p_val, 0.0); }
+		double get_sim_rate() const { return sim_rate; }
+
+		void set_max_sim_steps(int p_val) { max_sim_steps = std::max(p_val, 1); }
+		int get_max_sim_steps() const { return max_sim_steps; }
+
+		void set_lod_enabled(bool p_val) { core.lod_enabled = p_val; }
+		bool get_lod_enabled() const { return core.lod_enabled; }
+
+		void set_lod_view_margin(float p_val) { core.lod_view_margin = std::max(p_val, 0.0f); }
+		float get_lod_view_margin() const { return core.lod_view_margin; }
+
+		void set_lod_half_distance(float p_val) { core.lod_half_distance = std::max(p_val, 0.0f); }
+		float get_lod_half_distance() const { return core.lod_half_distance; }
+
+		// 0 表示不按拥挤程度提升级别
+		void set_lod_contact_density(float p_val) { core.lod_contact_density = std::max(p_val, 0.0f); }
+		float get_lod_contact_density() const { return core.lod_contact_density; }
 
-		void set_separation_factor(float p_val) { separation_factor = p_val; }
-		float get_separation_factor() const { return separation_factor; }
+		void set_influence_enabled(bool p_val) { core.influence_enabled = p_val; }
+		bool get_influence_enabled() const { return core.influence_enabled; }
 
-		void set_separation_limit(float p_val) { separation_limit = p_val; }
-		float get_separation_limit() const { return separation_limit; }
+		void set_influence_strength_decay(float p_val) { core.get_influence_map().strength_decay = p_val; }
+		float get_influence_strength_decay() const { return core.get_influence_map().strength_decay; }
 
-		void set_separation_radius_factor(float p_val) { separation_radius_factor = p_val; }
-		float get_separation_radius_factor() const { return separation_radius_factor; }
+		void set_influence_threat_decay(float p_val) { core.get_influence_map().threat_decay = p_val; }
+		float get_influence_threat_decay() const { return core.get_influence_map().threat_decay; }
 
-		void set_friction_factor(float p_val) { friction_factor = p_val; }
-		float get_friction_factor() const { return friction_factor; }
+		void set_influence_cell_budget(int p_val) { core.get_influence_map().cell_budget = p_val; }
+		int get_influence_cell_budget() const { return core.get_influence_map().cell_budget; }
 
-		void set_force_threshold_squared(float p_val) { force_threshold_squared = p_val; }
-		float get_force_threshold_squared() const { return force_threshold_squared; }
+		void set_force_threshold_squared(float p_val) { core.force_threshold_squared = p_val; }
+		float get_force_threshold_squared() const { return core.force_threshold_squared; }
 
-		void set_velocity_threshold_squared(float p_val) { velocity_threshold_squared = p_val; }
-		float get_velocity_threshold_squared() const { return velocity_threshold_squared; }
+		void set_velocity_threshold_squared(float p_val) { core.velocity_threshold_squared = p_val; }
+		float get_velocity_threshold_squared() const { return core.velocity_threshold_squared; }
 
-		void set_desired_integration(float p_val) { desired_integration = p_val; }
-		float get_desired_integration() const { return desired_integration; }
+		void set_desired_integration(float p_val) { core.desired_integration = p_val; }
+		float get_desired_integration() const { return core.desired_integration; }
 	};
 }
 
 VARIANT_ENUM_CAST(UnitManager::UnitState);
-VARIANT_ENUM_CAST(UnitManager::UnitType);
\ No newline at end of file
+VARIANT_ENUM_CAST(UnitManager::UnitType);
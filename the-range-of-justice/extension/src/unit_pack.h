@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "unit_type_registry.h"
+
+namespace godot {
+
+    // 二进制单位定义包 (.upak) 的文件格式
+    // [UnitPackHeader][UnitPackEntry * count]
+    // 记录直接是 UnitTypeRecord 的内存布局，读入后整块拷进类型表，不做逐字段解析
+
+    static const uint32_t UNIT_PACK_MAGIC = 0x4B415055;     // "UPAK"
+    static const uint32_t UNIT_PACK_VERSION = 1;
+
+    struct UnitPackHeader {
+        uint32_t magic = UNIT_PACK_MAGIC;
+        uint32_t version = UNIT_PACK_VERSION;
+        uint32_t record_size = sizeof(UnitTypeRecord);     // 记录布局变化时旧包会被拒绝
+        uint32_t count = 0;
+    };
+
+    struct UnitPackEntry {
+        int32_t type;
+        UnitTypeRecord record;
+    };
+
+    static_assert(std::is_trivially_copyable<UnitTypeRecord>::value, "UnitTypeRecord 必须是 POD，才能直接写入二进制包");
+    static_assert(std::is_trivially_copyable<UnitPackEntry>::value, "UnitPackEntry 必须是 POD");
+}
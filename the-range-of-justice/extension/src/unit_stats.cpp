@@ -94,6 +94,10 @@ void UnitStats::_bind_methods() {
     ClassDB::bind_method(D_METHOD("get_collision_radius"), &UnitStats::get_collision_radius);
     ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "collision_radius"), "set_collision_radius", "get_collision_radius");
 
+    ClassDB::bind_method(D_METHOD("set_selection_radius", "value"), &UnitStats::set_selection_radius);
+    ClassDB::bind_method(D_METHOD("get_selection_radius"), &UnitStats::get_selection_radius);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "selection_radius"), "set_selection_radius", "get_selection_radius");
+
     ClassDB::bind_method(D_METHOD("set_move_type", "value"), &UnitStats::set_move_type);
     ClassDB::bind_method(D_METHOD("get_move_type"), &UnitStats::get_move_type);
     ADD_PROPERTY(PropertyInfo(Variant::INT, "move_type", PROPERTY_HINT_ENUM, "Ground,Air,Hover"), "set_move_type", "get_move_type");
@@ -29,6 +29,7 @@ namespace godot {
         float move_speed = 200.0f;
         float turn_speed = 5.0f;
         float collision_radius = 10.0f;
+        float selection_radius = 12.0f;
         MoveType move_type = MOVE_GROUND;
 
         // --- 其他 ---
@@ -92,6 +93,9 @@ namespace godot {
         void set_collision_radius(float p_value) { collision_radius = p_value; }
         float get_collision_radius() const { return collision_radius; }
 
+        void set_selection_radius(float p_value) { selection_radius = p_value; }
+        float get_selection_radius() const { return selection_radius; }
+
         void set_move_type(MoveType p_value) { move_type = p_value; }
         MoveType get_move_type() const { return move_type; }
 
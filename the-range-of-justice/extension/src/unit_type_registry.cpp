@@ -0,0 +1,90 @@
+#include "unit_type_registry.h"
+
+using namespace godot;
+
+UnitTypeRegistry* UnitTypeRegistry::get_singleton() {
+    static UnitTypeRegistry singleton;
+    return &singleton;
+}
+
+void UnitTypeRegistry::compile(const UnitStats& p_stats, UnitTypeRecord& r_record) {
+    r_record.move_speed = p_stats.move_speed;
+    r_record.turn_speed = p_stats.turn_speed;
+    r_record.collision_radius = p_stats.collision_radius;
+    r_record.selection_radius = p_stats.selection_radius;
+
+    r_record.health_max = p_stats.health_max;
+    r_record.health_regen = p_stats.health_regen;
+    r_record.shield_max = p_stats.shield_max;
+    r_record.shield_regen = p_stats.shield_regen;
+
+    r_record.attack_damage = p_stats.attack_damage;
+    r_record.attack_range = p_stats.attack_range;
+    r_record.attack_interval = p_stats.attack_interval;
+    r_record.splash_radius = p_stats.splash_radius;
+    r_record.projectile_speed = p_stats.projectile_speed;
+
+    r_record.sight_range = p_stats.sight_range;
+    r_record.aggro_range = p_stats.aggro_range;
+    r_record.build_time = p_stats.build_time;
+    r_record.cost = p_stats.cost;
+    r_record.unit_tags = (uint32_t)(int64_t)p_stats.unit_tags;
+
+    r_record.armor_type = (uint8_t)p_stats.armor_type;
+    r_record.attack_type = (uint8_t)p_stats.attack_type;
+    r_record.move_type = (uint8_t)p_stats.move_type;
+    r_record.target_priority = (uint8_t)p_stats.target_priority;
+}
+
+void UnitTypeRegistry::ensure_type(int p_type) {
+    if (!sim::is_valid_unit_type(p_type)) return;
+
+    table.ensure_type(p_type);
+    if (p_type >= (int)sources.size()) {
+        sources.resize(p_type + 1);
+    }
+}
+
+void UnitTypeRegistry::register_type(int p_type, Ref<UnitStats> p_stats) {
+    if (!sim::is_valid_unit_type(p_type) || p_stats.is_null()) return;
+
+    ensure_type(p_type);
+    sources[p_type] = p_stats;
+
+    UnitTypeRecord record;
+    compile(*p_stats.ptr(), record);
+    table.set_record(p_type, record);
+}
+
+void UnitTypeRegistry::set_record(int p_type, const UnitTypeRecord& p_record) {
+    if (!sim::is_valid_unit_type(p_type)) return;
+
+    ensure_type(p_type);
+    sources[p_type].unref();
+    table.set_record(p_type, p_record);
+}
+
+int UnitTypeRegistry::rebuild_rows(const UnitStats* p_stats) {
+    if (!p_stats) return 0;
+
+    // 类型数量很少，直接线性扫描
+    int rebuilt = 0;
+    for (int i = 0; i < (int)sources.size(); ++i) {
+        if (sources[i].ptr() == p_stats) {
+            UnitTypeRecord record;
+            compile(*p_stats, record);
+            table.set_record(i, record);
+            rebuilt++;
+        }
+    }
+    return rebuilt;
+}
+
+void UnitTypeRegistry::apply_defaults(float p_speed, float p_radius, float p_selection_radius) {
+    table.apply_defaults(p_speed, p_radius, p_selection_radius);
+}
+
+void UnitTypeRegistry::clear() {
+    table.clear();
+    sources.clear();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "unit_stats.h"
+#include "core/unit_types.h"
+
+namespace godot {
+
+    using sim::UnitTypeRecord;
+
+    // 单位类型注册表：把 UnitStats 资源编译进模拟核心的 sim::UnitTypeTable
+    // 单位只保存类型下标，改数值只需要重建对应的一行
+    class UnitTypeRegistry {
+    private:
+        sim::UnitTypeTable table;
+        std::vector<Ref<UnitStats>> sources;     // 每一行对应的资源（来自二进制包或默认值的行为空）
+
+    public:
+        static UnitTypeRegistry* get_singleton();
+
+        // 把 UnitStats 编译成紧凑记录
+        static void compile(const UnitStats& p_stats, UnitTypeRecord& r_record);
+
+        sim::UnitTypeTable& get_table() { return table; }
+
+        bool has_type(int p_type) const { return table.has_type(p_type); }
+
+        // 保证表中存在该行，不存在则以默认值补齐
+        void ensure_type(int p_type);
+
+        // 绑定某个类型的数据来源，并立即编译该行
+        void register_type(int p_type, Ref<UnitStats> p_stats);
+
+        // 直接写入一行已编译好的数据（来自二进制包），该行不再绑定资源
+        void set_record(int p_type, const UnitTypeRecord& p_record);
+
+        Ref<UnitStats> get_source(int p_type) const { return p_type >= 0 && p_type < (int)sources.size() ? sources[p_type] : Ref<UnitStats>(); }
+
+        // 热重载：只重建引用了 p_stats 的行，返回重建的行数
+        int rebuild_rows(const UnitStats* p_stats);
+
+        // 既没有绑定 UnitStats、也没有从包里加载的行使用调试参数
+        void apply_defaults(float p_speed, float p_radius, float p_selection_radius);
+
+        // 释放所有资源引用（模块卸载时调用）
+        void clear();
+
+        const UnitTypeRecord& get(int p_type) const { return table.get(p_type); }
+    };
+}
@@ -1,5 +1,7 @@
 extends Node
 
+const BAKED_FLOW_FIELDS_PATH := "res://data/flow_fields.ffbk"
+
 func _ready() -> void:
 	var tile_map_layer: TileMapLayer = $TileMapLayer
 	var multi_mesh_instance_2d: MultiMeshInstance2D = $MultiMeshInstance2D
@@ -20,12 +22,14 @@ func _ready() -> void:
 	
 	unit_manager.setup_system(width, height, cell_size, grid_origin)
 	
-	for x in range(used_rect.position.x, used_rect.end.x):
-		for y in range(used_rect.position.y, used_rect.end.y):
-			var coords: Vector2i = Vector2i(x, y)
-			var data = tile_map_layer.get_cell_tile_data(coords)
-			if data == null or data.get_custom_data("IsWall"):
-				flow_field_manager.set_cost(coords, 10)
+	# 空格子和 IsWall 格子的代价设为 10，在 C++ 中一次性导入
+	flow_field_manager.import_tile_map_layer(tile_map_layer, "IsWall", 10, 10)
+	# 代价 10 的格子就是墙，单位按墙壁距离场被挡在外面
+	unit_manager.wall_cost = 10
+	
+	# 固定目标的流场由 tools/bake_flow_fields.gd 预先烘焙，文件与当前地图不符时会被拒绝
+	if FileAccess.file_exists(BAKED_FLOW_FIELDS_PATH):
+		flow_field_manager.load_baked_fields(BAKED_FLOW_FIELDS_PATH)
 	
 	for x in range(40):
 		for y in range(40):
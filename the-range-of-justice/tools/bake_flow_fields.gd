@@ -0,0 +1,37 @@
+extends SceneTree
+
+# 构建步骤：为关卡中标记的固定目标（基地、隘口、资源点等）预先烘焙流场
+# 目标点是 main.tscn 中 "flow_field_destinations" 组里的 Node2D，烘焙使用 main.gd 设置好的代价地图
+# 用法: godot --headless --path . --script res://tools/bake_flow_fields.gd -- [输出文件]
+# 地图或代价改动之后需要重新烘焙，否则运行时会拒绝加载旧文件
+
+const MAIN_SCENE := "res://main/main.tscn"
+const DESTINATION_GROUP := "flow_field_destinations"
+
+func _initialize() -> void:
+	var args := OS.get_cmdline_user_args()
+	var output_path: String = args[0] if args.size() > 0 else "res://data/flow_fields.ffbk"
+	
+	# 加入场景树后 main.gd 的 _ready 会完成网格和代价地图的初始化
+	var main: Node = load(MAIN_SCENE).instantiate()
+	root.add_child(main)
+	var flow_field_manager: FlowFieldManager = main.get_node("FlowFieldManager")
+	
+	# main.gd 可能已经映射了旧的烘焙文件，写入前先释放
+	flow_field_manager.clear_all_fields()
+	
+	var targets := PackedVector2iArray()
+	for node in get_nodes_in_group(DESTINATION_GROUP):
+		if node is Node2D:
+			targets.append(flow_field_manager.world_to_grid(node.global_position))
+	
+	if targets.is_empty():
+		print("Error: No nodes in group ", DESTINATION_GROUP)
+		quit(1)
+		return
+	
+	DirAccess.make_dir_recursive_absolute(output_path.get_base_dir())
+	var ok := flow_field_manager.bake_flow_fields(output_path, targets)
+	if ok:
+		print("Baked ", targets.size(), " flow fields to ", output_path)
+	quit(0 if ok else 1)
@@ -0,0 +1,12 @@
+extends SceneTree
+
+# 构建步骤：把单位定义 txt 编译成一个二进制包
+# 用法: godot --headless --path . --script res://tools/compile_unit_pack.gd -- <定义目录> <输出包>
+
+func _init() -> void:
+	var args := OS.get_cmdline_user_args()
+	var source_dir: String = args[0] if args.size() > 0 else "res://data/units"
+	var pack_path: String = args[1] if args.size() > 1 else "res://data/units.upak"
+	
+	var err = UnitLoader.compile_pack(source_dir, pack_path)
+	quit(0 if err == OK else 1)